@@ -93,6 +93,202 @@ PROJECTM_EXPORT void projectm_pcm_add_int16(projectm_handle instance, const int1
 PROJECTM_EXPORT void projectm_pcm_add_uint8(projectm_handle instance, const uint8_t* samples,
                                             unsigned int count, projectm_channels channels);
 
+/**
+ * @brief Adds 32-bit floating-point audio samples with a timestamp.
+ *
+ * Same as projectm_pcm_add_float(), but additionally records the host time of the first sample, e.g.
+ * the time it was captured or submitted to the audio output. Together with
+ * projectm_pcm_set_presentation_time(), this allows projectM to analyze exactly the audio which is
+ * audible while a frame is displayed, independent of the audio block sizes and timing.
+ *
+ * @param instance The projectM instance handle.
+ * @param samples An array of PCM samples.
+ * Each sample is expected to be within the range -1 to 1.
+ * @param count The number of audio samples in a channel.
+ * @param channels If the buffer is mono or stereo.
+ * Can be PROJECTM_MONO or PROJECTM_STEREO.
+ * @param timestamp Host time of the first sample in seconds. Any monotonic clock can be used, as long as
+ *                  the same clock is used for the frame presentation time.
+ */
+PROJECTM_EXPORT void projectm_pcm_add_float_timestamped(projectm_handle instance, const float* samples,
+                                                        unsigned int count, projectm_channels channels,
+                                                        double timestamp);
+
+/**
+ * @brief Adds 16-bit integer audio samples with a timestamp.
+ *
+ * See projectm_pcm_add_float_timestamped() for details.
+ *
+ * @param instance The projectM instance handle.
+ * @param samples An array of PCM samples.
+ * @param count The number of audio samples in a channel.
+ * @param channels If the buffer is mono or stereo.
+ * Can be PROJECTM_MONO or PROJECTM_STEREO.
+ * @param timestamp Host time of the first sample in seconds.
+ */
+PROJECTM_EXPORT void projectm_pcm_add_int16_timestamped(projectm_handle instance, const int16_t* samples,
+                                                        unsigned int count, projectm_channels channels,
+                                                        double timestamp);
+
+/**
+ * @brief Adds 8-bit unsigned integer audio samples with a timestamp.
+ *
+ * See projectm_pcm_add_float_timestamped() for details.
+ *
+ * @param instance The projectM instance handle.
+ * @param samples An array of PCM samples.
+ * @param count The number of audio samples in a channel.
+ * @param channels If the buffer is mono or stereo.
+ * Can be PROJECTM_MONO or PROJECTM_STEREO.
+ * @param timestamp Host time of the first sample in seconds.
+ */
+PROJECTM_EXPORT void projectm_pcm_add_uint8_timestamped(projectm_handle instance, const uint8_t* samples,
+                                                        unsigned int count, projectm_channels channels,
+                                                        double timestamp);
+
+/**
+ * @brief Sets the sample rate of the audio data.
+ *
+ * Used to convert timestamps and the output latency into sample positions. Defaults to 44100 Hz.
+ *
+ * @param instance The projectM instance handle.
+ * @param sample_rate The sample rate in Hz. A value of 0 is ignored.
+ */
+PROJECTM_EXPORT void projectm_pcm_set_sample_rate(projectm_handle instance, unsigned int sample_rate);
+
+/**
+ * @brief Returns the sample rate of the audio data.
+ * @param instance The projectM instance handle.
+ * @return The sample rate in Hz.
+ */
+PROJECTM_EXPORT unsigned int projectm_pcm_get_sample_rate(projectm_handle instance);
+
+/**
+ * @brief Sets the audio output latency.
+ *
+ * This is the time between adding audio data (or the timestamp passed with it) and the samples being
+ * audible, e.g. caused by the audio output buffer. projectM will analyze older samples accordingly
+ * to keep the visuals in sync with what's heard. Limited to about 16000 samples, e.g. roughly 0.37
+ * seconds at 44100 Hz. Defaults to 0.
+ *
+ * @param instance The projectM instance handle.
+ * @param seconds The output latency in seconds. Negative values are treated as 0.
+ */
+PROJECTM_EXPORT void projectm_pcm_set_output_latency(projectm_handle instance, double seconds);
+
+/**
+ * @brief Returns the audio output latency.
+ * @param instance The projectM instance handle.
+ * @return The output latency in seconds.
+ */
+PROJECTM_EXPORT double projectm_pcm_get_output_latency(projectm_handle instance);
+
+/**
+ * @brief Sets the host time at which the next rendered frame will be displayed.
+ *
+ * Only applies to the next call to projectm_opengl_render_frame(). Uses the same clock as the timestamps
+ * passed to the projectm_pcm_add_*_timestamped() functions. If not set, or if no timestamped audio data
+ * was added, the newest audio data is analyzed, delayed by the output latency.
+ *
+ * @param instance The projectM instance handle.
+ * @param presentation_time Host time in seconds at which the next frame will be displayed.
+ */
+PROJECTM_EXPORT void projectm_pcm_set_presentation_time(projectm_handle instance, double presentation_time);
+
+/**
+ * @brief Enables or disables running the audio analysis on a separate worker thread.
+ *
+ * By default, the spectrum analysis, waveform alignment and beat detection run synchronously at the
+ * start of each projectm_opengl_render_frame() call. If enabled, a worker thread analyzes the audio data
+ * for the next frame while the current frame is being rendered. Each frame then uses the audio data
+ * analyzed during the previous frame, adding one frame of latency.
+ *
+ * If the platform doesn't support threads, e.g. Emscripten builds without pthreads, the analysis
+ * will stay synchronous.
+ *
+ * @param instance The projectM instance handle.
+ * @param enabled True to run the audio analysis on a worker thread, false to run it synchronously.
+ */
+PROJECTM_EXPORT void projectm_pcm_set_threaded_analysis(projectm_handle instance, bool enabled);
+
+/**
+ * @brief Returns whether the audio analysis runs on a separate worker thread.
+ * @param instance The projectM instance handle.
+ * @return True if the audio analysis runs on a worker thread, false if it runs synchronously.
+ */
+PROJECTM_EXPORT bool projectm_pcm_get_threaded_analysis(projectm_handle instance);
+
+/**
+ * @brief Sets the waveform for the next frame, bypassing projectM's audio analysis.
+ *
+ * Applications which already analyze the audio, e.g. for their own spectrum display, can pass
+ * the results to projectM instead of having it analyze the PCM data again. If any of the
+ * projectm_pcm_set_frame_*() functions was called, the next projectm_opengl_render_frame() call
+ * uses the supplied data and skips projectM's own analysis completely. Data not supplied for a
+ * frame is silent, except for the beat detection values, see projectm_pcm_set_frame_beat_values().
+ *
+ * Supplied data is only used for a single frame and must be set again for each frame.
+ *
+ * @param instance The projectM instance handle.
+ * @param left projectm_pcm_get_max_samples() left channel samples. Values should be in the range of
+ *             about -128 to 128, which is how projectM scales its waveform data.
+ * @param right projectm_pcm_get_max_samples() right channel samples, scaled like the left channel.
+ */
+PROJECTM_EXPORT void projectm_pcm_set_frame_waveform(projectm_handle instance, const float* left, const float* right);
+
+/**
+ * @brief Sets the spectrum for the next frame, bypassing projectM's audio analysis.
+ *
+ * See projectm_pcm_set_frame_waveform() for details. The spectrum covers frequencies from 0 Hz to
+ * half the sample rate, evenly spaced.
+ *
+ * @param instance The projectM instance handle.
+ * @param left projectm_pcm_get_spectrum_samples() left channel frequency magnitudes.
+ * @param right projectm_pcm_get_spectrum_samples() right channel frequency magnitudes.
+ */
+PROJECTM_EXPORT void projectm_pcm_set_frame_spectrum(projectm_handle instance, const float* left, const float* right);
+
+/**
+ * @brief Sets the beat detection values for the next frame, bypassing projectM's audio analysis.
+ *
+ * See projectm_pcm_set_frame_waveform() for details. All values are loudness values relative to the
+ * recent past, revolving around 1.0, with values below 0.7 being very silent and above 1.3 very loud.
+ * The beat sensitivity is applied on top of these values.
+ *
+ * If not set for a frame, but waveform or spectrum data was supplied, the values are calculated
+ * from the supplied spectrum using projectM's beat detection.
+ *
+ * @param instance The projectM instance handle.
+ * @param bass Bass loudness.
+ * @param mid Middles loudness.
+ * @param treb Treble loudness.
+ * @param bass_att Attenuated (time-smoothed) bass loudness.
+ * @param mid_att Attenuated (time-smoothed) middles loudness.
+ * @param treb_att Attenuated (time-smoothed) treble loudness.
+ */
+PROJECTM_EXPORT void projectm_pcm_set_frame_beat_values(projectm_handle instance, float bass, float mid, float treb,
+                                                        float bass_att, float mid_att, float treb_att);
+
+/**
+ * @brief Returns the number of values in the spectrum data.
+ * @return The number of spectrum values per channel.
+ */
+PROJECTM_EXPORT unsigned int projectm_pcm_get_spectrum_samples();
+
+/**
+ * @brief Returns the spectrum used to render the last frame.
+ *
+ * Applications can use this to display a spectrum without running their own analysis. The returned
+ * array holds projectm_pcm_get_spectrum_samples() values and is read-only. It stays valid until the
+ * next call to projectm_opengl_render_frame() or destroying the instance. Before the first frame is
+ * rendered, all values are zero.
+ *
+ * @param instance The projectM instance handle.
+ * @param channel The channel to return, either PROJECTM_CHANNEL_L or PROJECTM_CHANNEL_R.
+ * @return A pointer to the spectrum values, or NULL if the channel is invalid.
+ */
+PROJECTM_EXPORT const float* projectm_pcm_get_spectrum(projectm_handle instance, projectm_pcm_channel channel);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
@@ -54,6 +54,21 @@ typedef void (*projectm_preset_switch_requested_event)(bool is_hard_cut, void* u
 typedef void (*projectm_preset_switch_failed_event)(const char* preset_filename,
                                                     const char* message, void* user_data);
 
+/**
+ * @brief Callback function that is executed once for a preset if it exceeds the expression time budget.
+ *
+ * The preset keeps running, but its expression code is no longer evaluated after it exceeded the
+ * budget set with projectm_set_expression_time_budget(). The application can decide whether to
+ * switch to another preset.
+ *
+ * The filename pointer is only valid inside the callback. Make a copy if this value needs to be
+ * retained for later use.
+ *
+ * @param preset_filename The filename of the preset, or an empty string if it was loaded from data.
+ * @param user_data A user-defined data pointer that was provided when registering the callback,
+ *                  e.g. context information.
+ */
+typedef void (*projectm_preset_time_budget_exceeded_event)(const char* preset_filename, void* user_data);
 
 /**
  * @brief Sets a callback function that will be called when a preset change is requested.
@@ -83,6 +98,20 @@ PROJECTM_EXPORT void projectm_set_preset_switch_failed_event_callback(projectm_h
                                                                       projectm_preset_switch_failed_event callback,
                                                                       void* user_data);
 
+/**
+ * @brief Sets a callback function that will be called when a preset exceeds the expression time budget.
+ *
+ * Only one callback can be registered per projectM instance. To remove the callback, use NULL.
+ *
+ * @param instance The projectM instance handle.
+ * @param callback A pointer to the callback function.
+ * @param user_data A pointer to any data that will be sent back in the callback, e.g. context
+ *                  information.
+ */
+PROJECTM_EXPORT void projectm_set_preset_time_budget_exceeded_event_callback(projectm_handle instance,
+                                                                             projectm_preset_time_budget_exceeded_event callback,
+                                                                             void* user_data);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
@@ -42,12 +42,34 @@ extern "C" {
  */
 PROJECTM_EXPORT projectm_handle projectm_create();
 
+/**
+ * @brief Creates a new projectM instance with a custom spectrum analyzer size.
+ *
+ * By default, projectM analyzes 480 audio samples with a 1024-point FFT, resulting in 512 frequency
+ * values, like Milkdrop does. This function allows using a smaller analyzer on low-end devices, or
+ * a larger analyzer with a longer audio window and finer frequency resolution on fast machines.
+ * Presets still see 512 frequency values, as the analyzer output is resampled to this size.
+ *
+ * Examples:
+ * - Low-cost analysis: 256 frequencies, 240 window samples.
+ * - High-resolution analysis: 2048 frequencies, 1920 window samples.
+ *
+ * @param spectrum_samples The number of analyzed frequencies, half the FFT size. Must be a power of
+ *                         two between 128 and 4096.
+ * @param window_samples The number of audio samples passed into the FFT. Must be between 1 and
+ *                       twice the number of frequencies.
+ * @return A projectM handle for the newly created instance that must be used in subsequent API calls.
+ *         NULL if the sizes are invalid or the instance could not be created successfully.
+ */
+PROJECTM_EXPORT projectm_handle projectm_create_with_audio_analysis_size(unsigned int spectrum_samples,
+                                                                         unsigned int window_samples);
+
 /**
  * @brief Destroys the given instance and frees the resources.
  *
  * After destroying the handle, it must not be used for any other calls to the API.
  *
- * @param instance A handle returned by projectm_create() or projectm_create_settings().
+ * @param instance A handle returned by projectm_create() or projectm_create_with_audio_analysis_size().
  */
 PROJECTM_EXPORT void projectm_destroy(projectm_handle instance);
 
@@ -71,6 +93,57 @@ PROJECTM_EXPORT void projectm_destroy(projectm_handle instance);
 PROJECTM_EXPORT void projectm_load_preset_file(projectm_handle instance, const char* filename,
                                                bool smooth_transition);
 
+/**
+ * @brief Loads a preset from the given filename/URL in the background.
+ *
+ * Works like projectm_load_preset_file(), but the preset file is read and parsed, its expression
+ * code compiled and its shaders translated to GLSL on a worker thread, so this call returns
+ * immediately. The current preset continues to be displayed until the new preset is ready, which
+ * usually happens a few frames later inside projectm_opengl_render_frame(). Only the steps which
+ * need the OpenGL context, creating the preset's textures and compiling the GLSL shaders, run on
+ * the rendering thread. If the driver supports KHR_parallel_shader_compile, the GLSL shaders are
+ * compiled by the driver in the background as well, and the switch takes place once they're done.
+ *
+ * If the preset can't be loaded, the preset switch failed callback is called from within
+ * projectm_opengl_render_frame() and the current preset continues to be displayed.
+ *
+ * Only the most recent request is loaded. Calling this function again, or calling
+ * projectm_load_preset_file() or projectm_load_preset_data(), discards any preset still being loaded.
+ *
+ * @param instance The projectM instance handle.
+ * @param filename The preset filename or URL to load.
+ * @param smooth_transition If true, the new preset is smoothly blended over.
+ */
+PROJECTM_EXPORT void projectm_load_preset_file_async(projectm_handle instance, const char* filename,
+                                                     bool smooth_transition);
+
+/**
+ * @brief Returns whether a preset is currently being loaded in the background.
+ * @param instance The projectM instance handle.
+ * @return True if a preset requested via projectm_load_preset_file_async() isn't displayed yet,
+ *         false otherwise.
+ */
+PROJECTM_EXPORT bool projectm_is_preset_loading(projectm_handle instance);
+
+/**
+ * @brief Prepares a preset in the background so a later load is quicker.
+ *
+ * The preset file is read and parsed, and the preset shaders are translated to GLSL, mostly on a
+ * worker thread like projectm_load_preset_file_async() does. The next call to
+ * projectm_load_preset_file() or projectm_load_preset_file_async() with the same filename then only
+ * has to compile the preset's expression code and GLSL shaders. Each prefetched preset is only used
+ * once, and only if the file's modification time and size didn't change since it was prefetched.
+ *
+ * Only local files and "file://" URLs are prefetched, other URLs are ignored. Prefetching requires
+ * thread support, otherwise this call does nothing. The number of prefetched presets is limited,
+ * see projectm_set_preset_prefetch_limit(). Parts of the preparation run inside
+ * projectm_opengl_render_frame(), so this function must be called from the rendering thread.
+ *
+ * @param instance The projectM instance handle.
+ * @param filename The preset filename or URL, exactly as it will be passed to the load function.
+ */
+PROJECTM_EXPORT void projectm_prefetch_preset_file(projectm_handle instance, const char* filename);
+
 /**
  * @brief Loads a preset from the data pointer.
  *
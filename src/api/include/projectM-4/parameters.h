@@ -215,6 +215,70 @@ PROJECTM_EXPORT void projectm_set_fps(projectm_handle instance, int32_t fps);
  */
 PROJECTM_EXPORT int32_t projectm_get_fps(projectm_handle instance);
 
+/**
+ * @brief Sets the maximum time presets may spend evaluating their expression code in each frame.
+ *
+ * The budget applies to the whole frame, so during a transition both presets share it. If a preset
+ * exceeds it, none of its remaining expression code is evaluated, neither in that frame nor in any
+ * following frame, so a slow preset can only overrun the budget once. The preset is then drawn with
+ * its initial per-frame values, the per-pixel mesh keeps its last values and custom shapes and waves
+ * are skipped. The callback set with projectm_set_preset_time_budget_exceeded_event_callback() is
+ * called once for each affected preset, so the application can switch to another preset.
+ *
+ * If the library was built with the expression JIT, loops in compiled code are aborted as soon as
+ * the budget is used up. Code run by the expression interpreter can't be interrupted, so a single
+ * execution, e.g. of a long loop in the per-frame code, can still take longer than the budget.
+ *
+ * Setting the budget to 0 resumes expression evaluation of presets which exceeded it.
+ *
+ * @param instance The projectM instance handle.
+ * @param seconds The time budget in seconds. 0 or less disables the limit, which is the default.
+ */
+PROJECTM_EXPORT void projectm_set_expression_time_budget(projectm_handle instance, double seconds);
+
+/**
+ * @brief Returns the maximum time presets may spend evaluating their expression code in each frame.
+ * @param instance The projectM instance handle.
+ * @return The time budget in seconds, or 0 if unlimited.
+ */
+PROJECTM_EXPORT double projectm_get_expression_time_budget(projectm_handle instance);
+
+/**
+ * @brief Sets the directory to store compiled shader program binaries in.
+ *
+ * Linked shader programs are written into this directory and loaded from there on subsequent
+ * runs, which skips compiling the preset shaders again. Files written by other drivers or
+ * projectM versions are ignored. This requires driver support for program binaries, otherwise
+ * the setting has no effect.
+ *
+ * The cache is shared by all projectM instances in the process. The directory must exist and be
+ * writable by the application.
+ *
+ * @param instance The projectM instance handle.
+ * @param path The cache directory. NULL or an empty string disables the cache, which is the default.
+ */
+PROJECTM_EXPORT void projectm_set_shader_cache_path(projectm_handle instance, const char* path);
+
+/**
+ * @brief Sets the maximum number of presets kept prepared via projectm_prefetch_preset_file().
+ *
+ * The limit is a number of presets, not a memory size. A prefetched preset holds its parsed code,
+ * translated shaders and allocated textures, so its memory use depends on the preset and can be far
+ * larger than its file. If the limit is reached, the presets requested longest ago are dropped
+ * first. Lowering the limit drops already prefetched presets until the new limit is met.
+ *
+ * @param instance The projectM instance handle.
+ * @param count The maximum number of prefetched presets. 0 disables prefetching. Default is 4.
+ */
+PROJECTM_EXPORT void projectm_set_preset_prefetch_limit(projectm_handle instance, uint32_t count);
+
+/**
+ * @brief Returns the maximum number of presets kept prepared via projectm_prefetch_preset_file().
+ * @param instance The projectM instance handle.
+ * @return The maximum number of prefetched presets.
+ */
+PROJECTM_EXPORT uint32_t projectm_get_preset_prefetch_limit(projectm_handle instance);
+
 /**
  * @brief Enabled or disables aspect ratio correction in presets that support it.
  *
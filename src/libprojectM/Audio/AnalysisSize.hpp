@@ -0,0 +1,56 @@
+/**
+ * @file AnalysisSize.hpp
+ * @brief Spectrum analyzer sizes, selectable per projectM instance.
+ */
+
+#pragma once
+
+#include "AudioConstants.hpp"
+
+#include <cstdint>
+
+namespace libprojectM {
+namespace Audio {
+
+/**
+ * @brief Spectrum analyzer sizes used by a PCM instance.
+ *
+ * The spectrum analyzer can run with a different resolution than the legacy Milkdrop analyzer, e.g.
+ * with fewer frequencies on low-end devices or with more frequencies and a longer time window for a
+ * more detailed spectrum. The result is always resampled to SpectrumSamples frequencies, so presets,
+ * waveforms and beat detection see the same data layout regardless of the analyzer size.
+ *
+ * The default values are identical to the legacy Milkdrop analyzer.
+ */
+struct AnalysisSize {
+    static constexpr uint32_t MinSpectrumSamples = 128;  //!< Smallest supported number of analyzed frequencies.
+    static constexpr uint32_t MaxSpectrumSamples = 4096; //!< Largest supported number of analyzed frequencies.
+
+    uint32_t spectrumSamples{SpectrumSamples}; //!< Number of analyzed frequencies. The FFT size is twice this value. Must be a power of two.
+    uint32_t windowSamples{WaveformSamples};   //!< Number of waveform samples passed into the FFT. Must not exceed the FFT size.
+
+    /**
+     * @brief Checks if the sizes are supported by the spectrum analyzer.
+     * @return true if both sizes are valid, false if not.
+     */
+    auto IsValid() const -> bool
+    {
+        return spectrumSamples >= MinSpectrumSamples &&
+               spectrumSamples <= MaxSpectrumSamples &&
+               (spectrumSamples & (spectrumSamples - 1)) == 0 &&
+               windowSamples > 0 &&
+               windowSamples <= 2 * spectrumSamples;
+    }
+
+    /**
+     * @brief Checks if the sizes are identical to the legacy Milkdrop analyzer.
+     * @return true if both sizes match the legacy analyzer.
+     */
+    auto IsLegacy() const -> bool
+    {
+        return spectrumSamples == SpectrumSamples && windowSamples == WaveformSamples;
+    }
+};
+
+} // namespace Audio
+} // namespace libprojectM
@@ -0,0 +1,126 @@
+#include "AnalysisThread.hpp"
+
+#include "PCM.hpp"
+
+#include <system_error>
+
+namespace libprojectM {
+namespace Audio {
+
+AnalysisThread::AnalysisThread(PCM& pcm)
+    : m_pcm(pcm)
+{
+}
+
+AnalysisThread::~AnalysisThread()
+{
+    Stop();
+}
+
+auto AnalysisThread::Start() -> bool
+{
+    if (m_thread.joinable())
+    {
+        return true;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_requestMutex);
+        m_stopRequested = false;
+        m_updateRequested = false;
+        m_pendingSeconds = 0.0;
+    }
+
+    try
+    {
+        m_thread = std::thread(&AnalysisThread::Run, this);
+    }
+    catch (const std::system_error&)
+    {
+        // No thread support, e.g. Emscripten builds without pthreads.
+        return false;
+    }
+
+    return true;
+}
+
+void AnalysisThread::Stop()
+{
+    if (!m_thread.joinable())
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_requestMutex);
+        m_stopRequested = true;
+    }
+    m_requestCondition.notify_one();
+
+    m_thread.join();
+}
+
+auto AnalysisThread::IsRunning() const -> bool
+{
+    return m_thread.joinable();
+}
+
+void AnalysisThread::RequestUpdate(double secondsSinceLastFrame, uint32_t frame, float beatSensitivity,
+                                   double presentationTime)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_requestMutex);
+        m_updateRequested = true;
+        m_pendingSeconds += secondsSinceLastFrame;
+        m_pendingFrame = frame;
+        m_pendingBeatSensitivity = beatSensitivity;
+        m_pendingPresentationTime = presentationTime;
+    }
+    m_requestCondition.notify_one();
+}
+
+auto AnalysisThread::LatestFrameAudioData() const -> FrameAudioData::Ptr
+{
+    std::lock_guard<std::mutex> lock(m_publishMutex);
+    return m_latestFrameData;
+}
+
+void AnalysisThread::Run()
+{
+    while (true)
+    {
+        double secondsSinceLastFrame{};
+        uint32_t frame{};
+        float beatSensitivity{};
+        double presentationTime{};
+
+        {
+            std::unique_lock<std::mutex> lock(m_requestMutex);
+            m_requestCondition.wait(lock, [this] { return m_stopRequested || m_updateRequested; });
+
+            // Finish a pending request before exiting, so its result is available after Stop().
+            if (!m_updateRequested)
+            {
+                return;
+            }
+
+            secondsSinceLastFrame = m_pendingSeconds;
+            frame = m_pendingFrame;
+            beatSensitivity = m_pendingBeatSensitivity;
+            presentationTime = m_pendingPresentationTime;
+            m_pendingSeconds = 0.0;
+            m_updateRequested = false;
+        }
+
+        m_pcm.UpdateFrameAudioData(secondsSinceLastFrame, frame, presentationTime);
+        auto frameData = m_pcm.GetFrameAudioData(beatSensitivity);
+
+        // The previous snapshot is released outside the lock, as it may be the last reference.
+        std::unique_lock<std::mutex> lock(m_publishMutex);
+        m_latestFrameData.swap(frameData);
+        lock.unlock();
+    }
+}
+
+} // namespace Audio
+} // namespace libprojectM
@@ -0,0 +1,115 @@
+/**
+ * @file AnalysisThread.hpp
+ * @brief Runs the per-frame audio analysis on a separate worker thread.
+ */
+
+#pragma once
+
+#include "FrameAudioData.hpp"
+
+#include <condition_variable>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <thread>
+
+namespace libprojectM {
+namespace Audio {
+
+class PCM;
+
+/**
+ * @class AnalysisThread
+ * @brief Runs PCM::UpdateFrameAudioData() on a worker thread, pipelined with rendering.
+ *
+ * Each rendered frame requests the next analysis pass via RequestUpdate() and retrieves the most
+ * recently published result with LatestFrameAudioData(). Neither call waits for the analysis to
+ * finish, so the spectrum analysis, waveform alignment and beat detection overlap with rendering.
+ * The audio data used for a frame is usually the one requested in the previous frame.
+ *
+ * Each analysis pass creates a new immutable FrameAudioData snapshot without holding any lock, then
+ * publishes it by swapping the shared pointer. Snapshots still used by the render thread stay valid.
+ * If the render thread requests updates faster than the worker can process them, the pending
+ * requests are merged, adding up the elapsed time.
+ *
+ * While the thread is running, it is the only caller of the PCM update/get functions. Audio data
+ * can still be added to the PCM instance from any single thread.
+ */
+class AnalysisThread
+{
+public:
+    /**
+     * @brief Constructor.
+     * @param pcm The PCM instance to analyze. Must outlive this object.
+     */
+    explicit AnalysisThread(PCM& pcm);
+
+    /**
+     * @brief Destructor. Stops the worker thread if it is running.
+     */
+    ~AnalysisThread();
+
+    AnalysisThread(const AnalysisThread&) = delete;
+    auto operator=(const AnalysisThread&) -> AnalysisThread& = delete;
+
+    /**
+     * @brief Starts the worker thread.
+     * @return true if the thread is running, false if threads are not available on this platform.
+     */
+    auto Start() -> bool;
+
+    /**
+     * @brief Stops the worker thread and waits for it to finish the pending analysis pass.
+     * Afterwards, LatestFrameAudioData() returns the result of the last request and the PCM
+     * instance can be updated synchronously again.
+     */
+    void Stop();
+
+    /**
+     * @brief Returns whether the worker thread is currently running.
+     * @return true if the worker thread is running, false if not.
+     */
+    auto IsRunning() const -> bool;
+
+    /**
+     * @brief Requests a new analysis pass. Returns immediately.
+     * @param secondsSinceLastFrame Time passed since rendering the last frame. Basically 1.0/FPS.
+     * @param frame Frames rendered since projectM was started.
+     * @param beatSensitivity The beat sensitivity stored in the resulting snapshot.
+     * @param presentationTime Host time at which the analyzed frame will be displayed, see PCM::UpdateFrameAudioData().
+     */
+    void RequestUpdate(double secondsSinceLastFrame, uint32_t frame, float beatSensitivity,
+                       double presentationTime = std::numeric_limits<double>::quiet_NaN());
+
+    /**
+     * @brief Returns the most recently published audio data snapshot.
+     * Never waits for a running analysis pass.
+     * @return A shared FrameAudioData snapshot with waveform, spectrum and other derived values.
+     */
+    auto LatestFrameAudioData() const -> FrameAudioData::Ptr;
+
+private:
+    /**
+     * @brief Worker thread main loop.
+     */
+    void Run();
+
+    PCM& m_pcm; //!< The PCM instance to analyze.
+
+    std::thread m_thread; //!< The worker thread.
+
+    std::mutex m_requestMutex;                  //!< Protects the request state below.
+    std::condition_variable m_requestCondition; //!< Signals new requests or stopping to the worker.
+    bool m_stopRequested{false};                //!< If true, the worker thread will exit.
+    bool m_updateRequested{false};              //!< If true, an analysis pass is pending.
+    double m_pendingSeconds{0.0};               //!< Accumulated time since the last processed request.
+    uint32_t m_pendingFrame{0};                 //!< Frame number of the latest request.
+    float m_pendingBeatSensitivity{1.0f};       //!< Beat sensitivity of the latest request.
+    double m_pendingPresentationTime{0.0};      //!< Presentation time of the latest request.
+
+    mutable std::mutex m_publishMutex;                                         //!< Protects the published snapshot pointer.
+    FrameAudioData::Ptr m_latestFrameData{std::make_shared<FrameAudioData>()}; //!< The most recently published snapshot.
+};
+
+} // namespace Audio
+} // namespace libprojectM
@@ -5,9 +5,11 @@
 namespace libprojectM {
 namespace Audio {
 
-static constexpr int AudioBufferSamples = 576; //!< Number of waveform data samples stored in the buffer for analysis.
-static constexpr int WaveformSamples = 480;    //!< Number of waveform data samples available for rendering a frame.
-static constexpr int SpectrumSamples = 512;    //!< Number of spectrum analyzer samples.
+static constexpr int AudioBufferSamples = 576;   //!< Number of waveform data samples stored in the buffer for analysis.
+static constexpr int WaveformSamples = 480;      //!< Number of waveform data samples available for rendering a frame.
+static constexpr int SpectrumSamples = 512;      //!< Number of spectrum analyzer samples.
+static constexpr int HistorySamples = 16384;     //!< Number of past input samples kept for latency compensation. Must be a power of two.
+static constexpr int DefaultSampleRate = 44100;  //!< Assumed input sample rate if not set by the application.
 
 using WaveformBuffer = std::array<float, AudioBufferSamples>; //!< Buffer with waveform data. Only the first WaveformSamples number of samples are valid.
 using SpectrumBuffer = std::array<float, SpectrumSamples>;    //!< Buffer with spectrum data.
@@ -0,0 +1,87 @@
+#include "ExternalAnalyzer.hpp"
+
+#include <algorithm>
+
+namespace libprojectM {
+namespace Audio {
+
+void ExternalAnalyzer::SetWaveform(const float* left, const float* right)
+{
+    auto& data = PendingData();
+    std::copy_n(left, WaveformSamples, data.waveformLeft.begin());
+    std::copy_n(right, WaveformSamples, data.waveformRight.begin());
+}
+
+void ExternalAnalyzer::SetSpectrum(const float* left, const float* right)
+{
+    auto& data = PendingData();
+    std::copy_n(left, SpectrumSamples, data.spectrumLeft.begin());
+    std::copy_n(right, SpectrumSamples, data.spectrumRight.begin());
+}
+
+void ExternalAnalyzer::SetBeatValues(float bass, float mid, float treb, float bassAtt, float midAtt, float trebAtt)
+{
+    auto& data = PendingData();
+    data.bass = bass;
+    data.mid = mid;
+    data.treb = treb;
+    data.bassAtt = bassAtt;
+    data.midAtt = midAtt;
+    data.trebAtt = trebAtt;
+    m_hasBeatValues = true;
+}
+
+auto ExternalAnalyzer::HasPendingData() const -> bool
+{
+    return m_pendingData != nullptr;
+}
+
+auto ExternalAnalyzer::TakeFrameAudioData(double secondsSinceLastFrame, uint32_t frame, float beatSensitivity) -> FrameAudioData::Ptr
+{
+    if (!m_pendingData)
+    {
+        return {};
+    }
+
+    auto& data = *m_pendingData;
+
+    if (!m_hasBeatValues)
+    {
+        // Same as PCM, all bands use the left channel.
+        m_bass.Update(data.spectrumLeft, secondsSinceLastFrame, frame);
+        m_middles.Update(data.spectrumLeft, secondsSinceLastFrame, frame);
+        m_treble.Update(data.spectrumLeft, secondsSinceLastFrame, frame);
+
+        data.bass = m_bass.CurrentRelative();
+        data.mid = m_middles.CurrentRelative();
+        data.treb = m_treble.CurrentRelative();
+
+        data.bassAtt = m_bass.AverageRelative();
+        data.midAtt = m_middles.AverageRelative();
+        data.trebAtt = m_treble.AverageRelative();
+    }
+
+    data.vol = (data.bass + data.mid + data.treb) * 0.333f;
+    data.volAtt = (data.bassAtt + data.midAtt + data.trebAtt) * 0.333f;
+    data.beatSensitivity = beatSensitivity;
+
+    m_hasBeatValues = false;
+
+    FrameAudioData::Ptr frameData = std::move(m_pendingData);
+    m_pendingData.reset();
+
+    return frameData;
+}
+
+auto ExternalAnalyzer::PendingData() -> FrameAudioData&
+{
+    if (!m_pendingData)
+    {
+        m_pendingData = std::make_shared<FrameAudioData>();
+    }
+
+    return *m_pendingData;
+}
+
+} // namespace Audio
+} // namespace libprojectM
@@ -0,0 +1,98 @@
+/**
+ * @file ExternalAnalyzer.hpp
+ * @brief Creates frame audio data from analysis results supplied by the application.
+ */
+
+#pragma once
+
+#include "FrameAudioData.hpp"
+#include "Loudness.hpp"
+
+#include <projectM-4/projectM_export.h>
+
+#include <cstdint>
+#include <memory>
+
+namespace libprojectM {
+namespace Audio {
+
+/**
+ * @class ExternalAnalyzer
+ * @brief Creates frame audio data from analysis results supplied by the application.
+ *
+ * Applications which already analyze the audio for their own purposes can pass the waveform,
+ * spectrum and/or beat detection values for the next frame, replacing projectM's own analysis.
+ * Data not supplied by the application is silent, except for the beat detection values: if
+ * only a spectrum is supplied, they are calculated from it using projectM's beat detection.
+ *
+ * The data is written directly into the next frame's snapshot, so it is only copied once. Uses
+ * its own beat detection state, so it doesn't interfere with a PCM instance analyzed on a worker
+ * thread at the same time.
+ */
+class ExternalAnalyzer
+{
+public:
+    /**
+     * @brief Sets the waveform for the next frame.
+     * @param left WaveformSamples left channel samples, scaled like the analyzer output.
+     * @param right WaveformSamples right channel samples, scaled like the analyzer output.
+     */
+    PROJECTM_EXPORT void SetWaveform(const float* left, const float* right);
+
+    /**
+     * @brief Sets the spectrum for the next frame.
+     * @param left SpectrumSamples left channel frequency magnitudes.
+     * @param right SpectrumSamples right channel frequency magnitudes.
+     */
+    PROJECTM_EXPORT void SetSpectrum(const float* left, const float* right);
+
+    /**
+     * @brief Sets the beat detection values for the next frame.
+     *
+     * All values are relative loudness values revolving around 1.0, see Loudness.
+     *
+     * @param bass Bass loudness.
+     * @param mid Middles loudness.
+     * @param treb Treble loudness.
+     * @param bassAtt Attenuated bass loudness.
+     * @param midAtt Attenuated middles loudness.
+     * @param trebAtt Attenuated treble loudness.
+     */
+    PROJECTM_EXPORT void SetBeatValues(float bass, float mid, float treb, float bassAtt, float midAtt, float trebAtt);
+
+    /**
+     * @brief Returns whether any data was supplied for the next frame.
+     * @return true if the next frame should use the supplied data, false if not.
+     */
+    PROJECTM_EXPORT auto HasPendingData() const -> bool;
+
+    /**
+     * @brief Finalizes and returns the supplied data for the next frame.
+     *
+     * Calculates the beat detection values from the spectrum if they weren't supplied. Afterwards,
+     * no data is pending anymore.
+     *
+     * @param secondsSinceLastFrame Time passed since rendering the last frame. Basically 1.0/FPS.
+     * @param frame Frames rendered since projectM was started.
+     * @param beatSensitivity The beat sensitivity stored in the snapshot, see FrameAudioData.
+     * @return The frame audio data snapshot, or an empty pointer if no data is pending.
+     */
+    PROJECTM_EXPORT auto TakeFrameAudioData(double secondsSinceLastFrame, uint32_t frame, float beatSensitivity) -> FrameAudioData::Ptr;
+
+private:
+    /**
+     * @brief Returns the snapshot for the next frame, creating it if needed.
+     * @return The writable snapshot for the next frame.
+     */
+    auto PendingData() -> FrameAudioData&;
+
+    std::shared_ptr<FrameAudioData> m_pendingData; //!< Snapshot for the next frame, empty if no data was supplied.
+    bool m_hasBeatValues{false};                   //!< True if the application supplied the beat detection values.
+
+    Loudness m_bass{Loudness::Band::Bass};       //!< Beat detection for the "bass" band if calculated from the spectrum.
+    Loudness m_middles{Loudness::Band::Middles}; //!< Beat detection for the "middles" band if calculated from the spectrum.
+    Loudness m_treble{Loudness::Band::Treble};   //!< Beat detection for the "treble" band if calculated from the spectrum.
+};
+
+} // namespace Audio
+} // namespace libprojectM
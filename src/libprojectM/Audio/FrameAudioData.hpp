@@ -10,13 +10,70 @@
 #include "AudioConstants.hpp"
 
 #include <array>
+#include <memory>
 
 namespace libprojectM {
 namespace Audio {
 
+/**
+ * @brief Immutable audio data snapshot for a single frame.
+ *
+ * The audio analyzer creates exactly one instance per frame, which is then shared via a Ptr by
+ * everything rendering this frame, e.g. presets, waveforms, shaders and transitions. To prevent
+ * accidental copies of the waveform and spectrum arrays, the class is not copyable.
+ *
+ * The beat detection members hold the unscaled analyzer output. The user-defined beat sensitivity
+ * is stored alongside and applied by the accessor functions, which consumers should use instead.
+ */
 class PROJECTM_EXPORT FrameAudioData
 {
 public:
+    using Ptr = std::shared_ptr<const FrameAudioData>;
+
+    FrameAudioData() = default;
+    FrameAudioData(const FrameAudioData&) = delete;
+    auto operator=(const FrameAudioData&) -> FrameAudioData& = delete;
+
+    auto Bass() const -> float
+    {
+        return bass * beatSensitivity;
+    }
+
+    auto BassAtt() const -> float
+    {
+        return bassAtt * beatSensitivity;
+    }
+
+    auto Mid() const -> float
+    {
+        return mid * beatSensitivity;
+    }
+
+    auto MidAtt() const -> float
+    {
+        return midAtt * beatSensitivity;
+    }
+
+    auto Treb() const -> float
+    {
+        return treb * beatSensitivity;
+    }
+
+    auto TrebAtt() const -> float
+    {
+        return trebAtt * beatSensitivity;
+    }
+
+    auto Vol() const -> float
+    {
+        return vol * beatSensitivity;
+    }
+
+    auto VolAtt() const -> float
+    {
+        return volAtt * beatSensitivity;
+    }
+
     float bass{0.f};
     float bassAtt{0.f};
     float mid{0.f};
@@ -27,11 +84,13 @@ public:
     float vol{0.f};
     float volAtt{0.f};
 
-    std::array<float, WaveformSamples> waveformLeft;
-    std::array<float, WaveformSamples> waveformRight;
+    float beatSensitivity{1.f}; //!< Multiplier applied to all beat detection values by the accessors.
+
+    std::array<float, WaveformSamples> waveformLeft{};
+    std::array<float, WaveformSamples> waveformRight{};
 
-    std::array<float, SpectrumSamples> spectrumLeft;
-    std::array<float, SpectrumSamples> spectrumRight;
+    std::array<float, SpectrumSamples> spectrumLeft{};
+    std::array<float, SpectrumSamples> spectrumRight{};
 };
 
 } // namespace Audio
@@ -1,12 +1,34 @@
 #include "PCM.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <memory>
+
 namespace libprojectM {
 namespace Audio {
 
-template<
-    int signalAmplitude,
-    int signalOffset,
-    typename SampleType>
+static_assert((HistorySamples & (HistorySamples - 1)) == 0, "HistorySamples must be a power of two.");
+static_assert(HistorySamples > SampleRingBuffer::Capacity, "HistorySamples must be larger than the input buffer.");
+static_assert(HistorySamples >= 2 * AnalysisSize::MaxSpectrumSamples + AudioBufferSamples - WaveformSamples,
+              "HistorySamples must hold the largest spectrum analyzer window.");
+
+PCM::PCM(const AnalysisSize& analysisSize)
+    : m_analysisSize(analysisSize.IsValid() ? analysisSize : AnalysisSize())
+    , m_historyWindowSamples(std::max<size_t>(AudioBufferSamples, m_analysisSize.windowSamples + AudioBufferSamples - WaveformSamples))
+    , m_spectrumInputL(m_analysisSize.windowSamples)
+    , m_spectrumInputR(m_analysisSize.windowSamples)
+    , m_fft(m_analysisSize.windowSamples, m_analysisSize.spectrumSamples, true)
+    , m_spectrumResampler(m_analysisSize.spectrumSamples, SpectrumSamples,
+                          std::sqrt(static_cast<float>(WaveformSamples) / static_cast<float>(m_analysisSize.windowSamples)))
+{
+    if (!m_analysisSize.IsLegacy())
+    {
+        m_analyzerSpectrumL.resize(m_analysisSize.spectrumSamples);
+        m_analyzerSpectrumR.resize(m_analysisSize.spectrumSamples);
+    }
+}
+
+template<typename SampleType>
 void PCM::AddToBuffer(
     SampleType const* const samples,
     uint32_t channels,
@@ -17,44 +39,109 @@ void PCM::AddToBuffer(
         return;
     }
 
-    for (size_t i = 0; i < sampleCount; i++)
+    auto const region = m_inputBuffer.PrepareWrite(sampleCount);
+
+    // If the block doesn't fit, only its newest samples are stored.
+    size_t const writeCount = region.length[0] + region.length[1];
+    SampleType const* source = samples + (sampleCount - writeCount) * channels;
+
+    // Convert directly into the ring buffer, which is at most two contiguous spans.
+    m_sampleConverter.Convert(source, channels, region.left[0], region.right[0], region.length[0]);
+    source += region.length[0] * channels;
+    m_sampleConverter.Convert(source, channels, region.left[1], region.right[1], region.length[1]);
+
+    m_inputBuffer.CommitWrite(writeCount);
+    m_inputPosition += writeCount;
+}
+
+template<typename SampleType>
+void PCM::AddToBuffer(
+    SampleType const* const samples,
+    uint32_t channels,
+    size_t const sampleCount,
+    double const timestamp)
+{
+    if (channels == 0 || sampleCount == 0)
+    {
+        return;
+    }
+
+    // Anchor the first sample actually stored, which is later than the block's first sample
+    // if the older samples are dropped due to the ring buffer being full.
+    uint64_t const firstPosition = m_inputPosition;
+
+    AddToBuffer(samples, channels, sampleCount);
+
+    size_t const storedSamples = static_cast<size_t>(m_inputPosition - firstPosition);
+    if (storedSamples > 0)
     {
-        size_t const bufferOffset = (m_start + i) % AudioBufferSamples;
-        m_inputBufferL[bufferOffset] = 128.0f * (static_cast<float>(samples[0 + i * channels]) - float(signalOffset)) / float(signalAmplitude);
-        if (channels > 1)
-        {
-            m_inputBufferR[bufferOffset] = 128.0f * (static_cast<float>(samples[1 + i * channels]) - float(signalOffset)) / float(signalAmplitude);
-        }
-        else
-        {
-            m_inputBufferR[bufferOffset] = m_inputBufferL[bufferOffset];
-        }
+        size_t const skippedSamples = sampleCount - storedSamples;
+        m_inputClock.SetAnchor(firstPosition,
+                               timestamp + static_cast<double>(skippedSamples) / static_cast<double>(m_sampleRate.load()));
     }
-    m_start = (m_start + sampleCount) % AudioBufferSamples;
 }
 
 void PCM::Add(float const* const samples, uint32_t channels, size_t const count)
 {
-    AddToBuffer<1, 0>(samples, channels, count);
+    AddToBuffer(samples, channels, count);
 }
 void PCM::Add(uint8_t const* const samples, uint32_t channels, size_t const count)
 {
-    AddToBuffer<128, 128>(samples, channels, count);
+    AddToBuffer(samples, channels, count);
 }
 void PCM::Add(int16_t const* const samples, uint32_t channels, size_t const count)
 {
-    AddToBuffer<32768, 0>(samples, channels, count);
+    AddToBuffer(samples, channels, count);
+}
+
+void PCM::Add(float const* const samples, uint32_t channels, size_t const count, double const timestamp)
+{
+    AddToBuffer(samples, channels, count, timestamp);
+}
+void PCM::Add(uint8_t const* const samples, uint32_t channels, size_t const count, double const timestamp)
+{
+    AddToBuffer(samples, channels, count, timestamp);
+}
+void PCM::Add(int16_t const* const samples, uint32_t channels, size_t const count, double const timestamp)
+{
+    AddToBuffer(samples, channels, count, timestamp);
 }
 
-void PCM::UpdateFrameAudioData(double secondsSinceLastFrame, uint32_t frame)
+void PCM::SetSampleRate(uint32_t sampleRate)
+{
+    if (sampleRate > 0)
+    {
+        m_sampleRate.store(sampleRate);
+    }
+}
+
+auto PCM::SampleRate() const -> uint32_t
+{
+    return m_sampleRate.load();
+}
+
+void PCM::SetOutputLatency(double seconds)
+{
+    m_outputLatency.store(std::isfinite(seconds) ? std::max(seconds, 0.0) : 0.0);
+}
+
+auto PCM::OutputLatency() const -> double
+{
+    return m_outputLatency.load();
+}
+
+auto PCM::GetAnalysisSize() const -> AnalysisSize
+{
+    return m_analysisSize;
+}
+
+void PCM::UpdateFrameAudioData(double secondsSinceLastFrame, uint32_t frame, double presentationTime)
 {
     // 1. Copy audio data from input buffer
-    CopyNewWaveformData(m_inputBufferL, m_waveformL);
-    CopyNewWaveformData(m_inputBufferR, m_waveformR);
+    CopyNewWaveformData(presentationTime);
 
     // 2. Update spectrum analyzer data for both channels
-    UpdateSpectrum(m_waveformL, m_spectrumL);
-    UpdateSpectrum(m_waveformR, m_spectrumR);
+    UpdateSpectrum();
 
     // 3. Align waveforms
     m_alignL.Align(m_waveformL);
@@ -67,57 +154,127 @@ void PCM::UpdateFrameAudioData(double secondsSinceLastFrame, uint32_t frame)
 
 }
 
-auto PCM::GetFrameAudioData() const -> FrameAudioData
+auto PCM::GetFrameAudioData(float beatSensitivity) const -> FrameAudioData::Ptr
 {
-    FrameAudioData data{};
+    auto data = std::make_shared<FrameAudioData>();
+
+    std::copy(m_waveformL.begin(), m_waveformL.begin() + WaveformSamples, data->waveformLeft.begin());
+    std::copy(m_waveformR.begin(), m_waveformR.begin() + WaveformSamples, data->waveformRight.begin());
+    std::copy(m_spectrumL.begin(), m_spectrumL.begin() + SpectrumSamples, data->spectrumLeft.begin());
+    std::copy(m_spectrumR.begin(), m_spectrumR.begin() + SpectrumSamples, data->spectrumRight.begin());
 
-    std::copy(m_waveformL.begin(), m_waveformL.begin() + WaveformSamples, data.waveformLeft.begin());
-    std::copy(m_waveformR.begin(), m_waveformR.begin() + WaveformSamples, data.waveformRight.begin());
-    std::copy(m_spectrumL.begin(), m_spectrumL.begin() + SpectrumSamples, data.spectrumLeft.begin());
-    std::copy(m_spectrumR.begin(), m_spectrumR.begin() + SpectrumSamples, data.spectrumRight.begin());
+    data->bass = m_bass.CurrentRelative();
+    data->mid = m_middles.CurrentRelative();
+    data->treb = m_treble.CurrentRelative();
 
-    data.bass = m_bass.CurrentRelative();
-    data.mid = m_middles.CurrentRelative();
-    data.treb = m_treble.CurrentRelative();
+    data->bassAtt = m_bass.AverageRelative();
+    data->midAtt = m_middles.AverageRelative();
+    data->trebAtt = m_treble.AverageRelative();
 
-    data.bassAtt = m_bass.AverageRelative();
-    data.midAtt = m_middles.AverageRelative();
-    data.trebAtt = m_treble.AverageRelative();
+    data->vol = (data->bass + data->mid + data->treb) * 0.333f;
+    data->volAtt = (data->bassAtt + data->midAtt + data->trebAtt) * 0.333f;
 
-    data.vol = (data.bass + data.mid + data.treb) * 0.333f;
-    data.volAtt = (data.bassAtt + data.midAtt + data.trebAtt) * 0.333f;
+    data->beatSensitivity = beatSensitivity;
 
     return data;
 }
 
-void PCM::UpdateSpectrum(const WaveformBuffer& waveformData, SpectrumBuffer& spectrumData)
+void PCM::UpdateSpectrum()
 {
-    std::vector<float> waveformSamples(AudioBufferSamples);
-    std::vector<float> spectrumValues;
-
-    size_t oldI{0};
-    for (size_t i = 0; i < AudioBufferSamples; i++)
+    // Damp the input into the FFT a bit, to reduce high-frequency noise.
+    // Runs backwards, so each sample is averaged with its undamped predecessor.
+    for (size_t i = m_spectrumInputL.size() - 1; i > 0; i--)
     {
-        // Damp the input into the FFT a bit, to reduce high-frequency noise:
-        waveformSamples[i] = 0.5f * (waveformData[i] + waveformData[oldI]);
-        oldI = i;
+        m_spectrumInputL[i] = 0.5f * (m_spectrumInputL[i] + m_spectrumInputL[i - 1]);
+        m_spectrumInputR[i] = 0.5f * (m_spectrumInputR[i] + m_spectrumInputR[i - 1]);
     }
 
-    m_fft.TimeToFrequencyDomain(waveformSamples, spectrumValues);
+    if (m_analysisSize.IsLegacy())
+    {
+        m_fft.TimeToFrequencyDomain(m_spectrumInputL.data(), m_spectrumInputR.data(), m_spectrumL.data(), m_spectrumR.data());
+        return;
+    }
 
-    std::copy(spectrumValues.begin(), spectrumValues.end(), spectrumData.begin());
+    m_fft.TimeToFrequencyDomain(m_spectrumInputL.data(), m_spectrumInputR.data(), m_analyzerSpectrumL.data(), m_analyzerSpectrumR.data());
+    m_spectrumResampler.Resample(m_analyzerSpectrumL.data(), m_spectrumL.data());
+    m_spectrumResampler.Resample(m_analyzerSpectrumR.data(), m_spectrumR.data());
 }
 
-void PCM::CopyNewWaveformData(const WaveformBuffer& source, WaveformBuffer& destination)
+void PCM::CopyNewWaveformData(double presentationTime)
 {
-    auto const bufferStartIndex = m_start.load();
+    constexpr size_t historyMask = HistorySamples - 1;
 
-    for (size_t i = 0; i < AudioBufferSamples; i++)
+    // Append all new samples to the history ring buffer.
+    size_t skippedSamples{};
+    size_t const newSamples = m_inputBuffer.ReadLatest(m_newSamplesL.data(), m_newSamplesR.data(), SampleRingBuffer::Capacity, skippedSamples);
+
+    // Samples overwritten in the input buffer after a render stall are replaced by silence, so the
+    // history positions stay in sync with the input positions used for the timestamps.
+    for (size_t skipped = 0; skipped < std::min<size_t>(skippedSamples, HistorySamples); skipped++)
     {
-        destination[i] = source[(bufferStartIndex + i) % AudioBufferSamples];
+        m_historyL[(m_historyPosition + skipped) & historyMask] = 0.0f;
+        m_historyR[(m_historyPosition + skipped) & historyMask] = 0.0f;
     }
+    m_historyPosition += skippedSamples;
+
+    size_t const writeIndex = m_historyPosition & historyMask;
+    size_t const firstLength = std::min(newSamples, HistorySamples - writeIndex);
+    std::copy_n(m_newSamplesL.begin(), firstLength, m_historyL.begin() + writeIndex);
+    std::copy_n(m_newSamplesR.begin(), firstLength, m_historyR.begin() + writeIndex);
+    std::copy_n(m_newSamplesL.begin() + firstLength, newSamples - firstLength, m_historyL.begin());
+    std::copy_n(m_newSamplesR.begin() + firstLength, newSamples - firstLength, m_historyR.begin());
+    m_historyPosition += newSamples;
+
+    // Copy the selected window. The spectrum analyzer window ends at the same sample as the
+    // WaveformSamples part of the waveform window which is passed on to the presets.
+    uint64_t const windowEnd = WindowEndPosition(presentationTime);
+    CopyFromHistory(windowEnd, AudioBufferSamples, m_waveformL.data(), m_waveformR.data());
+    CopyFromHistory(windowEnd - (AudioBufferSamples - WaveformSamples), m_spectrumInputL.size(),
+                    m_spectrumInputL.data(), m_spectrumInputR.data());
 }
 
+void PCM::CopyFromHistory(uint64_t endPosition, size_t count, float* left, float* right) const
+{
+    // Before enough samples were added, the start wraps into the never-written end of the history,
+    // which still contains silence.
+    size_t const readIndex = (endPosition - count) & (HistorySamples - 1);
+    size_t const firstLength = std::min<size_t>(count, HistorySamples - readIndex);
+    std::copy_n(m_historyL.begin() + readIndex, firstLength, left);
+    std::copy_n(m_historyR.begin() + readIndex, firstLength, right);
+    std::copy_n(m_historyL.begin(), count - firstLength, left + firstLength);
+    std::copy_n(m_historyR.begin(), count - firstLength, right + firstLength);
+}
+
+auto PCM::WindowEndPosition(double presentationTime) const -> uint64_t
+{
+    uint64_t const newestEnd = m_historyPosition;
+    uint64_t const storedSamples = std::min<uint64_t>(m_historyPosition, HistorySamples);
+    uint64_t const oldestEnd = newestEnd - storedSamples + std::min<uint64_t>(storedSamples, m_historyWindowSamples);
+
+    double const sampleRate = static_cast<double>(m_sampleRate.load());
+    double const outputLatency = m_outputLatency.load();
+
+    // Without timestamps, the newest sample is assumed to be audible after the output latency.
+    double targetEnd = static_cast<double>(newestEnd) - outputLatency * sampleRate;
+
+    uint64_t anchorPosition{0};
+    double anchorTimestamp{0.0};
+    if (!std::isnan(presentationTime) && m_inputClock.GetAnchor(anchorPosition, anchorTimestamp))
+    {
+        targetEnd = static_cast<double>(anchorPosition) + (presentationTime - outputLatency - anchorTimestamp) * sampleRate;
+    }
+
+    if (!(targetEnd > static_cast<double>(oldestEnd)))
+    {
+        return oldestEnd;
+    }
+    if (targetEnd >= static_cast<double>(newestEnd))
+    {
+        return newestEnd;
+    }
+
+    return static_cast<uint64_t>(std::llround(targetEnd));
+}
 
 } // namespace Audio
 } // namespace libprojectM
@@ -7,25 +7,57 @@
 
 #pragma once
 
+#include "AnalysisSize.hpp"
 #include "AudioConstants.hpp"
 #include "FrameAudioData.hpp"
 #include "Loudness.hpp"
-#include "MilkdropFFT.hpp"
+#include "SampleClock.hpp"
+#include "SampleConverter.hpp"
+#include "SampleRingBuffer.hpp"
+#include "SpectrumResampler.hpp"
+#include "StereoFFT.hpp"
 #include "WaveformAligner.hpp"
 
 #include <projectM-4/projectM_export.h>
 
+#include <array>
 #include <atomic>
 #include <cstdint>
 #include <cstdlib>
+#include <limits>
+#include <vector>
 
 
 namespace libprojectM {
 namespace Audio {
 
+/**
+ * @class PCM
+ * @brief Stores incoming audio data and calculates the per-frame audio analysis data.
+ *
+ * The Add() methods and UpdateFrameAudioData()/GetFrameAudioData() may be called from two
+ * different threads, e.g. an audio capture thread and the render thread. Samples are passed
+ * between both through a lock-free ring buffer, so adding audio data never blocks and each
+ * frame always sees a consistent window of whole sample blocks.
+ *
+ * The most recent HistorySamples input samples are kept. By default, each frame analyzes the newest
+ * samples. If an output latency is set, or the application passes timestamps with the audio data and
+ * the presentation time of each frame, the analyzed window is instead selected to end at the sample
+ * being played when the frame is displayed. This keeps audio and visuals in sync regardless of the
+ * size and timing of the audio blocks.
+ *
+ * The spectrum analyzer size is set on construction, see AnalysisSize. The spectrum passed on in
+ * FrameAudioData always has SpectrumSamples values, the analyzer output is resampled if needed.
+ */
 class PCM
 {
 public:
+    /**
+     * @brief Creates a new audio analyzer.
+     * @param analysisSize The spectrum analyzer size. If invalid, the legacy size is used instead.
+     */
+    PROJECTM_EXPORT explicit PCM(const AnalysisSize& analysisSize = AnalysisSize());
+
     /**
      * @brief Adds new interleaved floating-point PCM data to the buffer.
      * Left channel is expected at offset 0, right channel at offset 1. Other channels are ignored.
@@ -53,6 +85,68 @@ public:
      */
     PROJECTM_EXPORT void Add(const int16_t* samples, uint32_t channels, size_t count);
 
+    /**
+     * @brief Adds new interleaved floating-point PCM data with a timestamp to the buffer.
+     * @param samples The buffer to be added
+     * @param channels The number of channels in the input data.
+     * @param count The amount of samples in the buffer
+     * @param timestamp Host time in seconds of the first sample, e.g. its capture or submission time.
+     */
+    PROJECTM_EXPORT void Add(const float* samples, uint32_t channels, size_t count, double timestamp);
+
+    /**
+     * @brief Adds new unsigned 8-bit PCM data with a timestamp to the buffer.
+     * @param samples The buffer to be added
+     * @param channels The number of channels in the input data.
+     * @param count The amount of samples in the buffer
+     * @param timestamp Host time in seconds of the first sample, e.g. its capture or submission time.
+     */
+    PROJECTM_EXPORT void Add(const uint8_t* samples, uint32_t channels, size_t count, double timestamp);
+
+    /**
+     * @brief Adds new signed 16-bit PCM data with a timestamp to the buffer.
+     * @param samples The buffer to be added
+     * @param channels The number of channels in the input data.
+     * @param count The amount of samples in the buffer
+     * @param timestamp Host time in seconds of the first sample, e.g. its capture or submission time.
+     */
+    PROJECTM_EXPORT void Add(const int16_t* samples, uint32_t channels, size_t count, double timestamp);
+
+    /**
+     * @brief Sets the sample rate of the input data, used to convert latencies and timestamps to samples.
+     * @param sampleRate The sample rate in Hz. Values of 0 are ignored.
+     */
+    PROJECTM_EXPORT void SetSampleRate(uint32_t sampleRate);
+
+    /**
+     * @brief Returns the sample rate of the input data.
+     * @return The sample rate in Hz.
+     */
+    PROJECTM_EXPORT auto SampleRate() const -> uint32_t;
+
+    /**
+     * @brief Sets the time between adding a sample (or its timestamp) and the sample being audible.
+     *
+     * Use this to compensate for audio output buffering, so the analyzed window ends at the sample
+     * which is audible while the frame is displayed. The resulting delay is limited by the size of the
+     * sample history, which holds HistorySamples samples.
+     *
+     * @param seconds The output latency in seconds. Negative values are treated as 0.
+     */
+    PROJECTM_EXPORT void SetOutputLatency(double seconds);
+
+    /**
+     * @brief Returns the output latency.
+     * @return The output latency in seconds.
+     */
+    PROJECTM_EXPORT auto OutputLatency() const -> double;
+
+    /**
+     * @brief Returns the spectrum analyzer size used by this instance.
+     * @return The spectrum analyzer size.
+     */
+    PROJECTM_EXPORT auto GetAnalysisSize() const -> AnalysisSize;
+
     /**
      * @brief Updates the internal audio data values for rendering the next frame.
      * This method must only be called once per frame, as it does some temporal blending
@@ -63,36 +157,76 @@ public:
      *
      * @param secondsSinceLastFrame Time passed since rendering the last frame. Basically 1.0/FPS.
      * @param frame Frames rendered since projectM was started.
+     * @param presentationTime Host time in seconds at which the frame will be displayed, in the same
+     *                         clock as the audio timestamps. If NaN or no timestamped audio data was
+     *                         added, the window is selected relative to the newest sample.
      */
-    PROJECTM_EXPORT void UpdateFrameAudioData(double secondsSinceLastFrame, uint32_t frame);
+    PROJECTM_EXPORT void UpdateFrameAudioData(double secondsSinceLastFrame, uint32_t frame,
+                                              double presentationTime = std::numeric_limits<double>::quiet_NaN());
 
     /**
-     * @brief Returns a class holding a copy of the current frame audio data.
-     * @return A FrameAudioData class with waveform, spectrum and other derived values.
+     * @brief Creates an immutable snapshot of the current frame audio data.
+     * This is the only place the waveform and spectrum data is copied for each frame.
+     * @param beatSensitivity The beat sensitivity stored in the snapshot, see FrameAudioData.
+     * @return A shared FrameAudioData snapshot with waveform, spectrum and other derived values.
      */
-    PROJECTM_EXPORT auto GetFrameAudioData() const -> FrameAudioData;
+    PROJECTM_EXPORT auto GetFrameAudioData(float beatSensitivity = 1.0f) const -> FrameAudioData::Ptr;
 
 private:
-    template<
-        int signalAmplitude,
-        int signalOffset,
-        typename SampleType>
+    using HistoryBuffer = std::array<float, HistorySamples>;
+
+    template<typename SampleType>
     void AddToBuffer(const SampleType* samples, uint32_t channel, size_t sampleCount);
 
+    template<typename SampleType>
+    void AddToBuffer(const SampleType* samples, uint32_t channel, size_t sampleCount, double timestamp);
+
     /**
-     * Updates FFT data
+     * Updates FFT data for both channels.
      */
-    void UpdateSpectrum(const WaveformBuffer& waveformData, SpectrumBuffer& spectrumData);
+    void UpdateSpectrum();
 
     /**
-     * Copies data out of the circular input buffer into the per-frame waveform buffer.
+     * Moves new data out of the input ring buffer into the sample history and copies
+     * the window to analyze into the per-frame waveform buffers.
+     * @param presentationTime Host time at which the frame will be displayed, or NaN if unknown.
      */
-    void CopyNewWaveformData(const WaveformBuffer& source, WaveformBuffer& destination);
+    void CopyNewWaveformData(double presentationTime);
+
+    /**
+     * Calculates the absolute position of the sample following the window to analyze.
+     * @param presentationTime Host time at which the frame will be displayed, or NaN if unknown.
+     * @return The end position of the window, clamped to the available sample history.
+     */
+    auto WindowEndPosition(double presentationTime) const -> uint64_t;
+
+    /**
+     * Copies samples from the sample history.
+     * @param endPosition Absolute position of the sample following the last one to copy.
+     * @param count Number of samples to copy. Must not exceed HistorySamples.
+     * @param left Destination for the left channel samples.
+     * @param right Destination for the right channel samples.
+     */
+    void CopyFromHistory(uint64_t endPosition, size_t count, float* left, float* right) const;
+
+    AnalysisSize m_analysisSize; //!< Spectrum analyzer size.
+    size_t m_historyWindowSamples{AudioBufferSamples}; //!< Number of history samples needed for the waveform and spectrum windows.
 
     // External input buffer
-    WaveformBuffer m_inputBufferL{0.f}; //!< Circular buffer for left-channel PCM data.
-    WaveformBuffer m_inputBufferR{0.f}; //!< Circular buffer for right-channel PCM data.
-    std::atomic<size_t> m_start{0};     //!< Circular buffer start index.
+    SampleConverter m_sampleConverter; //!< Deinterleaves and scales incoming samples using the fastest available kernel.
+    SampleRingBuffer m_inputBuffer;    //!< Lock-free buffer passing PCM data from the audio thread to the render thread.
+    SampleClock m_inputClock;          //!< Host time of the timestamped input samples.
+    uint64_t m_inputPosition{0};       //!< Total number of samples added. Only accessed by the thread adding audio data.
+
+    std::atomic<uint32_t> m_sampleRate{DefaultSampleRate}; //!< Input sample rate in Hz.
+    std::atomic<double> m_outputLatency{0.0};              //!< Output latency in seconds.
+
+    // Sample history, only accessed by the thread calling UpdateFrameAudioData()
+    HistoryBuffer m_historyL{0.f};   //!< Ring buffer with the most recent left-channel samples.
+    HistoryBuffer m_historyR{0.f};   //!< Ring buffer with the most recent right-channel samples.
+    uint64_t m_historyPosition{0};   //!< Total number of samples moved into the history.
+    std::array<float, SampleRingBuffer::Capacity> m_newSamplesL{}; //!< Scratch buffer for new left-channel samples taken from the input buffer.
+    std::array<float, SampleRingBuffer::Capacity> m_newSamplesR{}; //!< Scratch buffer for new right-channel samples taken from the input buffer.
 
     // Frame waveform data
     WaveformBuffer m_waveformL{0.f}; //!< Left-channel waveform data, aligned. Only the first WaveformSamples number of samples are valid.
@@ -102,7 +236,16 @@ private:
     SpectrumBuffer m_spectrumL{0.f}; //!< Left-channel spectrum data.
     SpectrumBuffer m_spectrumR{0.f}; //!< Right-channel spectrum data.
 
-    MilkdropFFT m_fft{WaveformSamples, SpectrumSamples, true}; //!< Spectrum analyzer instance.
+    // Spectrum analyzer input, damped waveform data
+    std::vector<float> m_spectrumInputL; //!< Left-channel input data for the spectrum analyzer.
+    std::vector<float> m_spectrumInputR; //!< Right-channel input data for the spectrum analyzer.
+
+    StereoFFT m_fft; //!< Spectrum analyzer instance.
+
+    // Spectrum analyzer output if not using the legacy size, resampled into m_spectrumL/R.
+    std::vector<float> m_analyzerSpectrumL;  //!< Left-channel spectrum analyzer output.
+    std::vector<float> m_analyzerSpectrumR;  //!< Right-channel spectrum analyzer output.
+    SpectrumResampler m_spectrumResampler;   //!< Converts the analyzer output to SpectrumSamples values.
 
     // Alignment data
     WaveformAligner m_alignL; //!< Left-channel waveform alignment.
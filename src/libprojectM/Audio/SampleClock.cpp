@@ -0,0 +1,43 @@
+#include "SampleClock.hpp"
+
+namespace libprojectM {
+namespace Audio {
+
+void SampleClock::SetAnchor(uint64_t samplePosition, double timestamp)
+{
+    uint32_t const sequence = m_sequence.load(std::memory_order_relaxed);
+
+    m_sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    m_samplePosition.store(samplePosition, std::memory_order_relaxed);
+    m_timestamp.store(timestamp, std::memory_order_relaxed);
+
+    m_sequence.store(sequence + 2, std::memory_order_release);
+}
+
+auto SampleClock::GetAnchor(uint64_t& samplePosition, double& timestamp) const -> bool
+{
+    while (true)
+    {
+        uint32_t const sequenceBefore = m_sequence.load(std::memory_order_acquire);
+        if (sequenceBefore == 0)
+        {
+            return false;
+        }
+
+        samplePosition = m_samplePosition.load(std::memory_order_relaxed);
+        timestamp = m_timestamp.load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint32_t const sequenceAfter = m_sequence.load(std::memory_order_relaxed);
+
+        if (sequenceBefore == sequenceAfter && (sequenceBefore & 1) == 0)
+        {
+            return true;
+        }
+    }
+}
+
+} // namespace Audio
+} // namespace libprojectM
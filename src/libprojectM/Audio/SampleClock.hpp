@@ -0,0 +1,51 @@
+/**
+ * @file SampleClock.hpp
+ * @brief Lock-free mapping between audio sample positions and host timestamps.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace libprojectM {
+namespace Audio {
+
+/**
+ * @class SampleClock
+ * @brief Lock-free mapping between audio sample positions and host timestamps.
+ *
+ * Stores a single anchor point, the absolute position of a sample in the input stream and the
+ * host time it is played at. Together with the sample rate, this allows calculating the time of
+ * any other sample. The audio thread updates the anchor with each timestamped block, the thread
+ * analyzing the audio data reads it.
+ *
+ * Uses a sequence lock, so both sides always see a consistent anchor without ever blocking. The
+ * reader retries in the unlikely case the writer updated the anchor while it was being read.
+ */
+class SampleClock
+{
+public:
+    /**
+     * @brief Writer: sets a new anchor point.
+     * @param samplePosition Absolute position of the sample in the input stream.
+     * @param timestamp Host time in seconds at which this sample is played.
+     */
+    void SetAnchor(uint64_t samplePosition, double timestamp);
+
+    /**
+     * @brief Reader: retrieves the current anchor point.
+     * @param[out] samplePosition Absolute position of the anchor sample in the input stream.
+     * @param[out] timestamp Host time in seconds at which the anchor sample is played.
+     * @return true if an anchor was set, false if no timestamped data was added yet.
+     */
+    auto GetAnchor(uint64_t& samplePosition, double& timestamp) const -> bool;
+
+private:
+    std::atomic<uint32_t> m_sequence{0};       //!< Sequence counter. Odd while the writer updates the anchor, 0 if no anchor was set.
+    std::atomic<uint64_t> m_samplePosition{0}; //!< Anchor sample position.
+    std::atomic<double> m_timestamp{0.0};      //!< Anchor timestamp.
+};
+
+} // namespace Audio
+} // namespace libprojectM
@@ -0,0 +1,630 @@
+#include "SampleConverter.hpp"
+
+#include <initializer_list>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define PROJECTM_SAMPLE_CONVERTER_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64) || defined(__ARM_NEON)
+#define PROJECTM_SAMPLE_CONVERTER_NEON 1
+#include <arm_neon.h>
+#endif
+
+// GCC and Clang require functions using intrinsics of instruction sets not enabled globally to be marked as such.
+#if defined(PROJECTM_SAMPLE_CONVERTER_X86) && (defined(__GNUC__) || defined(__clang__))
+#define PROJECTM_TARGET_SSE2 __attribute__((target("sse2")))
+#define PROJECTM_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define PROJECTM_TARGET_SSE2
+#define PROJECTM_TARGET_AVX2
+#endif
+
+namespace libprojectM {
+namespace Audio {
+
+namespace {
+
+/**
+ * Input value range parameters for each sample type.
+ */
+template<typename SampleType>
+struct SampleTraits;
+
+template<>
+struct SampleTraits<float> {
+    static constexpr int amplitude = 1;
+    static constexpr int offset = 0;
+};
+
+template<>
+struct SampleTraits<int16_t> {
+    static constexpr int amplitude = 32768;
+    static constexpr int offset = 0;
+};
+
+template<>
+struct SampleTraits<uint8_t> {
+    static constexpr int amplitude = 128;
+    static constexpr int offset = 128;
+};
+
+/**
+ * Reference implementation, supporting any number of channels.
+ */
+template<typename SampleType>
+void ConvertScalar(const SampleType* samples, uint32_t channels, float* left, float* right, size_t count)
+{
+    float const signalOffset = static_cast<float>(SampleTraits<SampleType>::offset);
+    float const signalAmplitude = static_cast<float>(SampleTraits<SampleType>::amplitude);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        left[i] = 128.0f * (static_cast<float>(samples[0]) - signalOffset) / signalAmplitude;
+        if (channels > 1)
+        {
+            right[i] = 128.0f * (static_cast<float>(samples[1]) - signalOffset) / signalAmplitude;
+        }
+        else
+        {
+            right[i] = left[i];
+        }
+        samples += channels;
+    }
+}
+
+template<typename SampleType>
+void ConvertScalarMono(const SampleType* samples, float* left, float* right, size_t count)
+{
+    ConvertScalar(samples, 1, left, right, count);
+}
+
+template<typename SampleType>
+void ConvertScalarStereo(const SampleType* samples, float* left, float* right, size_t count)
+{
+    ConvertScalar(samples, 2, left, right, count);
+}
+
+/**
+ * Multiplier replacing "128 / amplitude". As the amplitudes are powers of two, multiplying
+ * by this factor gives the exact same result as the scalar multiply-and-divide.
+ */
+template<typename SampleType>
+constexpr auto ScaleFactor() -> float
+{
+    return 128.0f / static_cast<float>(SampleTraits<SampleType>::amplitude);
+}
+
+#ifdef PROJECTM_SAMPLE_CONVERTER_X86
+
+// SSE2 kernels
+
+PROJECTM_TARGET_SSE2 void ConvertFloatMonoSSE2(const float* samples, float* left, float* right, size_t count)
+{
+    __m128 const scale = _mm_set1_ps(ScaleFactor<float>());
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 const value = _mm_mul_ps(_mm_loadu_ps(samples + i), scale);
+        _mm_storeu_ps(left + i, value);
+        _mm_storeu_ps(right + i, value);
+    }
+
+    ConvertScalarMono(samples + i, left + i, right + i, count - i);
+}
+
+PROJECTM_TARGET_SSE2 void ConvertFloatStereoSSE2(const float* samples, float* left, float* right, size_t count)
+{
+    __m128 const scale = _mm_set1_ps(ScaleFactor<float>());
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 const first = _mm_loadu_ps(samples + i * 2);
+        __m128 const second = _mm_loadu_ps(samples + i * 2 + 4);
+        _mm_storeu_ps(left + i, _mm_mul_ps(_mm_shuffle_ps(first, second, _MM_SHUFFLE(2, 0, 2, 0)), scale));
+        _mm_storeu_ps(right + i, _mm_mul_ps(_mm_shuffle_ps(first, second, _MM_SHUFFLE(3, 1, 3, 1)), scale));
+    }
+
+    ConvertScalarStereo(samples + i * 2, left + i, right + i, count - i);
+}
+
+PROJECTM_TARGET_SSE2 void ConvertInt16MonoSSE2(const int16_t* samples, float* left, float* right, size_t count)
+{
+    __m128 const scale = _mm_set1_ps(ScaleFactor<int16_t>());
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i const value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(samples + i));
+        // Move each 16-bit value into the upper half of a 32-bit lane, then sign-extend it.
+        __m128 const low = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(value, value), 16)), scale);
+        __m128 const high = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(value, value), 16)), scale);
+        _mm_storeu_ps(left + i, low);
+        _mm_storeu_ps(left + i + 4, high);
+        _mm_storeu_ps(right + i, low);
+        _mm_storeu_ps(right + i + 4, high);
+    }
+
+    ConvertScalarMono(samples + i, left + i, right + i, count - i);
+}
+
+PROJECTM_TARGET_SSE2 void ConvertInt16StereoSSE2(const int16_t* samples, float* left, float* right, size_t count)
+{
+    __m128 const scale = _mm_set1_ps(ScaleFactor<int16_t>());
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        // Each 32-bit lane holds one stereo sample, left channel in the lower half.
+        __m128i const value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(samples + i * 2));
+        __m128i const leftValue = _mm_srai_epi32(_mm_slli_epi32(value, 16), 16);
+        __m128i const rightValue = _mm_srai_epi32(value, 16);
+        _mm_storeu_ps(left + i, _mm_mul_ps(_mm_cvtepi32_ps(leftValue), scale));
+        _mm_storeu_ps(right + i, _mm_mul_ps(_mm_cvtepi32_ps(rightValue), scale));
+    }
+
+    ConvertScalarStereo(samples + i * 2, left + i, right + i, count - i);
+}
+
+PROJECTM_TARGET_SSE2 void ConvertUInt8MonoSSE2(const uint8_t* samples, float* left, float* right, size_t count)
+{
+    __m128 const offset = _mm_set1_ps(static_cast<float>(SampleTraits<uint8_t>::offset));
+    __m128 const scale = _mm_set1_ps(ScaleFactor<uint8_t>());
+    __m128i const zero = _mm_setzero_si128();
+
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        __m128i const value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(samples + i));
+        __m128i const low16 = _mm_unpacklo_epi8(value, zero);
+        __m128i const high16 = _mm_unpackhi_epi8(value, zero);
+
+        __m128i const values32[4] = {
+            _mm_unpacklo_epi16(low16, zero),
+            _mm_unpackhi_epi16(low16, zero),
+            _mm_unpacklo_epi16(high16, zero),
+            _mm_unpackhi_epi16(high16, zero)};
+
+        for (int part = 0; part < 4; part++)
+        {
+            __m128 const result = _mm_mul_ps(_mm_sub_ps(_mm_cvtepi32_ps(values32[part]), offset), scale);
+            _mm_storeu_ps(left + i + part * 4, result);
+            _mm_storeu_ps(right + i + part * 4, result);
+        }
+    }
+
+    ConvertScalarMono(samples + i, left + i, right + i, count - i);
+}
+
+PROJECTM_TARGET_SSE2 void ConvertUInt8StereoSSE2(const uint8_t* samples, float* left, float* right, size_t count)
+{
+    __m128 const offset = _mm_set1_ps(static_cast<float>(SampleTraits<uint8_t>::offset));
+    __m128 const scale = _mm_set1_ps(ScaleFactor<uint8_t>());
+    __m128i const zero = _mm_setzero_si128();
+    __m128i const lowMask = _mm_set1_epi32(0xFFFF);
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i const value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(samples + i * 2));
+
+        // After widening to 16 bits, each 32-bit lane holds one stereo sample.
+        __m128i const stereo32[2] = {
+            _mm_unpacklo_epi8(value, zero),
+            _mm_unpackhi_epi8(value, zero)};
+
+        for (int part = 0; part < 2; part++)
+        {
+            __m128i const leftValue = _mm_and_si128(stereo32[part], lowMask);
+            __m128i const rightValue = _mm_srli_epi32(stereo32[part], 16);
+            _mm_storeu_ps(left + i + part * 4, _mm_mul_ps(_mm_sub_ps(_mm_cvtepi32_ps(leftValue), offset), scale));
+            _mm_storeu_ps(right + i + part * 4, _mm_mul_ps(_mm_sub_ps(_mm_cvtepi32_ps(rightValue), offset), scale));
+        }
+    }
+
+    ConvertScalarStereo(samples + i * 2, left + i, right + i, count - i);
+}
+
+// AVX2 kernels
+
+PROJECTM_TARGET_AVX2 void ConvertFloatMonoAVX2(const float* samples, float* left, float* right, size_t count)
+{
+    __m256 const scale = _mm256_set1_ps(ScaleFactor<float>());
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 const value = _mm256_mul_ps(_mm256_loadu_ps(samples + i), scale);
+        _mm256_storeu_ps(left + i, value);
+        _mm256_storeu_ps(right + i, value);
+    }
+
+    ConvertScalarMono(samples + i, left + i, right + i, count - i);
+}
+
+PROJECTM_TARGET_AVX2 void ConvertFloatStereoAVX2(const float* samples, float* left, float* right, size_t count)
+{
+    __m256 const scale = _mm256_set1_ps(ScaleFactor<float>());
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 const first = _mm256_loadu_ps(samples + i * 2);
+        __m256 const second = _mm256_loadu_ps(samples + i * 2 + 8);
+
+        // The shuffle works per 128-bit lane, so the 64-bit blocks have to be reordered afterwards.
+        __m256 const leftValue = _mm256_castpd_ps(_mm256_permute4x64_pd(
+            _mm256_castps_pd(_mm256_shuffle_ps(first, second, _MM_SHUFFLE(2, 0, 2, 0))), _MM_SHUFFLE(3, 1, 2, 0)));
+        __m256 const rightValue = _mm256_castpd_ps(_mm256_permute4x64_pd(
+            _mm256_castps_pd(_mm256_shuffle_ps(first, second, _MM_SHUFFLE(3, 1, 3, 1))), _MM_SHUFFLE(3, 1, 2, 0)));
+
+        _mm256_storeu_ps(left + i, _mm256_mul_ps(leftValue, scale));
+        _mm256_storeu_ps(right + i, _mm256_mul_ps(rightValue, scale));
+    }
+
+    ConvertScalarStereo(samples + i * 2, left + i, right + i, count - i);
+}
+
+PROJECTM_TARGET_AVX2 void ConvertInt16MonoAVX2(const int16_t* samples, float* left, float* right, size_t count)
+{
+    __m256 const scale = _mm256_set1_ps(ScaleFactor<int16_t>());
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i const value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(samples + i));
+        __m256 const result = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(value)), scale);
+        _mm256_storeu_ps(left + i, result);
+        _mm256_storeu_ps(right + i, result);
+    }
+
+    ConvertScalarMono(samples + i, left + i, right + i, count - i);
+}
+
+PROJECTM_TARGET_AVX2 void ConvertInt16StereoAVX2(const int16_t* samples, float* left, float* right, size_t count)
+{
+    __m256 const scale = _mm256_set1_ps(ScaleFactor<int16_t>());
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i const value = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(samples + i * 2));
+        __m256i const leftValue = _mm256_srai_epi32(_mm256_slli_epi32(value, 16), 16);
+        __m256i const rightValue = _mm256_srai_epi32(value, 16);
+        _mm256_storeu_ps(left + i, _mm256_mul_ps(_mm256_cvtepi32_ps(leftValue), scale));
+        _mm256_storeu_ps(right + i, _mm256_mul_ps(_mm256_cvtepi32_ps(rightValue), scale));
+    }
+
+    ConvertScalarStereo(samples + i * 2, left + i, right + i, count - i);
+}
+
+PROJECTM_TARGET_AVX2 void ConvertUInt8MonoAVX2(const uint8_t* samples, float* left, float* right, size_t count)
+{
+    __m256 const offset = _mm256_set1_ps(static_cast<float>(SampleTraits<uint8_t>::offset));
+    __m256 const scale = _mm256_set1_ps(ScaleFactor<uint8_t>());
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i const value = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(samples + i));
+        __m256 const result = _mm256_mul_ps(_mm256_sub_ps(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(value)), offset), scale);
+        _mm256_storeu_ps(left + i, result);
+        _mm256_storeu_ps(right + i, result);
+    }
+
+    ConvertScalarMono(samples + i, left + i, right + i, count - i);
+}
+
+PROJECTM_TARGET_AVX2 void ConvertUInt8StereoAVX2(const uint8_t* samples, float* left, float* right, size_t count)
+{
+    __m256 const offset = _mm256_set1_ps(static_cast<float>(SampleTraits<uint8_t>::offset));
+    __m256 const scale = _mm256_set1_ps(ScaleFactor<uint8_t>());
+    __m256i const lowMask = _mm256_set1_epi32(0xFFFF);
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i const value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(samples + i * 2));
+        __m256i const stereo32 = _mm256_cvtepu8_epi16(value);
+        __m256i const leftValue = _mm256_and_si256(stereo32, lowMask);
+        __m256i const rightValue = _mm256_srli_epi32(stereo32, 16);
+        _mm256_storeu_ps(left + i, _mm256_mul_ps(_mm256_sub_ps(_mm256_cvtepi32_ps(leftValue), offset), scale));
+        _mm256_storeu_ps(right + i, _mm256_mul_ps(_mm256_sub_ps(_mm256_cvtepi32_ps(rightValue), offset), scale));
+    }
+
+    ConvertScalarStereo(samples + i * 2, left + i, right + i, count - i);
+}
+
+auto CpuSupportsSSE2() -> bool
+{
+#if defined(__x86_64__) || defined(_M_X64)
+    return true;
+#elif defined(_MSC_VER) && !defined(__clang__)
+    int cpuInfo[4]{};
+    __cpuid(cpuInfo, 1);
+    return (cpuInfo[3] & (1 << 26)) != 0;
+#else
+    return __builtin_cpu_supports("sse2");
+#endif
+}
+
+auto CpuSupportsAVX2() -> bool
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    int cpuInfo[4]{};
+    __cpuid(cpuInfo, 0);
+    if (cpuInfo[0] < 7)
+    {
+        return false;
+    }
+
+    // The OS must also save the YMM registers on context switches.
+    __cpuid(cpuInfo, 1);
+    bool const osSavesYmm = (cpuInfo[2] & (1 << 27)) != 0 && (_xgetbv(0) & 0x6) == 0x6;
+
+    __cpuidex(cpuInfo, 7, 0);
+    return osSavesYmm && (cpuInfo[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif // PROJECTM_SAMPLE_CONVERTER_X86
+
+#ifdef PROJECTM_SAMPLE_CONVERTER_NEON
+
+// NEON kernels
+
+void ConvertFloatMonoNEON(const float* samples, float* left, float* right, size_t count)
+{
+    float32x4_t const scale = vdupq_n_f32(ScaleFactor<float>());
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        float32x4_t const value = vmulq_f32(vld1q_f32(samples + i), scale);
+        vst1q_f32(left + i, value);
+        vst1q_f32(right + i, value);
+    }
+
+    ConvertScalarMono(samples + i, left + i, right + i, count - i);
+}
+
+void ConvertFloatStereoNEON(const float* samples, float* left, float* right, size_t count)
+{
+    float32x4_t const scale = vdupq_n_f32(ScaleFactor<float>());
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        float32x4x2_t const value = vld2q_f32(samples + i * 2);
+        vst1q_f32(left + i, vmulq_f32(value.val[0], scale));
+        vst1q_f32(right + i, vmulq_f32(value.val[1], scale));
+    }
+
+    ConvertScalarStereo(samples + i * 2, left + i, right + i, count - i);
+}
+
+void ConvertInt16MonoNEON(const int16_t* samples, float* left, float* right, size_t count)
+{
+    float32x4_t const scale = vdupq_n_f32(ScaleFactor<int16_t>());
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        float32x4_t const value = vmulq_f32(vcvtq_f32_s32(vmovl_s16(vld1_s16(samples + i))), scale);
+        vst1q_f32(left + i, value);
+        vst1q_f32(right + i, value);
+    }
+
+    ConvertScalarMono(samples + i, left + i, right + i, count - i);
+}
+
+void ConvertInt16StereoNEON(const int16_t* samples, float* left, float* right, size_t count)
+{
+    float32x4_t const scale = vdupq_n_f32(ScaleFactor<int16_t>());
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        int16x4x2_t const value = vld2_s16(samples + i * 2);
+        vst1q_f32(left + i, vmulq_f32(vcvtq_f32_s32(vmovl_s16(value.val[0])), scale));
+        vst1q_f32(right + i, vmulq_f32(vcvtq_f32_s32(vmovl_s16(value.val[1])), scale));
+    }
+
+    ConvertScalarStereo(samples + i * 2, left + i, right + i, count - i);
+}
+
+void ConvertUInt8MonoNEON(const uint8_t* samples, float* left, float* right, size_t count)
+{
+    float32x4_t const offset = vdupq_n_f32(static_cast<float>(SampleTraits<uint8_t>::offset));
+    float32x4_t const scale = vdupq_n_f32(ScaleFactor<uint8_t>());
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        uint16x8_t const value = vmovl_u8(vld1_u8(samples + i));
+        float32x4_t const low = vmulq_f32(vsubq_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(value))), offset), scale);
+        float32x4_t const high = vmulq_f32(vsubq_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(value))), offset), scale);
+        vst1q_f32(left + i, low);
+        vst1q_f32(left + i + 4, high);
+        vst1q_f32(right + i, low);
+        vst1q_f32(right + i + 4, high);
+    }
+
+    ConvertScalarMono(samples + i, left + i, right + i, count - i);
+}
+
+void ConvertUInt8StereoNEON(const uint8_t* samples, float* left, float* right, size_t count)
+{
+    float32x4_t const offset = vdupq_n_f32(static_cast<float>(SampleTraits<uint8_t>::offset));
+    float32x4_t const scale = vdupq_n_f32(ScaleFactor<uint8_t>());
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        uint8x8x2_t const value = vld2_u8(samples + i * 2);
+        uint16x8_t const leftValue = vmovl_u8(value.val[0]);
+        uint16x8_t const rightValue = vmovl_u8(value.val[1]);
+        vst1q_f32(left + i, vmulq_f32(vsubq_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(leftValue))), offset), scale));
+        vst1q_f32(left + i + 4, vmulq_f32(vsubq_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(leftValue))), offset), scale));
+        vst1q_f32(right + i, vmulq_f32(vsubq_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(rightValue))), offset), scale));
+        vst1q_f32(right + i + 4, vmulq_f32(vsubq_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(rightValue))), offset), scale));
+    }
+
+    ConvertScalarStereo(samples + i * 2, left + i, right + i, count - i);
+}
+
+#endif // PROJECTM_SAMPLE_CONVERTER_NEON
+
+} // anonymous namespace
+
+SampleConverter::SampleConverter()
+    : SampleConverter(BestKernel())
+{
+}
+
+SampleConverter::SampleConverter(Kernel kernel)
+{
+    if (!IsSupported(kernel))
+    {
+        kernel = Kernel::Scalar;
+    }
+
+    m_kernel = kernel;
+
+    switch (kernel)
+    {
+#ifdef PROJECTM_SAMPLE_CONVERTER_X86
+        case Kernel::SSE2:
+            m_floatKernels = {ConvertFloatMonoSSE2, ConvertFloatStereoSSE2};
+            m_int16Kernels = {ConvertInt16MonoSSE2, ConvertInt16StereoSSE2};
+            m_uint8Kernels = {ConvertUInt8MonoSSE2, ConvertUInt8StereoSSE2};
+            break;
+
+        case Kernel::AVX2:
+            m_floatKernels = {ConvertFloatMonoAVX2, ConvertFloatStereoAVX2};
+            m_int16Kernels = {ConvertInt16MonoAVX2, ConvertInt16StereoAVX2};
+            m_uint8Kernels = {ConvertUInt8MonoAVX2, ConvertUInt8StereoAVX2};
+            break;
+#endif
+
+#ifdef PROJECTM_SAMPLE_CONVERTER_NEON
+        case Kernel::NEON:
+            m_floatKernels = {ConvertFloatMonoNEON, ConvertFloatStereoNEON};
+            m_int16Kernels = {ConvertInt16MonoNEON, ConvertInt16StereoNEON};
+            m_uint8Kernels = {ConvertUInt8MonoNEON, ConvertUInt8StereoNEON};
+            break;
+#endif
+
+        default:
+            m_floatKernels = {ConvertScalarMono<float>, ConvertScalarStereo<float>};
+            m_int16Kernels = {ConvertScalarMono<int16_t>, ConvertScalarStereo<int16_t>};
+            m_uint8Kernels = {ConvertScalarMono<uint8_t>, ConvertScalarStereo<uint8_t>};
+            break;
+    }
+}
+
+auto SampleConverter::IsSupported(Kernel kernel) -> bool
+{
+    switch (kernel)
+    {
+        case Kernel::Scalar:
+            return true;
+
+#ifdef PROJECTM_SAMPLE_CONVERTER_X86
+        case Kernel::SSE2:
+            return CpuSupportsSSE2();
+
+        case Kernel::AVX2:
+            return CpuSupportsAVX2();
+#endif
+
+#ifdef PROJECTM_SAMPLE_CONVERTER_NEON
+        case Kernel::NEON:
+            return true;
+#endif
+
+        default:
+            return false;
+    }
+}
+
+auto SampleConverter::BestKernel() -> Kernel
+{
+    for (auto kernel : {Kernel::AVX2, Kernel::SSE2, Kernel::NEON})
+    {
+        if (IsSupported(kernel))
+        {
+            return kernel;
+        }
+    }
+
+    return Kernel::Scalar;
+}
+
+auto SampleConverter::ActiveKernel() const -> Kernel
+{
+    return m_kernel;
+}
+
+void SampleConverter::Convert(const float* samples, uint32_t channels, float* left, float* right, size_t count) const
+{
+    switch (channels)
+    {
+        case 1:
+            m_floatKernels.mono(samples, left, right, count);
+            break;
+
+        case 2:
+            m_floatKernels.stereo(samples, left, right, count);
+            break;
+
+        default:
+            ConvertScalar(samples, channels, left, right, count);
+            break;
+    }
+}
+
+void SampleConverter::Convert(const int16_t* samples, uint32_t channels, float* left, float* right, size_t count) const
+{
+    switch (channels)
+    {
+        case 1:
+            m_int16Kernels.mono(samples, left, right, count);
+            break;
+
+        case 2:
+            m_int16Kernels.stereo(samples, left, right, count);
+            break;
+
+        default:
+            ConvertScalar(samples, channels, left, right, count);
+            break;
+    }
+}
+
+void SampleConverter::Convert(const uint8_t* samples, uint32_t channels, float* left, float* right, size_t count) const
+{
+    switch (channels)
+    {
+        case 1:
+            m_uint8Kernels.mono(samples, left, right, count);
+            break;
+
+        case 2:
+            m_uint8Kernels.stereo(samples, left, right, count);
+            break;
+
+        default:
+            ConvertScalar(samples, channels, left, right, count);
+            break;
+    }
+}
+
+} // namespace Audio
+} // namespace libprojectM
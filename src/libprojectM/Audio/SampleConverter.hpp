@@ -0,0 +1,121 @@
+/**
+ * @file SampleConverter.hpp
+ * @brief Deinterleaves and scales incoming PCM samples into the internal float format.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace libprojectM {
+namespace Audio {
+
+/**
+ * @class SampleConverter
+ * @brief Deinterleaves and scales incoming PCM samples into the internal float format.
+ *
+ * Input samples are converted to float and scaled to the range [-128, 128]. The first channel is
+ * written to the left output, the second channel to the right output. Mono input is copied into
+ * both outputs, any additional channels are ignored.
+ *
+ * Vectorized kernels are available for mono and stereo input on CPUs supporting SSE2, AVX2 or NEON.
+ * As all scaling factors are powers of two, the vectorized kernels produce results bit-identical
+ * to the scalar implementation. Other channel counts always use the scalar implementation.
+ */
+class SampleConverter
+{
+public:
+    /**
+     * @brief Available conversion kernel implementations.
+     */
+    enum class Kernel : int
+    {
+        Scalar = 0, //!< Portable scalar implementation.
+        SSE2 = 1,   //!< x86 SSE2, four samples per iteration.
+        AVX2 = 2,   //!< x86 AVX2, eight samples per iteration.
+        NEON = 3    //!< ARM NEON, four to eight samples per iteration.
+    };
+
+    /**
+     * @brief Creates a converter using the fastest kernel supported by the current CPU.
+     */
+    SampleConverter();
+
+    /**
+     * @brief Creates a converter using a specific kernel.
+     * @param kernel The kernel to use. If not supported, the scalar implementation is used.
+     */
+    explicit SampleConverter(Kernel kernel);
+
+    /**
+     * @brief Checks if the given kernel was compiled in and is supported by the current CPU.
+     * @param kernel The kernel to check.
+     * @return true if the kernel can be used, false if not.
+     */
+    static auto IsSupported(Kernel kernel) -> bool;
+
+    /**
+     * @brief Returns the fastest kernel supported by the current CPU.
+     * @return The fastest available kernel.
+     */
+    static auto BestKernel() -> Kernel;
+
+    /**
+     * @brief Returns the kernel used by this converter.
+     * @return The kernel used by this converter.
+     */
+    auto ActiveKernel() const -> Kernel;
+
+    /**
+     * @brief Converts interleaved floating-point samples in the range [-1, 1].
+     * @param samples The interleaved input samples. Must hold count * channels values.
+     * @param channels The number of channels in the input data. Must be at least 1.
+     * @param left The left channel output buffer. Must hold count values.
+     * @param right The right channel output buffer. Must hold count values.
+     * @param count The number of samples per channel to convert.
+     */
+    void Convert(const float* samples, uint32_t channels, float* left, float* right, size_t count) const;
+
+    /**
+     * @brief Converts interleaved signed 16-bit samples.
+     * @param samples The interleaved input samples. Must hold count * channels values.
+     * @param channels The number of channels in the input data. Must be at least 1.
+     * @param left The left channel output buffer. Must hold count values.
+     * @param right The right channel output buffer. Must hold count values.
+     * @param count The number of samples per channel to convert.
+     */
+    void Convert(const int16_t* samples, uint32_t channels, float* left, float* right, size_t count) const;
+
+    /**
+     * @brief Converts interleaved unsigned 8-bit samples.
+     * @param samples The interleaved input samples. Must hold count * channels values.
+     * @param channels The number of channels in the input data. Must be at least 1.
+     * @param left The left channel output buffer. Must hold count values.
+     * @param right The right channel output buffer. Must hold count values.
+     * @param count The number of samples per channel to convert.
+     */
+    void Convert(const uint8_t* samples, uint32_t channels, float* left, float* right, size_t count) const;
+
+private:
+    template<typename SampleType>
+    using ConvertFunction = void (*)(const SampleType* samples, float* left, float* right, size_t count);
+
+    /**
+     * @brief Mono and stereo kernel functions for a single sample type.
+     */
+    template<typename SampleType>
+    struct KernelFunctions {
+        ConvertFunction<SampleType> mono{};   //!< Mono kernel, writes the same data to both outputs.
+        ConvertFunction<SampleType> stereo{}; //!< Stereo kernel, deinterleaves two channels.
+    };
+
+    Kernel m_kernel{Kernel::Scalar}; //!< The active kernel.
+
+    KernelFunctions<float> m_floatKernels;   //!< Kernels for 32-bit float samples.
+    KernelFunctions<int16_t> m_int16Kernels; //!< Kernels for signed 16-bit samples.
+    KernelFunctions<uint8_t> m_uint8Kernels; //!< Kernels for unsigned 8-bit samples.
+};
+
+} // namespace Audio
+} // namespace libprojectM
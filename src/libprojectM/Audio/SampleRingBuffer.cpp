@@ -0,0 +1,93 @@
+#include "SampleRingBuffer.hpp"
+
+#include <algorithm>
+
+namespace libprojectM {
+namespace Audio {
+
+constexpr size_t SampleRingBuffer::Capacity;
+constexpr size_t SampleRingBuffer::NoReader;
+
+auto SampleRingBuffer::PrepareWrite(size_t count) -> WriteRegion
+{
+    // Only the producer modifies the write position, so a relaxed load is sufficient.
+    size_t const writePosition = m_writePosition.load(std::memory_order_relaxed);
+    size_t writeCount = std::min(count, Capacity);
+
+    // Announce the slots about to be written, then check whether the consumer is copying any of them.
+    // Pairs with the store and load in ReadLatest(): either the consumer sees this reservation and
+    // skips the slots, or the reservation sees the consumer's position and leaves its slots alone.
+    m_reservedPosition.store(writePosition + writeCount, std::memory_order_seq_cst);
+    size_t const readerPosition = m_readerPosition.load(std::memory_order_seq_cst);
+    if (readerPosition != NoReader)
+    {
+        // The consumer may have announced slots which were overwritten before, then nothing is writable.
+        size_t const readerEnd = readerPosition + Capacity;
+        size_t const writableCount = readerEnd > writePosition ? readerEnd - writePosition : 0;
+        if (writeCount > writableCount)
+        {
+            writeCount = writableCount;
+            m_reservedPosition.store(writePosition + writeCount, std::memory_order_relaxed);
+        }
+    }
+
+    size_t const startIndex = writePosition & IndexMask;
+    size_t const firstLength = std::min(writeCount, Capacity - startIndex);
+
+    WriteRegion region;
+    region.left[0] = m_left.data() + startIndex;
+    region.right[0] = m_right.data() + startIndex;
+    region.length[0] = firstLength;
+    region.left[1] = m_left.data();
+    region.right[1] = m_right.data();
+    region.length[1] = writeCount - firstLength;
+
+    return region;
+}
+
+void SampleRingBuffer::CommitWrite(size_t count)
+{
+    size_t const writePosition = m_writePosition.load(std::memory_order_relaxed);
+    m_writePosition.store(writePosition + count, std::memory_order_release);
+}
+
+auto SampleRingBuffer::Available() const -> size_t
+{
+    return std::min(m_writePosition.load(std::memory_order_acquire) - m_readPosition.load(std::memory_order_relaxed), Capacity);
+}
+
+auto SampleRingBuffer::ReadLatest(float* left, float* right, size_t maxCount, size_t& skippedCount) -> size_t
+{
+    size_t const readPosition = m_readPosition.load(std::memory_order_relaxed);
+    size_t const writePosition = m_writePosition.load(std::memory_order_acquire);
+
+    size_t const available = writePosition - readPosition;
+    size_t copyStart = writePosition - std::min({available, maxCount, Capacity});
+
+    // Announce the slots about to be copied, then skip any the producer may already be overwriting.
+    m_readerPosition.store(copyStart, std::memory_order_seq_cst);
+    size_t const reservedPosition = m_reservedPosition.load(std::memory_order_seq_cst);
+    if (reservedPosition - copyStart > Capacity)
+    {
+        copyStart = std::min(reservedPosition - Capacity, writePosition);
+        m_readerPosition.store(copyStart, std::memory_order_relaxed);
+    }
+
+    size_t const copyCount = writePosition - copyStart;
+    size_t const startIndex = copyStart & IndexMask;
+    size_t const firstLength = std::min(copyCount, Capacity - startIndex);
+
+    std::copy_n(m_left.begin() + startIndex, firstLength, left);
+    std::copy_n(m_right.begin() + startIndex, firstLength, right);
+    std::copy_n(m_left.begin(), copyCount - firstLength, left + firstLength);
+    std::copy_n(m_right.begin(), copyCount - firstLength, right + firstLength);
+
+    m_readerPosition.store(NoReader, std::memory_order_release);
+    m_readPosition.store(writePosition, std::memory_order_relaxed);
+
+    skippedCount = available - copyCount;
+    return copyCount;
+}
+
+} // namespace Audio
+} // namespace libprojectM
@@ -0,0 +1,102 @@
+/**
+ * @file SampleRingBuffer.hpp
+ * @brief Lock-free single-producer/single-consumer ring buffer for stereo PCM samples.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+namespace libprojectM {
+namespace Audio {
+
+/**
+ * @class SampleRingBuffer
+ * @brief Lock-free single-producer/single-consumer ring buffer for stereo PCM samples.
+ *
+ * The audio thread (producer) writes whole blocks of deinterleaved samples and publishes them
+ * with a single release store of the write position. The render thread (consumer) acquires the
+ * write position and copies the newest published samples. Neither side ever waits for the other.
+ *
+ * For visualization, the newest audio matters most. If the consumer doesn't keep up, the producer
+ * overwrites the oldest unread samples, and the consumer skips them on its next read. The only
+ * slots the producer never overwrites are the ones the consumer is copying at that moment, which
+ * it announces before starting the copy. Both sides announce their intent with sequentially
+ * consistent stores followed by loads of the other side's announcement, so at least one of them
+ * always sees the other and no slot is written while being read.
+ */
+class SampleRingBuffer
+{
+public:
+    static constexpr size_t Capacity = 8192; //!< Number of stereo samples the buffer can hold. Must be a power of two.
+
+    static_assert((Capacity & (Capacity - 1)) == 0, "SampleRingBuffer::Capacity must be a power of two.");
+
+    /**
+     * @brief Up to two contiguous writable regions in the ring buffer.
+     * The second region is only used if the write wraps around the end of the buffer.
+     */
+    struct WriteRegion {
+        float* left[2]{};   //!< Start of the left channel span(s).
+        float* right[2]{};  //!< Start of the right channel span(s).
+        size_t length[2]{}; //!< Number of samples in each span.
+    };
+
+    /**
+     * @brief Producer: reserves space for up to count new samples.
+     *
+     * Unread samples are overwritten if needed. The returned region is only smaller than requested
+     * if count exceeds the capacity, or the consumer is copying the slots in question right now.
+     * The caller should then write the newest samples of its block. Nothing is visible to the
+     * consumer until CommitWrite() is called.
+     *
+     * @param count The number of samples the producer wants to write.
+     * @return The writable region, which holds length[0] + length[1] <= count samples.
+     */
+    auto PrepareWrite(size_t count) -> WriteRegion;
+
+    /**
+     * @brief Producer: publishes samples previously written to the region returned by PrepareWrite().
+     * @param count The number of samples written. Must not exceed the size of the prepared region.
+     */
+    void CommitWrite(size_t count);
+
+    /**
+     * @brief Consumer: returns the number of samples currently available for reading.
+     * @return The number of published, not yet consumed samples which are still stored.
+     */
+    auto Available() const -> size_t;
+
+    /**
+     * @brief Consumer: takes all available samples from the buffer and copies the newest ones.
+     *
+     * All published samples are consumed, but only the last (most recent) maxCount samples which
+     * are still stored are copied into the destination buffers, in chronological order.
+     *
+     * @param left Destination for the left channel samples.
+     * @param right Destination for the right channel samples.
+     * @param maxCount The maximum number of samples to copy.
+     * @param[out] skippedCount The number of consumed samples preceding the copied ones which were
+     *                          not copied, either because they were overwritten or due to maxCount.
+     * @return The number of samples copied, which is at most maxCount.
+     */
+    auto ReadLatest(float* left, float* right, size_t maxCount, size_t& skippedCount) -> size_t;
+
+private:
+    static constexpr size_t IndexMask = Capacity - 1;
+    static constexpr size_t NoReader = static_cast<size_t>(-1); //!< Value of m_readerPosition while the consumer isn't copying.
+
+    std::array<float, Capacity> m_left{};  //!< Left channel sample storage.
+    std::array<float, Capacity> m_right{}; //!< Right channel sample storage.
+
+    std::atomic<size_t> m_writePosition{0};                     //!< Total samples published by the producer.
+    std::atomic<size_t> m_reservedPosition{0};                  //!< End of the slots the producer is writing or has written.
+    char m_padding[64 - 2 * sizeof(std::atomic<size_t>)]{};     //!< Keeps the producer and consumer positions on separate cache lines.
+    std::atomic<size_t> m_readPosition{0};                      //!< Total samples consumed by the consumer.
+    std::atomic<size_t> m_readerPosition{NoReader};             //!< Start of the slots the consumer is copying, or NoReader.
+};
+
+} // namespace Audio
+} // namespace libprojectM
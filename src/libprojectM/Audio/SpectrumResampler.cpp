@@ -0,0 +1,154 @@
+#include "SpectrumResampler.hpp"
+
+#include <cmath>
+
+namespace libprojectM {
+namespace Audio {
+
+namespace {
+
+/**
+ * @brief Reduces each group of ratio source samples to their RMS magnitude.
+ *
+ * Always inlined, so the fixed-ratio kernels below get a constant inner loop trip count.
+ */
+inline void DecimateGroups(const float* source, float* target, size_t targetSamples, size_t ratio, float gain)
+{
+    float const inverseRatio = 1.0f / static_cast<float>(ratio);
+
+    for (size_t targetIndex = 0; targetIndex < targetSamples; targetIndex++)
+    {
+        const float* group = source + targetIndex * ratio;
+
+        float power{};
+        for (size_t i = 0; i < ratio; i++)
+        {
+            power += group[i] * group[i];
+        }
+
+        target[targetIndex] = gain * std::sqrt(power * inverseRatio);
+    }
+}
+
+/**
+ * @brief Linearly interpolates the power between source samples to get ratio target samples each.
+ *
+ * Always inlined, so the fixed-ratio kernels below get a constant inner loop trip count.
+ */
+inline void InterpolateGroups(const float* source, float* target, size_t sourceSamples, size_t ratio, float gain)
+{
+    float const inverseRatio = 1.0f / static_cast<float>(ratio);
+
+    for (size_t sourceIndex = 0; sourceIndex < sourceSamples; sourceIndex++)
+    {
+        // The last target samples are extrapolated flat, as there's no higher source frequency.
+        float const power = source[sourceIndex] * source[sourceIndex];
+        float const nextSource = sourceIndex + 1 < sourceSamples ? source[sourceIndex + 1] : source[sourceIndex];
+        float const powerDelta = nextSource * nextSource - power;
+
+        float* out = target + sourceIndex * ratio;
+        for (size_t i = 0; i < ratio; i++)
+        {
+            out[i] = gain * std::sqrt(power + powerDelta * static_cast<float>(i) * inverseRatio);
+        }
+    }
+}
+
+template<size_t Ratio>
+void Decimate(const float* source, float* target, size_t, size_t targetSamples, float gain)
+{
+    DecimateGroups(source, target, targetSamples, Ratio, gain);
+}
+
+template<>
+void Decimate<1>(const float* source, float* target, size_t, size_t targetSamples, float gain)
+{
+    for (size_t i = 0; i < targetSamples; i++)
+    {
+        target[i] = gain * source[i];
+    }
+}
+
+template<size_t Ratio>
+void Interpolate(const float* source, float* target, size_t sourceSamples, size_t, float gain)
+{
+    InterpolateGroups(source, target, sourceSamples, Ratio, gain);
+}
+
+void DecimateGeneric(const float* source, float* target, size_t sourceSamples, size_t targetSamples, float gain)
+{
+    DecimateGroups(source, target, targetSamples, sourceSamples / targetSamples, gain);
+}
+
+void InterpolateGeneric(const float* source, float* target, size_t sourceSamples, size_t targetSamples, float gain)
+{
+    InterpolateGroups(source, target, sourceSamples, targetSamples / sourceSamples, gain);
+}
+
+} // namespace
+
+SpectrumResampler::SpectrumResampler(size_t sourceSamples, size_t targetSamples, float gain)
+    : m_sourceSamples(sourceSamples)
+    , m_targetSamples(targetSamples)
+    , m_gain(gain)
+{
+    m_specialized = true;
+
+    if (sourceSamples >= targetSamples)
+    {
+        switch (sourceSamples / targetSamples)
+        {
+            case 1:
+                m_resample = &Decimate<1>;
+                break;
+
+            case 2:
+                m_resample = &Decimate<2>;
+                break;
+
+            case 4:
+                m_resample = &Decimate<4>;
+                break;
+
+            case 8:
+                m_resample = &Decimate<8>;
+                break;
+
+            default:
+                m_resample = &DecimateGeneric;
+                m_specialized = false;
+                break;
+        }
+    }
+    else
+    {
+        switch (targetSamples / sourceSamples)
+        {
+            case 2:
+                m_resample = &Interpolate<2>;
+                break;
+
+            case 4:
+                m_resample = &Interpolate<4>;
+                break;
+
+            default:
+                m_resample = &InterpolateGeneric;
+                m_specialized = false;
+                break;
+        }
+    }
+}
+
+void SpectrumResampler::Resample(const float* source, float* target) const
+{
+    m_resample(source, target, m_sourceSamples, m_targetSamples, m_gain);
+}
+
+auto SpectrumResampler::IsSpecialized() const -> bool
+{
+    return m_specialized;
+}
+
+} // namespace Audio
+} // namespace libprojectM
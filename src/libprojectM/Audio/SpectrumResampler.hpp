@@ -0,0 +1,66 @@
+/**
+ * @file SpectrumResampler.hpp
+ * @brief Converts spectrum analyzer output between different frequency resolutions.
+ */
+
+#pragma once
+
+#include <cstddef>
+
+namespace libprojectM {
+namespace Audio {
+
+/**
+ * @class SpectrumResampler
+ * @brief Converts spectrum analyzer output between different frequency resolutions.
+ *
+ * Used to map the output of a larger or smaller FFT onto the legacy number of spectrum samples.
+ * Both spectra cover the same frequency range, so each target frequency either corresponds to a
+ * group of consecutive source frequencies, or lies between two source frequencies.
+ *
+ * Magnitudes are combined in the power domain: a group of source frequencies is reduced to the
+ * root mean square of their magnitudes, and target frequencies between two source frequencies are
+ * linearly interpolated in power. Together with the gain, which compensates for the different
+ * analysis window length, this keeps the level of broadband signals like music independent of the
+ * analyzer resolution.
+ *
+ * Resampling kernels are instantiated for all power-of-two ratios between the supported analyzer
+ * sizes, so the inner loops have a fixed trip count and can be fully unrolled by the compiler.
+ */
+class SpectrumResampler
+{
+public:
+    /**
+     * @brief Creates a resampler for the given sizes.
+     * @param sourceSamples Number of source spectrum samples. Must be a power of two.
+     * @param targetSamples Number of target spectrum samples. Must be a power of two.
+     * @param gain Factor applied to all resampled magnitudes.
+     */
+    SpectrumResampler(size_t sourceSamples, size_t targetSamples, float gain);
+
+    /**
+     * @brief Resamples a spectrum.
+     * @param source The source spectrum. Must hold sourceSamples elements.
+     * @param target The target spectrum. Must hold targetSamples elements.
+     */
+    void Resample(const float* source, float* target) const;
+
+    /**
+     * @brief Returns whether a specialized kernel is used for the source/target ratio.
+     * @return true if a fixed-ratio kernel is used, false if the generic kernel is used.
+     */
+    auto IsSpecialized() const -> bool;
+
+private:
+    using ResampleFunction = void (*)(const float* source, float* target, size_t sourceSamples, size_t targetSamples, float gain);
+
+    size_t m_sourceSamples{}; //!< Number of source spectrum samples.
+    size_t m_targetSamples{}; //!< Number of target spectrum samples.
+    float m_gain{1.0f};       //!< Gain applied to the output.
+
+    ResampleFunction m_resample{}; //!< The resampling kernel for the source/target ratio.
+    bool m_specialized{false};     //!< True if m_resample is a fixed-ratio kernel.
+};
+
+} // namespace Audio
+} // namespace libprojectM
@@ -0,0 +1,308 @@
+#include "StereoFFT.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PROJECTM_STEREO_FFT_SSE2 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__aarch64__) || defined(_M_ARM64)
+#define PROJECTM_STEREO_FFT_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace libprojectM {
+namespace Audio {
+
+namespace {
+
+constexpr auto PI = 3.141592653589793238462643383279502884197169399;
+
+/**
+ * @brief Radix-2 decimation-in-frequency butterflies for four consecutive elements.
+ *
+ * Calculates x[j] = x[j] + x[j+h] and x[j+h] = (x[j] - x[j+h]) * w[j] for j in [0, 3].
+ */
+inline void Butterfly4(float* realLow, float* imagLow, float* realHigh, float* imagHigh,
+                       const float* twiddleReal, const float* twiddleImag)
+{
+#if defined(PROJECTM_STEREO_FFT_SSE2)
+    __m128 const aReal = _mm_loadu_ps(realLow);
+    __m128 const aImag = _mm_loadu_ps(imagLow);
+    __m128 const bReal = _mm_loadu_ps(realHigh);
+    __m128 const bImag = _mm_loadu_ps(imagHigh);
+    __m128 const wReal = _mm_loadu_ps(twiddleReal);
+    __m128 const wImag = _mm_loadu_ps(twiddleImag);
+
+    __m128 const dReal = _mm_sub_ps(aReal, bReal);
+    __m128 const dImag = _mm_sub_ps(aImag, bImag);
+
+    _mm_storeu_ps(realLow, _mm_add_ps(aReal, bReal));
+    _mm_storeu_ps(imagLow, _mm_add_ps(aImag, bImag));
+    _mm_storeu_ps(realHigh, _mm_sub_ps(_mm_mul_ps(dReal, wReal), _mm_mul_ps(dImag, wImag)));
+    _mm_storeu_ps(imagHigh, _mm_add_ps(_mm_mul_ps(dReal, wImag), _mm_mul_ps(dImag, wReal)));
+#elif defined(PROJECTM_STEREO_FFT_NEON)
+    float32x4_t const aReal = vld1q_f32(realLow);
+    float32x4_t const aImag = vld1q_f32(imagLow);
+    float32x4_t const bReal = vld1q_f32(realHigh);
+    float32x4_t const bImag = vld1q_f32(imagHigh);
+    float32x4_t const wReal = vld1q_f32(twiddleReal);
+    float32x4_t const wImag = vld1q_f32(twiddleImag);
+
+    float32x4_t const dReal = vsubq_f32(aReal, bReal);
+    float32x4_t const dImag = vsubq_f32(aImag, bImag);
+
+    vst1q_f32(realLow, vaddq_f32(aReal, bReal));
+    vst1q_f32(imagLow, vaddq_f32(aImag, bImag));
+    vst1q_f32(realHigh, vsubq_f32(vmulq_f32(dReal, wReal), vmulq_f32(dImag, wImag)));
+    vst1q_f32(imagHigh, vaddq_f32(vmulq_f32(dReal, wImag), vmulq_f32(dImag, wReal)));
+#else
+    for (int i = 0; i < 4; i++)
+    {
+        float const dReal = realLow[i] - realHigh[i];
+        float const dImag = imagLow[i] - imagHigh[i];
+        realLow[i] += realHigh[i];
+        imagLow[i] += imagHigh[i];
+        realHigh[i] = dReal * twiddleReal[i] - dImag * twiddleImag[i];
+        imagHigh[i] = dReal * twiddleImag[i] + dImag * twiddleReal[i];
+    }
+#endif
+}
+
+/**
+ * @brief Butterflies for a stage where all values in the upper half are zero.
+ *
+ * Calculates x[j+h] = x[j] * w[j] for j in [0, 3], x[j] stays unchanged.
+ */
+inline void ZeroPaddedButterfly4(const float* realLow, const float* imagLow, float* realHigh, float* imagHigh,
+                                 const float* twiddleReal, const float* twiddleImag)
+{
+#if defined(PROJECTM_STEREO_FFT_SSE2)
+    __m128 const aReal = _mm_loadu_ps(realLow);
+    __m128 const aImag = _mm_loadu_ps(imagLow);
+    __m128 const wReal = _mm_loadu_ps(twiddleReal);
+    __m128 const wImag = _mm_loadu_ps(twiddleImag);
+
+    _mm_storeu_ps(realHigh, _mm_sub_ps(_mm_mul_ps(aReal, wReal), _mm_mul_ps(aImag, wImag)));
+    _mm_storeu_ps(imagHigh, _mm_add_ps(_mm_mul_ps(aReal, wImag), _mm_mul_ps(aImag, wReal)));
+#elif defined(PROJECTM_STEREO_FFT_NEON)
+    float32x4_t const aReal = vld1q_f32(realLow);
+    float32x4_t const aImag = vld1q_f32(imagLow);
+    float32x4_t const wReal = vld1q_f32(twiddleReal);
+    float32x4_t const wImag = vld1q_f32(twiddleImag);
+
+    vst1q_f32(realHigh, vsubq_f32(vmulq_f32(aReal, wReal), vmulq_f32(aImag, wImag)));
+    vst1q_f32(imagHigh, vaddq_f32(vmulq_f32(aReal, wImag), vmulq_f32(aImag, wReal)));
+#else
+    for (int i = 0; i < 4; i++)
+    {
+        realHigh[i] = realLow[i] * twiddleReal[i] - imagLow[i] * twiddleImag[i];
+        imagHigh[i] = realLow[i] * twiddleImag[i] + imagLow[i] * twiddleReal[i];
+    }
+#endif
+}
+
+} // anonymous namespace
+
+StereoFFT::StereoFFT(size_t samplesIn, size_t samplesOut, bool equalize, float envelopePower)
+    : m_samplesIn(samplesIn)
+    , m_numFrequencies(samplesOut * 2)
+{
+    m_real.resize(m_numFrequencies);
+    m_imag.resize(m_numFrequencies);
+
+    InitTransformTables();
+    InitEnvelopeTable(envelopePower);
+    InitEqualizeTable(equalize);
+}
+
+void StereoFFT::InitEnvelopeTable(float power)
+{
+    m_envelope.resize(m_samplesIn);
+
+    if (power < 0.0f)
+    {
+        // Keep all values as-is.
+        std::fill(m_envelope.begin(), m_envelope.end(), 1.0f);
+        return;
+    }
+
+    float const pi = static_cast<float>(PI);
+    float const multiplier = 1.0f / static_cast<float>(m_samplesIn) * 2.0f * pi;
+
+    for (size_t i = 0; i < m_samplesIn; i++)
+    {
+        float const envelope = 0.5f + 0.5f * std::sin(static_cast<float>(i) * multiplier - pi * 0.5f);
+        m_envelope[i] = power == 1.0f ? envelope : std::pow(envelope, power);
+    }
+}
+
+void StereoFFT::InitEqualizeTable(bool equalize)
+{
+    size_t const halfNumFrequencies = m_numFrequencies / 2;
+
+    m_equalize.resize(halfNumFrequencies);
+
+    if (!equalize)
+    {
+        std::fill(m_equalize.begin(), m_equalize.end(), 1.0f);
+        return;
+    }
+
+    float const scaling = -0.02f;
+    float const inverseHalfNumFrequencies = 1.0f / static_cast<float>(halfNumFrequencies);
+
+    for (size_t i = 0; i < halfNumFrequencies; i++)
+    {
+        m_equalize[i] = scaling * std::log(static_cast<float>(halfNumFrequencies - i) * inverseHalfNumFrequencies);
+    }
+}
+
+void StereoFFT::InitTransformTables()
+{
+    m_twiddleReal.resize(m_numFrequencies);
+    m_twiddleImag.resize(m_numFrequencies);
+
+    // The stage with butterfly half-size h uses the (2h)th roots of unity w[j] = e^(-2*pi*i*j/(2h)), j in [0, h).
+    for (size_t halfSize = 1; halfSize < m_numFrequencies; halfSize <<= 1)
+    {
+        for (size_t j = 0; j < halfSize; j++)
+        {
+            double const theta = -PI * static_cast<double>(j) / static_cast<double>(halfSize);
+            m_twiddleReal[halfSize + j] = static_cast<float>(std::cos(theta));
+            m_twiddleImag[halfSize + j] = static_cast<float>(std::sin(theta));
+        }
+    }
+
+    // Decimation in frequency produces the output in bit-reversed order.
+    m_bitRev.resize(m_numFrequencies);
+
+    uint32_t bits{};
+    while ((size_t{1} << bits) < m_numFrequencies)
+    {
+        bits++;
+    }
+
+    for (size_t i = 0; i < m_numFrequencies; i++)
+    {
+        uint32_t reversed{};
+        for (uint32_t bit = 0; bit < bits; bit++)
+        {
+            reversed |= ((i >> bit) & 1) << (bits - 1 - bit);
+        }
+        m_bitRev[i] = reversed;
+    }
+}
+
+void StereoFFT::TimeToFrequencyDomain(const float* waveformLeft, const float* waveformRight,
+                                      float* spectrumLeft, float* spectrumRight)
+{
+    // 1. Pack the enveloped channels into one complex signal, left as real and right as imaginary part.
+    size_t const inputSamples = std::min(m_samplesIn, m_numFrequencies);
+    for (size_t i = 0; i < inputSamples; i++)
+    {
+        m_real[i] = waveformLeft[i] * m_envelope[i];
+        m_imag[i] = waveformRight[i] * m_envelope[i];
+    }
+    std::fill(m_real.begin() + inputSamples, m_real.end(), 0.0f);
+    std::fill(m_imag.begin() + inputSamples, m_imag.end(), 0.0f);
+
+    // 2. Perform FFT
+    TransformWideStages();
+    TransformLastStages();
+
+    // 3. Separate both channels, then take the magnitude & equalize it.
+    //    With Z = FFT(l + i*r), L[k] = (Z[k] + conj(Z[N-k])) / 2 and R[k] = (Z[k] - conj(Z[N-k])) / 2i.
+    size_t const mask = m_numFrequencies - 1;
+    for (size_t k = 0; k < m_numFrequencies / 2; k++)
+    {
+        size_t const index = m_bitRev[k];
+        size_t const mirrorIndex = m_bitRev[(m_numFrequencies - k) & mask];
+
+        float const leftReal = m_real[index] + m_real[mirrorIndex];
+        float const leftImag = m_imag[index] - m_imag[mirrorIndex];
+        float const rightReal = m_real[index] - m_real[mirrorIndex];
+        float const rightImag = m_imag[index] + m_imag[mirrorIndex];
+
+        spectrumLeft[k] = m_equalize[k] * 0.5f * std::sqrt(leftReal * leftReal + leftImag * leftImag);
+        spectrumRight[k] = m_equalize[k] * 0.5f * std::sqrt(rightReal * rightReal + rightImag * rightImag);
+    }
+}
+
+void StereoFFT::TransformWideStages()
+{
+    float* const real = m_real.data();
+    float* const imag = m_imag.data();
+    size_t halfSize = m_numFrequencies / 2;
+
+    // If the input only fills the lower half, the upper half of the first stage's input is zero.
+    if (halfSize >= 4 && m_samplesIn <= halfSize)
+    {
+        for (size_t j = 0; j < halfSize; j += 4)
+        {
+            ZeroPaddedButterfly4(real + j, imag + j, real + halfSize + j, imag + halfSize + j,
+                                 m_twiddleReal.data() + halfSize + j, m_twiddleImag.data() + halfSize + j);
+        }
+        halfSize >>= 1;
+    }
+
+    for (; halfSize >= 4; halfSize >>= 1)
+    {
+        const float* const twiddleReal = m_twiddleReal.data() + halfSize;
+        const float* const twiddleImag = m_twiddleImag.data() + halfSize;
+
+        for (size_t block = 0; block < m_numFrequencies; block += halfSize * 2)
+        {
+            for (size_t j = 0; j < halfSize; j += 4)
+            {
+                Butterfly4(real + block + j, imag + block + j,
+                           real + block + halfSize + j, imag + block + halfSize + j,
+                           twiddleReal + j, twiddleImag + j);
+            }
+        }
+    }
+}
+
+void StereoFFT::TransformLastStages()
+{
+    // A transform of size 2 (one output sample per channel) only has the stage h=1.
+    if (m_numFrequencies == 2)
+    {
+        float const realLow = m_real[0];
+        float const imagLow = m_imag[0];
+        m_real[0] = realLow + m_real[1];
+        m_imag[0] = imagLow + m_imag[1];
+        m_real[1] = realLow - m_real[1];
+        m_imag[1] = imagLow - m_imag[1];
+        return;
+    }
+
+    // Stage h=2 uses the twiddle factors 1 and -i, stage h=1 only 1, so no multiplications are needed.
+    for (size_t block = 0; block + 3 < m_numFrequencies; block += 4)
+    {
+        float* const real = m_real.data() + block;
+        float* const imag = m_imag.data() + block;
+
+        float const a0Real = real[0] + real[2];
+        float const a0Imag = imag[0] + imag[2];
+        float const a1Real = real[1] + real[3];
+        float const a1Imag = imag[1] + imag[3];
+        float const a2Real = real[0] - real[2];
+        float const a2Imag = imag[0] - imag[2];
+        // (x1 - x3) * -i
+        float const a3Real = imag[1] - imag[3];
+        float const a3Imag = real[3] - real[1];
+
+        real[0] = a0Real + a1Real;
+        imag[0] = a0Imag + a1Imag;
+        real[1] = a0Real - a1Real;
+        imag[1] = a0Imag - a1Imag;
+        real[2] = a2Real + a3Real;
+        imag[2] = a2Imag + a3Imag;
+        real[3] = a2Real - a3Real;
+        imag[3] = a2Imag - a3Imag;
+    }
+}
+
+} // namespace Audio
+} // namespace libprojectM
@@ -0,0 +1,118 @@
+/**
+ * @file StereoFFT.hpp
+ * @brief Spectrum analyzer transforming both audio channels with a single complex FFT.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace libprojectM {
+namespace Audio {
+
+/**
+ * @class StereoFFT
+ * @brief Spectrum analyzer transforming both audio channels with a single complex FFT.
+ *
+ * Produces the same output as running MilkdropFFT::TimeToFrequencyDomain() once per channel,
+ * including the envelope and equalization, but is considerably faster:
+ * - Both real-valued channels are packed into a single complex input (left as the real part,
+ *   right as the imaginary part) and separated again after the transform using the conjugate
+ *   symmetry of real-input FFTs. This halves the number of transforms.
+ * - The radix-2 decimation-in-frequency butterflies operate on separate real and imaginary arrays
+ *   and are vectorized with SSE2 or NEON where available.
+ * - Twiddle factors are precomputed for each stage in double precision. MilkdropFFT calculates
+ *   them recursively in single precision, which accumulates rounding errors.
+ * - All working memory is allocated once on construction, no allocations happen per transform.
+ *
+ * Due to the different summation order and more precise twiddle factors, the output is not
+ * bit-identical to MilkdropFFT. The absolute difference of each spectrum value to MilkdropFFT is
+ * below 1e-4 times the largest absolute input sample value. Most of this difference is caused by
+ * the rounding errors of MilkdropFFT. Compared to a double-precision DFT, the absolute error of this
+ * implementation is below 2e-6 times the largest absolute input sample value.
+ */
+class StereoFFT
+{
+public:
+    /**
+     * Initializes the Fast Fourier Transform.
+     * @param samplesIn Number of waveform samples which will be fed into the FFT.
+     * @param samplesOut Number of frequency samples generated per channel; MUST BE A POWER OF 2 and at least 1.
+     * @param equalize true to roughly equalize the magnitude of the basses and trebles,
+     *                 false to leave them untouched.
+     * @param envelopePower Specifies the envelope power. Set to any negative value to disable the envelope.
+     *                      See MilkdropFFT::InitEnvelopeTable() for more info.
+     */
+    StereoFFT(size_t samplesIn, size_t samplesOut, bool equalize = true, float envelopePower = 1.0f);
+
+    /**
+     * @brief Converts time-domain samples of both channels into frequency-domain samples.
+     *
+     * See MilkdropFFT::TimeToFrequencyDomain() for a description of the output.
+     *
+     * @param waveformLeft The left channel waveform data. Must contain at least samplesIn elements.
+     * @param waveformRight The right channel waveform data. Must contain at least samplesIn elements.
+     * @param spectrumLeft The resulting left channel frequency data. Must hold samplesOut elements.
+     * @param spectrumRight The resulting right channel frequency data. Must hold samplesOut elements.
+     */
+    void TimeToFrequencyDomain(const float* waveformLeft, const float* waveformRight,
+                               float* spectrumLeft, float* spectrumRight);
+
+    /**
+     * @brief Returns the number of frequency samples calculated.
+     * This is twice the value of samplesOut passed to the constructor.
+     * @return The number of frequency samples calculated.
+     */
+    auto NumFrequencies() const -> size_t
+    {
+        return m_numFrequencies;
+    };
+
+private:
+    /**
+     * @brief Initializes the equalizer envelope table, using the same curve as MilkdropFFT.
+     * @param power Number of convolutions in the envelope.
+     */
+    void InitEnvelopeTable(float power);
+
+    /**
+     * @brief Calculates equalization factors for each frequency, using the same curve as MilkdropFFT.
+     * @param equalize If false, all factors will be set to 1, otherwise will calculate a frequency-based multiplier.
+     */
+    void InitEqualizeTable(bool equalize);
+
+    /**
+     * @brief Calculates the twiddle factors for all stages and the bit-reversed output index table.
+     */
+    void InitTransformTables();
+
+    /**
+     * @brief Runs the radix-2 stages with a butterfly size of 8 or more samples.
+     * Does nothing for transform sizes of 4 or less, TransformLastStages() handles those completely.
+     */
+    void TransformWideStages();
+
+    /**
+     * @brief Runs the last two radix-2 stages, combined into a single radix-4 pass.
+     * For a transform size of 2, only runs the single remaining radix-2 stage.
+     */
+    void TransformLastStages();
+
+    size_t m_samplesIn{};      //!< Number of waveform samples to use for the FFT calculation.
+    size_t m_numFrequencies{}; //!< Number of frequency samples calculated by the FFT, also the transform size.
+
+    std::vector<float> m_envelope; //!< Equalizer envelope table.
+    std::vector<float> m_equalize; //!< Equalization values.
+
+    std::vector<float> m_twiddleReal; //!< Real parts of the twiddle factors. Stage with half-size h starts at index h.
+    std::vector<float> m_twiddleImag; //!< Imaginary parts of the twiddle factors, same layout as m_twiddleReal.
+    std::vector<uint32_t> m_bitRev;   //!< Bit-reversed index table to read the transform output in natural order.
+
+    std::vector<float> m_real; //!< Transform working memory, real parts.
+    std::vector<float> m_imag; //!< Transform working memory, imaginary parts.
+};
+
+} // namespace Audio
+} // namespace libprojectM
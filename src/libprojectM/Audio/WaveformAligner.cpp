@@ -4,6 +4,14 @@
 #include <cmath>
 #include <iterator>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PROJECTM_WAVEFORM_ALIGNER_SSE2 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__aarch64__) || defined(_M_ARM64)
+#define PROJECTM_WAVEFORM_ALIGNER_NEON 1
+#include <arm_neon.h>
+#endif
+
 namespace libprojectM {
 namespace Audio {
 
@@ -21,6 +29,7 @@ WaveformAligner::WaveformAligner()
     m_octaveSamples.resize(m_octaves);
     m_octaveSampleSpacing.resize(m_octaves);
     m_oldWaveformMips.resize(m_octaves);
+    m_newWaveformMips.resize(m_octaves);
 
     m_octaveSamples[0] = AudioBufferSamples;
     m_octaveSampleSpacing[0] = AudioBufferSamples - WaveformSamples;
@@ -119,6 +128,65 @@ void WaveformAligner::GenerateWeights()
     }
 }
 
+void WaveformAligner::CalculateErrorSums(const WaveformBuffer& newWaveformMip, uint32_t octave, int firstOffset, float* errorSums) const
+{
+    uint32_t const firstSample = m_firstNonzeroWeights[octave];
+    uint32_t const lastSample = m_lastNonzeroWeights[octave];
+    const auto& oldWaveformMip = m_oldWaveformMips[octave];
+    const auto& weights = m_aligmentWeights[octave];
+
+    // The vector code reads four new samples per step, which must all be inside the buffer.
+    bool const vectorize = m_vectorizedErrorSums && lastSample + firstOffset + 4 <= newWaveformMip.size();
+
+#if defined(PROJECTM_WAVEFORM_ALIGNER_SSE2)
+    if (vectorize)
+    {
+        // Weights are never negative, so |(new - old) * weight| == |new - old| * weight.
+        __m128 const absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+        __m128 sums = _mm_setzero_ps();
+        for (uint32_t i = firstSample; i <= lastSample; i++)
+        {
+            __m128 const difference = _mm_sub_ps(_mm_loadu_ps(&newWaveformMip[i + firstOffset]), _mm_set1_ps(oldWaveformMip[i]));
+            sums = _mm_add_ps(sums, _mm_mul_ps(_mm_and_ps(difference, absMask), _mm_set1_ps(weights[i])));
+        }
+        _mm_storeu_ps(errorSums, sums);
+        return;
+    }
+#elif defined(PROJECTM_WAVEFORM_ALIGNER_NEON)
+    if (vectorize)
+    {
+        // Weights are never negative, so |(new - old) * weight| == |new - old| * weight.
+        float32x4_t sums = vdupq_n_f32(0.0f);
+        for (uint32_t i = firstSample; i <= lastSample; i++)
+        {
+            float32x4_t const difference = vsubq_f32(vld1q_f32(&newWaveformMip[i + firstOffset]), vdupq_n_f32(oldWaveformMip[i]));
+            sums = vaddq_f32(sums, vmulq_f32(vabsq_f32(difference), vdupq_n_f32(weights[i])));
+        }
+        vst1q_f32(errorSums, sums);
+        return;
+    }
+#else
+    static_cast<void>(vectorize);
+#endif
+
+    for (int lane = 0; lane < 4; lane++)
+    {
+        int const offset = firstOffset + lane;
+        float errorSum{};
+
+        // Skip offsets which would read past the end of the buffer. These are never used by the caller.
+        if (lastSample + offset < newWaveformMip.size())
+        {
+            for (uint32_t i = firstSample; i <= lastSample; i++)
+            {
+                errorSum += std::abs((newWaveformMip[i + offset] - oldWaveformMip[i]) * weights[i]);
+            }
+        }
+
+        errorSums[lane] = errorSum;
+    }
+}
+
 int WaveformAligner::CalculateOffset(std::vector<WaveformBuffer>& newWaveformMips)
 {
     /*
@@ -137,21 +205,21 @@ int WaveformAligner::CalculateOffset(std::vector<WaveformBuffer>& newWaveformMip
         float lowestErrorAmount{};
 
         // For each octave, find the offset that maximizes the correlation between waveforms.
-        for (int sample = offsetStart; sample < offsetEnd; sample++)
+        // Perform the cross-correlation for four offsets at once. Note that we shift the new waveform but
+        // not the old one because we're looking for the offset between them that produces the lowest error.
+        for (int firstOffset = offsetStart; firstOffset < offsetEnd; firstOffset += 4)
         {
-            float errorSum{};
-
-            // Perform the cross-correlation. Note that we shift the new waveform but not the old
-            // one because we're looking for the offset between them that produces the lowest error.
-            for (uint32_t i = m_firstNonzeroWeights[octave]; i <= m_lastNonzeroWeights[octave]; i++)
-            {
-                errorSum += std::abs((newWaveformMips[octave][i + sample] - m_oldWaveformMips[octave][i]) * m_aligmentWeights[octave][i]);
-            }
+            float errorSums[4];
+            CalculateErrorSums(newWaveformMips[octave], static_cast<uint32_t>(octave), firstOffset, errorSums);
 
-            if (lowestErrorOffset == -1 || errorSum < lowestErrorAmount)
+            for (int sample = firstOffset; sample < std::min(firstOffset + 4, offsetEnd); sample++)
             {
-                lowestErrorOffset = static_cast<int>(sample);
-                lowestErrorAmount = errorSum;
+                float const errorSum = errorSums[sample - firstOffset];
+                if (lowestErrorOffset == -1 || errorSum < lowestErrorAmount)
+                {
+                    lowestErrorOffset = static_cast<int>(sample);
+                    lowestErrorAmount = errorSum;
+                }
             }
         }
 
@@ -200,8 +268,7 @@ void WaveformAligner::Align(WaveformBuffer& newWaveform)
     }
 
 
-    std::vector<WaveformBuffer> newWaveformMips(m_octaves, WaveformBuffer());
-    ResampleOctaves(newWaveformMips, newWaveform);
+    ResampleOctaves(m_newWaveformMips, newWaveform);
 
     if (!m_alignWaveReady)
     {
@@ -210,7 +277,7 @@ void WaveformAligner::Align(WaveformBuffer& newWaveform)
         m_alignWaveReady = true;
     }
 
-    int alignOffset = CalculateOffset(newWaveformMips);
+    int alignOffset = CalculateOffset(m_newWaveformMips);
 
     // Finally, apply the results by scooting the aligned samples so that they start at index 0.
     // This is the second place where we limit negative offsets.
@@ -22,6 +22,10 @@ namespace Audio {
  * and sample offsets, then shifts the new waveform forward to best align with the previous frame.
  * This will keep similar features in-place instead of randomly jumping around on each frame and creates
  * for a smoother-looking waveform visualization.
+ *
+ * The error sums for up to four candidate offsets are calculated at once using SSE2 or NEON, with
+ * one offset per vector lane. Each lane adds up its samples in the same order as the scalar code,
+ * so the chosen offsets are identical on all platforms.
  */
 class WaveformAligner
 {
@@ -39,7 +43,17 @@ protected:
     int CalculateOffset(std::vector<WaveformBuffer>& newWaveformMips);
     void ResampleOctaves(std::vector<WaveformBuffer>& dstWaveformMips, WaveformBuffer& newWaveform);
 
-    bool m_alignWaveReady{false}; //!< Alignment needs special treatment for the first buffer fill.
+    /**
+     * @brief Calculates the weighted absolute error between the old and new waveform for four consecutive offsets.
+     * @param newWaveformMip The new waveform's mip level for the given octave.
+     * @param octave The octave to compare.
+     * @param firstOffset The first offset to check.
+     * @param errorSums Receives the error sums for the offsets firstOffset to firstOffset + 3.
+     */
+    void CalculateErrorSums(const WaveformBuffer& newWaveformMip, uint32_t octave, int firstOffset, float* errorSums) const;
+
+    bool m_alignWaveReady{false};     //!< Alignment needs special treatment for the first buffer fill.
+    bool m_vectorizedErrorSums{true}; //!< If false, always uses the scalar error sum code. Used for testing and benchmarks.
 
     std::vector<std::array<float, AudioBufferSamples>> m_aligmentWeights; //!< Sample weights per octave.
 
@@ -48,6 +62,7 @@ protected:
     std::vector<uint32_t> m_octaveSampleSpacing; //!< Space between samples per octave.
 
     std::vector<WaveformBuffer> m_oldWaveformMips; //!< Mip levels of the previous frame's waveform.
+    std::vector<WaveformBuffer> m_newWaveformMips; //!< Mip levels of the current frame's waveform.
     std::vector<uint32_t> m_firstNonzeroWeights;   //!< First non-zero weight sample index for each octave.
     std::vector<uint32_t> m_lastNonzeroWeights;    //!< Last non-zero weight sample index for each octave.
 };
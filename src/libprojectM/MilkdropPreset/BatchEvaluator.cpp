@@ -0,0 +1,573 @@
+#include "BatchEvaluator.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+namespace libprojectM {
+namespace MilkdropPreset {
+
+namespace {
+
+// Tolerances used by the expression library for comparisons and truth values.
+constexpr double CloseFactor = 0.00001;
+constexpr double CloseFactorLow = 1e-300;
+
+template<typename Value>
+auto IsTrue(Value value) -> bool
+{
+    return std::fabs(value) > static_cast<Value>(CloseFactorLow);
+}
+
+} // namespace
+
+template<typename Value>
+BasicBatchEvaluator<Value>::BasicBatchEvaluator(const ExpressionNode& root, const std::vector<std::string>& variables)
+{
+    CollectAssignedVariables(root);
+
+    for (const auto& name : variables)
+    {
+        VariableRegister(name);
+    }
+
+    Compile(root, NoMask);
+
+    m_registers.resize(static_cast<size_t>(m_registerCount) * BatchSize, Value{});
+    for (const auto& constant : m_constants)
+    {
+        std::fill_n(Register(constant.first), BatchSize, static_cast<Value>(constant.second));
+    }
+}
+
+template<typename Value>
+auto BasicBatchEvaluator<Value>::Lanes(const std::string& name) -> Value*
+{
+    auto variable = m_variables.find(name);
+    if (variable == m_variables.end())
+    {
+        return nullptr;
+    }
+
+    return Register(variable->second);
+}
+
+template<typename Value>
+auto BasicBatchEvaluator<Value>::ReadVariables() const -> const std::vector<std::string>&
+{
+    return m_readVariables;
+}
+
+template<typename Value>
+void BasicBatchEvaluator<Value>::Execute(size_t count)
+{
+    assert(count <= BatchSize);
+
+    constexpr Value zero{0};
+    constexpr Value one{1};
+
+    for (const auto& instruction : m_program)
+    {
+        Value* out = Register(instruction.destination);
+        const Value* a = Register(instruction.operands[0]);
+        const Value* b = Register(instruction.operands[1]);
+        const Value* c = Register(instruction.operands[2]);
+
+        switch (instruction.opcode)
+        {
+            case Opcode::Copy:
+                std::copy_n(a, count, out);
+                break;
+
+            case Opcode::StoreMasked:
+                for (size_t i = 0; i < count; i++)
+                {
+                    out[i] = b[i] != zero ? a[i] : out[i];
+                }
+                break;
+
+            case Opcode::Select:
+                for (size_t i = 0; i < count; i++)
+                {
+                    out[i] = a[i] != zero ? b[i] : c[i];
+                }
+                break;
+
+            case Opcode::Truth:
+                for (size_t i = 0; i < count; i++)
+                {
+                    out[i] = IsTrue(a[i]) ? one : zero;
+                }
+                break;
+
+            case Opcode::Not:
+                for (size_t i = 0; i < count; i++)
+                {
+                    out[i] = IsTrue(a[i]) ? zero : one;
+                }
+                break;
+
+            case Opcode::MaskAnd:
+                for (size_t i = 0; i < count; i++)
+                {
+                    out[i] = (a[i] != zero && b[i] != zero) ? one : zero;
+                }
+                break;
+
+            case Opcode::MaskOr:
+                for (size_t i = 0; i < count; i++)
+                {
+                    out[i] = (a[i] != zero || b[i] != zero) ? one : zero;
+                }
+                break;
+
+            case Opcode::Negate:
+                for (size_t i = 0; i < count; i++)
+                {
+                    out[i] = -a[i];
+                }
+                break;
+
+            case Opcode::Add:
+                for (size_t i = 0; i < count; i++)
+                {
+                    out[i] = a[i] + b[i];
+                }
+                break;
+
+            case Opcode::Subtract:
+                for (size_t i = 0; i < count; i++)
+                {
+                    out[i] = a[i] - b[i];
+                }
+                break;
+
+            case Opcode::Multiply:
+                for (size_t i = 0; i < count; i++)
+                {
+                    out[i] = a[i] * b[i];
+                }
+                break;
+
+            case Opcode::Divide:
+                for (size_t i = 0; i < count; i++)
+                {
+                    out[i] = b[i] == zero ? zero : a[i] / b[i];
+                }
+                break;
+
+            case Opcode::Modulo:
+                for (size_t i = 0; i < count; i++)
+                {
+                    // x % -1 is always 0, but INT_MIN % -1 would trap.
+                    auto const divisor = static_cast<int>(b[i]);
+                    out[i] = (divisor == 0 || divisor == -1) ? zero : static_cast<Value>(static_cast<int>(a[i]) % divisor);
+                }
+                break;
+
+            case Opcode::Equal:
+                for (size_t i = 0; i < count; i++)
+                {
+                    out[i] = std::fabs(a[i] - b[i]) < static_cast<Value>(CloseFactor) ? one : zero;
+                }
+                break;
+
+            case Opcode::NotEqual:
+                for (size_t i = 0; i < count; i++)
+                {
+                    out[i] = std::fabs(a[i] - b[i]) < static_cast<Value>(CloseFactor) ? zero : one;
+                }
+                break;
+
+            case Opcode::ExactEqual:
+                for (size_t i = 0; i < count; i++)
+                {
+                    out[i] = a[i] == b[i] ? one : zero;
+                }
+                break;
+
+            case Opcode::ExactNotEqual:
+                for (size_t i = 0; i < count; i++)
+                {
+                    out[i] = a[i] != b[i] ? one : zero;
+                }
+                break;
+
+            case Opcode::Less:
+                for (size_t i = 0; i < count; i++)
+                {
+                    out[i] = a[i] < b[i] ? one : zero;
+                }
+                break;
+
+            case Opcode::Greater:
+                for (size_t i = 0; i < count; i++)
+                {
+                    out[i] = a[i] > b[i] ? one : zero;
+                }
+                break;
+
+            case Opcode::LessEqual:
+                for (size_t i = 0; i < count; i++)
+                {
+                    out[i] = a[i] <= b[i] ? one : zero;
+                }
+                break;
+
+            case Opcode::GreaterEqual:
+                for (size_t i = 0; i < count; i++)
+                {
+                    out[i] = a[i] >= b[i] ? one : zero;
+                }
+                break;
+
+            case Opcode::Sqr:
+                for (size_t i = 0; i < count; i++)
+                {
+                    out[i] = a[i] * a[i];
+                }
+                break;
+
+            case Opcode::Sqrt:
+                for (size_t i = 0; i < count; i++)
+                {
+                    out[i] = std::sqrt(std::fabs(a[i]));
+                }
+                break;
+
+            case Opcode::Abs:
+                for (size_t i = 0; i < count; i++)
+                {
+                    out[i] = std::fabs(a[i]);
+                }
+                break;
+
+            case Opcode::Sign:
+                for (size_t i = 0; i < count; i++)
+                {
+                    out[i] = a[i] > zero ? one : (a[i] < zero ? -one : zero);
+                }
+                break;
+
+            case Opcode::Min:
+                for (size_t i = 0; i < count; i++)
+                {
+                    out[i] = a[i] < b[i] ? a[i] : b[i];
+                }
+                break;
+
+            case Opcode::Max:
+                for (size_t i = 0; i < count; i++)
+                {
+                    out[i] = a[i] > b[i] ? a[i] : b[i];
+                }
+                break;
+
+            case Opcode::Floor:
+                for (size_t i = 0; i < count; i++)
+                {
+                    out[i] = std::floor(a[i]);
+                }
+                break;
+
+            case Opcode::Ceil:
+                for (size_t i = 0; i < count; i++)
+                {
+                    out[i] = std::ceil(a[i]);
+                }
+                break;
+
+            case Opcode::Function1:
+                for (size_t i = 0; i < count; i++)
+                {
+                    out[i] = instruction.function1(a[i]);
+                }
+                break;
+
+            case Opcode::Function2:
+                for (size_t i = 0; i < count; i++)
+                {
+                    out[i] = instruction.function2(a[i], b[i]);
+                }
+                break;
+        }
+    }
+}
+
+template<typename Value>
+auto BasicBatchEvaluator<Value>::WithinTolerance(double expected, double actual) -> bool
+{
+    if (std::isnan(expected) || std::isnan(actual))
+    {
+        return std::isnan(expected) && std::isnan(actual);
+    }
+
+    if (expected == actual)
+    {
+        return true;
+    }
+
+    auto const difference = std::fabs(expected - actual);
+    return difference <= AbsoluteTolerance || difference <= RelativeTolerance * std::max(std::fabs(expected), std::fabs(actual));
+}
+
+template<typename Value>
+auto BasicBatchEvaluator<Value>::MatchesReference(const float* expected, const float* actual, size_t count) -> bool
+{
+    if (sizeof(Value) == sizeof(double))
+    {
+        return std::memcmp(expected, actual, count * sizeof(float)) == 0;
+    }
+
+    return std::equal(expected, expected + count, actual, [](float expectedValue, float actualValue) {
+        return WithinTolerance(expectedValue, actualValue);
+    });
+}
+
+template<typename Value>
+auto BasicBatchEvaluator<Value>::Compile(const ExpressionNode& node, uint32_t mask) -> uint32_t
+{
+    auto compileArgument = [this, &node, mask](size_t index) {
+        return Compile(*node.arguments[index], mask);
+    };
+
+    switch (node.operation)
+    {
+        case ExpressionOperation::Constant: {
+            auto const constant = NewRegister();
+            m_constants.emplace_back(constant, node.value);
+            return constant;
+        }
+
+        case ExpressionOperation::Variable: {
+            if (std::find(m_readVariables.begin(), m_readVariables.end(), node.name) == m_readVariables.end())
+            {
+                m_readVariables.push_back(node.name);
+            }
+
+            auto const variable = VariableRegister(node.name);
+
+            // Later assignments must not change the value already read.
+            if (m_assignedVariables.find(node.name) != m_assignedVariables.end())
+            {
+                return Emit(Opcode::Copy, NewRegister(), variable);
+            }
+            return variable;
+        }
+
+        case ExpressionOperation::Assign: {
+            auto const value = compileArgument(0);
+            auto const variable = VariableRegister(node.name);
+            if (mask == NoMask)
+            {
+                Emit(Opcode::Copy, variable, value);
+            }
+            else
+            {
+                Emit(Opcode::StoreMasked, variable, value, mask);
+            }
+            return value;
+        }
+
+        case ExpressionOperation::Sequence: {
+            uint32_t result{};
+            for (size_t index = 0; index < node.arguments.size(); index++)
+            {
+                result = compileArgument(index);
+            }
+            return result;
+        }
+
+        case ExpressionOperation::If: {
+            auto const condition = compileArgument(0);
+
+            auto trueMask = Emit(Opcode::Truth, NewRegister(), condition);
+            auto falseMask = Emit(Opcode::Not, NewRegister(), condition);
+            if (mask != NoMask)
+            {
+                trueMask = Emit(Opcode::MaskAnd, NewRegister(), trueMask, mask);
+                falseMask = Emit(Opcode::MaskAnd, NewRegister(), falseMask, mask);
+            }
+
+            auto const trueValue = Compile(*node.arguments[1], trueMask);
+            auto const falseValue = Compile(*node.arguments[2], falseMask);
+            return Emit(Opcode::Select, NewRegister(), trueMask, trueValue, falseValue);
+        }
+
+        case ExpressionOperation::And:
+        case ExpressionOperation::Or: {
+            // The right-hand side is only evaluated if the left-hand side doesn't decide the result.
+            bool const isAnd = node.operation == ExpressionOperation::And;
+            auto const left = Emit(Opcode::Truth, NewRegister(), compileArgument(0));
+
+            auto rightMask = isAnd ? left : Emit(Opcode::Not, NewRegister(), left);
+            if (mask != NoMask)
+            {
+                rightMask = Emit(Opcode::MaskAnd, NewRegister(), rightMask, mask);
+            }
+
+            auto const right = Emit(Opcode::Truth, NewRegister(), Compile(*node.arguments[1], rightMask));
+            return Emit(isAnd ? Opcode::MaskAnd : Opcode::MaskOr, NewRegister(), left, right);
+        }
+
+        default:
+            break;
+    }
+
+    // Plain operators and functions: evaluate all arguments, then apply the operation.
+    std::vector<uint32_t> operands;
+    for (size_t index = 0; index < node.arguments.size(); index++)
+    {
+        operands.push_back(compileArgument(index));
+    }
+    operands.resize(3, 0);
+
+    auto emit = [this, &operands](Opcode opcode) {
+        return Emit(opcode, NewRegister(), operands[0], operands[1], operands[2]);
+    };
+    auto emitFunction1 = [this, &operands](Value (*function)(Value)) {
+        auto const result = Emit(Opcode::Function1, NewRegister(), operands[0]);
+        m_program.back().function1 = function;
+        return result;
+    };
+    auto emitFunction2 = [this, &operands](Value (*function)(Value, Value)) {
+        auto const result = Emit(Opcode::Function2, NewRegister(), operands[0], operands[1]);
+        m_program.back().function2 = function;
+        return result;
+    };
+
+    switch (node.operation)
+    {
+        case ExpressionOperation::Negate:
+            return emit(Opcode::Negate);
+        case ExpressionOperation::Not:
+            return emit(Opcode::Not);
+        case ExpressionOperation::Add:
+            return emit(Opcode::Add);
+        case ExpressionOperation::Subtract:
+            return emit(Opcode::Subtract);
+        case ExpressionOperation::Multiply:
+            return emit(Opcode::Multiply);
+        case ExpressionOperation::Divide:
+            return emit(Opcode::Divide);
+        case ExpressionOperation::Modulo:
+            return emit(Opcode::Modulo);
+        case ExpressionOperation::Equal:
+            return emit(Opcode::Equal);
+        case ExpressionOperation::NotEqual:
+            return emit(Opcode::NotEqual);
+        case ExpressionOperation::ExactEqual:
+            return emit(Opcode::ExactEqual);
+        case ExpressionOperation::ExactNotEqual:
+            return emit(Opcode::ExactNotEqual);
+        case ExpressionOperation::Less:
+            return emit(Opcode::Less);
+        case ExpressionOperation::Greater:
+            return emit(Opcode::Greater);
+        case ExpressionOperation::LessEqual:
+            return emit(Opcode::LessEqual);
+        case ExpressionOperation::GreaterEqual:
+            return emit(Opcode::GreaterEqual);
+        case ExpressionOperation::Sqr:
+            return emit(Opcode::Sqr);
+        case ExpressionOperation::Sqrt:
+            return emit(Opcode::Sqrt);
+        case ExpressionOperation::Abs:
+            return emit(Opcode::Abs);
+        case ExpressionOperation::Sign:
+            return emit(Opcode::Sign);
+        case ExpressionOperation::Min:
+            return emit(Opcode::Min);
+        case ExpressionOperation::Max:
+            return emit(Opcode::Max);
+        case ExpressionOperation::Floor:
+            return emit(Opcode::Floor);
+        case ExpressionOperation::Ceil:
+            return emit(Opcode::Ceil);
+        case ExpressionOperation::Power:
+            return emitFunction2([](Value base, Value exponent) { return std::pow(base, exponent); });
+        case ExpressionOperation::Atan2:
+            return emitFunction2([](Value y, Value x) { return std::atan2(y, x); });
+        case ExpressionOperation::Sin:
+            return emitFunction1([](Value value) { return std::sin(value); });
+        case ExpressionOperation::Cos:
+            return emitFunction1([](Value value) { return std::cos(value); });
+        case ExpressionOperation::Tan:
+            return emitFunction1([](Value value) { return std::tan(value); });
+        case ExpressionOperation::Asin:
+            return emitFunction1([](Value value) { return std::asin(value); });
+        case ExpressionOperation::Acos:
+            return emitFunction1([](Value value) { return std::acos(value); });
+        case ExpressionOperation::Atan:
+            return emitFunction1([](Value value) { return std::atan(value); });
+        case ExpressionOperation::Exp:
+            return emitFunction1([](Value value) { return std::exp(value); });
+        case ExpressionOperation::Log:
+            return emitFunction1([](Value value) { return std::log(value); });
+        case ExpressionOperation::Log10:
+            return emitFunction1([](Value value) { return std::log10(value); });
+        default:
+            assert(false);
+            return operands[0];
+    }
+}
+
+template<typename Value>
+auto BasicBatchEvaluator<Value>::VariableRegister(const std::string& name) -> uint32_t
+{
+    auto variable = m_variables.find(name);
+    if (variable != m_variables.end())
+    {
+        return variable->second;
+    }
+
+    auto const index = NewRegister();
+    m_variables.emplace(name, index);
+    return index;
+}
+
+template<typename Value>
+auto BasicBatchEvaluator<Value>::NewRegister() -> uint32_t
+{
+    return m_registerCount++;
+}
+
+template<typename Value>
+auto BasicBatchEvaluator<Value>::Emit(Opcode opcode, uint32_t destination, uint32_t operand1, uint32_t operand2, uint32_t operand3) -> uint32_t
+{
+    Instruction instruction;
+    instruction.opcode = opcode;
+    instruction.destination = destination;
+    instruction.operands[0] = operand1;
+    instruction.operands[1] = operand2;
+    instruction.operands[2] = operand3;
+    m_program.push_back(instruction);
+    return destination;
+}
+
+template<typename Value>
+void BasicBatchEvaluator<Value>::CollectAssignedVariables(const ExpressionNode& node)
+{
+    if (node.operation == ExpressionOperation::Assign)
+    {
+        m_assignedVariables.insert(node.name);
+    }
+
+    for (const auto& argument : node.arguments)
+    {
+        CollectAssignedVariables(*argument);
+    }
+}
+
+template<typename Value>
+auto BasicBatchEvaluator<Value>::Register(uint32_t index) -> Value*
+{
+    return m_registers.data() + static_cast<size_t>(index) * BatchSize;
+}
+
+template class BasicBatchEvaluator<double>;
+template class BasicBatchEvaluator<float>;
+
+} // namespace MilkdropPreset
+} // namespace libprojectM
@@ -0,0 +1,204 @@
+#pragma once
+
+#include "ExpressionTree.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace libprojectM {
+namespace MilkdropPreset {
+
+/**
+ * @brief Evaluates parsed expression code for a whole batch of inputs at once.
+ *
+ * The expression tree is compiled into a flat list of instructions, each applying a single operation
+ * to BatchSize values stored in structure-of-arrays form. Every variable and intermediate result is a
+ * "register" holding one value per lane. This removes the per-execution dispatch and variable
+ * marshalling overhead of the tree interpreter, and the simple per-instruction loops can be
+ * vectorized by the compiler.
+ *
+ * Conditionals evaluate both branches for all lanes and select the result per lane. Assignments
+ * inside a conditional branch only affect lanes for which the branch condition is true. As all lanes
+ * are independent, this is only valid for code which doesn't carry any state from one execution to
+ * the next, see CodeAnalysis::IsParallelSafe().
+ *
+ * The host writes the input values to the variable lanes, calls Execute() and then reads the results
+ * from the lanes of the output variables. Lanes not written by the host or code keep their values.
+ *
+ * Lanes either hold double precision values, giving the same results as the expression library, or
+ * single precision values. Single precision doubles the number of lanes per SIMD register and halves
+ * the memory traffic, but results differ slightly, see WithinTolerance().
+ *
+ * @tparam Value The lane value type, double or float.
+ */
+template<typename Value>
+class BasicBatchEvaluator
+{
+public:
+    static constexpr size_t BatchSize = 64; //!< Maximum number of inputs evaluated in one Execute() call.
+
+    static constexpr double RelativeTolerance = 1e-3; //!< Allowed relative difference of single precision results.
+    static constexpr double AbsoluteTolerance = 1e-3; //!< Allowed absolute difference of single precision results near zero.
+
+    /**
+     * @brief Compiles the given expression tree.
+     * @param root The root node of the parsed code.
+     * @param variables Variables to create lanes for even if not used by the code, e.g. all host inputs and outputs.
+     */
+    BasicBatchEvaluator(const ExpressionNode& root, const std::vector<std::string>& variables);
+
+    /**
+     * @brief Returns the value lanes of a variable.
+     * @param name The lower-case variable name.
+     * @return A pointer to BatchSize values, or nullptr if the variable isn't used by the code.
+     */
+    auto Lanes(const std::string& name) -> Value*;
+
+    /**
+     * @brief Returns the names of all variables read by the code.
+     * @return The lower-case names of all variables read by the code. Can include temporaries.
+     */
+    auto ReadVariables() const -> const std::vector<std::string>&;
+
+    /**
+     * @brief Evaluates the code for the first count lanes.
+     * @param count The number of lanes to evaluate. Must not exceed BatchSize.
+     */
+    void Execute(size_t count);
+
+    /**
+     * @brief Returns whether a single precision result is close enough to the double precision result to be indistinguishable on screen.
+     * @param expected The double precision result.
+     * @param actual The single precision result.
+     * @return True if the values are equal within RelativeTolerance or AbsoluteTolerance, or are both NaN.
+     */
+    static auto WithinTolerance(double expected, double actual) -> bool;
+
+    /**
+     * @brief Compares host results calculated from the lanes with results calculated by the expression library.
+     *
+     * Double precision results must match bitwise, single precision results within WithinTolerance().
+     *
+     * @param expected The results calculated by the expression library.
+     * @param actual The results calculated from this evaluator's lanes.
+     * @param count The number of values to compare.
+     * @return True if all values match.
+     */
+    static auto MatchesReference(const float* expected, const float* actual, size_t count) -> bool;
+
+private:
+    enum class Opcode
+    {
+        Copy,
+        StoreMasked,
+        Select,
+        Truth,
+        Not,
+        MaskAnd,
+        MaskOr,
+        Negate,
+        Add,
+        Subtract,
+        Multiply,
+        Divide,
+        Modulo,
+        Equal,
+        NotEqual,
+        ExactEqual,
+        ExactNotEqual,
+        Less,
+        Greater,
+        LessEqual,
+        GreaterEqual,
+        Sqr,
+        Sqrt,
+        Abs,
+        Sign,
+        Min,
+        Max,
+        Floor,
+        Ceil,
+        Function1,
+        Function2
+    };
+
+    /**
+     * A single operation, applied to all lanes of the operand registers.
+     */
+    struct Instruction {
+        Opcode opcode{Opcode::Copy};
+        uint32_t destination{};
+        uint32_t operands[3]{};
+        Value (*function1)(Value){};
+        Value (*function2)(Value, Value){};
+    };
+
+    static constexpr uint32_t NoMask = UINT32_MAX; //!< Mask register index for unconditionally executed code.
+
+    /**
+     * Compiles a node and its arguments into instructions.
+     * @param node The node to compile.
+     * @param mask The register holding the execution mask for assignments, or NoMask.
+     * @return The register holding the node result.
+     */
+    auto Compile(const ExpressionNode& node, uint32_t mask) -> uint32_t;
+
+    /**
+     * Returns the register of a variable, allocating it if needed.
+     */
+    auto VariableRegister(const std::string& name) -> uint32_t;
+
+    /**
+     * Allocates a new register for an intermediate result.
+     */
+    auto NewRegister() -> uint32_t;
+
+    /**
+     * Adds an instruction to the program.
+     * @return The destination register.
+     */
+    auto Emit(Opcode opcode, uint32_t destination, uint32_t operand1, uint32_t operand2 = 0, uint32_t operand3 = 0) -> uint32_t;
+
+    /**
+     * Collects the names of all assigned variables in a tree.
+     */
+    void CollectAssignedVariables(const ExpressionNode& node);
+
+    /**
+     * Returns a pointer to the first lane of a register.
+     */
+    auto Register(uint32_t index) -> Value*;
+
+    std::vector<Instruction> m_program;                   //!< The compiled instructions.
+    std::vector<Value> m_registers;                       //!< Lane storage of all registers.
+    uint32_t m_registerCount{0};                          //!< Number of allocated registers.
+    std::map<std::string, uint32_t> m_variables;          //!< Variable name to register index.
+    std::set<std::string> m_assignedVariables;            //!< Variables assigned somewhere in the code.
+    std::vector<std::string> m_readVariables;             //!< Variables read by the code.
+    std::vector<std::pair<uint32_t, double>> m_constants; //!< Constant registers and their values.
+};
+
+template<typename Value>
+constexpr size_t BasicBatchEvaluator<Value>::BatchSize;
+
+using BatchEvaluator = BasicBatchEvaluator<double>;
+using FloatBatchEvaluator = BasicBatchEvaluator<float>;
+
+/**
+ * Lane value type used to evaluate preset code. Single precision is selected at build time with ENABLE_FLOAT_EXPRESSIONS.
+ */
+#ifdef MILKDROP_FLOAT_EXPRESSIONS
+using PresetBatchValue = float;
+#else
+using PresetBatchValue = double;
+#endif
+
+using PresetBatchEvaluator = BasicBatchEvaluator<PresetBatchValue>;
+
+} // namespace MilkdropPreset
+} // namespace libprojectM
@@ -0,0 +1,235 @@
+#include "CodeAnalysis.hpp"
+
+#include "CodeTokenizer.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <map>
+#include <vector>
+
+namespace libprojectM {
+namespace MilkdropPreset {
+
+namespace {
+
+/**
+ * Occurrence of a variable in the code, used to find temporaries.
+ */
+struct VariableUse {
+    bool assignmentTarget{false}; //!< True if the variable is the target of a plain "=" assignment.
+    bool statementStart{false};   //!< True if the variable is the first token of a top-level statement.
+    int statement{0};             //!< Index of the top-level statement containing the variable.
+};
+
+// Functions accessing per-context or global memory, which is shared between executions.
+const std::array<const char*, 15> MemoryFunctions{
+    "megabuf", "gmegabuf", "gmem", "mem", "memcpy", "memset", "freembuf",
+    "mem_get_values", "mem_set_values", "mem_multiply_sum", "mem_insert_shuffle",
+    "stack_push", "stack_pop", "stack_peek", "stack_exch"};
+
+template<size_t Size>
+auto Contains(const std::array<const char*, Size>& list, const std::string& value) -> bool
+{
+    return std::any_of(list.begin(), list.end(), [&value](const char* entry) {
+        return value == entry;
+    });
+}
+
+auto IsGlobalRegister(const std::string& name) -> bool
+{
+    return name.size() == 5 && name.compare(0, 3, "reg") == 0 &&
+           std::isdigit(static_cast<unsigned char>(name[3])) != 0 &&
+           std::isdigit(static_cast<unsigned char>(name[4])) != 0;
+}
+
+} // namespace
+
+CodeAnalysis::CodeAnalysis(const std::string& code)
+{
+    std::vector<CodeToken> tokens;
+    if (!TokenizeCode(code, tokens))
+    {
+        m_valid = false;
+        return;
+    }
+
+    std::map<std::string, std::vector<VariableUse>> variableUses;
+
+    int depth{0};
+    int statement{0};
+    bool statementStart{true};
+
+    for (size_t index = 0; index < tokens.size(); index++)
+    {
+        const auto& token = tokens[index];
+        const CodeToken* nextToken = index + 1 < tokens.size() ? &tokens[index + 1] : nullptr;
+        bool const atStatementStart = statementStart;
+        statementStart = false;
+
+        switch (token.type)
+        {
+            case CodeTokenType::OpenParenthesis:
+                depth++;
+                break;
+
+            case CodeTokenType::OpenBracket:
+                // Bracket indexing accesses the context's memory buffer.
+                m_usesMemoryBuffers = true;
+                depth++;
+                break;
+
+            case CodeTokenType::CloseParenthesis:
+            case CodeTokenType::CloseBracket:
+                depth--;
+                if (depth < 0)
+                {
+                    m_valid = false;
+                    return;
+                }
+                break;
+
+            case CodeTokenType::Semicolon:
+                if (depth == 0)
+                {
+                    statement++;
+                    statementStart = true;
+                }
+                break;
+
+            case CodeTokenType::Identifier: {
+                if (Contains(MemoryFunctions, token.text))
+                {
+                    m_usesMemoryBuffers = true;
+                    break;
+                }
+
+                if (nextToken != nullptr && nextToken->type == CodeTokenType::OpenParenthesis)
+                {
+                    if (token.text == "rand")
+                    {
+                        m_usesRandom = true;
+                    }
+                    else if (token.text == "assign")
+                    {
+                        // Assigns its first argument, which isn't tracked here.
+                        m_valid = false;
+                        return;
+                    }
+                    break;
+                }
+
+                VariableUse use;
+                use.statement = statement;
+                use.statementStart = atStatementStart && depth == 0;
+
+                bool const isAssignment = nextToken != nullptr && nextToken->type == CodeTokenType::Operator &&
+                                          IsAssignmentOperator(nextToken->text);
+                if (isAssignment)
+                {
+                    m_writtenVariables.insert(token.text);
+                    use.assignmentTarget = nextToken->text == "=";
+                    if (IsGlobalRegister(token.text))
+                    {
+                        m_writesGlobalRegisters = true;
+                    }
+                }
+                if (!use.assignmentTarget)
+                {
+                    // Plain reads and compound assignments.
+                    m_readVariables.insert(token.text);
+                }
+
+                variableUses[token.text].push_back(use);
+                break;
+            }
+
+            default:
+                break;
+        }
+    }
+
+    if (depth != 0)
+    {
+        m_valid = false;
+        return;
+    }
+
+    // A variable is a temporary if its first use is a top-level statement assigning it, and the
+    // assigned expression doesn't use the variable itself.
+    for (const auto& entry : variableUses)
+    {
+        const auto& uses = entry.second;
+        const auto& firstUse = uses.front();
+        if (!firstUse.assignmentTarget || !firstUse.statementStart)
+        {
+            continue;
+        }
+
+        bool const usedInAssignment = std::any_of(uses.begin() + 1, uses.end(), [&firstUse](const VariableUse& use) {
+            return use.statement == firstUse.statement;
+        });
+        if (!usedInAssignment)
+        {
+            m_localVariables.insert(entry.first);
+        }
+    }
+}
+
+auto CodeAnalysis::ReadVariables() const -> const VariableSet&
+{
+    return m_readVariables;
+}
+
+auto CodeAnalysis::WrittenVariables() const -> const VariableSet&
+{
+    return m_writtenVariables;
+}
+
+auto CodeAnalysis::LocalVariables() const -> const VariableSet&
+{
+    return m_localVariables;
+}
+
+auto CodeAnalysis::References(const std::string& name) const -> bool
+{
+    return !m_valid ||
+           m_readVariables.find(name) != m_readVariables.end() ||
+           m_writtenVariables.find(name) != m_writtenVariables.end();
+}
+
+auto CodeAnalysis::UsesMemoryBuffers() const -> bool
+{
+    return m_usesMemoryBuffers;
+}
+
+auto CodeAnalysis::WritesGlobalRegisters() const -> bool
+{
+    return m_writesGlobalRegisters;
+}
+
+auto CodeAnalysis::UsesRandom() const -> bool
+{
+    return m_usesRandom;
+}
+
+auto CodeAnalysis::IsValid() const -> bool
+{
+    return m_valid;
+}
+
+auto CodeAnalysis::IsParallelSafe(const VariableSet& resetVariables) const -> bool
+{
+    if (!m_valid || m_usesMemoryBuffers || m_writesGlobalRegisters || m_usesRandom)
+    {
+        return false;
+    }
+
+    return std::all_of(m_writtenVariables.begin(), m_writtenVariables.end(), [this, &resetVariables](const std::string& name) {
+        return resetVariables.find(name) != resetVariables.end() ||
+               m_localVariables.find(name) != m_localVariables.end();
+    });
+}
+
+} // namespace MilkdropPreset
+} // namespace libprojectM
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <set>
+#include <string>
+
+namespace libprojectM {
+namespace MilkdropPreset {
+
+/**
+ * @brief Static analysis of preset expression code.
+ *
+ * Scans the EEL source code of a preset code block and collects which variables are read and written,
+ * and whether the code uses any state shared between executions or contexts. This is used to decide
+ * whether a code block can be executed on multiple cloned contexts in parallel without changing the
+ * result, e.g. the per-pixel code of the warp mesh.
+ *
+ * The analysis is conservative: anything it can't prove to be free of cross-execution side effects
+ * is reported as such. Variable names are returned in lower case, as EEL is case-insensitive.
+ */
+class CodeAnalysis
+{
+public:
+    using VariableSet = std::set<std::string>;
+
+    CodeAnalysis() = default;
+
+    /**
+     * @brief Analyzes the given code.
+     * @param code The EEL source code, as passed to the expression compiler.
+     */
+    explicit CodeAnalysis(const std::string& code);
+
+    /**
+     * @brief Returns all variables read by the code, including those read by compound assignments.
+     * @return A set with the lower-case names of all variables read by the code.
+     */
+    auto ReadVariables() const -> const VariableSet&;
+
+    /**
+     * @brief Returns all variables written by the code.
+     * @return A set with the lower-case names of all variables assigned by the code.
+     */
+    auto WrittenVariables() const -> const VariableSet&;
+
+    /**
+     * @brief Returns the variables which are always assigned before being read in a single execution.
+     *
+     * These variables are only used as temporaries. Their value at the start of an execution has no
+     * influence on the result.
+     *
+     * @return A set with the lower-case names of all temporary variables.
+     */
+    auto LocalVariables() const -> const VariableSet&;
+
+    /**
+     * @brief Returns whether the code reads or writes the given variable.
+     *
+     * Variables the code doesn't reference keep their value across executions, so the host doesn't
+     * need to set them before or read them after each execution.
+     *
+     * @param name The lower-case variable name.
+     * @return True if the variable is read or written, or if the code couldn't be analyzed.
+     */
+    auto References(const std::string& name) const -> bool;
+
+    /**
+     * @brief Returns whether the code accesses megabuf, gmegabuf or any other memory buffer function.
+     * @return True if the code uses any memory buffer, false if not.
+     */
+    auto UsesMemoryBuffers() const -> bool;
+
+    /**
+     * @brief Returns whether the code assigns any of the global reg00 to reg99 variables.
+     * @return True if the code writes global registers, false if not.
+     */
+    auto WritesGlobalRegisters() const -> bool;
+
+    /**
+     * @brief Returns whether the code calls a function with a non-deterministic result, e.g. rand().
+     * @return True if the code uses random numbers, false if not.
+     */
+    auto UsesRandom() const -> bool;
+
+    /**
+     * @brief Returns whether the code could be parsed by the analyzer.
+     * @return True if the code was analyzed successfully, false if it is malformed or uses unsupported constructs.
+     */
+    auto IsValid() const -> bool;
+
+    /**
+     * @brief Checks whether running the code on cloned contexts gives the same result as running it serially.
+     *
+     * This is the case if no memory buffers, global registers or random numbers are used, and each
+     * written variable is either reset by the host before each execution or a local temporary.
+     *
+     * @param resetVariables Lower-case names of the variables the host sets before each execution.
+     * @return True if the code can be executed in parallel on cloned contexts, false if not.
+     */
+    auto IsParallelSafe(const VariableSet& resetVariables) const -> bool;
+
+private:
+    VariableSet m_readVariables;    //!< All variables read by the code.
+    VariableSet m_writtenVariables; //!< All variables written by the code.
+    VariableSet m_localVariables;   //!< Variables always assigned before they are read.
+
+    bool m_usesMemoryBuffers{false};     //!< True if the code uses megabuf, gmegabuf or similar functions.
+    bool m_writesGlobalRegisters{false}; //!< True if the code assigns a regXX variable.
+    bool m_usesRandom{false};            //!< True if the code calls rand().
+    bool m_valid{true};                  //!< False if the code couldn't be tokenized, has unbalanced parentheses or calls assign().
+};
+
+} // namespace MilkdropPreset
+} // namespace libprojectM
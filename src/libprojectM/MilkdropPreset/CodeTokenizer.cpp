@@ -0,0 +1,184 @@
+#include "CodeTokenizer.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+
+namespace libprojectM {
+namespace MilkdropPreset {
+
+namespace {
+
+// Sorted longest-first, so the tokenizer always matches the longest operator.
+const std::array<const char*, 25> Operators{
+    "===", "!==",
+    "==", "!=", "<=", ">=", "&&", "||", "<<", ">>", "+=", "-=", "*=", "/=", "%=", "^=", "&=", "|=",
+    "=", "<", ">", "+", "-", "*", "/"};
+
+const std::array<const char*, 5> SingleCharacterOperators{"%", "^", "&", "|", "!"};
+
+const std::array<const char*, 9> AssignmentOperators{"=", "+=", "-=", "*=", "/=", "%=", "^=", "&=", "|="};
+
+template<size_t Size>
+auto Contains(const std::array<const char*, Size>& list, const std::string& value) -> bool
+{
+    return std::any_of(list.begin(), list.end(), [&value](const char* entry) {
+        return value == entry;
+    });
+}
+
+auto IsIdentifierStart(char character) -> bool
+{
+    return std::isalpha(static_cast<unsigned char>(character)) != 0 || character == '_';
+}
+
+auto IsIdentifierCharacter(char character) -> bool
+{
+    return std::isalnum(static_cast<unsigned char>(character)) != 0 || character == '_' || character == '.';
+}
+
+} // namespace
+
+auto TokenizeCode(const std::string& code, std::vector<CodeToken>& tokens) -> bool
+{
+    size_t pos = 0;
+    while (pos < code.size())
+    {
+        char const current = code[pos];
+        char const next = pos + 1 < code.size() ? code[pos + 1] : '\0';
+
+        if (std::isspace(static_cast<unsigned char>(current)) != 0)
+        {
+            pos++;
+            continue;
+        }
+
+        if (current == '/' && next == '/')
+        {
+            pos = code.find('\n', pos);
+            if (pos == std::string::npos)
+            {
+                break;
+            }
+            continue;
+        }
+
+        if (current == '/' && next == '*')
+        {
+            pos = code.find("*/", pos + 2);
+            if (pos == std::string::npos)
+            {
+                break;
+            }
+            pos += 2;
+            continue;
+        }
+
+        if (IsIdentifierStart(current))
+        {
+            size_t const start = pos;
+            while (pos < code.size() && IsIdentifierCharacter(code[pos]))
+            {
+                pos++;
+            }
+            std::string name = code.substr(start, pos - start);
+            std::transform(name.begin(), name.end(), name.begin(), [](char character) {
+                return static_cast<char>(std::tolower(static_cast<unsigned char>(character)));
+            });
+            tokens.push_back({CodeTokenType::Identifier, std::move(name)});
+            continue;
+        }
+
+        // Numbers, named constants like $PI and hex/char constants like $x1F or $'a'.
+        if (std::isdigit(static_cast<unsigned char>(current)) != 0 ||
+            (current == '.' && std::isdigit(static_cast<unsigned char>(next)) != 0) ||
+            current == '$')
+        {
+            size_t const start = pos;
+            pos++;
+            if (current == '$' && next == '\'')
+            {
+                pos = code.find('\'', pos + 1);
+                if (pos == std::string::npos)
+                {
+                    return false;
+                }
+            }
+            while (pos < code.size() && (IsIdentifierCharacter(code[pos]) || code[pos] == '\''))
+            {
+                pos++;
+            }
+            tokens.push_back({CodeTokenType::Constant, code.substr(start, pos - start)});
+            continue;
+        }
+
+        switch (current)
+        {
+            case '(':
+                tokens.push_back({CodeTokenType::OpenParenthesis, "("});
+                pos++;
+                continue;
+            case ')':
+                tokens.push_back({CodeTokenType::CloseParenthesis, ")"});
+                pos++;
+                continue;
+            case '[':
+                tokens.push_back({CodeTokenType::OpenBracket, "["});
+                pos++;
+                continue;
+            case ']':
+                tokens.push_back({CodeTokenType::CloseBracket, "]"});
+                pos++;
+                continue;
+            case ';':
+                tokens.push_back({CodeTokenType::Semicolon, ";"});
+                pos++;
+                continue;
+            case ',':
+                tokens.push_back({CodeTokenType::Comma, ","});
+                pos++;
+                continue;
+            case '?':
+            case ':':
+            case '~':
+                tokens.push_back({CodeTokenType::Operator, std::string(1, current)});
+                pos++;
+                continue;
+            default:
+                break;
+        }
+
+        bool matched{false};
+        for (const auto* op : Operators)
+        {
+            std::string const opString(op);
+            if (code.compare(pos, opString.size(), opString) == 0)
+            {
+                tokens.push_back({CodeTokenType::Operator, opString});
+                pos += opString.size();
+                matched = true;
+                break;
+            }
+        }
+        if (!matched)
+        {
+            std::string const opString(1, current);
+            if (!Contains(SingleCharacterOperators, opString))
+            {
+                return false;
+            }
+            tokens.push_back({CodeTokenType::Operator, opString});
+            pos++;
+        }
+    }
+
+    return true;
+}
+
+auto IsAssignmentOperator(const std::string& op) -> bool
+{
+    return Contains(AssignmentOperators, op);
+}
+
+} // namespace MilkdropPreset
+} // namespace libprojectM
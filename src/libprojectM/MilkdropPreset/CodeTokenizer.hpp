@@ -0,0 +1,52 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace libprojectM {
+namespace MilkdropPreset {
+
+/**
+ * @brief Token types of the expression code syntax.
+ */
+enum class CodeTokenType
+{
+    Identifier,       //!< Variable or function name, converted to lower case.
+    Constant,         //!< Numeric literal or named constant like $PI.
+    Operator,         //!< Arithmetic, comparison, logical or assignment operator.
+    OpenParenthesis,  //!< "("
+    CloseParenthesis, //!< ")"
+    OpenBracket,      //!< "["
+    CloseBracket,     //!< "]"
+    Semicolon,        //!< ";"
+    Comma             //!< ","
+};
+
+/**
+ * @brief A single token of preset expression code.
+ */
+struct CodeToken {
+    CodeTokenType type{CodeTokenType::Constant}; //!< The token type.
+    std::string text;                            //!< The token text. Identifiers are lower case.
+};
+
+/**
+ * @brief Splits preset expression code into tokens.
+ *
+ * Comments are removed and identifiers converted to lower case, as EEL is case-insensitive.
+ *
+ * @param code The EEL source code.
+ * @param tokens Receives the tokens.
+ * @return False if the code contains characters which are not part of the supported syntax.
+ */
+auto TokenizeCode(const std::string& code, std::vector<CodeToken>& tokens) -> bool;
+
+/**
+ * @brief Checks whether an operator token assigns its left-hand side, e.g. "=" or "+=".
+ * @param op The operator token text.
+ * @return True if the operator is an assignment, false if not.
+ */
+auto IsAssignmentOperator(const std::string& op) -> bool;
+
+} // namespace MilkdropPreset
+} // namespace libprojectM
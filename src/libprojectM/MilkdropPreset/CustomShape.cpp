@@ -1,51 +1,44 @@
 #include "CustomShape.hpp"
 
 #include "PresetFileParser.hpp"
+#include "WorkerPool.hpp"
 
 #include <Renderer/TextureManager.hpp>
 #include <Renderer/RenderItem.hpp>
 
-#include <vector>
+#include <algorithm>
+#include <array>
+#include <cmath>
 
 namespace libprojectM {
 namespace MilkdropPreset {
 
+static constexpr float pi = 3.141592653589793f;
+static constexpr int MinInstancesPerTask = 32; //!< Minimum number of shape instances per parallel task, to keep the threading overhead low.
+
 CustomShape::CustomShape(PresetState& presetState)
     : m_presetState(presetState)
     , m_perFrameContext(presetState.globalMemory, &presetState.globalRegisters)
 {
-    std::vector<TexturedPoint> vertexData;
-    vertexData.resize(102);
-
-    glGenVertexArrays(1, &m_vaoIdTextured);
-    glGenBuffers(1, &m_vboIdTextured);
-
-    glGenVertexArrays(1, &m_vaoIdUntextured);
-    glGenBuffers(1, &m_vboIdUntextured);
-
-    glBindVertexArray(m_vaoIdTextured);
-    glBindBuffer(GL_ARRAY_BUFFER, m_vboIdTextured);
-
-    glEnableVertexAttribArray(0);
-    glEnableVertexAttribArray(1);
-    glEnableVertexAttribArray(2);
-
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(TexturedPoint), reinterpret_cast<void*>(offsetof(TexturedPoint, x))); // Position
-    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(TexturedPoint), reinterpret_cast<void*>(offsetof(TexturedPoint, r))); // Color
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(TexturedPoint), reinterpret_cast<void*>(offsetof(TexturedPoint, u))); // Texture coordinate
-
-    glBufferData(GL_ARRAY_BUFFER, sizeof(TexturedPoint) * vertexData.size(), vertexData.data(), GL_STREAM_DRAW);
-
-    glBindVertexArray(m_vaoIdUntextured);
-    glBindBuffer(GL_ARRAY_BUFFER, m_vboIdUntextured);
-
-    glEnableVertexAttribArray(0);
-    glEnableVertexAttribArray(1);
-
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(TexturedPoint), reinterpret_cast<void*>(offsetof(TexturedPoint, x))); // Position
-    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(TexturedPoint), reinterpret_cast<void*>(offsetof(TexturedPoint, r))); // Color
+    // Unit circle corners for all possible side counts, each as a triangle fan with the center
+    // vertex first and the first rim vertex repeated at the end.
+    std::vector<ShapeCorner> corners;
+    corners.reserve(FirstCorner(MaxSides + 1));
+    for (int sides = MinSides; sides <= MaxSides; sides++)
+    {
+        corners.push_back({0.0f, 0.0f, 0.0f});
+        for (int corner = 0; corner < sides; corner++)
+        {
+            const float cornerProgress = static_cast<float>(corner) / static_cast<float>(sides);
+            const float angle = cornerProgress * pi * 2.0f + pi * 0.25f;
+            corners.push_back({cosf(angle), sinf(angle), 1.0f});
+        }
+        corners.push_back(corners.at(FirstCorner(sides) + 1));
+    }
 
-    glBufferData(GL_ARRAY_BUFFER, sizeof(TexturedPoint) * vertexData.size(), vertexData.data(), GL_STREAM_DRAW);
+    glGenBuffers(1, &m_vboIdCorners);
+    glBindBuffer(GL_ARRAY_BUFFER, m_vboIdCorners);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(ShapeCorner) * corners.size(), corners.data(), GL_STATIC_DRAW);
 
     RenderItem::Init();
 
@@ -54,22 +47,22 @@ CustomShape::CustomShape(PresetState& presetState)
 
 CustomShape::~CustomShape()
 {
-    glDeleteBuffers(1, &m_vboIdTextured);
-    glDeleteVertexArrays(1, &m_vaoIdTextured);
-
-    glDeleteBuffers(1, &m_vboIdUntextured);
-    glDeleteVertexArrays(1, &m_vaoIdUntextured);
+    glDeleteBuffers(1, &m_vboIdCorners);
 }
 
 void CustomShape::InitVertexAttrib()
 {
+    glBindBuffer(GL_ARRAY_BUFFER, m_vboIdCorners);
     glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, nullptr); // points
-    glDisableVertexAttribArray(1);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(ShapeCorner), reinterpret_cast<void*>(offsetof(ShapeCorner, x))); // Unit circle corner
 
-    std::vector<Point> vertexData;
-    vertexData.resize(100);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(Point) * vertexData.size(), vertexData.data(), GL_STREAM_DRAW);
+    for (GLuint attribute = 1; attribute <= 5; attribute++)
+    {
+        glEnableVertexAttribArray(attribute);
+        glVertexAttribDivisor(attribute, 1);
+    }
+
+    SetInstanceAttributePointers(0);
 }
 
 void CustomShape::Initialize(PresetFileParser& parsedFile, int index)
@@ -121,222 +114,260 @@ void CustomShape::CompileCodeAndRunInitExpressions()
 
 void CustomShape::Draw()
 {
-    static constexpr float pi = 3.141592653589793f;
+    if (!m_enabled || m_presetState.expressionWatchdog.CheckExpired())
+    {
+        return;
+    }
 
-    if (!m_enabled)
+    // Instances not evaluated in time would show the previous frame's data, so the whole shape is skipped.
+    EvaluateInstances();
+    if (m_instanceData.empty() || m_presetState.expressionWatchdog.Expired())
     {
         return;
     }
 
+    glBindVertexArray(m_vaoID);
+    glBindBuffer(GL_ARRAY_BUFFER, m_vboID);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(ShapeInstance) * m_instanceData.size(), m_instanceData.data(), GL_STREAM_DRAW);
+
     glEnable(GL_BLEND);
 
-    for (int instance = 0; instance < m_instances; instance++)
+    // Each instance's border is drawn right after its fill, so a run of instances ends at the first one with a border.
+    size_t firstInstance = 0;
+    for (size_t instance = 0; instance < m_instanceData.size(); instance++)
     {
-        m_perFrameContext.LoadStateVariables(m_presetState, *this, instance);
-        m_perFrameContext.ExecutePerFrameCode();
-
-        int sides = static_cast<int>(*m_perFrameContext.sides);
-        if (sides < 3)
+        const auto& current = m_instanceData[instance];
+        if (current.border ||
+            instance + 1 == m_instanceData.size() ||
+            m_instanceData[instance + 1].sides != current.sides ||
+            m_instanceData[instance + 1].additive != current.additive ||
+            m_instanceData[instance + 1].textured != current.textured)
         {
-            sides = 3;
-        }
-        if (sides > 100)
-        {
-            sides = 100;
+            DrawInstances(firstInstance, instance + 1 - firstInstance);
+            firstInstance = instance + 1;
         }
+    }
 
-        // Additive Drawing or Overwrite
-        glBlendFunc(GL_SRC_ALPHA, static_cast<int>(*m_perFrameContext.additive) != 0 ? GL_ONE : GL_ONE_MINUS_SRC_ALPHA);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
 
-        std::vector<TexturedPoint> vertexData(sides + 2);
+#ifndef USE_GLES
+    glDisable(GL_LINE_SMOOTH);
+#endif
+    glDisable(GL_BLEND);
 
-        vertexData[0].x = static_cast<float>(*m_perFrameContext.x * 2.0 - 1.0);
-        vertexData[0].y = static_cast<float>(*m_perFrameContext.y * -2.0 + 1.0);
+    Renderer::Shader::Unbind();
+}
 
-        vertexData[0].u = 0.5f;
-        vertexData[0].v = 0.5f;
+auto CustomShape::FirstCorner(int sides) -> int
+{
+    // Each side count uses sides + 2 vertices.
+    return (sides - 1) * sides / 2 - (MinSides - 1) * MinSides / 2 + 2 * (sides - MinSides);
+}
 
-        // x = f*255.0 & 0xFF = (f*255.0) % 256
-        // f' = x/255.0 = f % (256/255)
-        // 1.0 -> 255 (0xFF)
-        // 2.0 -> 254 (0xFE)
-        // -1.0 -> 0x01
+void CustomShape::EvaluateInstances()
+{
+    int const instanceCount = std::max(0, m_instances);
+    m_instanceData.resize(instanceCount);
 
-        vertexData[0].r = Renderer::color_modulo(*m_perFrameContext.r);
-        vertexData[0].g = Renderer::color_modulo(*m_perFrameContext.g);
-        vertexData[0].b = Renderer::color_modulo(*m_perFrameContext.b);
-        vertexData[0].a = Renderer::color_modulo(*m_perFrameContext.a);
+    // Per-frame code carrying state from one instance to the next, e.g. through gmegabuf or
+    // user variables, must run serially in instance order to give the same result.
+    auto& workerPool = WorkerPool::Instance();
+    if (!m_perFrameContext.CanExecuteInParallel() || workerPool.Concurrency() < 2 || instanceCount < 2 * MinInstancesPerTask)
+    {
+        EvaluateInstanceRange(m_perFrameContext, 0, instanceCount);
+        return;
+    }
 
-        vertexData[1].r = Renderer::color_modulo(*m_perFrameContext.r2);
-        vertexData[1].g = Renderer::color_modulo(*m_perFrameContext.g2);
-        vertexData[1].b = Renderer::color_modulo(*m_perFrameContext.b2);
-        vertexData[1].a = Renderer::color_modulo(*m_perFrameContext.a2);
+    size_t const taskCount = static_cast<size_t>((instanceCount + MinInstancesPerTask - 1) / MinInstancesPerTask);
 
-        for (int i = 1; i < sides + 1; i++)
-        {
-            const float cornerProgress = static_cast<float>(i - 1) / static_cast<float>(sides);
-            const float angle = cornerProgress * pi * 2.0f + static_cast<float>(*m_perFrameContext.ang) + pi * 0.25f;
+    // Prepare the worker contexts on this thread, as they copy the current variables from the main context.
+    size_t const slotCount = std::min(taskCount, workerPool.Concurrency());
+    std::vector<ShapePerFrameContext*> slotContexts(slotCount);
+    for (size_t slot = 0; slot < slotCount; slot++)
+    {
+        slotContexts[slot] = &m_perFrameContext.WorkerContext(slot);
+    }
 
-            // Todo: There's still some issue with aspect ratio here, as everything gets squashed horizontally if Y > x.
-            vertexData[i].x = vertexData[0].x + static_cast<float>(*m_perFrameContext.rad) * cosf(angle) * m_presetState.renderContext.aspectY;
-            vertexData[i].y = vertexData[0].y + static_cast<float>(*m_perFrameContext.rad) * sinf(angle);
+    workerPool.ParallelFor(taskCount, [&](size_t task, size_t slot) {
+        int const firstInstance = static_cast<int>(task) * MinInstancesPerTask;
+        int const lastInstance = std::min(firstInstance + MinInstancesPerTask, instanceCount);
+        EvaluateInstanceRange(*slotContexts[slot], firstInstance, lastInstance);
+    });
+}
 
-            vertexData[i].r = vertexData[1].r;
-            vertexData[i].g = vertexData[1].g;
-            vertexData[i].b = vertexData[1].b;
-            vertexData[i].a = vertexData[1].a;
+void CustomShape::EvaluateInstanceRange(ShapePerFrameContext& context, int firstInstance, int lastInstance)
+{
+    for (int instance = firstInstance; instance < lastInstance; instance++)
+    {
+        if (m_presetState.expressionWatchdog.CheckExpired())
+        {
+            return;
         }
 
-        // Duplicate last vertex.
-        vertexData[sides + 1] = vertexData[1];
-
-        if (static_cast<int>(*m_perFrameContext.textured) != 0)
+        if (instance == firstInstance)
+        {
+            context.LoadStateVariables(m_presetState, *this, instance);
+        }
+        else
         {
-            m_presetState.texturedShader.Bind();
-            m_presetState.texturedShader.SetUniformMat4x4("vertex_transformation", PresetState::orthogonalProjection);
-            m_presetState.texturedShader.SetUniformInt("texture_sampler", 0);
+            context.LoadInstanceVariables(instance);
+        }
+        context.ExecutePerFrameCode(m_presetState.expressionWatchdog);
 
-            // Textured shape, either main texture or texture from "image" key
-            auto textureAspectY = m_presetState.renderContext.aspectY;
-            if (m_image.empty())
-            {
-                assert(!m_presetState.mainTexture.expired());
-                m_presetState.mainTexture.lock()->Bind(0);
-            }
-            else
-            {
-                auto desc = m_presetState.renderContext.textureManager->GetTexture(m_image);
-                if (!desc.Empty())
-                {
-                    desc.Bind(0, m_presetState.texturedShader);
-                    textureAspectY = 1.0f;
-                }
-                else
-                {
-                    // No texture found, fall back to main texture.
-                    assert(!m_presetState.mainTexture.expired());
-                    m_presetState.mainTexture.lock()->Bind(0);
-                }
-            }
+        auto& data = m_instanceData[instance];
 
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        data.sides = std::max(MinSides, std::min(MaxSides, static_cast<int>(*context.sides)));
+        data.additive = static_cast<int>(*context.additive) != 0;
+        data.textured = static_cast<int>(*context.textured) != 0;
+        data.border = *context.border_a > 0.0001f;
 
-            for (int i = 1; i < sides + 1; i++)
-            {
-                const float cornerProgress = static_cast<float>(i - 1) / static_cast<float>(sides);
-                const float angle = cornerProgress * pi * 2.0f + static_cast<float>(*m_perFrameContext.tex_ang) + pi * 0.25f;
+        data.x = static_cast<float>(*context.x * 2.0 - 1.0);
+        data.y = static_cast<float>(*context.y * -2.0 + 1.0);
+        data.radius = static_cast<float>(*context.rad);
+        data.angle = static_cast<float>(*context.ang);
+        data.textureAngle = static_cast<float>(*context.tex_ang);
+        data.textureZoom = static_cast<float>(*context.tex_zoom);
 
-                vertexData[i].u = 0.5f + 0.5f * cosf(angle) / static_cast<float>(*m_perFrameContext.tex_zoom) * textureAspectY;
-                vertexData[i].v = 1.0f - (0.5f - 0.5f * sinf(angle) / static_cast<float>(*m_perFrameContext.tex_zoom)); // Vertical flip required!
-            }
+        // x = f*255.0 & 0xFF = (f*255.0) % 256
+        // f' = x/255.0 = f % (256/255)
+        // 1.0 -> 255 (0xFF)
+        // 2.0 -> 254 (0xFE)
+        // -1.0 -> 0x01
 
-            vertexData[sides + 1] = vertexData[1];
+        data.r = Renderer::color_modulo(*context.r);
+        data.g = Renderer::color_modulo(*context.g);
+        data.b = Renderer::color_modulo(*context.b);
+        data.a = Renderer::color_modulo(*context.a);
 
-            glBindBuffer(GL_ARRAY_BUFFER, m_vboIdTextured);
+        data.r2 = Renderer::color_modulo(*context.r2);
+        data.g2 = Renderer::color_modulo(*context.g2);
+        data.b2 = Renderer::color_modulo(*context.b2);
+        data.a2 = Renderer::color_modulo(*context.a2);
 
-            glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(TexturedPoint) * (sides + 2), vertexData.data());
+        data.borderR = static_cast<float>(*context.border_r);
+        data.borderG = static_cast<float>(*context.border_g);
+        data.borderB = static_cast<float>(*context.border_b);
+        data.borderA = static_cast<float>(*context.border_a);
+    }
+}
 
-            glBindVertexArray(m_vaoIdTextured);
-            glDrawArrays(GL_TRIANGLE_FAN, 0, sides + 2);
-            glBindVertexArray(0);
+void CustomShape::SetInstanceAttributePointers(size_t firstInstance)
+{
+    glBindBuffer(GL_ARRAY_BUFFER, m_vboID);
+
+    size_t const offset = firstInstance * sizeof(ShapeInstance);
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(ShapeInstance), reinterpret_cast<void*>(offset + offsetof(ShapeInstance, x)));            // Position, radius & angle
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(ShapeInstance), reinterpret_cast<void*>(offset + offsetof(ShapeInstance, textureAngle))); // Texture angle & zoom
+    glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(ShapeInstance), reinterpret_cast<void*>(offset + offsetof(ShapeInstance, r)));            // Center color
+    glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(ShapeInstance), reinterpret_cast<void*>(offset + offsetof(ShapeInstance, r2)));           // Rim color
+    glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, sizeof(ShapeInstance), reinterpret_cast<void*>(offset + offsetof(ShapeInstance, borderR)));      // Border color
+}
 
-            glBindTexture(GL_TEXTURE_2D, 0);
-            Renderer::Sampler::Unbind(0);
-        }
-        else
-        {
-            // Untextured (creates a color gradient: center=r/g/b/a to border=r2/b2/g2/a2)
-            glBindBuffer(GL_ARRAY_BUFFER, m_vboIdUntextured);
+void CustomShape::DrawInstances(size_t firstInstance, size_t instanceCount)
+{
+    const auto& instance = m_instanceData[firstInstance];
+    int const firstCorner = FirstCorner(instance.sides);
 
-            glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(TexturedPoint) * (sides + 2), vertexData.data());
+    SetInstanceAttributePointers(firstInstance);
 
-            m_presetState.untexturedShader.Bind();
-            m_presetState.untexturedShader.SetUniformMat4x4("vertex_transformation", PresetState::orthogonalProjection);
+    // Additive Drawing or Overwrite
+    glBlendFunc(GL_SRC_ALPHA, instance.additive ? GL_ONE : GL_ONE_MINUS_SRC_ALPHA);
 
-            glBindVertexArray(m_vaoIdUntextured);
-            glDrawArrays(GL_TRIANGLE_FAN, 0, sides + 2);
-            glBindVertexArray(0);
+    if (instance.textured)
+    {
+        auto& shader = m_presetState.texturedShapeShader;
+        shader.Bind();
+        shader.SetUniformMat4x4("vertex_transformation", PresetState::orthogonalProjection);
+        shader.SetUniformInt("texture_sampler", 0);
+
+        // Textured shape, either main texture or texture from "image" key
+        auto textureAspectY = m_presetState.renderContext.aspectY;
+        if (m_image.empty())
+        {
+            assert(!m_presetState.mainTexture.expired());
+            m_presetState.mainTexture.lock()->Bind(0);
         }
-
-        if (*m_perFrameContext.border_a > 0.0001f)
+        else
         {
-            std::vector<ShapeVertex> points(sides);
-
-            for (int i = 0; i < sides; i++)
+            auto desc = m_presetState.renderContext.textureManager->GetTexture(m_image);
+            if (!desc.Empty())
             {
-                points[i].x = vertexData[i + 1].x;
-                points[i].y = vertexData[i + 1].y;
+                desc.Bind(0, shader);
+                textureAspectY = 1.0f;
             }
+            else
+            {
+                // No texture found, fall back to main texture.
+                assert(!m_presetState.mainTexture.expired());
+                m_presetState.mainTexture.lock()->Bind(0);
+            }
+        }
 
-            m_presetState.untexturedShader.Bind();
-            m_presetState.untexturedShader.SetUniformMat4x4("vertex_transformation", PresetState::orthogonalProjection);
-
-            glVertexAttrib4f(1,
-                             static_cast<float>(*m_perFrameContext.border_r),
-                             static_cast<float>(*m_perFrameContext.border_g),
-                             static_cast<float>(*m_perFrameContext.border_b),
-                             static_cast<float>(*m_perFrameContext.border_a));
-            glLineWidth(1);
-#ifndef USE_GLES
-            glEnable(GL_LINE_SMOOTH);
-#endif
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 
-            glBindVertexArray(m_vaoID);
-            glBindBuffer(GL_ARRAY_BUFFER, m_vboID);
+        shader.SetUniformFloat("aspect_y", m_presetState.renderContext.aspectY);
+        shader.SetUniformFloat("texture_aspect_y", textureAspectY);
+        shader.SetUniformFloat2("position_offset", {0.0f, 0.0f});
+        shader.SetUniformInt("draw_border", 0);
 
-            const auto iterations = m_thickOutline ? 4 : 1;
+        glDrawArraysInstanced(GL_TRIANGLE_FAN, firstCorner, instance.sides + 2, static_cast<GLsizei>(instanceCount));
 
-            // Need to use +/- 1.0 here instead of 2.0 used in Milkdrop to achieve the same rendering result.
-            const auto incrementX = 1.0f / static_cast<float>(m_presetState.renderContext.viewportSizeX);
-            const auto incrementY = 1.0f / static_cast<float>(m_presetState.renderContext.viewportSizeY);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        Renderer::Sampler::Unbind(0);
+    }
+    else
+    {
+        // Untextured (creates a color gradient: center=r/g/b/a to border=r2/b2/g2/a2)
+        auto& shader = m_presetState.untexturedShapeShader;
+        shader.Bind();
+        shader.SetUniformMat4x4("vertex_transformation", PresetState::orthogonalProjection);
+        shader.SetUniformFloat("aspect_y", m_presetState.renderContext.aspectY);
+        shader.SetUniformFloat2("position_offset", {0.0f, 0.0f});
+        shader.SetUniformInt("draw_border", 0);
+
+        glDrawArraysInstanced(GL_TRIANGLE_FAN, firstCorner, instance.sides + 2, static_cast<GLsizei>(instanceCount));
+    }
 
-            // If thick outline is used, draw the shape four times with slight offsets
-            // (top left, top right, bottom right, bottom left).
-            for (auto iteration = 0; iteration < iterations; iteration++)
-            {
-                switch (iteration)
-                {
-                    case 0:
-                        break;
-
-                    case 1:
-                        for (auto j = 0; j < sides; j++)
-                        {
-                            points[j].x += incrementX;
-                        }
-                        break;
-
-                    case 2:
-                        for (auto j = 0; j < sides; j++)
-                        {
-                            points[j].y += incrementY;
-                        }
-                        break;
-
-                    case 3:
-                        for (auto j = 0; j < sides; j++)
-                        {
-                            points[j].x -= incrementX;
-                        }
-                        break;
-                }
-
-                glBufferSubData(GL_ARRAY_BUFFER, 0, static_cast<GLsizei>(sizeof(Point) * sides), points.data());
-                glDrawArrays(GL_LINE_LOOP, 0, sides);
-            }
-        }
+    // Only the last instance of a run can have a border.
+    size_t const lastInstance = firstInstance + instanceCount - 1;
+    if (!m_instanceData[lastInstance].border)
+    {
+        return;
     }
 
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    SetInstanceAttributePointers(lastInstance);
+
+    auto& shader = m_presetState.untexturedShapeShader;
+    shader.Bind();
+    shader.SetUniformMat4x4("vertex_transformation", PresetState::orthogonalProjection);
+    shader.SetUniformFloat("aspect_y", m_presetState.renderContext.aspectY);
+    shader.SetUniformInt("draw_border", 1);
 
+    glLineWidth(1);
 #ifndef USE_GLES
-    glDisable(GL_LINE_SMOOTH);
+    glEnable(GL_LINE_SMOOTH);
 #endif
-    glDisable(GL_BLEND);
 
-    Renderer::Shader::Unbind();
+    const auto iterations = m_thickOutline ? 4 : 1;
+
+    // Need to use +/- 1.0 here instead of 2.0 used in Milkdrop to achieve the same rendering result.
+    const auto incrementX = 1.0f / static_cast<float>(m_presetState.renderContext.viewportSizeX);
+    const auto incrementY = 1.0f / static_cast<float>(m_presetState.renderContext.viewportSizeY);
+
+    // If thick outline is used, draw the shape four times with slight offsets
+    // (top left, top right, bottom right, bottom left).
+    const std::array<glm::vec2, 4> offsets{{{0.0f, 0.0f},
+                                            {incrementX, 0.0f},
+                                            {incrementX, incrementY},
+                                            {0.0f, incrementY}}};
+
+    for (auto iteration = 0; iteration < iterations; iteration++)
+    {
+        shader.SetUniformFloat2("position_offset", offsets[iteration]);
+        glDrawArraysInstanced(GL_LINE_LOOP, firstCorner + 1, instance.sides, 1);
+    }
 }
 
 } // namespace MilkdropPreset
@@ -8,6 +8,8 @@
 
 #include <projectm-eval.h>
 
+#include <vector>
+
 namespace libprojectM {
 namespace MilkdropPreset {
 
@@ -16,8 +18,11 @@ class PresetFileParser;
 /**
  * @brief Renders a custom shape with or without a texture.
  *
- * The class creates two sets of VBO/VAO as it's only known later (in the Draw() call) whether the shape is textured
- * or not.
+ * The per-frame code of all instances is evaluated first, in parallel if the code allows it. The
+ * instances are then drawn with instanced draw calls, using a static table of unit circle corners
+ * for each possible number of sides and one set of per-instance attributes uploaded once per frame.
+ * Consecutive instances with the same number of sides, blend mode and texturing are drawn with a
+ * single call, which keeps the original drawing order.
  */
 class CustomShape : public Renderer::RenderItem
 {
@@ -47,11 +52,83 @@ public:
     void Draw();
 
 private:
-    struct ShapeVertex {
-        float x{.0f}; //!< The vertex X coordinate.
-        float y{.0f}; //!< The vertex Y coordinate.
+    static constexpr int MinSides = 3;   //!< Minimum number of sides a shape can have.
+    static constexpr int MaxSides = 100; //!< Maximum number of sides a shape can have.
+
+    /**
+     * @brief Vertex of the unit circle table.
+     */
+    struct ShapeCorner {
+        float x{.0f};   //!< Unit circle X coordinate.
+        float y{.0f};   //!< Unit circle Y coordinate.
+        float rim{.0f}; //!< 0.0 for the center vertex, 1.0 for rim vertices.
+    };
+
+    /**
+     * @brief Per-instance vertex attributes and draw state, calculated by the per-frame code.
+     */
+    struct ShapeInstance {
+        float x{.0f};            //!< Center X coordinate in clip space.
+        float y{.0f};            //!< Center Y coordinate in clip space.
+        float radius{.0f};       //!< Shape radius.
+        float angle{.0f};        //!< Shape rotation.
+        float textureAngle{.0f}; //!< Texture rotation.
+        float textureZoom{.0f};  //!< Texture zoom.
+        float r{.0f};            //!< Center red color value.
+        float g{.0f};            //!< Center green color value.
+        float b{.0f};            //!< Center blue color value.
+        float a{.0f};            //!< Center alpha value.
+        float r2{.0f};           //!< Rim red color value.
+        float g2{.0f};           //!< Rim green color value.
+        float b2{.0f};           //!< Rim blue color value.
+        float a2{.0f};           //!< Rim alpha value.
+        float borderR{.0f};      //!< Border red color value.
+        float borderG{.0f};      //!< Border green color value.
+        float borderB{.0f};      //!< Border blue color value.
+        float borderA{.0f};      //!< Border alpha value.
+        int sides{MinSides};     //!< Number of sides, clamped to MinSides and MaxSides.
+        bool additive{false};    //!< If true, the instance is drawn with additive blending.
+        bool textured{false};    //!< If true, the instance is drawn textured.
+        bool border{false};      //!< If true, the instance has a visible border.
     };
 
+    /**
+     * @brief Returns the index of the first unit circle table vertex for the given number of sides.
+     * @param sides The number of sides.
+     * @return The first vertex index in the corner buffer.
+     */
+    static auto FirstCorner(int sides) -> int;
+
+    /**
+     * @brief Runs the per-frame code for all instances and stores the results in m_instanceData.
+     */
+    void EvaluateInstances();
+
+    /**
+     * @brief Runs the per-frame code for a range of instances.
+     * @param context The per-frame context to run the code on.
+     * @param firstInstance The first instance to evaluate.
+     * @param lastInstance The instance after the last instance to evaluate.
+     */
+    void EvaluateInstanceRange(ShapePerFrameContext& context, int firstInstance, int lastInstance);
+
+    /**
+     * @brief Points the per-instance vertex attributes to the given instance.
+     *
+     * OpenGL ES 3 has no base instance parameter for instanced draw calls, so the attribute offsets
+     * are changed instead.
+     *
+     * @param firstInstance The instance used for the first drawn instance.
+     */
+    void SetInstanceAttributePointers(size_t firstInstance);
+
+    /**
+     * @brief Draws a range of instances with the same number of sides, blend mode and texturing.
+     * @param firstInstance The first instance to draw.
+     * @param instanceCount The number of instances to draw.
+     */
+    void DrawInstances(size_t firstInstance, size_t instanceCount);
+
     std::string m_image; //!< Texture filename to be rendered on this shape
 
     int m_index{0};        //!< The custom shape index in the preset.
@@ -93,11 +170,9 @@ private:
     PresetState& m_presetState; //!< The global preset state.
     ShapePerFrameContext m_perFrameContext;
 
-    GLuint m_vboIdTextured{0}; //!< Vertex buffer object ID for a textured shape.
-    GLuint m_vaoIdTextured{0}; //!< Vertex array object ID for a textured shape.
+    std::vector<ShapeInstance> m_instanceData; //!< Per-instance results of the per-frame code, reused each frame.
 
-    GLuint m_vboIdUntextured{0}; //!< Vertex buffer object ID for an untextured shape.
-    GLuint m_vaoIdUntextured{0}; //!< Vertex array object ID for an untextured shape.
+    GLuint m_vboIdCorners{0}; //!< Vertex buffer object ID for the static unit circle table. The RenderItem VBO holds the instance data.
 
     friend class ShapePerFrameContext;
 };
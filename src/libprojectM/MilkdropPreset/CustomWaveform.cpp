@@ -1,5 +1,6 @@
 #include "CustomWaveform.hpp"
 
+#include "CodeAnalysis.hpp"
 #include "PerFrameContext.hpp"
 #include "PresetFileParser.hpp"
 
@@ -11,11 +12,32 @@ namespace MilkdropPreset {
 
 static constexpr int CustomWaveformMaxSamples = std::max(libprojectM::Audio::WaveformSamples, libprojectM::Audio::SpectrumSamples);
 
+namespace {
+
+/**
+ * Returns whether the code only uses state of its own expression contexts, so waves using it
+ * can be evaluated in any order or at the same time.
+ */
+auto IsSelfContained(const std::string& code) -> bool
+{
+    if (code.empty())
+    {
+        return true;
+    }
+
+    CodeAnalysis const analysis(code);
+    return analysis.IsValid() && !analysis.UsesMemoryBuffers() && !analysis.WritesGlobalRegisters() && !analysis.UsesRandom();
+}
+
+} // namespace
+
 CustomWaveform::CustomWaveform(PresetState& presetState)
     : RenderItem()
     , m_presetState(presetState)
     , m_perFrameContext(presetState.globalMemory, &presetState.globalRegisters)
     , m_perPointContext(presetState.globalMemory, &presetState.globalRegisters)
+    , m_pointsTransformed(CustomWaveformMaxSamples)
+    , m_pointsSmoothed(CustomWaveformMaxSamples * 2)
 {
     RenderItem::Init();
 
@@ -70,14 +92,25 @@ void CustomWaveform::CompileCodeAndRunInitExpressions(const PerFrameContext& pre
 
     m_perFrameContext.CompilePerFrameCode(m_presetState.customWavePerFrameCode[m_index], *this);
     m_perPointContext.CompilePerPointCode(m_presetState.customWavePerPointCode[m_index], *this);
+
+    m_isSelfContained = IsSelfContained(m_presetState.customWavePerFrameCode[m_index]) &&
+                        IsSelfContained(m_presetState.customWavePerPointCode[m_index]);
 }
 
-void CustomWaveform::Draw(const PerFrameContext& presetPerFrameContext)
+auto CustomWaveform::CanEvaluateConcurrently() const -> bool
+{
+    // Disabled waves don't run any code.
+    return m_enabled == 0 || m_isSelfContained;
+}
+
+void CustomWaveform::Evaluate(const PerFrameContext& presetPerFrameContext)
 {
     static_assert(libprojectM::Audio::WaveformSamples <= WaveformMaxPoints, "WaveformMaxPoints is larger than WaveformSamples");
     static_assert(libprojectM::Audio::SpectrumSamples <= WaveformMaxPoints, "WaveformMaxPoints is larger than SpectrumSamples");
 
-    if (!m_enabled)
+    m_smoothedVertexCount = 0;
+
+    if (!m_enabled || m_presetState.expressionWatchdog.CheckExpired())
     {
         return;
     }
@@ -86,7 +119,7 @@ void CustomWaveform::Draw(const PerFrameContext& presetPerFrameContext)
 
     // Initialize and execute per-frame code
     LoadPerFrameEvaluationVariables(presetPerFrameContext);
-    m_perFrameContext.ExecutePerFrameCode();
+    m_perFrameContext.ExecutePerFrameCode(m_presetState.expressionWatchdog);
 
     // Copy Q and T vars to per-point context
     InitPerPointEvaluationVariables();
@@ -101,11 +134,11 @@ void CustomWaveform::Draw(const PerFrameContext& presetPerFrameContext)
     }
 
     const auto* pcmL = m_spectrum
-                           ? m_presetState.audioData.spectrumLeft.data()
-                           : m_presetState.audioData.waveformLeft.data();
+                           ? m_presetState.audioData->spectrumLeft.data()
+                           : m_presetState.audioData->waveformLeft.data();
     const auto* pcmR = m_spectrum
-                           ? m_presetState.audioData.spectrumRight.data()
-                           : m_presetState.audioData.waveformRight.data();
+                           ? m_presetState.audioData->spectrumRight.data()
+                           : m_presetState.audioData->waveformRight.data();
 
     const float mult = m_scaling * m_presetState.waveScale * (m_spectrum ? 0.15f : 0.004f);
     //const float mult = m_scaling * m_presetState.waveScale * (m_spectrum ? 0.05f : 1.0f);
@@ -144,28 +177,39 @@ void CustomWaveform::Draw(const PerFrameContext& presetPerFrameContext)
         sampleDataR[sample] *= mult;
     }
 
-    std::vector<ColoredPoint> pointsTransformed(sampleCount);
+    // Batched results are checked against the expression library, so they're guaranteed to be identical,
+    // or within the single precision tolerance if built with ENABLE_FLOAT_EXPRESSIONS.
+    if (m_perPointContext.CanExecuteBatched())
+    {
+        CalculatePointsBatched(sampleDataL.data(), sampleDataR.data(), sampleCount, m_pointsTransformed.data());
 
-    float const sampleMultiplicator = sampleCount > 1 ? 1.0f / static_cast<float>(sampleCount - 1) : 0.0f;
-    for (int sample = 0; sample < sampleCount; sample++)
+        if (!m_presetState.expressionWatchdog.Expired() && !ValidateBatchedPoints(sampleDataL.data(), sampleDataR.data(), sampleCount, m_pointsTransformed.data()))
+        {
+            m_perPointContext.DisableBatchedExecution();
+            CalculatePoints(sampleDataL.data(), sampleDataR.data(), sampleCount, 0, sampleCount, m_pointsTransformed.data());
+        }
+    }
+    else
     {
-        float const sampleIndex = static_cast<float>(sample) * sampleMultiplicator;
-        LoadPerPointEvaluationVariables(sampleIndex, sampleDataL[sample], sampleDataR[sample]);
+        CalculatePoints(sampleDataL.data(), sampleDataR.data(), sampleCount, 0, sampleCount, m_pointsTransformed.data());
+    }
 
-        m_perPointContext.ExecutePerPointCode();
+    // Don't draw partially evaluated points.
+    if (m_presetState.expressionWatchdog.Expired())
+    {
+        return;
+    }
 
-        pointsTransformed[sample].x = static_cast<float>((*m_perPointContext.x * 2.0 - 1.0) * m_presetState.renderContext.invAspectX);
-        pointsTransformed[sample].y = static_cast<float>((*m_perPointContext.y * -2.0 + 1.0) * m_presetState.renderContext.invAspectY);
+    m_smoothedVertexCount = SmoothWave(m_pointsTransformed.data(), sampleCount, m_pointsSmoothed.data());
+}
 
-        pointsTransformed[sample].r = Renderer::color_modulo(*m_perPointContext.r);
-        pointsTransformed[sample].g = Renderer::color_modulo(*m_perPointContext.g);
-        pointsTransformed[sample].b = Renderer::color_modulo(*m_perPointContext.b);
-        pointsTransformed[sample].a = Renderer::color_modulo(*m_perPointContext.a);
+void CustomWaveform::Draw()
+{
+    if (m_smoothedVertexCount == 0)
+    {
+        return;
     }
 
-    std::vector<ColoredPoint> pointsSmoothed(sampleCount * 2);
-    auto smoothedVertexCount = SmoothWave(pointsTransformed.data(), sampleCount, pointsSmoothed.data());
-
 #ifndef USE_GLES
     glDisable(GL_LINE_SMOOTH);
 #endif
@@ -207,29 +251,29 @@ void CustomWaveform::Draw(const PerFrameContext& presetPerFrameContext)
                 break;
 
             case 1:
-                for (auto j = 0; j < smoothedVertexCount; j++)
+                for (auto j = 0; j < m_smoothedVertexCount; j++)
                 {
-                    pointsSmoothed[j].x += incrementX;
+                    m_pointsSmoothed[j].x += incrementX;
                 }
                 break;
 
             case 2:
-                for (auto j = 0; j < smoothedVertexCount; j++)
+                for (auto j = 0; j < m_smoothedVertexCount; j++)
                 {
-                    pointsSmoothed[j].y += incrementY;
+                    m_pointsSmoothed[j].y += incrementY;
                 }
                 break;
 
             case 3:
-                for (auto j = 0; j < smoothedVertexCount; j++)
+                for (auto j = 0; j < m_smoothedVertexCount; j++)
                 {
-                    pointsSmoothed[j].x -= incrementX;
+                    m_pointsSmoothed[j].x -= incrementX;
                 }
                 break;
         }
 
-        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(ColoredPoint) * smoothedVertexCount, pointsSmoothed.data());
-        glDrawArrays(drawType, 0, smoothedVertexCount);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(ColoredPoint) * m_smoothedVertexCount, m_pointsSmoothed.data());
+        glDrawArrays(drawType, 0, m_smoothedVertexCount);
     }
 
     glBindBuffer(GL_ARRAY_BUFFER, 0);
@@ -248,27 +292,194 @@ void CustomWaveform::LoadPerFrameEvaluationVariables(const PerFrameContext& pres
 
 void CustomWaveform::InitPerPointEvaluationVariables()
 {
+    auto const& referenced = m_perPointContext.referencedVariables;
+
+    // Unreferenced Q and T variables can't change the per-point results.
     for (int q = 0; q < QVarCount; q++)
     {
-        *m_perPointContext.q_vars[q] = *m_perFrameContext.q_vars[q];
+        if (referenced.q[q])
+        {
+            *m_perPointContext.q_vars[q] = *m_perFrameContext.q_vars[q];
+        }
     }
     for (int t = 0; t < TVarCount; t++)
     {
-        *m_perPointContext.t_vars[t] = *m_perFrameContext.t_vars[t];
+        if (referenced.t[t])
+        {
+            *m_perPointContext.t_vars[t] = *m_perFrameContext.t_vars[t];
+        }
     }
+
+    // The per-point code may only change some of the colors, the others stay at these values.
+    *m_perPointContext.r = *m_perFrameContext.r;
+    *m_perPointContext.g = *m_perFrameContext.g;
+    *m_perPointContext.b = *m_perFrameContext.b;
+    *m_perPointContext.a = *m_perFrameContext.a;
 }
 
 void CustomWaveform::LoadPerPointEvaluationVariables(float sample, float value1, float value2)
 {
-    *m_perPointContext.sample = static_cast<double>(sample);
-    *m_perPointContext.value1 = static_cast<double>(value1);
-    *m_perPointContext.value2 = static_cast<double>(value2);
+    auto const& referenced = m_perPointContext.referencedVariables;
+
+    if (referenced.sample)
+    {
+        *m_perPointContext.sample = static_cast<double>(sample);
+    }
+    if (referenced.value1)
+    {
+        *m_perPointContext.value1 = static_cast<double>(value1);
+    }
+    if (referenced.value2)
+    {
+        *m_perPointContext.value2 = static_cast<double>(value2);
+    }
     *m_perPointContext.x = static_cast<double>(0.5f + value1);
     *m_perPointContext.y = static_cast<double>(0.5f + value2);
-    *m_perPointContext.r = *m_perFrameContext.r;
-    *m_perPointContext.g = *m_perFrameContext.g;
-    *m_perPointContext.b = *m_perFrameContext.b;
-    *m_perPointContext.a = *m_perFrameContext.a;
+    if (referenced.r)
+    {
+        *m_perPointContext.r = *m_perFrameContext.r;
+    }
+    if (referenced.g)
+    {
+        *m_perPointContext.g = *m_perFrameContext.g;
+    }
+    if (referenced.b)
+    {
+        *m_perPointContext.b = *m_perFrameContext.b;
+    }
+    if (referenced.a)
+    {
+        *m_perPointContext.a = *m_perFrameContext.a;
+    }
+}
+
+void CustomWaveform::CalculatePoints(const float* sampleDataL, const float* sampleDataR, int sampleCount,
+                                     int firstSample, int lastSample, ColoredPoint* points)
+{
+    float const sampleMultiplicator = sampleCount > 1 ? 1.0f / static_cast<float>(sampleCount - 1) : 0.0f;
+    for (int sample = firstSample; sample < lastSample; sample++)
+    {
+        if (m_presetState.expressionWatchdog.CheckExpired())
+        {
+            return;
+        }
+
+        float const sampleIndex = static_cast<float>(sample) * sampleMultiplicator;
+        LoadPerPointEvaluationVariables(sampleIndex, sampleDataL[sample], sampleDataR[sample]);
+
+        m_perPointContext.ExecutePerPointCode(m_presetState.expressionWatchdog);
+
+        points[sample].x = static_cast<float>((*m_perPointContext.x * 2.0 - 1.0) * m_presetState.renderContext.invAspectX);
+        points[sample].y = static_cast<float>((*m_perPointContext.y * -2.0 + 1.0) * m_presetState.renderContext.invAspectY);
+
+        points[sample].r = Renderer::color_modulo(*m_perPointContext.r);
+        points[sample].g = Renderer::color_modulo(*m_perPointContext.g);
+        points[sample].b = Renderer::color_modulo(*m_perPointContext.b);
+        points[sample].a = Renderer::color_modulo(*m_perPointContext.a);
+    }
+}
+
+void CustomWaveform::CalculatePointsBatched(const float* sampleDataL, const float* sampleDataR, int sampleCount,
+                                            ColoredPoint* points)
+{
+    auto const& lanes = m_perPointContext.batchLanes;
+    auto const& referenced = m_perPointContext.referencedVariables;
+
+    // Colors not referenced by the code keep their value, so their lanes are only filled once.
+    struct ColorLane {
+        PresetBatchValue* lane;
+        PresetBatchValue value;
+        bool referenced;
+    };
+    std::array<ColorLane, 4> const colorLanes{{
+        {lanes.r, static_cast<PresetBatchValue>(*m_perFrameContext.r), referenced.r},
+        {lanes.g, static_cast<PresetBatchValue>(*m_perFrameContext.g), referenced.g},
+        {lanes.b, static_cast<PresetBatchValue>(*m_perFrameContext.b), referenced.b},
+        {lanes.a, static_cast<PresetBatchValue>(*m_perFrameContext.a), referenced.a},
+    }};
+
+    for (const auto& colorLane : colorLanes)
+    {
+        if (!colorLane.referenced)
+        {
+            std::fill_n(colorLane.lane, std::min(PresetBatchEvaluator::BatchSize, static_cast<size_t>(sampleCount)), colorLane.value);
+        }
+    }
+
+    float const sampleMultiplicator = sampleCount > 1 ? 1.0f / static_cast<float>(sampleCount - 1) : 0.0f;
+    for (int batchStart = 0; batchStart < sampleCount; batchStart += static_cast<int>(PresetBatchEvaluator::BatchSize))
+    {
+        if (m_presetState.expressionWatchdog.CheckExpired())
+        {
+            return;
+        }
+
+        size_t const count = std::min(PresetBatchEvaluator::BatchSize, static_cast<size_t>(sampleCount - batchStart));
+
+        // Same values and conversions as in LoadPerPointEvaluationVariables().
+        for (size_t lane = 0; lane < count; lane++)
+        {
+            int const sample = batchStart + static_cast<int>(lane);
+            float const sampleIndex = static_cast<float>(sample) * sampleMultiplicator;
+            if (referenced.sample)
+            {
+                lanes.sample[lane] = static_cast<PresetBatchValue>(sampleIndex);
+            }
+            if (referenced.value1)
+            {
+                lanes.value1[lane] = static_cast<PresetBatchValue>(sampleDataL[sample]);
+            }
+            if (referenced.value2)
+            {
+                lanes.value2[lane] = static_cast<PresetBatchValue>(sampleDataR[sample]);
+            }
+            lanes.x[lane] = static_cast<PresetBatchValue>(0.5f + sampleDataL[sample]);
+            lanes.y[lane] = static_cast<PresetBatchValue>(0.5f + sampleDataR[sample]);
+        }
+        for (const auto& colorLane : colorLanes)
+        {
+            if (colorLane.referenced)
+            {
+                std::fill_n(colorLane.lane, count, colorLane.value);
+            }
+        }
+
+        m_perPointContext.ExecutePerPointCodeBatch(count);
+
+        for (size_t lane = 0; lane < count; lane++)
+        {
+            auto& point = points[batchStart + static_cast<int>(lane)];
+            point.x = static_cast<float>((lanes.x[lane] * 2.0 - 1.0) * m_presetState.renderContext.invAspectX);
+            point.y = static_cast<float>((lanes.y[lane] * -2.0 + 1.0) * m_presetState.renderContext.invAspectY);
+
+            point.r = Renderer::color_modulo(lanes.r[lane]);
+            point.g = Renderer::color_modulo(lanes.g[lane]);
+            point.b = Renderer::color_modulo(lanes.b[lane]);
+            point.a = Renderer::color_modulo(lanes.a[lane]);
+        }
+    }
+}
+
+auto CustomWaveform::ValidateBatchedPoints(const float* sampleDataL, const float* sampleDataR, int sampleCount,
+                                           ColoredPoint* points) -> bool
+{
+    // Check all points on the first frame, then one point per frame.
+    int firstSample = 0;
+    int lastSample = sampleCount;
+    if (m_batchValidationPoint >= 0)
+    {
+        firstSample = m_batchValidationPoint % sampleCount;
+        lastSample = firstSample + 1;
+    }
+    m_batchValidationPoint = lastSample % sampleCount;
+
+    std::vector<ColoredPoint> const batchedPoints(points + firstSample, points + lastSample);
+
+    CalculatePoints(sampleDataL, sampleDataR, sampleCount, firstSample, lastSample, points);
+
+    return std::equal(points + firstSample, points + lastSample, batchedPoints.begin(), [](const ColoredPoint& point, const ColoredPoint& batchedPoint) {
+        return PresetBatchEvaluator::MatchesReference(&point.x, &batchedPoint.x, sizeof(ColoredPoint) / sizeof(float));
+    });
 }
 
 int CustomWaveform::SmoothWave(const CustomWaveform::ColoredPoint* inputVertices,
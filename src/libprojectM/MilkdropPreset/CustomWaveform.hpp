@@ -42,10 +42,29 @@ public:
     void CompileCodeAndRunInitExpressions(const PerFrameContext& presetPerFrameContext);
 
     /**
-     * @brief Renders the waveform.
+     * @brief Runs the per-frame and per-point code and calculates the waveform vertices.
+     *
+     * Doesn't use any OpenGL functions, so it can be called on a worker thread if
+     * CanEvaluateConcurrently() returns true.
+     *
      * @param presetPerFrameContext The per-frame context to retrieve the init Q vars from.
      */
-    void Draw(const PerFrameContext& presetPerFrameContext);
+    void Evaluate(const PerFrameContext& presetPerFrameContext);
+
+    /**
+     * @brief Returns whether this waveform can be evaluated at the same time as the other waveforms.
+     *
+     * This is the case if neither the per-frame nor the per-point code use memory buffers, random
+     * numbers or write global registers, so the results don't depend on the evaluation order.
+     *
+     * @return True if Evaluate() can run concurrently with other waveforms, false if not.
+     */
+    auto CanEvaluateConcurrently() const -> bool;
+
+    /**
+     * @brief Renders the waveform vertices calculated by the last Evaluate() call.
+     */
+    void Draw();
 
 private:
     /**
@@ -55,18 +74,60 @@ private:
     void LoadPerFrameEvaluationVariables(const PerFrameContext& presetPerFrameContext);
 
     /**
-     * @brief Loads the Q and T variables from the per-frame code into the per-point context.
+     * @brief Loads the Q and T variables and the colors from the per-frame code into the per-point context.
+     *
+     * Q and T variables not referenced by the per-point code are skipped.
      */
     void InitPerPointEvaluationVariables();
 
     /**
      * @brief Loads the variables for each point into the per-point evaluation context.
+     *
+     * Only sets the variables referenced by the per-point code, plus x and y. All others keep the
+     * values set in InitPerPointEvaluationVariables().
+     *
      * @param sample The sample index being rendered.
      * @param value1 The left channel value.
      * @param value2 The right channel value.
      */
     void LoadPerPointEvaluationVariables(float sample, float value1, float value2);
 
+    /**
+     * @brief Executes the per-point code for a range of samples and stores the transformed points.
+     * @param sampleDataL The smoothed left channel values.
+     * @param sampleDataR The smoothed right channel values.
+     * @param sampleCount The total number of samples.
+     * @param firstSample The first sample to calculate.
+     * @param lastSample The sample after the last sample to calculate.
+     * @param points The point array to store the results in.
+     */
+    void CalculatePoints(const float* sampleDataL, const float* sampleDataR, int sampleCount,
+                         int firstSample, int lastSample, ColoredPoint* points);
+
+    /**
+     * @brief Executes the per-point code for all samples in batches and stores the transformed points.
+     * @param sampleDataL The smoothed left channel values.
+     * @param sampleDataR The smoothed right channel values.
+     * @param sampleCount The total number of samples.
+     * @param points The point array to store the results in.
+     */
+    void CalculatePointsBatched(const float* sampleDataL, const float* sampleDataR, int sampleCount,
+                                ColoredPoint* points);
+
+    /**
+     * @brief Recalculates some points using the expression library and compares them to the batched results.
+     *
+     * All points are checked on the first frame, then one point per frame.
+     *
+     * @param sampleDataL The smoothed left channel values.
+     * @param sampleDataR The smoothed right channel values.
+     * @param sampleCount The total number of samples.
+     * @param points The batched results.
+     * @return True if the results match, see BatchEvaluator::MatchesReference(), false if not.
+     */
+    auto ValidateBatchedPoints(const float* sampleDataL, const float* sampleDataR, int sampleCount,
+                               ColoredPoint* points) -> bool;
+
     /**
      * @brief Does a better-than-linear smooth on a wave.
      *
@@ -102,7 +163,12 @@ private:
     WaveformPerFrameContext m_perFrameContext; //!< Holds the code execution context for per-frame expressions
     WaveformPerPointContext m_perPointContext; //!< Holds the code execution context for per-point expressions
 
-    std::vector<ColoredPoint> m_points; //!< Points in this waveform.
+    std::vector<ColoredPoint> m_pointsTransformed; //!< Points calculated by the per-point code, allocated once.
+    std::vector<ColoredPoint> m_pointsSmoothed;    //!< Smoothed waveform vertices, allocated once.
+    int m_smoothedVertexCount{0};                  //!< Number of vertices to draw from m_pointsSmoothed.
+    bool m_isSelfContained{false};                 //!< True if the waveform code doesn't use any shared state.
+
+    int m_batchValidationPoint{-1}; //!< Next point to check batched per-point results for, -1 to check all points.
 
     friend class WaveformPerFrameContext;
     friend class WaveformPerPointContext;
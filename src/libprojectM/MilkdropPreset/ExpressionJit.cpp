@@ -0,0 +1,917 @@
+#include "ExpressionJit.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <initializer_list>
+#include <map>
+#include <type_traits>
+
+#if defined(MILKDROP_EXPRESSION_JIT) && (defined(__x86_64__) || defined(_M_X64))
+#define MILKDROP_EXPRESSION_JIT_X86_64 1
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+#endif
+
+#ifdef MILKDROP_PRESET_DEBUG
+#include <iostream>
+#endif
+
+namespace libprojectM {
+namespace MilkdropPreset {
+
+namespace {
+
+// Tolerances used by the expression library for comparisons and truth values.
+constexpr double CloseFactor = 0.00001;
+constexpr double CloseFactorLow = 1e-300;
+
+// The expression library runs loop() and while() bodies at most this many times.
+constexpr int32_t MaxLoopIterations = 1048576;
+
+// Loops check the deadline each time this many iterations are left. Must be a power of 2.
+constexpr uint32_t LoopDeadlineCheckInterval = 1024;
+
+thread_local const ExpressionWatchdog* activeWatchdog{nullptr}; //!< Watchdog of the native code running on this thread.
+thread_local bool executionAborted{false};                      //!< True if the running native code was aborted.
+
+/**
+ * Called from loops in the generated code. If the deadline passed, the code returns immediately.
+ */
+auto LoopDeadlinePassed() -> bool
+{
+    if (activeWatchdog == nullptr || !activeWatchdog->CheckExpired())
+    {
+        return false;
+    }
+
+    executionAborted = true;
+    return true;
+}
+
+/**
+ * Math functions called from the generated code. Semantics must match BatchEvaluator.
+ */
+auto Modulo(double dividend, double divisor) -> double
+{
+    // x % -1 is always 0, but INT_MIN % -1 would trap.
+    auto const intDivisor = static_cast<int>(divisor);
+    return (intDivisor == 0 || intDivisor == -1) ? 0.0 : static_cast<double>(static_cast<int>(dividend) % intDivisor);
+}
+
+auto Sign(double value) -> double
+{
+    return value > 0.0 ? 1.0 : (value < 0.0 ? -1.0 : 0.0);
+}
+
+auto Power(double base, double exponent) -> double
+{
+    return std::pow(base, exponent);
+}
+
+auto Atan2(double y, double x) -> double
+{
+    return std::atan2(y, x);
+}
+
+auto Sin(double value) -> double
+{
+    return std::sin(value);
+}
+
+auto Cos(double value) -> double
+{
+    return std::cos(value);
+}
+
+auto Tan(double value) -> double
+{
+    return std::tan(value);
+}
+
+auto Asin(double value) -> double
+{
+    return std::asin(value);
+}
+
+auto Acos(double value) -> double
+{
+    return std::acos(value);
+}
+
+auto Atan(double value) -> double
+{
+    return std::atan(value);
+}
+
+auto Exp(double value) -> double
+{
+    return std::exp(value);
+}
+
+auto Log(double value) -> double
+{
+    return std::log(value);
+}
+
+auto Log10(double value) -> double
+{
+    return std::log10(value);
+}
+
+auto Floor(double value) -> double
+{
+    return std::floor(value);
+}
+
+auto Ceil(double value) -> double
+{
+    return std::ceil(value);
+}
+
+/**
+ * Generates x86-64 SSE2 code for an expression tree.
+ *
+ * Each node leaves its result in xmm0. Left operands are saved in 16-byte stack slots while the right
+ * operand is evaluated, so the stack pointer stays 16-byte aligned for function calls. Loops keep
+ * their remaining iteration count and the last body result in such a slot, too. Only xmm0 to xmm2,
+ * rax and rcx are used, which are caller-saved in both the System V and Windows x64 ABIs.
+ *
+ * Loop back-edges call LoopDeadlinePassed() every LoopDeadlineCheckInterval iterations. If it returns
+ * true, the function returns right away from any nesting depth, as rbp holds the initial stack pointer.
+ */
+class X86CodeGenerator
+{
+public:
+    /**
+     * Generates a complete function without arguments and return value.
+     * Variable addresses are left empty and recorded in VariableSites(), see ExpressionJit::Create().
+     * @return False if the tree contains an unsupported operation.
+     */
+    auto GenerateFunction(const ExpressionNode& root) -> bool
+    {
+        Emit({0x55});             // push rbp
+        Emit({0x48, 0x89, 0xE5}); // mov rbp, rsp
+
+        if (!Generate(root))
+        {
+            return false;
+        }
+
+        for (auto const abortJump : m_abortJumps)
+        {
+            PatchJump(abortJump);
+        }
+
+        Emit({0x48, 0x89, 0xEC}); // mov rsp, rbp
+        Emit({0x5D});             // pop rbp
+        Emit({0xC3});             // ret
+        return true;
+    }
+
+    auto Code() const -> const std::vector<uint8_t>&
+    {
+        return m_code;
+    }
+
+    auto VariableSites() const -> const std::vector<ExpressionJit::VariableSite>&
+    {
+        return m_variableSites;
+    }
+
+private:
+    enum class Condition : uint8_t
+    {
+        Above = 0x07,      //!< CF = 0 and ZF = 0
+        BelowEqual = 0x06, //!< CF = 1 or ZF = 1
+        Equal = 0x04,      //!< ZF = 1
+        NotEqual = 0x05,   //!< ZF = 0
+        LessEqual = 0x0E   //!< ZF = 1 or SF != OF
+    };
+
+    auto Generate(const ExpressionNode& node) -> bool
+    {
+        switch (node.operation)
+        {
+            case ExpressionOperation::Constant:
+                LoadConstant(node.value);
+                return true;
+
+            case ExpressionOperation::Variable: {
+                LoadVariableAddress(node.name);
+                Emit({0xF2, 0x0F, 0x10, 0x00}); // movsd xmm0, [rax]
+                return true;
+            }
+
+            case ExpressionOperation::Assign: {
+                if (!Generate(*node.arguments[0]))
+                {
+                    return false;
+                }
+                LoadVariableAddress(node.name);
+                Emit({0xF2, 0x0F, 0x11, 0x00}); // movsd [rax], xmm0
+                return true;
+            }
+
+            case ExpressionOperation::Sequence:
+                if (node.arguments.empty())
+                {
+                    LoadConstant(0.0);
+                }
+                for (const auto& argument : node.arguments)
+                {
+                    if (!Generate(*argument))
+                    {
+                        return false;
+                    }
+                }
+                return true;
+
+            case ExpressionOperation::If: {
+                if (!Generate(*node.arguments[0]))
+                {
+                    return false;
+                }
+                TestTruth();
+                auto const elseJump = Jump(Condition::BelowEqual);
+                if (!Generate(*node.arguments[1]))
+                {
+                    return false;
+                }
+                auto const endJump = Jump();
+                PatchJump(elseJump);
+                if (!Generate(*node.arguments[2]))
+                {
+                    return false;
+                }
+                PatchJump(endJump);
+                return true;
+            }
+
+            case ExpressionOperation::And:
+            case ExpressionOperation::Or: {
+                // The right-hand side is only evaluated if the left-hand side doesn't decide the result.
+                bool const isAnd = node.operation == ExpressionOperation::And;
+                if (!Generate(*node.arguments[0]))
+                {
+                    return false;
+                }
+                TestTruth();
+                auto const shortCircuitJump = Jump(isAnd ? Condition::BelowEqual : Condition::Above);
+                if (!Generate(*node.arguments[1]))
+                {
+                    return false;
+                }
+                TestTruth();
+                auto const rightJump = Jump(isAnd ? Condition::BelowEqual : Condition::Above);
+                LoadConstant(isAnd ? 1.0 : 0.0);
+                auto const endJump = Jump();
+                PatchJump(shortCircuitJump);
+                PatchJump(rightJump);
+                LoadConstant(isAnd ? 0.0 : 1.0);
+                PatchJump(endJump);
+                return true;
+            }
+
+            case ExpressionOperation::Loop: {
+                // The count is evaluated once, truncated and limited like in the expression library.
+                if (!Generate(*node.arguments[0]))
+                {
+                    return false;
+                }
+                Emit({0xF2, 0x0F, 0x2C, 0xC0}); // cvttsd2si eax, xmm0
+                Emit({0xB9});                   // mov ecx, imm32
+                EmitImmediate32(MaxLoopIterations);
+                Emit({0x39, 0xC8});                         // cmp eax, ecx
+                Emit({0x0F, 0x4F, 0xC1});                   // cmovg eax, ecx
+                Emit({0x48, 0x83, 0xEC, 0x10});             // sub rsp, 16
+                Emit({0x89, 0x04, 0x24});                   // mov [rsp], eax
+                Emit({0xF2, 0x0F, 0x11, 0x44, 0x24, 0x08}); // movsd [rsp + 8], xmm0
+
+                auto const loopStart = m_code.size();
+                Emit({0x83, 0x3C, 0x24, 0x00}); // cmp dword [rsp], 0
+                auto const endJump = Jump(Condition::LessEqual);
+                if (!Generate(*node.arguments[1]))
+                {
+                    return false;
+                }
+                Emit({0xF2, 0x0F, 0x11, 0x44, 0x24, 0x08}); // movsd [rsp + 8], xmm0
+                Emit({0xFF, 0x0C, 0x24});                   // dec dword [rsp]
+                CheckLoopDeadline(loopStart);
+                PatchJump(endJump);
+                Emit({0xF2, 0x0F, 0x10, 0x44, 0x24, 0x08}); // movsd xmm0, [rsp + 8]
+                Emit({0x48, 0x83, 0xC4, 0x10});             // add rsp, 16
+                return true;
+            }
+
+            case ExpressionOperation::While: {
+                // Runs the body until it returns false, but at most MaxLoopIterations times.
+                Emit({0x48, 0x83, 0xEC, 0x10}); // sub rsp, 16
+                Emit({0xC7, 0x04, 0x24});       // mov dword [rsp], imm32
+                EmitImmediate32(MaxLoopIterations);
+
+                auto const loopStart = m_code.size();
+                if (!Generate(*node.arguments[0]))
+                {
+                    return false;
+                }
+                Emit({0xF2, 0x0F, 0x11, 0x44, 0x24, 0x08}); // movsd [rsp + 8], xmm0
+                TestTruth();
+                auto const falseJump = Jump(Condition::BelowEqual);
+                Emit({0xFF, 0x0C, 0x24}); // dec dword [rsp]
+                auto const limitJump = Jump(Condition::Equal);
+                CheckLoopDeadline(loopStart);
+                PatchJump(falseJump);
+                PatchJump(limitJump);
+                Emit({0xF2, 0x0F, 0x10, 0x44, 0x24, 0x08}); // movsd xmm0, [rsp + 8]
+                Emit({0x48, 0x83, 0xC4, 0x10});             // add rsp, 16
+                return true;
+            }
+
+            default:
+                break;
+        }
+
+        // Unary operators and functions
+        if (node.arguments.size() == 1)
+        {
+            if (!Generate(*node.arguments[0]))
+            {
+                return false;
+            }
+            return GenerateUnary(node.operation);
+        }
+
+        // Binary operators and functions: left operand in xmm0, right operand in xmm1.
+        if (node.arguments.size() != 2 || !Generate(*node.arguments[0]))
+        {
+            return false;
+        }
+        Emit({0x48, 0x83, 0xEC, 0x10});       // sub rsp, 16
+        Emit({0xF2, 0x0F, 0x11, 0x04, 0x24}); // movsd [rsp], xmm0
+        if (!Generate(*node.arguments[1]))
+        {
+            return false;
+        }
+        Emit({0x66, 0x0F, 0x28, 0xC8});       // movapd xmm1, xmm0
+        Emit({0xF2, 0x0F, 0x10, 0x04, 0x24}); // movsd xmm0, [rsp]
+        Emit({0x48, 0x83, 0xC4, 0x10});       // add rsp, 16
+        return GenerateBinary(node.operation);
+    }
+
+    auto GenerateUnary(ExpressionOperation operation) -> bool
+    {
+        switch (operation)
+        {
+            case ExpressionOperation::Negate:
+                Emit({0x66, 0x48, 0x0F, 0x7E, 0xC0});       // movq rax, xmm0
+                Emit({0x48, 0x0F, 0xBA, 0xF8, 0x3F});       // btc rax, 63
+                Emit({0x66, 0x48, 0x0F, 0x6E, 0xC0});       // movq xmm0, rax
+                return true;
+            case ExpressionOperation::Not:
+                TestTruth();
+                SetResult(0x96); // setbe al
+                return true;
+            case ExpressionOperation::Abs:
+                AbsoluteValue();
+                return true;
+            case ExpressionOperation::Sqr:
+                Emit({0xF2, 0x0F, 0x59, 0xC0}); // mulsd xmm0, xmm0
+                return true;
+            case ExpressionOperation::Sqrt:
+                AbsoluteValue();
+                Emit({0xF2, 0x0F, 0x51, 0xC0}); // sqrtsd xmm0, xmm0
+                return true;
+            case ExpressionOperation::Sign:
+                Call(reinterpret_cast<const void*>(&Sign));
+                return true;
+            case ExpressionOperation::Floor:
+                Call(reinterpret_cast<const void*>(&Floor));
+                return true;
+            case ExpressionOperation::Ceil:
+                Call(reinterpret_cast<const void*>(&Ceil));
+                return true;
+            case ExpressionOperation::Sin:
+                Call(reinterpret_cast<const void*>(&Sin));
+                return true;
+            case ExpressionOperation::Cos:
+                Call(reinterpret_cast<const void*>(&Cos));
+                return true;
+            case ExpressionOperation::Tan:
+                Call(reinterpret_cast<const void*>(&Tan));
+                return true;
+            case ExpressionOperation::Asin:
+                Call(reinterpret_cast<const void*>(&Asin));
+                return true;
+            case ExpressionOperation::Acos:
+                Call(reinterpret_cast<const void*>(&Acos));
+                return true;
+            case ExpressionOperation::Atan:
+                Call(reinterpret_cast<const void*>(&Atan));
+                return true;
+            case ExpressionOperation::Exp:
+                Call(reinterpret_cast<const void*>(&Exp));
+                return true;
+            case ExpressionOperation::Log:
+                Call(reinterpret_cast<const void*>(&Log));
+                return true;
+            case ExpressionOperation::Log10:
+                Call(reinterpret_cast<const void*>(&Log10));
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    auto GenerateBinary(ExpressionOperation operation) -> bool
+    {
+        switch (operation)
+        {
+            case ExpressionOperation::Add:
+                Emit({0xF2, 0x0F, 0x58, 0xC1}); // addsd xmm0, xmm1
+                return true;
+            case ExpressionOperation::Subtract:
+                Emit({0xF2, 0x0F, 0x5C, 0xC1}); // subsd xmm0, xmm1
+                return true;
+            case ExpressionOperation::Multiply:
+                Emit({0xF2, 0x0F, 0x59, 0xC1}); // mulsd xmm0, xmm1
+                return true;
+            case ExpressionOperation::Divide:
+                // Returns 0 if the divisor is 0, the quotient otherwise (including NaN divisors).
+                Emit({0xF2, 0x0F, 0x5E, 0xC1}); // divsd xmm0, xmm1
+                Emit({0x66, 0x0F, 0x57, 0xD2}); // xorpd xmm2, xmm2
+                Emit({0x66, 0x0F, 0x2E, 0xCA}); // ucomisd xmm1, xmm2
+                Emit({0x7A, 0x06});             // jp +6
+                Emit({0x75, 0x04});             // jne +4
+                Emit({0x66, 0x0F, 0x28, 0xC2}); // movapd xmm0, xmm2
+                return true;
+            case ExpressionOperation::Min:
+                Emit({0xF2, 0x0F, 0x5D, 0xC1}); // minsd xmm0, xmm1 (a < b ? a : b)
+                return true;
+            case ExpressionOperation::Max:
+                Emit({0xF2, 0x0F, 0x5F, 0xC1}); // maxsd xmm0, xmm1 (a > b ? a : b)
+                return true;
+            case ExpressionOperation::Less:
+                Emit({0x66, 0x0F, 0x2E, 0xC8}); // ucomisd xmm1, xmm0
+                SetResult(0x97);                // seta al
+                return true;
+            case ExpressionOperation::LessEqual:
+                Emit({0x66, 0x0F, 0x2E, 0xC8}); // ucomisd xmm1, xmm0
+                SetResult(0x93);                // setae al
+                return true;
+            case ExpressionOperation::Greater:
+                Emit({0x66, 0x0F, 0x2E, 0xC1}); // ucomisd xmm0, xmm1
+                SetResult(0x97);                // seta al
+                return true;
+            case ExpressionOperation::GreaterEqual:
+                Emit({0x66, 0x0F, 0x2E, 0xC1}); // ucomisd xmm0, xmm1
+                SetResult(0x93);                // setae al
+                return true;
+            case ExpressionOperation::ExactEqual:
+                Emit({0x66, 0x0F, 0x2E, 0xC1}); // ucomisd xmm0, xmm1
+                Emit({0x0F, 0x94, 0xC0});       // sete al
+                Emit({0x0F, 0x9B, 0xC1});       // setnp cl
+                Emit({0x20, 0xC8});             // and al, cl
+                ConvertResult();
+                return true;
+            case ExpressionOperation::ExactNotEqual:
+                Emit({0x66, 0x0F, 0x2E, 0xC1}); // ucomisd xmm0, xmm1
+                Emit({0x0F, 0x95, 0xC0});       // setne al
+                Emit({0x0F, 0x9A, 0xC1});       // setp cl
+                Emit({0x08, 0xC8});             // or al, cl
+                ConvertResult();
+                return true;
+            case ExpressionOperation::Equal:
+            case ExpressionOperation::NotEqual:
+                Emit({0xF2, 0x0F, 0x5C, 0xC1}); // subsd xmm0, xmm1
+                AbsoluteValue();
+                LoadConstantToXmm1(CloseFactor);
+                Emit({0x66, 0x0F, 0x2E, 0xC8}); // ucomisd xmm1, xmm0
+                Emit({0x0F, 0x97, 0xC0});       // seta al
+                if (operation == ExpressionOperation::NotEqual)
+                {
+                    Emit({0x34, 0x01}); // xor al, 1
+                }
+                ConvertResult();
+                return true;
+            case ExpressionOperation::Modulo:
+                Call(reinterpret_cast<const void*>(&Modulo));
+                return true;
+            case ExpressionOperation::Power:
+                Call(reinterpret_cast<const void*>(&Power));
+                return true;
+            case ExpressionOperation::Atan2:
+                Call(reinterpret_cast<const void*>(&Atan2));
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    /**
+     * Jumps back to the loop start unless the deadline check of this iteration fails, in which case
+     * the function returns. The remaining iteration count must be stored in [rsp].
+     */
+    void CheckLoopDeadline(size_t loopStart)
+    {
+        Emit({0xF7, 0x04, 0x24}); // test dword [rsp], imm32
+        EmitImmediate32(static_cast<int32_t>(LoopDeadlineCheckInterval - 1));
+        JumpTo(Condition::NotEqual, loopStart);
+        Call(reinterpret_cast<const void*>(&LoopDeadlinePassed));
+        Emit({0x84, 0xC0}); // test al, al
+        JumpTo(Condition::Equal, loopStart);
+        m_abortJumps.push_back(Jump());
+    }
+
+    /**
+     * Sets the flags for a truth test of xmm0: "above" if true, "below or equal" if false or NaN.
+     */
+    void TestTruth()
+    {
+        AbsoluteValue();
+        LoadConstantToXmm1(CloseFactorLow);
+        Emit({0x66, 0x0F, 0x2E, 0xC1}); // ucomisd xmm0, xmm1
+    }
+
+    void AbsoluteValue()
+    {
+        Emit({0x66, 0x48, 0x0F, 0x7E, 0xC0}); // movq rax, xmm0
+        Emit({0x48, 0x0F, 0xBA, 0xF0, 0x3F}); // btr rax, 63
+        Emit({0x66, 0x48, 0x0F, 0x6E, 0xC0}); // movq xmm0, rax
+    }
+
+    /**
+     * Stores 1.0 in xmm0 if the given setcc condition is met, 0.0 otherwise.
+     */
+    void SetResult(uint8_t setccOpcode)
+    {
+        Emit({0x0F, setccOpcode, 0xC0}); // setcc al
+        ConvertResult();
+    }
+
+    /**
+     * Converts the boolean in al to 1.0 or 0.0 in xmm0.
+     */
+    void ConvertResult()
+    {
+        Emit({0x0F, 0xB6, 0xC0});       // movzx eax, al
+        Emit({0xF2, 0x0F, 0x2A, 0xC0}); // cvtsi2sd xmm0, eax
+    }
+
+    void LoadConstant(double value)
+    {
+        Emit({0x48, 0xB8}); // mov rax, imm64
+        EmitImmediate(value);
+        Emit({0x66, 0x48, 0x0F, 0x6E, 0xC0}); // movq xmm0, rax
+    }
+
+    void LoadConstantToXmm1(double value)
+    {
+        Emit({0x48, 0xB9}); // mov rcx, imm64
+        EmitImmediate(value);
+        Emit({0x66, 0x48, 0x0F, 0x6E, 0xC9}); // movq xmm1, rcx
+    }
+
+    void LoadAddress(const void* address)
+    {
+        Emit({0x48, 0xB8}); // mov rax, imm64
+        EmitImmediate(address);
+    }
+
+    /**
+     * Loads a variable address into rax. The immediate is filled in when binding the code.
+     */
+    void LoadVariableAddress(const std::string& name)
+    {
+        Emit({0x48, 0xB8}); // mov rax, imm64
+        m_variableSites.push_back({name, m_code.size()});
+        EmitImmediate(static_cast<const void*>(nullptr));
+    }
+
+    /**
+     * Calls a C function taking one or two doubles in xmm0 and xmm1, returning a double in xmm0.
+     * Reserves the 32 bytes of shadow space required by the Windows x64 ABI.
+     */
+    void Call(const void* function)
+    {
+        LoadAddress(function);
+        Emit({0x48, 0x83, 0xEC, 0x20}); // sub rsp, 32
+        Emit({0xFF, 0xD0});             // call rax
+        Emit({0x48, 0x83, 0xC4, 0x20}); // add rsp, 32
+    }
+
+    /**
+     * Emits a conditional jump with a 32-bit displacement.
+     * @return The position of the displacement, to be passed to PatchJump().
+     */
+    auto Jump(Condition condition) -> size_t
+    {
+        Emit({0x0F, static_cast<uint8_t>(0x80 | static_cast<uint8_t>(condition)), 0, 0, 0, 0});
+        return m_code.size() - 4;
+    }
+
+    /**
+     * Emits an unconditional jump with a 32-bit displacement.
+     * @return The position of the displacement, to be passed to PatchJump().
+     */
+    auto Jump() -> size_t
+    {
+        Emit({0xE9, 0, 0, 0, 0});
+        return m_code.size() - 4;
+    }
+
+    /**
+     * Emits a conditional jump to an already generated position.
+     */
+    void JumpTo(Condition condition, size_t target)
+    {
+        PatchJump(Jump(condition), target);
+    }
+
+    /**
+     * Sets the target of a jump to the current position.
+     */
+    void PatchJump(size_t displacementPosition)
+    {
+        PatchJump(displacementPosition, m_code.size());
+    }
+
+    /**
+     * Sets the target of a jump to the given position.
+     */
+    void PatchJump(size_t displacementPosition, size_t target)
+    {
+        auto const displacement = static_cast<int32_t>(static_cast<int64_t>(target) - static_cast<int64_t>(displacementPosition + 4));
+        std::memcpy(m_code.data() + displacementPosition, &displacement, sizeof(displacement));
+    }
+
+    void Emit(std::initializer_list<uint8_t> bytes)
+    {
+        m_code.insert(m_code.end(), bytes);
+    }
+
+    template<typename T>
+    void EmitImmediate(T value)
+    {
+        static_assert(sizeof(T) == 8, "Immediate must be 64 bits wide");
+        uint8_t bytes[8];
+        std::memcpy(bytes, &value, sizeof(bytes));
+        m_code.insert(m_code.end(), bytes, bytes + sizeof(bytes));
+    }
+
+    void EmitImmediate32(int32_t value)
+    {
+        uint8_t bytes[4];
+        std::memcpy(bytes, &value, sizeof(bytes));
+        m_code.insert(m_code.end(), bytes, bytes + sizeof(bytes));
+    }
+
+    std::vector<uint8_t> m_code;                              //!< The generated machine code.
+    std::vector<ExpressionJit::VariableSite> m_variableSites; //!< Positions of the variable address immediates.
+    std::vector<size_t> m_abortJumps;                         //!< Jumps to the function epilogue, taken if the deadline passed.
+};
+
+} // namespace
+
+ExpressionJit::~ExpressionJit()
+{
+#ifdef MILKDROP_EXPRESSION_JIT_X86_64
+    if (m_memory != nullptr)
+    {
+#ifdef _WIN32
+        VirtualFree(m_memory, 0, MEM_RELEASE);
+#else
+        munmap(m_memory, m_memorySize);
+#endif
+    }
+#endif
+}
+
+auto ExpressionJit::IsAvailable() -> bool
+{
+#ifdef MILKDROP_EXPRESSION_JIT_X86_64
+    return true;
+#else
+    return false;
+#endif
+}
+
+auto ExpressionJit::Compile(const ExpressionNode& root, const VariableResolver& resolveVariable) -> std::unique_ptr<ExpressionJit>
+{
+#ifdef MILKDROP_EXPRESSION_JIT_X86_64
+    X86CodeGenerator generator;
+    if (!generator.GenerateFunction(root))
+    {
+        return {};
+    }
+
+    return Create(generator.Code(), generator.VariableSites(), resolveVariable);
+#else
+    (void) root;
+    (void) resolveVariable;
+    return {};
+#endif
+}
+
+auto ExpressionJit::Compile(const std::string& code, projectm_eval_context* context) -> std::unique_ptr<ExpressionJit>
+{
+    // The generated code only operates on doubles.
+    if (!IsAvailable() || !std::is_same<PRJM_EVAL_F, double>::value)
+    {
+        return {};
+    }
+
+    ExpressionTree const tree(code, true);
+    if (tree.Root() == nullptr)
+    {
+        return {};
+    }
+
+    return Compile(*tree.Root(), [context](const std::string& name) {
+        return reinterpret_cast<double*>(projectm_eval_context_register_variable(context, name.c_str()));
+    });
+}
+
+auto ExpressionJit::Rebind(const VariableResolver& resolveVariable) const -> std::unique_ptr<ExpressionJit>
+{
+    return Create(m_code, m_variableSites, resolveVariable);
+}
+
+auto ExpressionJit::ExecuteNative(const ExpressionWatchdog* watchdog) const -> bool
+{
+    activeWatchdog = watchdog;
+    executionAborted = false;
+
+    m_function();
+
+    activeWatchdog = nullptr;
+    return !executionAborted;
+}
+
+void ExpressionJit::Execute(projectm_eval_code* interpreterCode, double frame, const ExpressionWatchdog& watchdog)
+{
+    if (m_disabled)
+    {
+        projectm_eval_code_execute(interpreterCode);
+        return;
+    }
+
+    if (frame != m_frame)
+    {
+        // Pick a different execution each sampled frame, wrapping at the previous frame's execution count.
+        uint32_t const executionsPerFrame = std::max(m_frameExecutionCount, 1U);
+        m_validatedFrameExecution = m_frameCount % ValidationFrameInterval == 0
+                                        ? (m_frameCount / ValidationFrameInterval) % executionsPerFrame
+                                        : NoValidation;
+        m_frame = frame;
+        m_frameCount++;
+        m_frameExecutionCount = 0;
+    }
+
+    if (m_executionCount < ValidatedExecutions || m_frameExecutionCount == m_validatedFrameExecution)
+    {
+        ExecuteValidated(interpreterCode, watchdog);
+    }
+    else
+    {
+        ExecuteNative(&watchdog);
+    }
+
+    if (m_executionCount < UINT32_MAX)
+    {
+        m_executionCount++;
+    }
+    m_frameExecutionCount++;
+}
+
+auto ExpressionJit::IsDisabled() const -> bool
+{
+    return m_disabled;
+}
+
+auto ExpressionJit::Variables() const -> const std::vector<double*>&
+{
+    return m_variables;
+}
+
+auto ExpressionJit::Create(const std::vector<uint8_t>& code, const std::vector<VariableSite>& variableSites,
+                           const VariableResolver& resolveVariable) -> std::unique_ptr<ExpressionJit>
+{
+#ifdef MILKDROP_EXPRESSION_JIT_X86_64
+    std::unique_ptr<ExpressionJit> jit(new ExpressionJit());
+    jit->m_code = code;
+    jit->m_variableSites = variableSites;
+
+    // Patch the variable addresses into the code, resolving each name only once.
+    std::map<std::string, double*> resolvedVariables;
+    for (const auto& site : variableSites)
+    {
+        auto variable = resolvedVariables.find(site.name);
+        if (variable == resolvedVariables.end())
+        {
+            auto* address = resolveVariable(site.name);
+            if (address == nullptr)
+            {
+                return {};
+            }
+            variable = resolvedVariables.emplace(site.name, address).first;
+            if (std::find(jit->m_variables.begin(), jit->m_variables.end(), address) == jit->m_variables.end())
+            {
+                jit->m_variables.push_back(address);
+            }
+        }
+        std::memcpy(jit->m_code.data() + site.offset, &variable->second, sizeof(double*));
+    }
+
+    // Write the code into a fresh mapping, then make it executable but not writable.
+#ifdef _WIN32
+    SYSTEM_INFO systemInfo;
+    GetSystemInfo(&systemInfo);
+    size_t const pageSize = systemInfo.dwPageSize;
+#else
+    size_t const pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+    size_t const memorySize = (jit->m_code.size() + pageSize - 1) / pageSize * pageSize;
+
+#ifdef _WIN32
+    void* memory = VirtualAlloc(nullptr, memorySize, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+    if (memory == nullptr)
+    {
+        return {};
+    }
+    std::memcpy(memory, jit->m_code.data(), jit->m_code.size());
+    DWORD oldProtection{};
+    if (!VirtualProtect(memory, memorySize, PAGE_EXECUTE_READ, &oldProtection))
+    {
+        VirtualFree(memory, 0, MEM_RELEASE);
+        return {};
+    }
+    FlushInstructionCache(GetCurrentProcess(), memory, memorySize);
+#else
+    void* memory = mmap(nullptr, memorySize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED)
+    {
+        return {};
+    }
+    std::memcpy(memory, jit->m_code.data(), jit->m_code.size());
+    if (mprotect(memory, memorySize, PROT_READ | PROT_EXEC) != 0)
+    {
+        munmap(memory, memorySize);
+        return {};
+    }
+#endif
+
+    jit->m_memory = memory;
+    jit->m_memorySize = memorySize;
+    jit->m_function = reinterpret_cast<void (*)()>(memory);
+    jit->m_initialValues.resize(jit->m_variables.size());
+    jit->m_nativeValues.resize(jit->m_variables.size());
+    return jit;
+#else
+    (void) code;
+    (void) variableSites;
+    (void) resolveVariable;
+    return {};
+#endif
+}
+
+void ExpressionJit::ExecuteValidated(projectm_eval_code* interpreterCode, const ExpressionWatchdog& watchdog)
+{
+    for (size_t index = 0; index < m_variables.size(); index++)
+    {
+        m_initialValues[index] = *m_variables[index];
+    }
+
+    // An aborted execution can't be compared, and running the interpreter would overrun the deadline.
+    if (!ExecuteNative(&watchdog))
+    {
+        return;
+    }
+
+    for (size_t index = 0; index < m_variables.size(); index++)
+    {
+        m_nativeValues[index] = *m_variables[index];
+        *m_variables[index] = m_initialValues[index];
+    }
+
+    projectm_eval_code_execute(interpreterCode);
+
+    for (size_t index = 0; index < m_variables.size(); index++)
+    {
+        if (std::memcmp(m_variables[index], &m_nativeValues[index], sizeof(double)) != 0)
+        {
+            m_disabled = true;
+#ifdef MILKDROP_PRESET_DEBUG
+            std::cerr << "[Preset] Native expression code differs from the interpreter, using the interpreter." << std::endl;
+#endif
+            break;
+        }
+    }
+}
+
+} // namespace MilkdropPreset
+} // namespace libprojectM
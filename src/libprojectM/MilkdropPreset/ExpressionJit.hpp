@@ -0,0 +1,167 @@
+#pragma once
+
+#include "ExpressionTree.hpp"
+#include "ExpressionWatchdog.hpp"
+
+#include <projectm-eval.h>
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace libprojectM {
+namespace MilkdropPreset {
+
+/**
+ * @brief Compiles parsed expression code into native machine code.
+ *
+ * Each variable used by the code is bound to a fixed double-precision memory location, usually
+ * the variable storage of an expression library context. The generated function reads and writes
+ * these locations directly, removing the tree walk and function dispatch overhead of the
+ * interpreter. Intermediate values are kept in SSE registers and on the machine stack, while
+ * division, comparisons and conditionals are inlined. Other math functions call the C library.
+ *
+ * The expression semantics match BatchEvaluator. if(), && and || only evaluate the selected branch.
+ * In addition, loop() and while() are supported with the same iteration limit as the expression
+ * library. Loops check the ExpressionWatchdog deadline periodically and abort the whole execution
+ * once it passed, so native code can't overrun the budget by more than a few loop iterations.
+ *
+ * Native code is currently only generated on x86-64 if the library was built with
+ * ENABLE_EXPRESSION_JIT. On all other platforms, or for code using constructs ExpressionTree
+ * can't parse, Compile() returns nullptr and the caller keeps using the interpreter.
+ */
+class ExpressionJit
+{
+public:
+    using VariableResolver = std::function<double*(const std::string&)>;
+
+    /**
+     * @brief Position of a variable address in the generated code.
+     */
+    struct VariableSite {
+        std::string name; //!< The lower-case variable name.
+        size_t offset{};  //!< Byte offset of the 64-bit address immediate in the code.
+    };
+
+    static constexpr uint32_t ValidatedExecutions = 64;   //!< Number of initial executions cross-checked against the interpreter.
+    static constexpr uint32_t ValidationFrameInterval = 8; //!< After the initial executions, one execution of every n-th frame is cross-checked.
+
+    ExpressionJit(const ExpressionJit&) = delete;
+    auto operator=(const ExpressionJit&) -> ExpressionJit& = delete;
+
+    ~ExpressionJit();
+
+    /**
+     * @brief Returns whether native code can be generated in this build and on this platform.
+     * @return True if Compile() can succeed, false if it always returns nullptr.
+     */
+    static auto IsAvailable() -> bool;
+
+    /**
+     * @brief Compiles the given expression tree.
+     * @param root The root node of the parsed code.
+     * @param resolveVariable Returns the storage location of a lower-case variable name. Must stay valid while the code is used.
+     * @return The compiled code, or nullptr if native code can't be generated.
+     */
+    static auto Compile(const ExpressionNode& root, const VariableResolver& resolveVariable) -> std::unique_ptr<ExpressionJit>;
+
+    /**
+     * @brief Parses and compiles code operating on the variables of an expression library context.
+     * @param code The EEL source code, which must already have been compiled successfully by the expression library.
+     * @param context The context to bind the variables to.
+     * @return The compiled code, or nullptr if native code can't be generated.
+     */
+    static auto Compile(const std::string& code, projectm_eval_context* context) -> std::unique_ptr<ExpressionJit>;
+
+    /**
+     * @brief Creates a copy of the compiled code operating on different variables.
+     *
+     * Only patches the variable addresses into a copy of the machine code, which is much cheaper
+     * than parsing and compiling the code again, e.g. for per-thread clones of an expression context.
+     * The copy starts with its own validation schedule.
+     *
+     * @param resolveVariable Returns the storage location of a lower-case variable name. Must stay valid while the code is used.
+     * @return The compiled code, or nullptr if a variable can't be resolved or the code can't be mapped.
+     */
+    auto Rebind(const VariableResolver& resolveVariable) const -> std::unique_ptr<ExpressionJit>;
+
+    /**
+     * @brief Executes the native code.
+     *
+     * If the watchdog's deadline passes while a loop runs, the execution is aborted. Variables keep
+     * the values assigned until then.
+     *
+     * @param watchdog The watchdog checked by loops, or nullptr to run loops without a time limit.
+     * @return True if the code ran to completion, false if it was aborted.
+     */
+    auto ExecuteNative(const ExpressionWatchdog* watchdog = nullptr) const -> bool;
+
+    /**
+     * @brief Executes the code, cross-checking the native results against the interpreter.
+     *
+     * The first ValidatedExecutions executions and then one execution of every ValidationFrameInterval-th
+     * frame run both the interpreter and the native code on the same variable values and compare the
+     * results bitwise. Within a frame, the checked execution moves on each time, so code executed
+     * multiple times per frame, e.g. per vertex, is checked with different inputs. If the results
+     * differ, the interpreter results are kept and all following executions only use the interpreter.
+     *
+     * Native executions are aborted once the watchdog's deadline passes, see ExecuteNative(). An
+     * aborted execution isn't cross-checked. The interpreter can't be aborted.
+     *
+     * @param interpreterCode The expression library code handle compiled from the same code.
+     * @param frame The current frame number. A different value than in the last call starts a new frame.
+     * @param watchdog The watchdog limiting the time spent in loops.
+     */
+    void Execute(projectm_eval_code* interpreterCode, double frame, const ExpressionWatchdog& watchdog);
+
+    /**
+     * @brief Returns whether native execution was disabled after a mismatch with the interpreter.
+     * @return True if Execute() only runs the interpreter.
+     */
+    auto IsDisabled() const -> bool;
+
+    /**
+     * @brief Returns the storage locations of all variables read or written by the code.
+     * @return A list of distinct variable addresses.
+     */
+    auto Variables() const -> const std::vector<double*>&;
+
+private:
+    static constexpr uint32_t NoValidation = UINT32_MAX; //!< m_validatedFrameExecution value if no execution in the frame is checked.
+
+    ExpressionJit() = default;
+
+    /**
+     * Binds the variables of generated code and maps it into executable memory.
+     */
+    static auto Create(const std::vector<uint8_t>& code, const std::vector<VariableSite>& variableSites,
+                       const VariableResolver& resolveVariable) -> std::unique_ptr<ExpressionJit>;
+
+    /**
+     * Compares one interpreter execution with a native execution starting from the same values.
+     * Leaves the interpreter results in the variables, or the native results if the native execution was aborted.
+     */
+    void ExecuteValidated(projectm_eval_code* interpreterCode, const ExpressionWatchdog& watchdog);
+
+    std::vector<uint8_t> m_code;               //!< The machine code, kept for Rebind().
+    std::vector<VariableSite> m_variableSites; //!< Variable address positions in m_code.
+    void* m_memory{nullptr};                   //!< The executable memory block.
+    size_t m_memorySize{0};                    //!< Size of the executable memory block in bytes.
+    void (*m_function)(){nullptr};             //!< The entry point of the generated code.
+    std::vector<double*> m_variables;          //!< Addresses of all variables used by the code.
+    std::vector<double> m_initialValues;       //!< Variable values before a validated execution.
+    std::vector<double> m_nativeValues;        //!< Native results of a validated execution.
+    uint32_t m_executionCount{0};              //!< Number of Execute() calls, used to schedule validation.
+    double m_frame{std::nan("")};              //!< Frame number of the last Execute() call.
+    uint32_t m_frameCount{0};                  //!< Number of frames the code was executed in.
+    uint32_t m_frameExecutionCount{0};         //!< Number of Execute() calls in the current frame.
+    uint32_t m_validatedFrameExecution{0};     //!< Index of the execution to check in the current frame, NoValidation if none.
+    bool m_disabled{false};                    //!< True if native code produced different results than the interpreter.
+};
+
+} // namespace MilkdropPreset
+} // namespace libprojectM
@@ -0,0 +1,497 @@
+#include "ExpressionTree.hpp"
+
+#include "CodeTokenizer.hpp"
+
+#include <cctype>
+#include <locale>
+#include <map>
+#include <sstream>
+#include <utility>
+
+namespace libprojectM {
+namespace MilkdropPreset {
+
+namespace {
+
+/**
+ * A supported builtin function and its number of arguments.
+ */
+struct FunctionInfo {
+    ExpressionOperation operation;
+    size_t argumentCount;
+};
+
+const std::map<std::string, FunctionInfo> Functions{
+    {"if", {ExpressionOperation::If, 3}},
+    {"above", {ExpressionOperation::Greater, 2}},
+    {"below", {ExpressionOperation::Less, 2}},
+    {"equal", {ExpressionOperation::Equal, 2}},
+    {"band", {ExpressionOperation::And, 2}},
+    {"bor", {ExpressionOperation::Or, 2}},
+    {"bnot", {ExpressionOperation::Not, 1}},
+    {"exec2", {ExpressionOperation::Sequence, 2}},
+    {"exec3", {ExpressionOperation::Sequence, 3}},
+    {"pow", {ExpressionOperation::Power, 2}},
+    {"sin", {ExpressionOperation::Sin, 1}},
+    {"cos", {ExpressionOperation::Cos, 1}},
+    {"tan", {ExpressionOperation::Tan, 1}},
+    {"asin", {ExpressionOperation::Asin, 1}},
+    {"acos", {ExpressionOperation::Acos, 1}},
+    {"atan", {ExpressionOperation::Atan, 1}},
+    {"atan2", {ExpressionOperation::Atan2, 2}},
+    {"sqr", {ExpressionOperation::Sqr, 1}},
+    {"sqrt", {ExpressionOperation::Sqrt, 1}},
+    {"exp", {ExpressionOperation::Exp, 1}},
+    {"log", {ExpressionOperation::Log, 1}},
+    {"log10", {ExpressionOperation::Log10, 1}},
+    {"abs", {ExpressionOperation::Abs, 1}},
+    {"sign", {ExpressionOperation::Sign, 1}},
+    {"min", {ExpressionOperation::Min, 2}},
+    {"max", {ExpressionOperation::Max, 2}},
+    {"floor", {ExpressionOperation::Floor, 1}},
+    {"ceil", {ExpressionOperation::Ceil, 1}}};
+
+const std::map<std::string, FunctionInfo> LoopFunctions{
+    {"loop", {ExpressionOperation::Loop, 2}},
+    {"while", {ExpressionOperation::While, 1}}};
+
+const std::map<std::string, ExpressionOperation> CompoundAssignments{
+    {"+=", ExpressionOperation::Add},
+    {"-=", ExpressionOperation::Subtract},
+    {"*=", ExpressionOperation::Multiply},
+    {"/=", ExpressionOperation::Divide},
+    {"%=", ExpressionOperation::Modulo},
+    {"^=", ExpressionOperation::Power}};
+
+const std::map<std::string, double> NamedConstants{
+    {"$pi", 3.14159265358979323846},
+    {"$e", 2.71828182845904523536},
+    {"$phi", 1.61803398874989484820}};
+
+auto MakeNode(ExpressionOperation operation) -> ExpressionNode::Ptr
+{
+    auto node = std::make_unique<ExpressionNode>();
+    node->operation = operation;
+    return node;
+}
+
+auto MakeNode(ExpressionOperation operation, ExpressionNode::Ptr left, ExpressionNode::Ptr right) -> ExpressionNode::Ptr
+{
+    auto node = MakeNode(operation);
+    node->arguments.push_back(std::move(left));
+    node->arguments.push_back(std::move(right));
+    return node;
+}
+
+/**
+ * Parses a numeric literal or $ constant.
+ * @return False if the constant isn't supported.
+ */
+auto ParseConstant(const std::string& text, double& value) -> bool
+{
+    if (text[0] == '$')
+    {
+        std::string lowerText = text;
+        for (auto& character : lowerText)
+        {
+            character = static_cast<char>(std::tolower(static_cast<unsigned char>(character)));
+        }
+
+        auto constant = NamedConstants.find(lowerText);
+        if (constant != NamedConstants.end())
+        {
+            value = constant->second;
+            return true;
+        }
+
+        if (lowerText.size() > 2 && lowerText[1] == 'x')
+        {
+            std::istringstream stream(lowerText.substr(2));
+            unsigned long long hexValue{};
+            stream >> std::hex >> hexValue;
+            value = static_cast<double>(hexValue);
+            return !stream.fail() && stream.eof();
+        }
+
+        return false;
+    }
+
+    // Always use a period as decimal separator, regardless of the user locale.
+    std::istringstream stream(text);
+    stream.imbue(std::locale::classic());
+    stream >> value;
+    return !stream.fail() && stream.eof();
+}
+
+/**
+ * Recursive descent parser for the supported expression syntax.
+ *
+ * All Parse functions return nullptr if the code at the current position can't be parsed,
+ * which aborts parsing the whole code.
+ */
+class Parser
+{
+public:
+    Parser(std::vector<CodeToken> tokens, bool allowLoops)
+        : m_tokens(std::move(tokens))
+        , m_allowLoops(allowLoops)
+    {
+    }
+
+    auto ParseProgram() -> ExpressionNode::Ptr
+    {
+        auto program = ParseSequence();
+        if (!program || m_position != m_tokens.size())
+        {
+            return {};
+        }
+
+        return program;
+    }
+
+private:
+    auto Peek() const -> const CodeToken*
+    {
+        return m_position < m_tokens.size() ? &m_tokens[m_position] : nullptr;
+    }
+
+    auto PeekIs(CodeTokenType type, const char* text = nullptr) const -> bool
+    {
+        const auto* token = Peek();
+        return token != nullptr && token->type == type && (text == nullptr || token->text == text);
+    }
+
+    /**
+     * Statements separated by semicolons. Ends at a closing parenthesis, comma or the end of the code.
+     */
+    auto ParseSequence() -> ExpressionNode::Ptr
+    {
+        auto sequence = MakeNode(ExpressionOperation::Sequence);
+
+        while (true)
+        {
+            if (PeekIs(CodeTokenType::Semicolon))
+            {
+                m_position++;
+                continue;
+            }
+            if (Peek() == nullptr || PeekIs(CodeTokenType::CloseParenthesis) || PeekIs(CodeTokenType::Comma))
+            {
+                break;
+            }
+
+            auto statement = ParseAssignment();
+            if (!statement)
+            {
+                return {};
+            }
+            sequence->arguments.push_back(std::move(statement));
+
+            if (!PeekIs(CodeTokenType::Semicolon))
+            {
+                break;
+            }
+        }
+
+        // Empty code evaluates to 0.
+        if (sequence->arguments.empty())
+        {
+            return MakeNode(ExpressionOperation::Constant);
+        }
+
+        if (sequence->arguments.size() == 1)
+        {
+            return std::move(sequence->arguments.front());
+        }
+
+        return sequence;
+    }
+
+    auto ParseAssignment() -> ExpressionNode::Ptr
+    {
+        auto target = ParseTernary();
+        if (!target || !PeekIs(CodeTokenType::Operator) || !IsAssignmentOperator(Peek()->text))
+        {
+            return target;
+        }
+
+        if (target->operation != ExpressionOperation::Variable)
+        {
+            return {};
+        }
+
+        std::string const op = Peek()->text;
+        m_position++;
+
+        auto value = ParseAssignment();
+        if (!value)
+        {
+            return {};
+        }
+
+        if (op != "=")
+        {
+            auto compound = CompoundAssignments.find(op);
+            if (compound == CompoundAssignments.end())
+            {
+                return {};
+            }
+
+            auto current = MakeNode(ExpressionOperation::Variable);
+            current->name = target->name;
+            value = MakeNode(compound->second, std::move(current), std::move(value));
+        }
+
+        auto assignment = MakeNode(ExpressionOperation::Assign);
+        assignment->name = target->name;
+        assignment->arguments.push_back(std::move(value));
+        return assignment;
+    }
+
+    auto ParseTernary() -> ExpressionNode::Ptr
+    {
+        auto condition = ParseBinary(0);
+        if (!condition || !PeekIs(CodeTokenType::Operator, "?"))
+        {
+            return condition;
+        }
+        m_position++;
+
+        auto trueValue = ParseAssignment();
+        if (!trueValue || !PeekIs(CodeTokenType::Operator, ":"))
+        {
+            return {};
+        }
+        m_position++;
+
+        auto falseValue = ParseAssignment();
+        if (!falseValue)
+        {
+            return {};
+        }
+
+        auto node = MakeNode(ExpressionOperation::If);
+        node->arguments.push_back(std::move(condition));
+        node->arguments.push_back(std::move(trueValue));
+        node->arguments.push_back(std::move(falseValue));
+        return node;
+    }
+
+    /**
+     * Left-associative binary operators, from lowest to highest precedence level.
+     */
+    auto ParseBinary(size_t level) -> ExpressionNode::Ptr
+    {
+        static const std::vector<std::map<std::string, ExpressionOperation>> levels{
+            {{"||", ExpressionOperation::Or}},
+            {{"&&", ExpressionOperation::And}},
+            {{"==", ExpressionOperation::Equal},
+             {"!=", ExpressionOperation::NotEqual},
+             {"===", ExpressionOperation::ExactEqual},
+             {"!==", ExpressionOperation::ExactNotEqual}},
+            {{"<", ExpressionOperation::Less},
+             {">", ExpressionOperation::Greater},
+             {"<=", ExpressionOperation::LessEqual},
+             {">=", ExpressionOperation::GreaterEqual}},
+            {{"+", ExpressionOperation::Add},
+             {"-", ExpressionOperation::Subtract}},
+            {{"*", ExpressionOperation::Multiply},
+             {"/", ExpressionOperation::Divide},
+             {"%", ExpressionOperation::Modulo}}};
+
+        if (level == levels.size())
+        {
+            return ParseUnary();
+        }
+
+        auto left = ParseBinary(level + 1);
+        while (left && PeekIs(CodeTokenType::Operator))
+        {
+            auto op = levels[level].find(Peek()->text);
+            if (op == levels[level].end())
+            {
+                break;
+            }
+            m_position++;
+
+            auto right = ParseBinary(level + 1);
+            if (!right)
+            {
+                return {};
+            }
+            left = MakeNode(op->second, std::move(left), std::move(right));
+        }
+
+        return left;
+    }
+
+    auto ParseUnary() -> ExpressionNode::Ptr
+    {
+        if (PeekIs(CodeTokenType::Operator, "-") || PeekIs(CodeTokenType::Operator, "!"))
+        {
+            auto node = MakeNode(Peek()->text == "-" ? ExpressionOperation::Negate : ExpressionOperation::Not);
+            m_position++;
+            auto operand = ParseUnary();
+            if (!operand)
+            {
+                return {};
+            }
+            node->arguments.push_back(std::move(operand));
+            return node;
+        }
+
+        if (PeekIs(CodeTokenType::Operator, "+"))
+        {
+            m_position++;
+            return ParseUnary();
+        }
+
+        return ParsePower();
+    }
+
+    auto ParsePower() -> ExpressionNode::Ptr
+    {
+        auto base = ParsePrimary();
+        if (!base || !PeekIs(CodeTokenType::Operator, "^"))
+        {
+            return base;
+        }
+        m_position++;
+
+        auto exponent = ParseUnary();
+        if (!exponent)
+        {
+            return {};
+        }
+
+        return MakeNode(ExpressionOperation::Power, std::move(base), std::move(exponent));
+    }
+
+    auto ParsePrimary() -> ExpressionNode::Ptr
+    {
+        const auto* token = Peek();
+        if (token == nullptr)
+        {
+            return {};
+        }
+
+        switch (token->type)
+        {
+            case CodeTokenType::Constant: {
+                auto node = MakeNode(ExpressionOperation::Constant);
+                if (!ParseConstant(token->text, node->value))
+                {
+                    return {};
+                }
+                m_position++;
+                return node;
+            }
+
+            case CodeTokenType::Identifier: {
+                m_position++;
+                if (PeekIs(CodeTokenType::OpenParenthesis))
+                {
+                    return ParseFunction(token->text);
+                }
+
+                auto node = MakeNode(ExpressionOperation::Variable);
+                node->name = token->text;
+                return node;
+            }
+
+            case CodeTokenType::OpenParenthesis: {
+                m_position++;
+                auto node = ParseSequence();
+                if (!node || !PeekIs(CodeTokenType::CloseParenthesis))
+                {
+                    return {};
+                }
+                m_position++;
+                return node;
+            }
+
+            default:
+                return {};
+        }
+    }
+
+    auto ParseFunction(const std::string& name) -> ExpressionNode::Ptr
+    {
+        auto function = Functions.find(name);
+        if (function == Functions.end())
+        {
+            if (!m_allowLoops)
+            {
+                return {};
+            }
+
+            function = LoopFunctions.find(name);
+            if (function == LoopFunctions.end())
+            {
+                return {};
+            }
+        }
+
+        // Skip opening parenthesis
+        m_position++;
+
+        auto node = MakeNode(function->second.operation);
+        while (true)
+        {
+            auto argument = ParseSequence();
+            if (!argument)
+            {
+                return {};
+            }
+            node->arguments.push_back(std::move(argument));
+
+            if (!PeekIs(CodeTokenType::Comma))
+            {
+                break;
+            }
+            m_position++;
+        }
+
+        if (!PeekIs(CodeTokenType::CloseParenthesis) || node->arguments.size() != function->second.argumentCount)
+        {
+            return {};
+        }
+        m_position++;
+
+        return node;
+    }
+
+    std::vector<CodeToken> m_tokens; //!< The code tokens.
+    size_t m_position{0};            //!< Index of the next token to parse.
+    bool m_allowLoops{false};        //!< If true, loop() and while() are parsed.
+};
+
+} // namespace
+
+ExpressionTree::ExpressionTree(const std::string& code, bool allowLoops)
+{
+    std::vector<CodeToken> tokens;
+    if (!TokenizeCode(code, tokens))
+    {
+        return;
+    }
+
+    Parser parser(std::move(tokens), allowLoops);
+    m_root = parser.ParseProgram();
+
+    // Always return a sequence, so the program result doesn't depend on the root node type.
+    if (m_root && m_root->operation != ExpressionOperation::Sequence)
+    {
+        auto sequence = MakeNode(ExpressionOperation::Sequence);
+        sequence->arguments.push_back(std::move(m_root));
+        m_root = std::move(sequence);
+    }
+}
+
+auto ExpressionTree::Root() const -> const ExpressionNode*
+{
+    return m_root.get();
+}
+
+} // namespace MilkdropPreset
+} // namespace libprojectM
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace libprojectM {
+namespace MilkdropPreset {
+
+/**
+ * @brief Operations of an expression tree node.
+ *
+ * Builtin functions like above() or pow() are mapped to the equivalent operator.
+ */
+enum class ExpressionOperation
+{
+    Constant,      //!< Numeric constant, stored in the node value.
+    Variable,      //!< Variable read, the name is stored in the node.
+    Assign,        //!< Assigns the only argument to the named variable.
+    Sequence,      //!< Evaluates all arguments in order, result is the last value.
+    Negate,        //!< Unary minus.
+    Not,           //!< Logical not, "!" and bnot().
+    Add,           //!< "+"
+    Subtract,      //!< "-"
+    Multiply,      //!< "*"
+    Divide,        //!< "/", returns 0 if dividing by 0.
+    Modulo,        //!< "%", integer modulo, returns 0 if dividing by 0.
+    Power,         //!< "^" and pow().
+    Equal,         //!< "==" and equal(), with a small tolerance.
+    NotEqual,      //!< "!=", with a small tolerance.
+    ExactEqual,    //!< "==="
+    ExactNotEqual, //!< "!=="
+    Less,          //!< "<" and below().
+    Greater,       //!< ">" and above().
+    LessEqual,     //!< "<="
+    GreaterEqual,  //!< ">="
+    And,           //!< "&&" and band().
+    Or,            //!< "||" and bor().
+    If,            //!< if() and the "?:" operator.
+    Loop,          //!< loop(count, body), only parsed if loops are enabled.
+    While,         //!< while(body), only parsed if loops are enabled.
+    Sin,
+    Cos,
+    Tan,
+    Asin,
+    Acos,
+    Atan,
+    Atan2,
+    Sqr,
+    Sqrt,
+    Exp,
+    Log,
+    Log10,
+    Abs,
+    Sign,
+    Min,
+    Max,
+    Floor,
+    Ceil
+};
+
+/**
+ * @brief A single node of a parsed expression tree.
+ */
+struct ExpressionNode {
+    using Ptr = std::unique_ptr<ExpressionNode>;
+
+    ExpressionOperation operation{ExpressionOperation::Constant}; //!< The node operation.
+    double value{};                                               //!< Constant value.
+    std::string name;                                             //!< Variable name for Variable and Assign nodes.
+    std::vector<Ptr> arguments;                                   //!< Operands, in evaluation order.
+};
+
+/**
+ * @brief Parses preset expression code into a tree.
+ *
+ * Only supports the side-effect-free subset of the expression language which can be evaluated without
+ * access to the expression library context: arithmetic, comparisons, conditionals, assignments and the
+ * most commonly used math functions. Code using memory buffers, random numbers or any other construct
+ * not listed in ExpressionOperation can't be parsed and leaves the tree empty.
+ *
+ * Loops are only parsed if requested, as only ExpressionJit can evaluate them. BatchEvaluator and
+ * GlslTranslator don't support them.
+ */
+class ExpressionTree
+{
+public:
+    /**
+     * @brief Parses the given code.
+     * @param code The EEL source code, as passed to the expression compiler.
+     * @param allowLoops If true, loop() and while() are parsed, otherwise code using them leaves the tree empty.
+     */
+    explicit ExpressionTree(const std::string& code, bool allowLoops = false);
+
+    /**
+     * @brief Returns the root node of the parsed code.
+     * @return The root node, or nullptr if the code uses unsupported constructs or is malformed.
+     */
+    auto Root() const -> const ExpressionNode*;
+
+private:
+    ExpressionNode::Ptr m_root; //!< The root node, always a Sequence node if the code was parsed successfully.
+};
+
+} // namespace MilkdropPreset
+} // namespace libprojectM
@@ -0,0 +1,45 @@
+#include "ExpressionWatchdog.hpp"
+
+namespace libprojectM {
+namespace MilkdropPreset {
+
+void ExpressionWatchdog::StartFrame(Clock::time_point deadline)
+{
+    m_enabled = deadline != Clock::time_point::max();
+    m_deadline = deadline;
+
+    // An expired budget skips all following frames until the watchdog is disabled.
+    if (!m_enabled)
+    {
+        m_expired.store(false, std::memory_order_relaxed);
+    }
+}
+
+auto ExpressionWatchdog::CheckExpired() const -> bool
+{
+    if (!m_enabled)
+    {
+        return false;
+    }
+
+    if (m_expired.load(std::memory_order_relaxed))
+    {
+        return true;
+    }
+
+    if (Clock::now() < m_deadline)
+    {
+        return false;
+    }
+
+    m_expired.store(true, std::memory_order_relaxed);
+    return true;
+}
+
+auto ExpressionWatchdog::Expired() const -> bool
+{
+    return m_expired.load(std::memory_order_relaxed);
+}
+
+} // namespace MilkdropPreset
+} // namespace libprojectM
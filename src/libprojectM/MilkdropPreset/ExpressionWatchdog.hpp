@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+
+namespace libprojectM {
+namespace MilkdropPreset {
+
+/**
+ * @brief Limits the time spent evaluating preset expression code.
+ *
+ * The budget is checked between executions, e.g. before the per-frame code, each per-pixel mesh
+ * row, waveform point batch or shape instance, and by native code on loop back-edges, see
+ * ExpressionJit. The expression library interpreter can't interrupt code while it runs, so a
+ * single interpreted execution, e.g. a long loop() in the per-frame code, can still overrun it.
+ *
+ * Once the budget is used up, all remaining evaluation of the frame and of all following frames is
+ * skipped, so a preset overrunning the budget once can't stall any further frames. The preset then
+ * keeps drawing with the last evaluated values: the mesh keeps the previous values, while shapes and
+ * waveforms aren't drawn. Disabling the budget resumes evaluation.
+ *
+ * The deadline is shared by all presets rendered in the same frame, so during a transition both
+ * presets together must stay within the budget.
+ *
+ * CheckExpired() can be called concurrently from worker threads.
+ */
+class ExpressionWatchdog
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * @brief Starts the budget for a new frame.
+     * @param deadline The time at which evaluation must stop. Clock::time_point::max() disables the
+     *                 watchdog and resets the expiration.
+     */
+    void StartFrame(Clock::time_point deadline);
+
+    /**
+     * @brief Checks whether the budget of the current frame is used up.
+     *
+     * If it is, Expired() returns true from then on, also in all following frames.
+     *
+     * @return True if evaluation should stop, false if it can continue.
+     */
+    auto CheckExpired() const -> bool;
+
+    /**
+     * @brief Returns whether evaluation was cut short.
+     * @return True if a previous CheckExpired() call returned true, unless the watchdog was disabled since.
+     */
+    auto Expired() const -> bool;
+
+private:
+    bool m_enabled{false};                      //!< False if no budget is set.
+    Clock::time_point m_deadline;               //!< The time at which the budget of the current frame is used up.
+    mutable std::atomic<bool> m_expired{false}; //!< True once a deadline passed.
+};
+
+} // namespace MilkdropPreset
+} // namespace libprojectM
@@ -2,21 +2,46 @@
 
 #include "IdlePreset.hpp"
 #include "MilkdropPreset.hpp"
+#include "MilkdropPresetExceptions.hpp"
+#include "PresetFileParser.hpp"
 
 namespace libprojectM {
 namespace MilkdropPreset {
 
-std::unique_ptr<::libprojectM::Preset> Factory::LoadPresetFromFile(const std::string& filename)
+namespace {
+
+/**
+ * @brief A parsed Milkdrop preset file, or the idle preset.
+ */
+class ParsedMilkdropPreset : public ParsedPreset
+{
+public:
+    bool idlePreset{false};   //!< If true, the built-in idle preset is created instead of using the parsed data.
+    std::string path;         //!< The file path the preset was read from, empty if read from a stream.
+    PresetFileParser parser;  //!< The parsed preset file.
+};
+
+} // namespace
+
+std::unique_ptr<ParsedPreset> Factory::ParsePresetFromFile(const std::string& filename)
 {
     std::string path;
     auto protocol = PresetFactory::Protocol(filename, path);
     if (protocol == "idle")
     {
-        return IdlePresets::allocate();
+        auto parsedPreset = std::make_unique<ParsedMilkdropPreset>();
+        parsedPreset->idlePreset = true;
+        return parsedPreset;
     }
     else if (protocol == "" || protocol == "file")
     {
-        return std::make_unique<MilkdropPreset>(path);
+        auto parsedPreset = std::make_unique<ParsedMilkdropPreset>();
+        parsedPreset->path = path;
+        if (!parsedPreset->parser.Read(path))
+        {
+            throw MilkdropPresetLoadException("Could not parse preset file \"" + path + "\"");
+        }
+        return parsedPreset;
     }
     else
     {
@@ -25,9 +50,31 @@ std::unique_ptr<::libprojectM::Preset> Factory::LoadPresetFromFile(const std::st
     }
 }
 
-std::unique_ptr<Preset> Factory::LoadPresetFromStream(std::istream& data)
+std::unique_ptr<ParsedPreset> Factory::ParsePresetFromStream(std::istream& data)
+{
+    auto parsedPreset = std::make_unique<ParsedMilkdropPreset>();
+    if (!parsedPreset->parser.Read(data))
+    {
+        throw MilkdropPresetLoadException("Could not parse preset data.");
+    }
+    return parsedPreset;
+}
+
+std::unique_ptr<Preset> Factory::CreatePreset(std::unique_ptr<ParsedPreset> parsedPreset)
 {
-    return std::make_unique<MilkdropPreset>(data);
+    if (!parsedPreset)
+    {
+        return nullptr;
+    }
+
+    // Only this factory creates ParsedMilkdropPreset instances.
+    auto& milkdropPreset = static_cast<ParsedMilkdropPreset&>(*parsedPreset);
+    if (milkdropPreset.idlePreset)
+    {
+        return IdlePresets::allocate();
+    }
+
+    return std::make_unique<MilkdropPreset>(milkdropPreset.parser, milkdropPreset.path);
 }
 
 } // namespace MilkdropPreset
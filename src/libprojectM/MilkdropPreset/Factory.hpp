@@ -23,9 +23,11 @@ class Factory : public PresetFactory
 {
 
 public:
-    std::unique_ptr<Preset> LoadPresetFromFile(const std::string& filename) override;
+    std::unique_ptr<ParsedPreset> ParsePresetFromFile(const std::string& filename) override;
 
-    std::unique_ptr<Preset> LoadPresetFromStream(std::istream& data) override;
+    std::unique_ptr<ParsedPreset> ParsePresetFromStream(std::istream& data) override;
+
+    std::unique_ptr<Preset> CreatePreset(std::unique_ptr<ParsedPreset> parsedPreset) override;
 
     std::string supportedExtensions() const override
     {
@@ -87,6 +87,47 @@ void FinalComposite::LoadCompositeShader(const PresetState& presetState)
     }
 }
 
+void FinalComposite::LoadCompositeShaderTextures(PresetState& presetState)
+{
+    if (m_compositeShader)
+    {
+        m_compositeShader->LoadTextures(presetState);
+    }
+}
+
+void FinalComposite::TranspileCompositeShader(const PresetState& presetState)
+{
+    if (m_compositeShader)
+    {
+        try
+        {
+            m_compositeShader->Transpile(presetState);
+        }
+        catch (Renderer::ShaderException& ex)
+        {
+#ifdef MILKDROP_PRESET_DEBUG
+            std::cerr << "[Composite Shader] Error translating composite shader code:" << ex.message() << std::endl;
+            std::cerr << "[Composite Shader] Using fallback shader." << std::endl;
+#else
+            (void)ex; // silence unused parameter warning
+#endif
+            // Fall back to default shader. Its textures are loaded when compiling it.
+            m_compositeShader = std::make_unique<MilkdropShader>(MilkdropShader::ShaderType::CompositeShader);
+            m_compositeShader->LoadCode(defaultCompositeShader);
+        }
+    }
+}
+
+auto FinalComposite::StartCompilingCompositeShader() const -> Renderer::ShaderCache::ProgramPtr
+{
+    if (!m_compositeShader)
+    {
+        return {};
+    }
+
+    return m_compositeShader->StartCompile();
+}
+
 void FinalComposite::CompileCompositeShader(PresetState& presetState)
 {
     if (m_compositeShader)
@@ -114,7 +155,7 @@ void FinalComposite::CompileCompositeShader(PresetState& presetState)
     }
 }
 
-void FinalComposite::Draw(const PresetState& presetState, const PerFrameContext& perFrameContext)
+void FinalComposite::Draw(const PresetState& presetState)
 {
     if (m_compositeShader)
     {
@@ -128,7 +169,7 @@ void FinalComposite::Draw(const PresetState& presetState, const PerFrameContext&
         glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(MeshVertex) * vertexCount, m_vertices.data());
         glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-        m_compositeShader->LoadVariables(presetState, perFrameContext);
+        m_compositeShader->LoadVariables(presetState);
 
         glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, nullptr);
     }
@@ -28,6 +28,25 @@ public:
      */
     void LoadCompositeShader(const PresetState& presetState);
 
+    /**
+     * @brief Loads the textures referenced by the composite shader.
+     * @param presetState The preset state to retrieve the textures from.
+     */
+    void LoadCompositeShaderTextures(PresetState& presetState);
+
+    /**
+     * @brief Translates the composite shader into GLSL without using OpenGL.
+     * If the shader can't be translated, the default composite shader is used instead.
+     * @param presetState The preset state to retrieve the blur textures from.
+     */
+    void TranspileCompositeShader(const PresetState& presetState);
+
+    /**
+     * @brief Starts compiling the translated composite shader in the background, if supported.
+     * @return The program being compiled, or an empty pointer if there is none.
+     */
+    auto StartCompilingCompositeShader() const -> Renderer::ShaderCache::ProgramPtr;
+
     /**
      * @brief Loads the required textures and compiles the composite shader.
      * @param presetState The preset state to retrieve the configuration values from.
@@ -37,10 +56,8 @@ public:
     /**
      * @brief Renders the composite quad with the appropriate effects or shaders.
      * @param presetState The preset state to retrieve the configuration values from.
-     * @param presetPerFrameContext The per-frame context to retrieve the initial vars from.
      */
-    void Draw(const PresetState& presetState,
-              const PerFrameContext& perFrameContext);
+    void Draw(const PresetState& presetState);
 
     /**
      * @brief Returns if the final composite is using a shader or classic filters.
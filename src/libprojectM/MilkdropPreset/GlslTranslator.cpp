@@ -0,0 +1,488 @@
+#include "GlslTranslator.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <iomanip>
+#include <locale>
+#include <sstream>
+
+namespace libprojectM {
+namespace MilkdropPreset {
+
+namespace {
+
+/**
+ * Helper functions implementing the expression semantics which differ from the GLSL builtins.
+ */
+constexpr auto HelperFunctions = R"(
+// GLSL leaves several builtins undefined outside of their domain, while the expression library
+// returns NaN or infinity as defined by IEEE 754. The wrappers check the domain explicitly.
+float pp_nan()
+{
+    return uintBitsToFloat(0x7FC00000u);
+}
+
+float pp_inf()
+{
+    return uintBitsToFloat(0x7F800000u);
+}
+
+bool pp_bool(float value)
+{
+    return abs(value) > 0.0;
+}
+
+float pp_div(float dividend, float divisor)
+{
+    return divisor == 0.0 ? 0.0 : dividend / divisor;
+}
+
+// Converts like the x86 CPU instructions: NaN and values outside the int range give INT_MIN.
+int pp_int(float value)
+{
+    return abs(value) < 2147483648.0 ? int(value) : (-2147483647 - 1);
+}
+
+// Remainder of the truncated integer values. Uses unsigned magnitudes, as GLSL doesn't define %
+// for negative operands and abs(INT_MIN) overflows.
+float pp_mod(float dividend, float divisor)
+{
+    int intDivisor = pp_int(divisor);
+    if (intDivisor == 0 || intDivisor == -1)
+    {
+        return 0.0;
+    }
+    int intDividend = pp_int(dividend);
+    uint dividendMagnitude = intDividend < 0 ? uint(-(intDividend + 1)) + 1u : uint(intDividend);
+    uint divisorMagnitude = intDivisor < 0 ? uint(-(intDivisor + 1)) + 1u : uint(intDivisor);
+    float remainder = float(dividendMagnitude % divisorMagnitude);
+    return intDividend < 0 ? -remainder : remainder;
+}
+
+float pp_pow(float base, float exponent)
+{
+    if (exponent == 0.0)
+    {
+        return 1.0;
+    }
+    if (base == 0.0)
+    {
+        return exponent > 0.0 ? 0.0 : pp_inf();
+    }
+    if (base < 0.0)
+    {
+        if (floor(exponent) != exponent)
+        {
+            return pp_nan();
+        }
+        float result = pow(-base, exponent);
+        return mod(exponent, 2.0) == 0.0 ? result : -result;
+    }
+    return pow(base, exponent);
+}
+
+float pp_atan2(float y, float x)
+{
+    // atan(0, x) is undefined for x == 0 in GLSL, and the sign for x < 0 depends on the sign of the
+    // zero, which shader compilers don't preserve reliably. Uses the result of atan2(+0, x) in C.
+    if (y == 0.0)
+    {
+        return x < 0.0 ? 3.14159265 : 0.0;
+    }
+    return atan(y, x);
+}
+
+float pp_asin(float value)
+{
+    return abs(value) > 1.0 ? pp_nan() : asin(value);
+}
+
+float pp_acos(float value)
+{
+    return abs(value) > 1.0 ? pp_nan() : acos(value);
+}
+
+float pp_exp(float value)
+{
+    // Larger values overflow single precision.
+    return value > 88.72283 ? pp_inf() : exp(value);
+}
+
+float pp_log(float value)
+{
+    if (value <= 0.0)
+    {
+        return value == 0.0 ? -pp_inf() : pp_nan();
+    }
+    return log(value);
+}
+
+float pp_log10(float value)
+{
+    return pp_log(value) * 0.4342944819;
+}
+
+float pp_sqr(float value)
+{
+    return value * value;
+}
+)";
+
+auto IsValidName(const std::string& name) -> bool
+{
+    if (name.empty() || name[0] == '_' || name.find("__") != std::string::npos)
+    {
+        return false;
+    }
+
+    return std::all_of(name.begin(), name.end(), [](char character) {
+        return (character >= 'a' && character <= 'z') || (character >= '0' && character <= '9') || character == '_';
+    });
+}
+
+auto LocalName(const std::string& variable) -> std::string
+{
+    return "v_" + variable;
+}
+
+void AddUnique(std::vector<std::string>& names, const std::string& name)
+{
+    if (std::find(names.begin(), names.end(), name) == names.end())
+    {
+        names.push_back(name);
+    }
+}
+
+auto Contains(const std::vector<std::string>& names, const std::string& name) -> bool
+{
+    return std::find(names.begin(), names.end(), name) != names.end();
+}
+
+} // namespace
+
+GlslTranslator::GlslTranslator(const ExpressionNode& root,
+                               const std::string& functionName,
+                               const std::vector<std::string>& inputs,
+                               const std::vector<std::string>& outputs)
+{
+    for (const auto& name : inputs)
+    {
+        if (!IsValidName(name))
+        {
+            return;
+        }
+    }
+    for (const auto& name : outputs)
+    {
+        if (!IsValidName(name))
+        {
+            return;
+        }
+        m_uniforms.push_back(name);
+    }
+
+    // Variables assigned at the top level before being read don't need the current value passed in.
+    std::vector<std::string> assigned(inputs);
+    for (const auto& statement : root.arguments)
+    {
+        m_read.clear();
+        if (!CollectVariables(*statement))
+        {
+            m_uniforms.clear();
+            return;
+        }
+
+        for (const auto& name : m_read)
+        {
+            if (!Contains(assigned, name))
+            {
+                AddUnique(m_uniforms, name);
+            }
+        }
+
+        if (statement->operation == ExpressionOperation::Assign)
+        {
+            AddUnique(assigned, statement->name);
+        }
+    }
+
+    std::string statements;
+    for (const auto& statement : root.arguments)
+    {
+        std::string expression;
+        if (!Translate(*statement, expression))
+        {
+            m_uniforms.clear();
+            return;
+        }
+        statements += "    " + expression + ";\n";
+    }
+
+    std::ostringstream source;
+    source << "precision highp float;\n\n";
+
+    for (const auto& name : m_uniforms)
+    {
+        source << "uniform float " << UniformName(name) << ";\n";
+    }
+
+    source << HelperFunctions << "\n";
+
+    source << "void " << functionName << "(";
+    bool firstParameter = true;
+    for (const auto& name : inputs)
+    {
+        source << (firstParameter ? "" : ", ") << "float " << LocalName(name);
+        firstParameter = false;
+    }
+    for (const auto& name : outputs)
+    {
+        source << (firstParameter ? "" : ", ") << "out float " << LocalName(name);
+        firstParameter = false;
+    }
+    source << ")\n{\n";
+
+    for (const auto& name : outputs)
+    {
+        source << "    " << LocalName(name) << " = " << UniformName(name) << ";\n";
+    }
+    for (const auto& name : m_locals)
+    {
+        if (Contains(inputs, name) || Contains(outputs, name))
+        {
+            continue;
+        }
+        source << "    float " << LocalName(name) << " = " << (Contains(m_uniforms, name) ? UniformName(name) : "0.0") << ";\n";
+    }
+
+    source << statements << "}\n";
+
+    m_source = source.str();
+}
+
+auto GlslTranslator::IsValid() const -> bool
+{
+    return !m_source.empty();
+}
+
+auto GlslTranslator::Source() const -> const std::string&
+{
+    return m_source;
+}
+
+auto GlslTranslator::Uniforms() const -> const std::vector<std::string>&
+{
+    return m_uniforms;
+}
+
+auto GlslTranslator::UniformName(const std::string& variable) -> std::string
+{
+    return "u_" + variable;
+}
+
+auto GlslTranslator::Translate(const ExpressionNode& node, std::string& expression) -> bool
+{
+    std::vector<std::string> arguments(node.arguments.size());
+    for (size_t index = 0; index < node.arguments.size(); index++)
+    {
+        if (!Translate(*node.arguments[index], arguments[index]))
+        {
+            return false;
+        }
+    }
+
+    auto binary = [&arguments](const char* op) {
+        return "(" + arguments[0] + " " + op + " " + arguments[1] + ")";
+    };
+    auto comparison = [&arguments](const char* op) {
+        return "(" + arguments[0] + " " + op + " " + arguments[1] + " ? 1.0 : 0.0)";
+    };
+    auto function = [&arguments](const char* name) {
+        std::string call = std::string(name) + "(";
+        for (size_t index = 0; index < arguments.size(); index++)
+        {
+            call += (index > 0 ? ", " : "") + arguments[index];
+        }
+        return call + ")";
+    };
+
+    switch (node.operation)
+    {
+        case ExpressionOperation::Constant: {
+            if (!std::isfinite(node.value) || std::fabs(node.value) > FLT_MAX)
+            {
+                return false;
+            }
+
+            // Always use a period as decimal separator, regardless of the user locale.
+            std::ostringstream literal;
+            literal.imbue(std::locale::classic());
+            literal << std::scientific << std::setprecision(9) << static_cast<float>(node.value);
+            expression = literal.str();
+            return true;
+        }
+
+        case ExpressionOperation::Variable:
+            expression = LocalName(node.name);
+            return true;
+
+        case ExpressionOperation::Assign:
+            expression = "(" + LocalName(node.name) + " = " + arguments[0] + ")";
+            return true;
+
+        case ExpressionOperation::Sequence:
+            expression = function("");
+            return true;
+
+        case ExpressionOperation::Negate:
+            expression = "(-" + arguments[0] + ")";
+            return true;
+
+        case ExpressionOperation::Not:
+            expression = "(pp_bool(" + arguments[0] + ") ? 0.0 : 1.0)";
+            return true;
+
+        case ExpressionOperation::Add:
+            expression = binary("+");
+            return true;
+        case ExpressionOperation::Subtract:
+            expression = binary("-");
+            return true;
+        case ExpressionOperation::Multiply:
+            expression = binary("*");
+            return true;
+        case ExpressionOperation::Divide:
+            expression = function("pp_div");
+            return true;
+        case ExpressionOperation::Modulo:
+            expression = function("pp_mod");
+            return true;
+        case ExpressionOperation::Power:
+            expression = function("pp_pow");
+            return true;
+
+        case ExpressionOperation::Equal:
+            expression = "(abs(" + arguments[0] + " - " + arguments[1] + ") < 0.00001 ? 1.0 : 0.0)";
+            return true;
+        case ExpressionOperation::NotEqual:
+            expression = "(abs(" + arguments[0] + " - " + arguments[1] + ") < 0.00001 ? 0.0 : 1.0)";
+            return true;
+        case ExpressionOperation::ExactEqual:
+            expression = comparison("==");
+            return true;
+        case ExpressionOperation::ExactNotEqual:
+            expression = comparison("!=");
+            return true;
+        case ExpressionOperation::Less:
+            expression = comparison("<");
+            return true;
+        case ExpressionOperation::Greater:
+            expression = comparison(">");
+            return true;
+        case ExpressionOperation::LessEqual:
+            expression = comparison("<=");
+            return true;
+        case ExpressionOperation::GreaterEqual:
+            expression = comparison(">=");
+            return true;
+
+        // GLSL evaluates the right-hand side and the if() branches lazily, same as the expression library.
+        case ExpressionOperation::And:
+            expression = "((pp_bool(" + arguments[0] + ") && pp_bool(" + arguments[1] + ")) ? 1.0 : 0.0)";
+            return true;
+        case ExpressionOperation::Or:
+            expression = "((pp_bool(" + arguments[0] + ") || pp_bool(" + arguments[1] + ")) ? 1.0 : 0.0)";
+            return true;
+        case ExpressionOperation::If:
+            expression = "(pp_bool(" + arguments[0] + ") ? " + arguments[1] + " : " + arguments[2] + ")";
+            return true;
+
+        case ExpressionOperation::Sin:
+            expression = function("sin");
+            return true;
+        case ExpressionOperation::Cos:
+            expression = function("cos");
+            return true;
+        case ExpressionOperation::Tan:
+            expression = function("tan");
+            return true;
+        case ExpressionOperation::Asin:
+            expression = function("pp_asin");
+            return true;
+        case ExpressionOperation::Acos:
+            expression = function("pp_acos");
+            return true;
+        case ExpressionOperation::Atan:
+            expression = function("atan");
+            return true;
+        case ExpressionOperation::Atan2:
+            expression = function("pp_atan2");
+            return true;
+        case ExpressionOperation::Sqr:
+            expression = function("pp_sqr");
+            return true;
+        case ExpressionOperation::Sqrt:
+            expression = "sqrt(abs(" + arguments[0] + "))";
+            return true;
+        case ExpressionOperation::Exp:
+            expression = function("pp_exp");
+            return true;
+        case ExpressionOperation::Log:
+            expression = function("pp_log");
+            return true;
+        case ExpressionOperation::Log10:
+            expression = function("pp_log10");
+            return true;
+        case ExpressionOperation::Abs:
+            expression = function("abs");
+            return true;
+        case ExpressionOperation::Sign:
+            expression = function("sign");
+            return true;
+        case ExpressionOperation::Min:
+            expression = function("min");
+            return true;
+        case ExpressionOperation::Max:
+            expression = function("max");
+            return true;
+        case ExpressionOperation::Floor:
+            expression = function("floor");
+            return true;
+        case ExpressionOperation::Ceil:
+            expression = function("ceil");
+            return true;
+    }
+
+    return false;
+}
+
+auto GlslTranslator::CollectVariables(const ExpressionNode& node) -> bool
+{
+    if (node.operation == ExpressionOperation::Variable || node.operation == ExpressionOperation::Assign)
+    {
+        if (!IsValidName(node.name))
+        {
+            return false;
+        }
+
+        AddUnique(m_locals, node.name);
+        if (node.operation == ExpressionOperation::Variable)
+        {
+            AddUnique(m_read, node.name);
+        }
+    }
+
+    for (const auto& argument : node.arguments)
+    {
+        if (!CollectVariables(*argument))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+} // namespace MilkdropPreset
+} // namespace libprojectM
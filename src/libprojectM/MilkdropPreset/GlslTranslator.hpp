@@ -0,0 +1,90 @@
+#pragma once
+
+#include "ExpressionTree.hpp"
+
+#include <string>
+#include <vector>
+
+namespace libprojectM {
+namespace MilkdropPreset {
+
+/**
+ * @brief Translates parsed expression code into a GLSL function.
+ *
+ * The generated function has one float parameter for each input variable, followed by one
+ * "out float" parameter for each output variable, in the order given to the constructor. The
+ * outputs are initialized from uniforms before the code runs. All other variables the code may
+ * read before assigning them are also passed in as uniforms, which the host sets to the current
+ * variable values of the expression context. Uniforms are named UniformName(variable).
+ *
+ * The expression semantics match BatchEvaluator, e.g. division by zero returns 0 and if()
+ * only evaluates the selected branch. Builtins which GLSL leaves undefined outside of their
+ * domain, e.g. asin(), log(), pow() and integer conversions, are wrapped in helper functions
+ * returning the same NaN, infinity or integer results as the CPU. As GLSL only provides single
+ * precision, results will still differ slightly from the double precision evaluation on the CPU,
+ * so callers must check the results, see PerPixelEquationsValidator.
+ *
+ * Translation fails if the code uses variable names or constants which can't be represented
+ * in GLSL.
+ */
+class GlslTranslator
+{
+public:
+    /**
+     * @brief Translates the given expression tree.
+     * @param root The root node of the parsed code.
+     * @param functionName The name of the generated GLSL function.
+     * @param inputs Lower-case names of the variables passed in as function parameters.
+     * @param outputs Lower-case names of the variables returned as out parameters.
+     */
+    GlslTranslator(const ExpressionNode& root,
+                   const std::string& functionName,
+                   const std::vector<std::string>& inputs,
+                   const std::vector<std::string>& outputs);
+
+    /**
+     * @brief Returns whether the code was translated successfully.
+     * @return True if the code was translated, false if not.
+     */
+    auto IsValid() const -> bool;
+
+    /**
+     * @brief Returns the generated GLSL source, containing the uniform declarations, helper functions and the function definition.
+     * @return The GLSL source, or an empty string if the translation failed.
+     */
+    auto Source() const -> const std::string&;
+
+    /**
+     * @brief Returns the variables passed in as uniforms, including the outputs.
+     * @return The lower-case variable names.
+     */
+    auto Uniforms() const -> const std::vector<std::string>&;
+
+    /**
+     * @brief Returns the GLSL uniform name for a variable.
+     * @param variable The lower-case variable name.
+     * @return The uniform name.
+     */
+    static auto UniformName(const std::string& variable) -> std::string;
+
+private:
+    /**
+     * Translates a node into a GLSL float expression.
+     * @return False if the node can't be translated.
+     */
+    auto Translate(const ExpressionNode& node, std::string& expression) -> bool;
+
+    /**
+     * Adds all variable names to m_locals and the names of all read variables to m_read.
+     * @return False if a name can't be used in GLSL.
+     */
+    auto CollectVariables(const ExpressionNode& node) -> bool;
+
+    std::string m_source;                //!< The generated GLSL source.
+    std::vector<std::string> m_uniforms; //!< Variables passed in as uniforms.
+    std::vector<std::string> m_locals;   //!< Variables declared as local variables in the function.
+    std::vector<std::string> m_read;     //!< Variables read by the currently analyzed statement.
+};
+
+} // namespace MilkdropPreset
+} // namespace libprojectM
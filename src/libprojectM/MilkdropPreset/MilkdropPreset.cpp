@@ -24,6 +24,9 @@
 #include "Factory.hpp"
 #include "MilkdropPresetExceptions.hpp"
 #include "PresetFileParser.hpp"
+#include "WorkerPool.hpp"
+
+#include <algorithm>
 
 #ifdef MILKDROP_PRESET_DEBUG
 #include <iostream>
@@ -55,13 +58,30 @@ MilkdropPreset::MilkdropPreset(std::istream& presetData)
     Load(presetData);
 }
 
+MilkdropPreset::MilkdropPreset(PresetFileParser& parsedFile, const std::string& absoluteFilePath)
+    : m_absoluteFilePath(absoluteFilePath)
+    , m_perFrameContext(m_state.globalMemory, &m_state.globalRegisters)
+    , m_perPixelContext(m_state.globalMemory, &m_state.globalRegisters)
+    , m_motionVectors(m_state)
+    , m_waveform(m_state)
+    , m_darkenCenter(m_state)
+    , m_border(m_state)
+{
+    SetFilename(ParseFilename(absoluteFilePath));
+    InitializePreset(parsedFile);
+}
+
 void MilkdropPreset::Initialize(const Renderer::RenderContext& renderContext)
 {
     assert(renderContext.textureManager);
     m_state.renderContext = renderContext;
 
-    // Initialize variables and code now we have a proper render state.
-    CompileCodeAndRunInitExpressions();
+    // Initialize variables and code now we have a proper render state, unless CompileCode() already did.
+    if (!m_codeCompiled)
+    {
+        CompileCodeAndRunInitExpressions();
+    }
+    m_codeCompiled = false;
 
     // Update framebuffer and texture sizes if needed
     m_framebuffer.SetSize(renderContext.viewportSizeX, renderContext.viewportSizeY);
@@ -71,14 +91,65 @@ void MilkdropPreset::Initialize(const Renderer::RenderContext& renderContext)
         m_state.mainTexture = m_framebuffer.GetColorAttachmentTexture(1, 0);
     }
 
-    m_perPixelMesh.CompileWarpShader(m_state);
+    m_perPixelMesh.CompileWarpShader(m_state, m_perPixelContext);
     m_finalComposite.CompileCompositeShader(m_state);
 }
 
-void MilkdropPreset::RenderFrame(const libprojectM::Audio::FrameAudioData& audioData, const Renderer::RenderContext& renderContext)
+void MilkdropPreset::CompileCode(const Renderer::RenderContext& renderContext)
+{
+    m_state.renderContext = renderContext;
+
+    CompileCodeAndRunInitExpressions();
+    m_codeCompiled = true;
+}
+
+void MilkdropPreset::LoadShaderTextures(const Renderer::RenderContext& renderContext)
+{
+    assert(renderContext.textureManager);
+    m_state.renderContext = renderContext;
+
+    // The main texture is replaced when the framebuffer is resized in Initialize(), but the shaders
+    // only need it to declare the sampler.
+    if (m_state.mainTexture.expired())
+    {
+        m_state.mainTexture = m_framebuffer.GetColorAttachmentTexture(1, 0);
+    }
+
+    m_perPixelMesh.LoadWarpShaderTextures(m_state);
+    m_finalComposite.LoadCompositeShaderTextures(m_state);
+    m_texturesLoaded = true;
+}
+
+void MilkdropPreset::TranspileShaders()
+{
+    if (!m_texturesLoaded || m_shadersTranspiled)
+    {
+        return;
+    }
+
+    m_perPixelMesh.TranspileWarpShader(m_state);
+    m_finalComposite.TranspileCompositeShader(m_state);
+    m_shadersTranspiled = true;
+}
+
+auto MilkdropPreset::StartCompilingShaders() -> std::vector<Renderer::ShaderCache::ProgramPtr>
+{
+    std::vector<Renderer::ShaderCache::ProgramPtr> programs;
+    for (auto& program : {m_perPixelMesh.StartCompilingWarpShader(), m_finalComposite.StartCompilingCompositeShader()})
+    {
+        if (program)
+        {
+            programs.push_back(program);
+        }
+    }
+    return programs;
+}
+
+void MilkdropPreset::RenderFrame(const libprojectM::Audio::FrameAudioData::Ptr& audioData, const Renderer::RenderContext& renderContext)
 {
     m_state.audioData = audioData;
     m_state.renderContext = renderContext;
+    m_state.expressionWatchdog.StartFrame(renderContext.expressionDeadline);
 
     // Update framebuffer and u/v texture size if needed
     if (m_framebuffer.SetSize(renderContext.viewportSizeX, renderContext.viewportSizeY))
@@ -92,6 +163,12 @@ void MilkdropPreset::RenderFrame(const libprojectM::Audio::FrameAudioData& audio
     // First evaluate per-frame code
     PerFrameUpdate();
 
+    // The constants of the warp and composite shaders only depend on the per-frame values.
+    if (m_state.warpShaderVersion > 0 || m_state.compositeShaderVersion > 0)
+    {
+        m_state.shaderConstants.Update(m_state, m_perFrameContext);
+    }
+
     glViewport(0, 0, renderContext.viewportSizeX, renderContext.viewportSizeY);
 
     m_framebuffer.Bind(m_previousFrameBuffer);
@@ -130,9 +207,10 @@ void MilkdropPreset::RenderFrame(const libprojectM::Audio::FrameAudioData& audio
     {
         shape->Draw();
     }
+    EvaluateCustomWaveforms();
     for (auto& wave : m_customWaveforms)
     {
-        wave->Draw(m_perFrameContext);
+        wave->Draw();
     }
     m_waveform.Draw(m_perFrameContext);
 
@@ -153,7 +231,7 @@ void MilkdropPreset::RenderFrame(const libprojectM::Audio::FrameAudioData& audio
     m_framebuffer.BindRead(m_currentFrameBuffer);
     m_framebuffer.BindDraw(m_previousFrameBuffer);
 
-    m_finalComposite.Draw(m_state, m_perFrameContext);
+    m_finalComposite.Draw(m_state);
 
     // ToDo: Draw user sprites (can have evaluated code)
 
@@ -183,12 +261,21 @@ void MilkdropPreset::DrawInitialImage(const std::shared_ptr<Renderer::Texture>&
     m_flipTexture.Draw(image, m_framebuffer, m_previousFrameBuffer);
 }
 
+auto MilkdropPreset::ExpressionTimeBudgetExceeded() const -> bool
+{
+    return m_state.expressionWatchdog.Expired();
+}
+
 void MilkdropPreset::PerFrameUpdate()
 {
     m_perFrameContext.LoadStateVariables(m_state);
     m_perPixelContext.LoadStateReadOnlyVariables(m_state, m_perFrameContext);
 
-    m_perFrameContext.ExecutePerFrameCode();
+    // Once the expression time budget is used up, the preset is drawn with its initial per-frame values.
+    if (!m_state.expressionWatchdog.CheckExpired())
+    {
+        m_perFrameContext.ExecutePerFrameCode(m_state.expressionWatchdog);
+    }
 
     m_perPixelContext.LoadPerFrameQVariables(m_state, m_perFrameContext);
 
@@ -197,6 +284,30 @@ void MilkdropPreset::PerFrameUpdate()
     *m_perFrameContext.echo_zoom = std::max(0.001, std::min(1000.0, *m_perFrameContext.echo_zoom));
 }
 
+void MilkdropPreset::EvaluateCustomWaveforms()
+{
+    // Waves sharing state through memory buffers, global registers or random numbers must be
+    // evaluated in order to give the same result. The OpenGL calls always stay on this thread.
+    auto& workerPool = WorkerPool::Instance();
+    bool const concurrent = workerPool.Concurrency() > 1 &&
+                            std::all_of(m_customWaveforms.begin(), m_customWaveforms.end(), [](const std::unique_ptr<CustomWaveform>& wave) {
+                                return wave->CanEvaluateConcurrently();
+                            });
+
+    if (!concurrent)
+    {
+        for (auto& wave : m_customWaveforms)
+        {
+            wave->Evaluate(m_perFrameContext);
+        }
+        return;
+    }
+
+    workerPool.ParallelFor(m_customWaveforms.size(), [this](size_t task, size_t) {
+        m_customWaveforms[task]->Evaluate(m_perFrameContext);
+    });
+}
+
 void MilkdropPreset::Load(const std::string& pathname)
 {
 #ifdef MILKDROP_PRESET_DEBUG
@@ -68,27 +68,49 @@ public:
      */
     MilkdropPreset(std::istream& presetData);
 
+    /**
+     * @brief Creates a MilkdropPreset from an already parsed preset file.
+     * @param parsedFile The parsed preset file.
+     * @param absoluteFilePath The file path the preset was read from, used to set the filename. Can be empty.
+     */
+    MilkdropPreset(PresetFileParser& parsedFile, const std::string& absoluteFilePath);
+
     /**
      * @brief Initializes the preset with rendering-related data.
      * @param renderContext The initial render context.
      */
     void Initialize(const Renderer::RenderContext& renderContext) override;
 
+    void CompileCode(const Renderer::RenderContext& renderContext) override;
+
+    void LoadShaderTextures(const Renderer::RenderContext& renderContext) override;
+
+    void TranspileShaders() override;
+
+    auto StartCompilingShaders() -> std::vector<Renderer::ShaderCache::ProgramPtr> override;
+
     /**
      * @brief Renders the preset.
-     * @param audioData The frame audio data.
+     * @param audioData The shared frame audio data snapshot.
      * @param renderContext The current rendering context/information.
      */
-    void RenderFrame(const libprojectM::Audio::FrameAudioData& audioData,
+    void RenderFrame(const libprojectM::Audio::FrameAudioData::Ptr& audioData,
                      const Renderer::RenderContext& renderContext) override;
 
     auto OutputTexture() const -> std::shared_ptr<Renderer::Texture> override;
 
     void DrawInitialImage(const std::shared_ptr<Renderer::Texture>& image, const Renderer::RenderContext& renderContext) override;
 
+    auto ExpressionTimeBudgetExceeded() const -> bool override;
+
 private:
     void PerFrameUpdate();
 
+    /**
+     * @brief Runs the code of all custom waveforms, concurrently if none of them uses shared state.
+     */
+    void EvaluateCustomWaveforms();
+
     void Load(const std::string& pathname);
 
     void Load(std::istream& stream);
@@ -128,7 +150,10 @@ private:
 
     FinalComposite m_finalComposite; //!< Final composite shader or filters.
 
-    bool m_isFirstFrame{true}; //!< Controls drawing the motion vectors starting with the second frame.
+    bool m_isFirstFrame{true};       //!< Controls drawing the motion vectors starting with the second frame.
+    bool m_codeCompiled{false};      //!< True if CompileCode() ran since the last Initialize() call.
+    bool m_texturesLoaded{false};    //!< True if LoadShaderTextures() was called.
+    bool m_shadersTranspiled{false}; //!< True if TranspileShaders() translated the shaders.
 };
 
 } // namespace MilkdropPreset
@@ -1,6 +1,6 @@
 #include "MilkdropShader.hpp"
 
-#include "PerFrameContext.hpp"
+#include "PresetShaderConstants.hpp"
 #include "PresetState.hpp"
 #include "Utils.hpp"
 
@@ -9,9 +9,6 @@
 #include <GLSLGenerator.h>
 #include <HLSLParser.h>
 
-#include <glm/gtc/matrix_transform.hpp>
-#include <glm/mat4x4.hpp>
-
 #include <algorithm>
 #include <regex>
 #include <set>
@@ -21,31 +18,9 @@ namespace MilkdropPreset {
 
 using libprojectM::MilkdropPreset::MilkdropStaticShaders;
 
-static auto floatRand = []() { return static_cast<float>(rand() % 7381) / 7380.0f; };
-
 MilkdropShader::MilkdropShader(ShaderType type)
     : m_type(type)
-    , m_randValues({floatRand(), floatRand(), floatRand(), floatRand()})
 {
-    unsigned int index = 0;
-    do
-    {
-        for (int i = 0; i < 4; i++)
-        {
-            float const m_randTranslationMult = 1;
-            float const rotMult = 0.9f * powf(index / 8.0f, 3.2f);
-            m_randTranslation[index].x = (floatRand() * 2 - 1) * m_randTranslationMult;
-            m_randTranslation[index].y = (floatRand() * 2 - 1) * m_randTranslationMult;
-            m_randTranslation[index].z = (floatRand() * 2 - 1) * m_randTranslationMult;
-            m_randRotationCenters[index].x = floatRand() * 6.28f;
-            m_randRotationCenters[index].y = floatRand() * 6.28f;
-            m_randRotationCenters[index].z = floatRand() * 6.28f;
-            m_randRotationSpeeds[index].x = (floatRand() * 2 - 1) * rotMult;
-            m_randRotationSpeeds[index].y = (floatRand() * 2 - 1) * rotMult;
-            m_randRotationSpeeds[index].z = (floatRand() * 2 - 1) * rotMult;
-            index++;
-        }
-    } while (index < sizeof(m_randTranslation) / sizeof(m_randTranslation[0]));
 }
 
 void MilkdropShader::LoadCode(const std::string& presetShaderCode)
@@ -59,6 +34,22 @@ void MilkdropShader::LoadCode(const std::string& presetShaderCode)
 
 void MilkdropShader::LoadTexturesAndCompile(PresetState& presetState)
 {
+    LoadTextures(presetState);
+    if (m_transpiledCode.empty())
+    {
+        Transpile(presetState);
+    }
+    Compile(presetState);
+}
+
+void MilkdropShader::LoadTextures(PresetState& presetState)
+{
+    if (m_texturesLoaded)
+    {
+        return;
+    }
+    m_texturesLoaded = true;
+
     std::locale loc;
 
     // Now request the textures and descriptors from the texture manager.
@@ -140,168 +131,66 @@ void MilkdropShader::LoadTexturesAndCompile(PresetState& presetState)
         m_textureSamplerDescriptors.push_back(std::move(desc));
     }
 
+    // Prefetched presets may be displayed several preset switches later, after the texture manager purged the textures.
+    for (const auto& desc : m_textureSamplerDescriptors)
+    {
+        auto texture = desc.Texture();
+        if (texture)
+        {
+            m_textures.push_back(std::move(texture));
+        }
+    }
+}
+
+void MilkdropShader::Transpile(const PresetState& presetState)
+{
     // Now that we have the textures, transpile the code.
     TranspileHLSLShader(presetState, m_preprocessedCode);
+}
+
+auto MilkdropShader::StartCompile() const -> Renderer::ShaderCache::ProgramPtr
+{
+    if (m_transpiledCode.empty())
+    {
+        return {};
+    }
+
+    return Renderer::Shader::StartCompileProgram(StandardVertexShader(), m_transpiledCode);
+}
+
+void MilkdropShader::Compile(PresetState& presetState)
+{
+    // Compile the preset shader fragment shader with the standard vertex shader and cross our fingers.
+    CompileWithVertexShader(StandardVertexShader());
 
     // Update blur texture level if shader was compiled successfully.
     presetState.blurTexture.SetRequiredBlurLevel(m_maxBlurLevelRequired);
 }
 
-void MilkdropShader::LoadVariables(const PresetState& presetState, const PerFrameContext& perFrameContext)
+auto MilkdropShader::StandardVertexShader() const -> std::string
 {
-    // These are the inputs: http://www.geisswerks.com/milkdrop/milkdrop_preset_authoring.html#3f6
+    if (m_type == ShaderType::WarpShader)
+    {
+        return MilkdropStaticShaders::Get()->GetPresetWarpVertexShader();
+    }
 
-    auto floatTime = static_cast<float>(presetState.renderContext.time);
-    auto timeSincePresetStartWrapped = floatTime - static_cast<int>(floatTime / 10000.0) * 10000;
-    auto mipX = logf(static_cast<float>(presetState.renderContext.viewportSizeX)) / logf(2.0f);
-    auto mipY = logf(static_cast<float>(presetState.renderContext.viewportSizeY)) / logf(2.0f);
-    auto mipAvg = 0.5f * (mipX + mipY);
+    return MilkdropStaticShaders::Get()->GetPresetCompVertexShader();
+}
 
-    BlurTexture::Values blurMin;
-    BlurTexture::Values blurMax;
-    BlurTexture::GetSafeBlurMinMaxValues(perFrameContext, blurMin, blurMax);
+void MilkdropShader::CompileWithVertexShader(const std::string& vertexShaderSource)
+{
+    m_shader.CompileProgram(vertexShaderSource, m_transpiledCode);
+    m_shader.SetUniformBlockBinding(PresetShaderConstants::BlockName, PresetShaderConstants::BindingPoint);
+}
 
+void MilkdropShader::LoadVariables(const PresetState& presetState)
+{
     m_shader.Bind();
 
     m_shader.SetUniformMat4x4("vertex_transformation", PresetState::orthogonalProjection);
 
-    m_shader.SetUniformFloat4("rand_frame", {floatRand(),
-                                             floatRand(),
-                                             floatRand(),
-                                             floatRand()});
-    m_shader.SetUniformFloat4("rand_preset", {m_randValues[0],
-                                              m_randValues[1],
-                                              m_randValues[2],
-                                              m_randValues[3]});
-
-    m_shader.SetUniformFloat4("_c0", {presetState.renderContext.aspectX,
-                                      presetState.renderContext.aspectY,
-                                      1.0f / presetState.renderContext.aspectX,
-                                      1.0f / presetState.renderContext.aspectY});
-    m_shader.SetUniformFloat4("_c1", {0.0,
-                                      0.0,
-                                      0.0,
-                                      0.0});
-    m_shader.SetUniformFloat4("_c2", {timeSincePresetStartWrapped,
-                                      presetState.renderContext.fps,
-                                      presetState.renderContext.frame,
-                                      presetState.renderContext.progress});
-    m_shader.SetUniformFloat4("_c3", {presetState.audioData.bass / 100,
-                                      presetState.audioData.mid / 100,
-                                      presetState.audioData.treb / 100,
-                                      presetState.audioData.vol / 100});
-    m_shader.SetUniformFloat4("_c4", {presetState.audioData.bassAtt / 100,
-                                      presetState.audioData.midAtt / 100,
-                                      presetState.audioData.trebAtt / 100,
-                                      presetState.audioData.volAtt / 100});
-    m_shader.SetUniformFloat4("_c5", {blurMax[0] - blurMin[0],
-                                      blurMin[0],
-                                      blurMax[1] - blurMin[1],
-                                      blurMin[1]});
-    m_shader.SetUniformFloat4("_c6", {blurMax[2] - blurMin[2],
-                                      blurMin[2],
-                                      blurMin[0],
-                                      blurMax[0]});
-    m_shader.SetUniformFloat4("_c7", {presetState.renderContext.viewportSizeX,
-                                      presetState.renderContext.viewportSizeY,
-                                      1.0f / static_cast<float>(presetState.renderContext.viewportSizeX),
-                                      1.0f / static_cast<float>(presetState.renderContext.viewportSizeY)});
-
-    m_shader.SetUniformFloat4("_c8", {0.5f + 0.5f * cosf(floatTime * 0.329f + 1.2f),
-                                      0.5f + 0.5f * cosf(floatTime * 1.293f + 3.9f),
-                                      0.5f + 0.5f * cosf(floatTime * 5.070f + 2.5f),
-                                      0.5f + 0.5f * cosf(floatTime * 20.051f + 5.4f)});
-
-    m_shader.SetUniformFloat4("_c9", {0.5f + 0.5f * sinf(floatTime * 0.329f + 1.2f),
-                                      0.5f + 0.5f * sinf(floatTime * 1.293f + 3.9f),
-                                      0.5f + 0.5f * sinf(floatTime * 5.070f + 2.5f),
-                                      0.5f + 0.5f * sinf(floatTime * 20.051f + 5.4f)});
-
-    m_shader.SetUniformFloat4("_c10", {0.5f + 0.5f * cosf(floatTime * 0.0050f + 2.7f),
-                                       0.5f + 0.5f * cosf(floatTime * 0.0085f + 5.3f),
-                                       0.5f + 0.5f * cosf(floatTime * 0.0133f + 4.5f),
-                                       0.5f + 0.5f * cosf(floatTime * 0.0217f + 3.8f)});
-
-    m_shader.SetUniformFloat4("_c11", {0.5f + 0.5f * sinf(floatTime * 0.0050f + 2.7f),
-                                       0.5f + 0.5f * sinf(floatTime * 0.0085f + 5.3f),
-                                       0.5f + 0.5f * sinf(floatTime * 0.0133f + 4.5f),
-                                       0.5f + 0.5f * sinf(floatTime * 0.0217f + 3.8f)});
-
-    m_shader.SetUniformFloat4("_c12", {mipX,
-                                       mipY,
-                                       mipAvg,
-                                       0});
-    m_shader.SetUniformFloat4("_c13", {blurMin[1],
-                                       blurMax[1],
-                                       blurMin[2],
-                                       blurMax[2]});
-
-
-    std::array<glm::mat4, 24> tempMatrices{};
-
-    // write matrices
-    for (int i = 0; i < 20; i++)
-    {
-        glm::mat4 const rotationX = glm::rotate(glm::mat4(1.0f), m_randRotationCenters[i].x + m_randRotationSpeeds[i].x * floatTime, glm::vec3(1.0f, 0.0f, 0.0f));
-        glm::mat4 const rotationY = glm::rotate(glm::mat4(1.0f), m_randRotationCenters[i].y + m_randRotationSpeeds[i].y * floatTime, glm::vec3(0.0f, 1.0f, 0.0f));
-        glm::mat4 const rotationZ = glm::rotate(glm::mat4(1.0f), m_randRotationCenters[i].z + m_randRotationSpeeds[i].z * floatTime, glm::vec3(0.0f, 0.0f, 1.0f));
-
-        glm::mat4 const randomTranslation = glm::translate(glm::mat4(1.0f), glm::vec3(m_randTranslation[i].x, m_randTranslation[i].y, m_randTranslation[i].z));
-
-        tempMatrices[i] = randomTranslation * rotationX;
-        tempMatrices[i] = rotationZ * tempMatrices[i];
-        tempMatrices[i] = rotationY * tempMatrices[i];
-    }
-
-    // the last 4 are totally random, each frame
-    for (int i = 20; i < 24; i++)
-    {
-        glm::mat4 const rotationX = glm::rotate(glm::mat4(1.0f), floatRand() * 6.28f, glm::vec3(1.0f, 0.0f, 0.0f));
-        glm::mat4 const rotationY = glm::rotate(glm::mat4(1.0f), floatRand() * 6.28f, glm::vec3(0.0f, 1.0f, 0.0f));
-        glm::mat4 const rotationZ = glm::rotate(glm::mat4(1.0f), floatRand() * 6.28f, glm::vec3(0.0f, 0.0f, 1.0f));
-
-        glm::mat4 const randomTranslation = glm::translate(glm::mat4(1.0f), glm::vec3(floatRand(), floatRand(), floatRand()));
-
-        tempMatrices[i] = randomTranslation * rotationX;
-        tempMatrices[i] = rotationZ * tempMatrices[i];
-        tempMatrices[i] = rotationY * tempMatrices[i];
-    }
-
-    m_shader.SetUniformMat3x4("rot_s1", tempMatrices[0]);
-    m_shader.SetUniformMat3x4("rot_s2", tempMatrices[1]);
-    m_shader.SetUniformMat3x4("rot_s3", tempMatrices[2]);
-    m_shader.SetUniformMat3x4("rot_s4", tempMatrices[3]);
-    m_shader.SetUniformMat3x4("rot_d1", tempMatrices[4]);
-    m_shader.SetUniformMat3x4("rot_d2", tempMatrices[5]);
-    m_shader.SetUniformMat3x4("rot_d3", tempMatrices[6]);
-    m_shader.SetUniformMat3x4("rot_d4", tempMatrices[7]);
-    m_shader.SetUniformMat3x4("rot_f1", tempMatrices[8]);
-    m_shader.SetUniformMat3x4("rot_f2", tempMatrices[9]);
-    m_shader.SetUniformMat3x4("rot_f3", tempMatrices[10]);
-    m_shader.SetUniformMat3x4("rot_f4", tempMatrices[11]);
-    m_shader.SetUniformMat3x4("rot_vf1", tempMatrices[12]);
-    m_shader.SetUniformMat3x4("rot_vf2", tempMatrices[13]);
-    m_shader.SetUniformMat3x4("rot_vf3", tempMatrices[14]);
-    m_shader.SetUniformMat3x4("rot_vf4", tempMatrices[15]);
-    m_shader.SetUniformMat3x4("rot_uf1", tempMatrices[16]);
-    m_shader.SetUniformMat3x4("rot_uf2", tempMatrices[17]);
-    m_shader.SetUniformMat3x4("rot_uf3", tempMatrices[18]);
-    m_shader.SetUniformMat3x4("rot_uf4", tempMatrices[19]);
-    m_shader.SetUniformMat3x4("rot_rand1", tempMatrices[20]);
-    m_shader.SetUniformMat3x4("rot_rand2", tempMatrices[21]);
-    m_shader.SetUniformMat3x4("rot_rand3", tempMatrices[22]);
-    m_shader.SetUniformMat3x4("rot_rand4", tempMatrices[23]);
-
-    // set program uniform "_q[a-h]" values (_qa.x, _qa.y, _qa.z, _qa.w, _qb.x, _qb.y ... ) alias q[1-32]
-    for (int i = 0; i < QVarCount; i += 4)
-    {
-        std::string varName = "_q";
-        varName.push_back(static_cast<char>('a' + i / 4));
-        m_shader.SetUniformFloat4(varName.c_str(), {presetState.frameQVariables[i],
-                                                    presetState.frameQVariables[i + 1],
-                                                    presetState.frameQVariables[i + 2],
-                                                    presetState.frameQVariables[i + 3]});
-    }
+    // The Milkdrop constants are stored in a uniform buffer, updated once per frame.
+    presetState.shaderConstants.Bind();
 
     // Bind all texture and sampler descriptors. This includes the main and blur textures.
     GLint textureUnit{0};
@@ -645,15 +534,7 @@ void MilkdropShader::TranspileHLSLShader(const PresetState& presetState, std::st
     }
 
     // Now we have GLSL source for the preset shader program (hopefully it's valid!)
-    // Compile the preset shader fragment shader with the standard vertex shader and cross our fingers.
-    if (m_type == ShaderType::WarpShader)
-    {
-        m_shader.CompileProgram(MilkdropStaticShaders::Get()->GetPresetWarpVertexShader(), generator.GetResult());
-    }
-    else
-    {
-        m_shader.CompileProgram(MilkdropStaticShaders::Get()->GetPresetCompVertexShader(), generator.GetResult());
-    }
+    m_transpiledCode = generator.GetResult();
 }
 
 void MilkdropShader::UpdateMaxBlurLevel(BlurTexture::BlurLevel requestedLevel)
@@ -18,7 +18,6 @@
 namespace libprojectM {
 namespace MilkdropPreset {
 
-class PerFrameContext;
 class PresetState;
 
 /**
@@ -48,18 +47,48 @@ public:
 
     /**
      * @brief Loads the required texture references into the shader.
-     * Binds the underlying shader program.
+     * Binds the underlying shader program. Skips the steps already done by LoadTextures() and Transpile().
      * @param presetState The preset state to pull the values and textures from.
      */
     void LoadTexturesAndCompile(PresetState& presetState);
 
+    /**
+     * @brief Requests the textures referenced by the shader code from the texture manager.
+     * Must be called on the rendering thread. Does nothing if called before.
+     * @param presetState The preset state to pull the textures from.
+     */
+    void LoadTextures(PresetState& presetState);
+
+    /**
+     * @brief Translates the preset shader into GLSL without compiling it.
+     * Doesn't use OpenGL, so it can be called on a worker thread. Requires LoadTextures().
+     * @throws Renderer::ShaderException Thrown if the shader couldn't be translated.
+     * @param presetState The preset state to pull the blur textures from.
+     */
+    void Transpile(const PresetState& presetState);
+
+    /**
+     * @brief Starts compiling the transpiled code with the standard vertex shader in the background.
+     * Must be called on the rendering thread after Transpile(). See Renderer::Shader::StartCompileProgram().
+     * @return The program being compiled, or an empty pointer if not transpiled or not supported.
+     */
+    auto StartCompile() const -> Renderer::ShaderCache::ProgramPtr;
+
+    /**
+     * @brief Relinks the shader program using the already transpiled preset shader and another vertex shader.
+     * Must be called after LoadTexturesAndCompile().
+     * @throws Renderer::ShaderException Thrown if the vertex shader couldn't be compiled or linked.
+     * @param vertexShaderSource The GLSL vertex shader source, including the version header.
+     */
+    void CompileWithVertexShader(const std::string& vertexShaderSource);
+
     /**
      * @brief Loads all required shader variables into the uniforms.
-     * Binds the underlying shader program.
+     * Binds the underlying shader program and the PresetShaderConstants buffer, which must have
+     * been updated for the current frame.
      * @param presetState The preset state to pull the values from.
-     * @param perFrameContext The per-frame context with dynamically calculated values.
      */
-    void LoadVariables(const PresetState& presetState, const PerFrameContext& perFrameContext);
+    void LoadVariables(const PresetState& presetState);
 
     /**
      * @brief Returns the contained shader.
@@ -87,6 +116,18 @@ private:
      */
     void TranspileHLSLShader(const PresetState& presetState, std::string& program);
 
+    /**
+     * @brief Compiles and links the transpiled code with the standard vertex shader.
+     * @param presetState The preset state to update the required blur level in.
+     */
+    void Compile(PresetState& presetState);
+
+    /**
+     * @brief Returns the standard vertex shader for this shader type.
+     * @return The GLSL vertex shader source.
+     */
+    auto StandardVertexShader() const -> std::string;
+
     /**
      * @brief Updates the requested blur level if higher than before.
      * Also adds the required samplers.
@@ -97,17 +138,15 @@ private:
     ShaderType m_type{ShaderType::WarpShader}; //!< Type of this shader.
     std::string m_fragmentShaderCode;          //!< The original preset fragment shader code.
     std::string m_preprocessedCode;            //!< The preprocessed preset shader code.
+    std::string m_transpiledCode;              //!< The GLSL fragment shader code transpiled from the preset shader.
+    bool m_texturesLoaded{false};              //!< True once LoadTextures() was called.
 
     std::set<std::string> m_samplerNames;                                        //!< All sampler names referenced in the shader code.
     std::vector<Renderer::TextureSamplerDescriptor> m_mainTextureDescriptors;              //!< Descriptors for all main texture references.
     std::vector<Renderer::TextureSamplerDescriptor> m_textureSamplerDescriptors;           //!< Descriptors of all referenced samplers in the shader code.
+    std::vector<std::shared_ptr<Renderer::Texture>> m_textures;                  //!< Keeps the referenced textures alive, even if purged from the texture manager.
     BlurTexture::BlurLevel m_maxBlurLevelRequired{BlurTexture::BlurLevel::None}; //!< Max blur level of main texture required by this shader.
 
-    std::array<float, 4> m_randValues{};               //!< Random values which don't change every frame.
-    std::array<glm::vec3, 20> m_randTranslation{};     //!< Random translation vectors which don't change every frame.
-    std::array<glm::vec3, 20> m_randRotationCenters{}; //!< Random rotation center vectors which don't change every frame.
-    std::array<glm::vec3, 20> m_randRotationSpeeds{};  //!< Random rotation speeds which don't change every frame.
-
     Renderer::Shader m_shader;
 };
 
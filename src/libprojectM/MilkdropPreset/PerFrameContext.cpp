@@ -162,12 +162,12 @@ void PerFrameContext::LoadStateVariables(PresetState& state)
     *sy = static_cast<PRJM_EVAL_F>(state.stretchY);
     *time = static_cast<PRJM_EVAL_F>(state.renderContext.time);
     *fps = static_cast<PRJM_EVAL_F>(state.renderContext.fps);
-    *bass = static_cast<PRJM_EVAL_F>(state.audioData.bass);
-    *mid = static_cast<PRJM_EVAL_F>(state.audioData.mid);
-    *treb = static_cast<PRJM_EVAL_F>(state.audioData.treb);
-    *bass_att = static_cast<PRJM_EVAL_F>(state.audioData.bassAtt);
-    *mid_att = static_cast<PRJM_EVAL_F>(state.audioData.midAtt);
-    *treb_att = static_cast<PRJM_EVAL_F>(state.audioData.trebAtt);
+    *bass = static_cast<PRJM_EVAL_F>(state.audioData->Bass());
+    *mid = static_cast<PRJM_EVAL_F>(state.audioData->Mid());
+    *treb = static_cast<PRJM_EVAL_F>(state.audioData->Treb());
+    *bass_att = static_cast<PRJM_EVAL_F>(state.audioData->BassAtt());
+    *mid_att = static_cast<PRJM_EVAL_F>(state.audioData->MidAtt());
+    *treb_att = static_cast<PRJM_EVAL_F>(state.audioData->TrebAtt());
     *frame = static_cast<PRJM_EVAL_F>(state.renderContext.frame);
     for (int q = 0; q < QVarCount; q++)
     {
@@ -252,11 +252,17 @@ void PerFrameContext::CompilePerFrameCode(const std::string& perFrameCode)
 #endif
         throw MilkdropCompileException("Could not compile per-frame code");
     }
+
+    m_perFrameJit = ExpressionJit::Compile(perFrameCode, perFrameCodeContext);
 }
 
-void PerFrameContext::ExecutePerFrameCode()
+void PerFrameContext::ExecutePerFrameCode(const ExpressionWatchdog& watchdog)
 {
-    if (perFrameCodeHandle != nullptr)
+    if (m_perFrameJit)
+    {
+        m_perFrameJit->Execute(perFrameCodeHandle, *frame, watchdog);
+    }
+    else if (perFrameCodeHandle != nullptr)
     {
         projectm_eval_code_execute(perFrameCodeHandle);
     }
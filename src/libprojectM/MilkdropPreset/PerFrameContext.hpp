@@ -1,9 +1,12 @@
 #pragma once
 
+#include "ExpressionJit.hpp"
 #include "PresetState.hpp"
 
 #include <projectm-eval.h>
 
+#include <memory>
+
 namespace libprojectM {
 namespace MilkdropPreset {
 
@@ -60,8 +63,9 @@ public:
 
     /**
      * @brief Executes the per-frame code with the current state.
+     * @param watchdog Aborts loops in native code once the expression time budget is used up.
      */
-    void ExecutePerFrameCode();
+    void ExecutePerFrameCode(const ExpressionWatchdog& watchdog);
 
     projectm_eval_context* perFrameCodeContext{nullptr}; //!< The code runtime context, holds memory buffers and variables.
     projectm_eval_code* perFrameCodeHandle{nullptr}; //!< The compiled per-frame code handle.
@@ -144,6 +148,9 @@ public:
     PRJM_EVAL_F* blur1_edge_darken{};
 
     PRJM_EVAL_F q_values_after_init_code[QVarCount]{};
+
+private:
+    std::unique_ptr<ExpressionJit> m_perFrameJit; //!< Native code for the per-frame code, if supported.
 };
 
 } // namespace MilkdropPreset
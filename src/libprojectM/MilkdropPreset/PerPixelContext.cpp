@@ -1,6 +1,10 @@
 #include "PerPixelContext.hpp"
 
 #include "MilkdropPresetExceptions.hpp"
+#include "WorkerPool.hpp"
+
+#include <algorithm>
+#include <cmath>
 
 #ifdef MILKDROP_PRESET_DEBUG
 #include <iostream>
@@ -9,11 +13,104 @@
 #define REG_VAR(var) \
     var = projectm_eval_context_register_variable(perPixelCodeContext, #var);
 
+#define COPY_VAR(var) \
+    *var = *other.var;
+
 namespace libprojectM {
 namespace MilkdropPreset {
 
+namespace {
+
+/**
+ * Variables set by the mesh before executing the per-pixel code for each vertex.
+ */
+const CodeAnalysis::VariableSet PerVertexVariables{
+    "x", "y", "rad", "ang",
+    "zoom", "zoomexp", "rot", "warp", "cx", "cy", "dx", "dy", "sx", "sy"};
+
+#ifdef MILKDROP_GPU_PER_PIXEL_EQUATIONS
+/**
+ * Default values of the motion variables, used to check the single precision results.
+ */
+const std::pair<const char*, double> DefaultMotionValues[]{
+    {"zoom", 1.0}, {"zoomexp", 1.0}, {"rot", 0.0}, {"warp", 1.0}, {"cx", 0.5},
+    {"cy", 0.5}, {"dx", 0.0}, {"dy", 0.0}, {"sx", 1.0}, {"sy", 1.0}};
+
+/**
+ * Checks whether evaluating the per-pixel code in single precision stays within the BatchEvaluator
+ * tolerance for a grid of sample vertices, with the motion variables at their default values and
+ * all other variables at their current values in the context.
+ *
+ * This only filters out code which obviously needs double precision, e.g. due to cancellation or
+ * large intermediate values. PerPixelMesh validates the actual GPU results while rendering.
+ */
+auto MatchesInSinglePrecision(const ExpressionNode& root, projectm_eval_context* context) -> bool
+{
+    constexpr size_t SampleGridSize{8};
+    static_assert(SampleGridSize * SampleGridSize <= BatchEvaluator::BatchSize, "Sample grid must fit into one batch");
+    constexpr size_t SampleCount{SampleGridSize * SampleGridSize};
+
+    std::vector<std::string> const variables(PerVertexVariables.begin(), PerVertexVariables.end());
+    BatchEvaluator doubleEvaluator(root, variables);
+    FloatBatchEvaluator floatEvaluator(root, variables);
+
+    for (const auto& name : doubleEvaluator.ReadVariables())
+    {
+        auto const value = static_cast<double>(*projectm_eval_context_register_variable(context, name.c_str()));
+        std::fill_n(doubleEvaluator.Lanes(name), SampleCount, value);
+        std::fill_n(floatEvaluator.Lanes(name), SampleCount, static_cast<float>(value));
+    }
+
+    for (const auto& motionValue : DefaultMotionValues)
+    {
+        std::fill_n(doubleEvaluator.Lanes(motionValue.first), SampleCount, motionValue.second);
+        std::fill_n(floatEvaluator.Lanes(motionValue.first), SampleCount, static_cast<float>(motionValue.second));
+    }
+
+    // Same inputs as the mesh vertices with a square aspect ratio.
+    for (size_t sample = 0; sample < SampleCount; sample++)
+    {
+        double const meshX = static_cast<double>(sample % SampleGridSize) / (SampleGridSize - 1) * 2.0 - 1.0;
+        double const meshY = static_cast<double>(sample / SampleGridSize) / (SampleGridSize - 1) * 2.0 - 1.0;
+        std::pair<const char*, double> const inputs[]{
+            {"x", meshX * 0.5 + 0.5},
+            {"y", meshY * -0.5 + 0.5},
+            {"rad", std::hypot(meshX, meshY)},
+            {"ang", std::atan2(meshY, meshX)}};
+
+        for (const auto& input : inputs)
+        {
+            doubleEvaluator.Lanes(input.first)[sample] = input.second;
+            floatEvaluator.Lanes(input.first)[sample] = static_cast<float>(input.second);
+        }
+    }
+
+    doubleEvaluator.Execute(SampleCount);
+    floatEvaluator.Execute(SampleCount);
+
+    for (const auto& motionValue : DefaultMotionValues)
+    {
+        auto const* expected = doubleEvaluator.Lanes(motionValue.first);
+        auto const* actual = floatEvaluator.Lanes(motionValue.first);
+        for (size_t sample = 0; sample < SampleCount; sample++)
+        {
+            if (!FloatBatchEvaluator::WithinTolerance(expected[sample], actual[sample]))
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+#endif
+
+} // namespace
+
 PerPixelContext::PerPixelContext(projectm_eval_mem_buffer gmegabuf, PRJM_EVAL_F (*globalRegisters)[100])
     : perPixelCodeContext(projectm_eval_context_create(gmegabuf, globalRegisters))
+    , m_gmegabuf(gmegabuf)
+    , m_globalRegisters(globalRegisters)
 {
 }
 
@@ -118,15 +215,269 @@ void PerPixelContext::CompilePerPixelCode(const std::string& perPixelCode)
 #endif
         throw MilkdropCompileException("Could not compile per-pixel code");
     }
+
+    m_perPixelJit = ExpressionJit::Compile(perPixelCode, perPixelCodeContext);
+
+    m_perPixelCode = perPixelCode;
+    CodeAnalysis const analysis(perPixelCode);
+    m_canExecuteInParallel = analysis.IsParallelSafe(PerVertexVariables);
+
+    referencedVariables.x = analysis.References("x");
+    referencedVariables.y = analysis.References("y");
+    referencedVariables.rad = analysis.References("rad");
+    referencedVariables.ang = analysis.References("ang");
+    referencedVariables.zoom = analysis.References("zoom");
+    referencedVariables.zoomexp = analysis.References("zoomexp");
+    referencedVariables.rot = analysis.References("rot");
+    referencedVariables.warp = analysis.References("warp");
+    referencedVariables.cx = analysis.References("cx");
+    referencedVariables.cy = analysis.References("cy");
+    referencedVariables.dx = analysis.References("dx");
+    referencedVariables.dy = analysis.References("dy");
+    referencedVariables.sx = analysis.References("sx");
+    referencedVariables.sy = analysis.References("sy");
+
+    if (m_canExecuteInParallel)
+    {
+        ExpressionTree const tree(perPixelCode);
+        if (tree.Root() != nullptr)
+        {
+            CreateBatchEvaluator(*tree.Root());
+#ifdef MILKDROP_GPU_PER_PIXEL_EQUATIONS
+            TranslateToGlsl(*tree.Root());
+#endif
+        }
+    }
+
+#ifdef MILKDROP_PRESET_DEBUG
+    std::cerr << "[Preset] Per-pixel code " << (m_canExecuteInParallel ? "can" : "can't") << " run in parallel." << std::endl;
+#endif
+
+    CreateWorkerContexts();
 }
 
-void PerPixelContext::ExecutePerPixelCode()
+void PerPixelContext::ExecutePerPixelCode(const ExpressionWatchdog& watchdog)
 {
-    if (perPixelCodeHandle != nullptr)
+    if (m_perPixelJit)
+    {
+        m_perPixelJit->Execute(perPixelCodeHandle, *frame, watchdog);
+    }
+    else if (perPixelCodeHandle != nullptr)
     {
         projectm_eval_code_execute(perPixelCodeHandle);
     }
 }
 
+auto PerPixelContext::CanExecuteInParallel() const -> bool
+{
+    return m_canExecuteInParallel;
+}
+
+auto PerPixelContext::IsVertexIndependent() const -> bool
+{
+    return m_canExecuteInParallel &&
+           !referencedVariables.x && !referencedVariables.y &&
+           !referencedVariables.rad && !referencedVariables.ang;
+}
+
+auto PerPixelContext::WorkerContext(size_t slot) -> PerPixelContext&
+{
+    if (slot == 0 || slot > m_workerContexts.size())
+    {
+        return *this;
+    }
+
+    auto& context = *m_workerContexts[slot - 1];
+    context.CopyVariables(*this);
+    return context;
+}
+
+auto PerPixelContext::CanExecuteBatched() const -> bool
+{
+    return m_batchEvaluator != nullptr;
+}
+
+void PerPixelContext::DisableBatchedExecution()
+{
+    m_batchEvaluator.reset();
+    m_batchInputs.clear();
+    batchLanes = {};
+
+    for (auto& context : m_workerContexts)
+    {
+        context->DisableBatchedExecution();
+    }
+}
+
+void PerPixelContext::ExecutePerPixelCodeBatch(size_t count)
+{
+    for (const auto& input : m_batchInputs)
+    {
+        std::fill_n(input.first, count, static_cast<PresetBatchValue>(*input.second));
+    }
+
+    m_batchEvaluator->Execute(count);
+}
+
+void PerPixelContext::CreateBatchEvaluator(const ExpressionNode& root)
+{
+    m_batchEvaluator = std::make_unique<PresetBatchEvaluator>(root,
+                                                              std::vector<std::string>(PerVertexVariables.begin(), PerVertexVariables.end()));
+    BindBatchEvaluator();
+}
+
+void PerPixelContext::BindBatchEvaluator()
+{
+    batchLanes.x = m_batchEvaluator->Lanes("x");
+    batchLanes.y = m_batchEvaluator->Lanes("y");
+    batchLanes.rad = m_batchEvaluator->Lanes("rad");
+    batchLanes.ang = m_batchEvaluator->Lanes("ang");
+    batchLanes.zoom = m_batchEvaluator->Lanes("zoom");
+    batchLanes.zoomexp = m_batchEvaluator->Lanes("zoomexp");
+    batchLanes.rot = m_batchEvaluator->Lanes("rot");
+    batchLanes.warp = m_batchEvaluator->Lanes("warp");
+    batchLanes.cx = m_batchEvaluator->Lanes("cx");
+    batchLanes.cy = m_batchEvaluator->Lanes("cy");
+    batchLanes.dx = m_batchEvaluator->Lanes("dx");
+    batchLanes.dy = m_batchEvaluator->Lanes("dy");
+    batchLanes.sx = m_batchEvaluator->Lanes("sx");
+    batchLanes.sy = m_batchEvaluator->Lanes("sy");
+
+    // All other variables read by the code are loaded from the expression context.
+    for (const auto& name : m_batchEvaluator->ReadVariables())
+    {
+        if (PerVertexVariables.find(name) == PerVertexVariables.end())
+        {
+            m_batchInputs.emplace_back(m_batchEvaluator->Lanes(name),
+                                       projectm_eval_context_register_variable(perPixelCodeContext, name.c_str()));
+        }
+    }
+}
+
+void PerPixelContext::CreateWorkerContexts()
+{
+    m_workerContexts.clear();
+
+    auto const concurrency = WorkerPool::Instance().Concurrency();
+    if (!m_canExecuteInParallel || concurrency < 2)
+    {
+        return;
+    }
+
+    for (size_t slot = 1; slot < concurrency; slot++)
+    {
+        auto context = std::make_unique<PerPixelContext>(m_gmegabuf, m_globalRegisters);
+        context->RegisterBuiltinVariables();
+        context->CloneCompiledCode(*this);
+        m_workerContexts.push_back(std::move(context));
+    }
+}
+
+void PerPixelContext::CloneCompiledCode(const PerPixelContext& other)
+{
+    // The expression library has no way to share a code handle between contexts.
+    perPixelCodeHandle = projectm_eval_code_compile(perPixelCodeContext, other.m_perPixelCode.c_str());
+    if (perPixelCodeHandle == nullptr)
+    {
+        throw MilkdropCompileException("Could not compile per-pixel code");
+    }
+
+    if (other.m_perPixelJit)
+    {
+        m_perPixelJit = other.m_perPixelJit->Rebind([this](const std::string& name) {
+            return reinterpret_cast<double*>(projectm_eval_context_register_variable(perPixelCodeContext, name.c_str()));
+        });
+    }
+
+    m_perPixelCode = other.m_perPixelCode;
+    m_canExecuteInParallel = other.m_canExecuteInParallel;
+    referencedVariables = other.referencedVariables;
+
+    if (other.m_batchEvaluator)
+    {
+        m_batchEvaluator = std::make_unique<PresetBatchEvaluator>(*other.m_batchEvaluator);
+        BindBatchEvaluator();
+    }
+
+    // The GLSL translation is only used by the main context.
+}
+
+auto PerPixelContext::GlslPerPixelCode() const -> const std::string&
+{
+    return m_glslPerPixelCode;
+}
+
+auto PerPixelContext::GlslUniforms() const -> const std::vector<std::pair<std::string, PRJM_EVAL_F*>>&
+{
+    return m_glslUniforms;
+}
+
+void PerPixelContext::TranslateToGlsl(const ExpressionNode& root)
+{
+#ifdef MILKDROP_GPU_PER_PIXEL_EQUATIONS
+    if (!MatchesInSinglePrecision(root, perPixelCodeContext))
+    {
+#ifdef MILKDROP_PRESET_DEBUG
+        std::cerr << "[Preset] Per-pixel code needs double precision, not evaluating it on the GPU." << std::endl;
+#endif
+        return;
+    }
+
+    GlslTranslator const translator(root, "PerPixelEquations", {"x", "y", "rad", "ang"},
+                                    {"zoom", "zoomexp", "rot", "warp", "cx", "cy", "dx", "dy", "sx", "sy"});
+    if (!translator.IsValid())
+    {
+        return;
+    }
+
+    m_glslPerPixelCode = translator.Source();
+    for (const auto& name : translator.Uniforms())
+    {
+        m_glslUniforms.emplace_back(GlslTranslator::UniformName(name),
+                                    projectm_eval_context_register_variable(perPixelCodeContext, name.c_str()));
+    }
+#else
+    (void) root;
+#endif
+}
+
+void PerPixelContext::CopyVariables(const PerPixelContext& other)
+{
+    COPY_VAR(zoom);
+    COPY_VAR(zoomexp);
+    COPY_VAR(rot);
+    COPY_VAR(warp);
+    COPY_VAR(cx);
+    COPY_VAR(cy);
+    COPY_VAR(dx);
+    COPY_VAR(dy);
+    COPY_VAR(sx);
+    COPY_VAR(sy);
+    COPY_VAR(time);
+    COPY_VAR(fps);
+    COPY_VAR(bass);
+    COPY_VAR(mid);
+    COPY_VAR(treb);
+    COPY_VAR(bass_att);
+    COPY_VAR(mid_att);
+    COPY_VAR(treb_att);
+    COPY_VAR(frame);
+    COPY_VAR(x);
+    COPY_VAR(y);
+    COPY_VAR(rad);
+    COPY_VAR(ang);
+    for (int q = 0; q < QVarCount; q++)
+    {
+        *q_vars[q] = *other.q_vars[q];
+    }
+    COPY_VAR(progress);
+    COPY_VAR(meshx);
+    COPY_VAR(meshy);
+    COPY_VAR(pixelsx);
+    COPY_VAR(pixelsy);
+    COPY_VAR(aspectx);
+    COPY_VAR(aspecty);
+}
+
 } // namespace MilkdropPreset
 } // namespace libprojectM
@@ -1,16 +1,68 @@
 #pragma once
 
+#include "BatchEvaluator.hpp"
+#include "CodeAnalysis.hpp"
+#include "ExpressionJit.hpp"
+#include "GlslTranslator.hpp"
 #include "PerFrameContext.hpp"
 #include "PresetState.hpp"
 
 #include <projectm-eval.h>
 
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
 namespace libprojectM {
 namespace MilkdropPreset {
 
 class PerPixelContext
 {
 public:
+    /**
+     * @brief Lanes of the per-vertex variables for batched execution.
+     */
+    struct BatchLanes {
+        PresetBatchValue* x{};
+        PresetBatchValue* y{};
+        PresetBatchValue* rad{};
+        PresetBatchValue* ang{};
+        PresetBatchValue* zoom{};
+        PresetBatchValue* zoomexp{};
+        PresetBatchValue* rot{};
+        PresetBatchValue* warp{};
+        PresetBatchValue* cx{};
+        PresetBatchValue* cy{};
+        PresetBatchValue* dx{};
+        PresetBatchValue* dy{};
+        PresetBatchValue* sx{};
+        PresetBatchValue* sy{};
+    };
+
+    /**
+     * @brief Flags for the per-vertex variables referenced by the per-pixel code.
+     *
+     * Variables the code doesn't reference keep their per-frame value for all vertices, so they
+     * don't need to be set before each execution.
+     */
+    struct ReferencedVariables {
+        bool x{true};
+        bool y{true};
+        bool rad{true};
+        bool ang{true};
+        bool zoom{true};
+        bool zoomexp{true};
+        bool rot{true};
+        bool warp{true};
+        bool cx{true};
+        bool cy{true};
+        bool dx{true};
+        bool dy{true};
+        bool sx{true};
+        bool sy{true};
+    };
+
     /**
      * @brief Constructor. Creates a new per-frame state object.
      * @param gmegabuf The global memory buffer to use in the code context.
@@ -55,8 +107,87 @@ public:
 
     /**
      * @brief Executes the per-pixel code with the current state.
+     * @param watchdog Aborts loops in native code once the expression time budget is used up.
+     */
+    void ExecutePerPixelCode(const ExpressionWatchdog& watchdog);
+
+    /**
+     * @brief Returns whether the per-pixel code can be executed on multiple contexts in parallel.
+     *
+     * This is the case if the compiled code doesn't use any state which carries over from one vertex
+     * to the next, i.e. memory buffers, global registers, random numbers or variables read before they
+     * are assigned, except those reset by the mesh for each vertex.
+     *
+     * @return True if the mesh rows can be calculated in parallel with identical results, false if not.
+     */
+    auto CanExecuteInParallel() const -> bool;
+
+    /**
+     * @brief Returns whether the per-pixel code gives the same result for all vertices.
+     *
+     * This is the case if the code can be executed in parallel and doesn't reference any of the
+     * per-vertex inputs x, y, rad and ang. The code then only needs to be executed once per frame.
+     *
+     * @return True if a single execution yields the motion variables of all vertices, false if not.
+     */
+    auto IsVertexIndependent() const -> bool;
+
+    /**
+     * @brief Returns a context to execute the per-pixel code on the given worker thread slot.
+     *
+     * Slot 0 is this context. All other slots use a clone with the same global memory buffer, global
+     * registers and code, created by CompilePerPixelCode() if the code can run in parallel. The clone's
+     * variables are copied from this context on each call, so this must be called after loading the
+     * per-frame variables and before executing the code on another thread.
+     *
+     * @param slot The worker thread slot.
+     * @return The context to use on the given slot.
+     */
+    auto WorkerContext(size_t slot) -> PerPixelContext&;
+
+    /**
+     * @brief Returns whether the per-pixel code can be executed in batches.
+     *
+     * Requires the code to be parallel-safe and to only use the operations supported by BatchEvaluator.
+     *
+     * @return True if ExecutePerPixelCodeBatch() can be used, false if not.
+     */
+    auto CanExecuteBatched() const -> bool;
+
+    /**
+     * @brief Disables batched execution, e.g. if the results differ from the expression library.
+     */
+    void DisableBatchedExecution();
+
+    /**
+     * @brief Executes the per-pixel code for a batch of vertices.
+     *
+     * The per-vertex inputs are read from batchLanes, all other variables are taken from the
+     * expression context. The results are written to batchLanes.
+     *
+     * @param count The number of vertices, at most BatchEvaluator::BatchSize.
      */
-    void ExecutePerPixelCode();
+    void ExecutePerPixelCodeBatch(size_t count);
+
+    /**
+     * @brief Returns the per-pixel code translated to a GLSL function for the warp vertex shader.
+     *
+     * The function is named PerPixelEquations and takes x, y, rad and ang as inputs and returns
+     * the ten motion variables (zoom to sy) in out parameters, see GlslTranslator.
+     *
+     * The code is only translated if the library was built with ENABLE_GPU_PER_PIXEL_EQUATIONS,
+     * the code can be executed in parallel and its single precision results on a grid of sample
+     * vertices are within the BatchEvaluator tolerance.
+     *
+     * @return The GLSL source, or an empty string if the code can't be evaluated on the GPU.
+     */
+    auto GlslPerPixelCode() const -> const std::string&;
+
+    /**
+     * @brief Returns the uniforms used by the translated per-pixel code.
+     * @return Pairs of GLSL uniform names and the expression variables to set them from.
+     */
+    auto GlslUniforms() const -> const std::vector<std::pair<std::string, PRJM_EVAL_F*>>&;
 
     projectm_eval_context* perPixelCodeContext{nullptr}; //!< The code runtime context, holds memory buffers and variables.
     projectm_eval_code* perPixelCodeHandle{nullptr};     //!< The compiled per-pixel code handle.
@@ -92,6 +223,61 @@ public:
     PRJM_EVAL_F* pixelsy{};
     PRJM_EVAL_F* aspectx{};
     PRJM_EVAL_F* aspecty{};
+
+    ReferencedVariables referencedVariables; //!< Per-vertex variables the per-pixel code reads or writes.
+    BatchLanes batchLanes;                   //!< Per-vertex variable lanes for ExecutePerPixelCodeBatch().
+
+private:
+    /**
+     * @brief Copies all builtin variable values from another context.
+     * @param other The context to copy the values from.
+     */
+    void CopyVariables(const PerPixelContext& other);
+
+    /**
+     * @brief Creates the batched evaluator for the parsed per-pixel code.
+     * @param root The root node of the parsed per-pixel code.
+     */
+    void CreateBatchEvaluator(const ExpressionNode& root);
+
+    /**
+     * @brief Looks up the batch lanes and context variables used by the batched evaluator.
+     */
+    void BindBatchEvaluator();
+
+    /**
+     * @brief Creates the clones for all worker slots if the per-pixel code can run in parallel.
+     */
+    void CreateWorkerContexts();
+
+    /**
+     * @brief Sets up this clone with the compiled code of another context.
+     *
+     * Shares the results of parsing and analyzing the code: the native code is rebound to this
+     * context's variables and the batched evaluator is copied. Only the expression library needs to
+     * compile the code again, as its code handles are tied to a context.
+     *
+     * @throws MilkdropCompileException Thrown if the per-pixel code couldn't be compiled.
+     * @param other The context to take the compiled code from.
+     */
+    void CloneCompiledCode(const PerPixelContext& other);
+
+    /**
+     * @brief Translates the parsed per-pixel code to GLSL if possible and precise enough.
+     * @param root The root node of the parsed per-pixel code.
+     */
+    void TranslateToGlsl(const ExpressionNode& root);
+
+    projectm_eval_mem_buffer m_gmegabuf{};              //!< The global memory buffer, used for creating worker contexts.
+    PRJM_EVAL_F (*m_globalRegisters)[100]{};            //!< The global registers, used for creating worker contexts.
+    std::string m_perPixelCode;                         //!< The compiled per-pixel code, used for creating worker contexts.
+    bool m_canExecuteInParallel{false};                 //!< True if the per-pixel code has no cross-vertex state.
+    std::unique_ptr<ExpressionJit> m_perPixelJit;       //!< Native code for the per-pixel code, if supported.
+    std::unique_ptr<PresetBatchEvaluator> m_batchEvaluator; //!< Batched evaluator for the per-pixel code, if supported.
+    std::vector<std::pair<PresetBatchValue*, PRJM_EVAL_F*>> m_batchInputs; //!< Lanes filled from context variables before each batch.
+    std::string m_glslPerPixelCode;                     //!< The per-pixel code translated to GLSL, if possible.
+    std::vector<std::pair<std::string, PRJM_EVAL_F*>> m_glslUniforms; //!< Uniform names and variables of the GLSL code.
+    std::vector<std::unique_ptr<PerPixelContext>> m_workerContexts; //!< Cloned contexts for worker slots 1 and above.
 };
 
 } // namespace MilkdropPreset
@@ -0,0 +1,224 @@
+#include "PerPixelEquationsValidator.hpp"
+
+#include "BatchEvaluator.hpp"
+#include "MilkdropStaticShaders.hpp"
+
+#include <Renderer/Shader.hpp>
+
+#include <cstdint>
+#include <cstring>
+
+namespace libprojectM {
+namespace MilkdropPreset {
+
+constexpr size_t PerPixelEquationsValidator::InputsPerVertex;
+constexpr size_t PerPixelEquationsValidator::ResultsPerVertex;
+
+namespace {
+
+/**
+ * Transform feedback outputs of the validation vertex shader, in result order.
+ */
+const char* const ResultVaryings[PerPixelEquationsValidator::ResultsPerVertex]{
+    "result_zoom", "result_zoomexp", "result_rot", "result_warp", "result_cx",
+    "result_cy", "result_dx", "result_dy", "result_sx", "result_sy"};
+
+auto CompileShader(const std::string& source, GLenum type) -> GLuint
+{
+    auto shader = glCreateShader(type);
+    const auto* sourceCStr = source.c_str();
+    glShaderSource(shader, 1, &sourceCStr, nullptr);
+    glCompileShader(shader);
+
+    GLint shaderCompiled{};
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &shaderCompiled);
+    if (shaderCompiled == GL_TRUE)
+    {
+        return shader;
+    }
+
+    GLint infoLogLength{};
+    glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &infoLogLength);
+    std::vector<char> message(infoLogLength + 1);
+    glGetShaderInfoLog(shader, infoLogLength, nullptr, message.data());
+    glDeleteShader(shader);
+
+    throw Renderer::ShaderException("Error compiling per-pixel validation shader: " + std::string(message.data()));
+}
+
+} // namespace
+
+PerPixelEquationsValidator::~PerPixelEquationsValidator()
+{
+    if (m_fence != nullptr)
+    {
+        glDeleteSync(m_fence);
+    }
+    glDeleteBuffers(1, &m_feedbackBuffer);
+    glDeleteBuffers(1, &m_inputBuffer);
+    glDeleteVertexArrays(1, &m_vertexArray);
+    glDeleteProgram(m_program);
+}
+
+void PerPixelEquationsValidator::Compile(const std::string& glslPerPixelCode)
+{
+    auto staticShaders = MilkdropStaticShaders::Get();
+    auto vertexShader = CompileShader(staticShaders->GetPerPixelEquationsVertexShader() + "\n" + glslPerPixelCode, GL_VERTEX_SHADER);
+
+    GLuint fragmentShader{};
+    try
+    {
+        fragmentShader = CompileShader(staticShaders->GetPerPixelEquationsFragmentShader(), GL_FRAGMENT_SHADER);
+    }
+    catch (Renderer::ShaderException&)
+    {
+        glDeleteShader(vertexShader);
+        throw;
+    }
+
+    m_program = glCreateProgram();
+    glAttachShader(m_program, vertexShader);
+    glAttachShader(m_program, fragmentShader);
+    glTransformFeedbackVaryings(m_program, ResultsPerVertex, ResultVaryings, GL_INTERLEAVED_ATTRIBS);
+    glLinkProgram(m_program);
+
+    glDetachShader(m_program, vertexShader);
+    glDetachShader(m_program, fragmentShader);
+    glDeleteShader(vertexShader);
+    glDeleteShader(fragmentShader);
+
+    GLint programLinked{};
+    glGetProgramiv(m_program, GL_LINK_STATUS, &programLinked);
+    if (programLinked != GL_TRUE)
+    {
+        GLint infoLogLength{};
+        glGetProgramiv(m_program, GL_INFO_LOG_LENGTH, &infoLogLength);
+        std::vector<char> message(infoLogLength + 1);
+        glGetProgramInfoLog(m_program, infoLogLength, nullptr, message.data());
+        glDeleteProgram(m_program);
+        m_program = 0;
+
+        throw Renderer::ShaderException("Error linking per-pixel validation program: " + std::string(message.data()));
+    }
+
+    glGenVertexArrays(1, &m_vertexArray);
+    glGenBuffers(1, &m_inputBuffer);
+    glGenBuffers(1, &m_feedbackBuffer);
+
+    glBindVertexArray(m_vertexArray);
+    glBindBuffer(GL_ARRAY_BUFFER, m_inputBuffer);
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(float) * InputsPerVertex, nullptr);                                     // Position
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(float) * InputsPerVertex, reinterpret_cast<void*>(sizeof(float) * 2)); // Radius & angle
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void PerPixelEquationsValidator::Submit(const std::vector<float>& inputs,
+                                        std::vector<float> expected,
+                                        const glm::vec4& aspect,
+                                        const std::vector<std::pair<std::string, float>>& uniforms)
+{
+    size_t const vertexCount = inputs.size() / InputsPerVertex;
+    if (m_program == 0 || IsPending() || vertexCount == 0 || expected.size() != vertexCount * ResultsPerVertex)
+    {
+        return;
+    }
+
+    m_expected = std::move(expected);
+
+    glUseProgram(m_program);
+    glUniform4f(glGetUniformLocation(m_program, "aspect"), aspect.x, aspect.y, aspect.z, aspect.w);
+    for (const auto& uniform : uniforms)
+    {
+        auto const location = glGetUniformLocation(m_program, uniform.first.c_str());
+        if (location >= 0)
+        {
+            glUniform1f(location, uniform.second);
+        }
+    }
+
+    glBindVertexArray(m_vertexArray);
+    glBindBuffer(GL_ARRAY_BUFFER, m_inputBuffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * inputs.size(), inputs.data(), GL_STREAM_DRAW);
+
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, m_feedbackBuffer);
+    glBufferData(GL_TRANSFORM_FEEDBACK_BUFFER, sizeof(float) * m_expected.size(), nullptr, GL_STREAM_READ);
+
+    glEnable(GL_RASTERIZER_DISCARD);
+    glBeginTransformFeedback(GL_POINTS);
+    glDrawArrays(GL_POINTS, 0, static_cast<GLsizei>(vertexCount));
+    glEndTransformFeedback();
+    glDisable(GL_RASTERIZER_DISCARD);
+
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glUseProgram(0);
+
+    m_fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+auto PerPixelEquationsValidator::IsPending() const -> bool
+{
+    return m_fence != nullptr;
+}
+
+auto PerPixelEquationsValidator::Poll(bool wait) -> Result
+{
+    if (m_fence == nullptr)
+    {
+        return Result::Idle;
+    }
+
+    constexpr GLuint64 WaitTimeout{1000000000}; // 1 second in nanoseconds
+    GLenum status{};
+    do
+    {
+        status = glClientWaitSync(m_fence, GL_SYNC_FLUSH_COMMANDS_BIT, wait ? WaitTimeout : 0);
+    } while (wait && status == GL_TIMEOUT_EXPIRED);
+
+    if (status == GL_TIMEOUT_EXPIRED)
+    {
+        return Result::Pending;
+    }
+
+    glDeleteSync(m_fence);
+    m_fence = nullptr;
+
+    if (status == GL_WAIT_FAILED)
+    {
+        return Result::Mismatch;
+    }
+
+    m_results.resize(m_expected.size());
+    glBindBuffer(GL_COPY_READ_BUFFER, m_feedbackBuffer);
+    const auto* mappedResults = glMapBufferRange(GL_COPY_READ_BUFFER, 0, sizeof(float) * m_results.size(), GL_MAP_READ_BIT);
+    if (mappedResults == nullptr)
+    {
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        return Result::Mismatch;
+    }
+    std::memcpy(m_results.data(), mappedResults, sizeof(float) * m_results.size());
+    glUnmapBuffer(GL_COPY_READ_BUFFER);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+    for (size_t index = 0; index < m_results.size(); index++)
+    {
+        if (!FloatBatchEvaluator::WithinTolerance(m_expected[index], m_results[index]))
+        {
+            return Result::Mismatch;
+        }
+    }
+
+    return Result::Match;
+}
+
+auto PerPixelEquationsValidator::Results() const -> const std::vector<float>&
+{
+    return m_results;
+}
+
+} // namespace MilkdropPreset
+} // namespace libprojectM
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <projectM-opengl.h>
+
+#include <glm/vec4.hpp>
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace libprojectM {
+namespace MilkdropPreset {
+
+/**
+ * @brief Compares the results of the per-pixel code evaluated on the GPU with the CPU results.
+ *
+ * The translated per-pixel code (see GlslTranslator) is linked into a small vertex shader program
+ * which evaluates it for a list of mesh vertices with rasterization disabled. The results are
+ * captured with transform feedback and read back once a fence signals that the GPU is done, so
+ * the render thread doesn't need to wait for the GPU. Each result must be within the single
+ * precision tolerance of BatchEvaluator of the CPU result.
+ *
+ * Requires a current OpenGL 3.3 or OpenGL ES 3.0 context for all methods.
+ */
+class PerPixelEquationsValidator
+{
+public:
+    static constexpr size_t InputsPerVertex{4};   //!< Mesh position x and y, radius and angle.
+    static constexpr size_t ResultsPerVertex{10}; //!< zoom, zoomexp, rot, warp, cx, cy, dx, dy, sx and sy.
+
+    /**
+     * @brief State of the last submitted comparison.
+     */
+    enum class Result
+    {
+        Idle,    //!< Nothing was submitted since the last result was returned.
+        Pending, //!< The GPU didn't finish evaluating the code yet.
+        Match,   //!< All GPU results are within the tolerance.
+        Mismatch //!< At least one GPU result differs from the CPU result.
+    };
+
+    PerPixelEquationsValidator() = default;
+
+    /**
+     * @brief Destructor. Deletes the OpenGL objects.
+     */
+    ~PerPixelEquationsValidator();
+
+    PerPixelEquationsValidator(const PerPixelEquationsValidator&) = delete;
+    auto operator=(const PerPixelEquationsValidator&) -> PerPixelEquationsValidator& = delete;
+
+    /**
+     * @brief Compiles and links the validation program.
+     * @throws Renderer::ShaderException Thrown if the translated code couldn't be compiled or linked.
+     * @param glslPerPixelCode The translated per-pixel code, see PerPixelContext::GlslPerPixelCode().
+     */
+    void Compile(const std::string& glslPerPixelCode);
+
+    /**
+     * @brief Starts evaluating the per-pixel code on the GPU.
+     *
+     * Does nothing if the previous submission is still pending.
+     *
+     * @param inputs The mesh position, radius and angle of each vertex, InputsPerVertex values per vertex.
+     * @param expected The CPU results for each vertex, ResultsPerVertex values per vertex.
+     * @param aspect The aspect ratio uniform of the warp shader.
+     * @param uniforms Uniform names and values for the translated code, see PerPixelContext::GlslUniforms().
+     */
+    void Submit(const std::vector<float>& inputs,
+                std::vector<float> expected,
+                const glm::vec4& aspect,
+                const std::vector<std::pair<std::string, float>>& uniforms);
+
+    /**
+     * @brief Returns whether a submission is waiting for the GPU.
+     * @return True if Poll() needs to be called to get the result of the last submission.
+     */
+    auto IsPending() const -> bool;
+
+    /**
+     * @brief Compares the GPU results with the CPU results once the GPU finished the last submission.
+     * @param wait If true, waits for the GPU to finish. If false, returns Result::Pending if it isn't finished yet.
+     * @return The comparison result. Match and Mismatch are only returned once per submission.
+     */
+    auto Poll(bool wait = false) -> Result;
+
+    /**
+     * @brief Returns the GPU results of the last comparison.
+     * @return The results, ResultsPerVertex values per vertex.
+     */
+    auto Results() const -> const std::vector<float>&;
+
+private:
+    GLuint m_program{};        //!< The validation program.
+    GLuint m_vertexArray{};    //!< Vertex array object for the input buffer.
+    GLuint m_inputBuffer{};    //!< Vertex inputs of the current submission.
+    GLuint m_feedbackBuffer{}; //!< Transform feedback buffer receiving the GPU results.
+    GLsync m_fence{};          //!< Signaled when the GPU finished the current submission.
+
+    std::vector<float> m_expected; //!< CPU results of the current submission.
+    std::vector<float> m_results;  //!< GPU results of the last comparison.
+};
+
+} // namespace MilkdropPreset
+} // namespace libprojectM
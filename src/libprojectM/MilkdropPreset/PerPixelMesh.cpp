@@ -4,9 +4,12 @@
 #include "MilkdropStaticShaders.hpp"
 #include "PerFrameContext.hpp"
 #include "PerPixelContext.hpp"
+#include "PerPixelEquationsValidator.hpp"
 #include "PresetState.hpp"
+#include "WorkerPool.hpp"
 
 #include <algorithm>
+#include <array>
 #include <cmath>
 
 #ifdef MILKDROP_PRESET_DEBUG
@@ -16,7 +19,10 @@
 namespace libprojectM {
 namespace MilkdropPreset {
 
-static constexpr uint32_t VerticesPerDrawCall = 1024 * 3;
+static constexpr int MinVerticesPerTask = 256; //!< Minimum number of vertices per parallel task, to keep the threading overhead low.
+
+constexpr int PerPixelMesh::GpuProbationValidations;
+constexpr int PerPixelMesh::GpuValidationInterval;
 
 PerPixelMesh::PerPixelMesh()
     : RenderItem()
@@ -28,15 +34,16 @@ PerPixelMesh::PerPixelMesh()
                                         staticShaders->GetPresetWarpFragmentShader());
 }
 
-void PerPixelMesh::InitVertexAttrib()
+PerPixelMesh::~PerPixelMesh()
 {
-    m_drawVertices.resize(VerticesPerDrawCall); // Fixed size, may scale it later depending on GPU caps.
-
-    glGenVertexArrays(1, &m_vaoID);
-    glGenBuffers(1, &m_vboID);
+    glDeleteBuffers(1, &m_elementBuffer);
+}
 
-    glBindVertexArray(m_vaoID);
-    glBindBuffer(GL_ARRAY_BUFFER, m_vboID);
+void PerPixelMesh::InitVertexAttrib()
+{
+    // The element buffer binding is stored in the vertex array object.
+    glGenBuffers(1, &m_elementBuffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_elementBuffer);
 
     glEnableVertexAttribArray(0);
     glEnableVertexAttribArray(1);
@@ -53,11 +60,7 @@ void PerPixelMesh::InitVertexAttrib()
     glVertexAttribPointer(4, 2, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), reinterpret_cast<void*>(offsetof(MeshVertex, distanceX))); // Distance
     glVertexAttribPointer(5, 2, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), reinterpret_cast<void*>(offsetof(MeshVertex, stretchX)));  // Stretch
 
-    // Pre-allocate vertex buffer
-    glBufferData(GL_ARRAY_BUFFER, sizeof(MeshVertex) * m_drawVertices.size(), m_drawVertices.data(), GL_STREAM_DRAW);
-
-    glBindVertexArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    // Buffer sizes depend on the grid size, they are allocated in InitializeIndices() and WarpedBlit().
 }
 
 void PerPixelMesh::LoadWarpShader(const PresetState& presetState)
@@ -88,7 +91,45 @@ void PerPixelMesh::LoadWarpShader(const PresetState& presetState)
     }
 }
 
-void PerPixelMesh::CompileWarpShader(PresetState& presetState)
+void PerPixelMesh::LoadWarpShaderTextures(PresetState& presetState)
+{
+    if (m_warpShader)
+    {
+        m_warpShader->LoadTextures(presetState);
+    }
+}
+
+void PerPixelMesh::TranspileWarpShader(const PresetState& presetState)
+{
+    if (m_warpShader)
+    {
+        try
+        {
+            m_warpShader->Transpile(presetState);
+        }
+        catch (Renderer::ShaderException& ex)
+        {
+#ifdef MILKDROP_PRESET_DEBUG
+            std::cerr << "[Warp Shader] Error translating warp shader code:" << ex.message() << std::endl;
+#else
+            (void)ex; // silence unused parameter warning
+#endif
+            m_warpShader.reset();
+        }
+    }
+}
+
+auto PerPixelMesh::StartCompilingWarpShader() const -> Renderer::ShaderCache::ProgramPtr
+{
+    if (!m_warpShader)
+    {
+        return {};
+    }
+
+    return m_warpShader->StartCompile();
+}
+
+void PerPixelMesh::CompileWarpShader(PresetState& presetState, const PerPixelContext& perPixelContext)
 {
     if (m_warpShader)
     {
@@ -109,6 +150,138 @@ void PerPixelMesh::CompileWarpShader(PresetState& presetState)
             m_warpShader.reset();
         }
     }
+
+    // The per-pixel code is evaluated on the CPU until the GPU results matched the CPU results, see Draw().
+    m_perPixelEquationsOnGpu = false;
+    m_gpuValidator.reset();
+    m_gpuMatchCount = 0;
+    if (perPixelContext.GlslPerPixelCode().empty())
+    {
+        return;
+    }
+
+    try
+    {
+        auto validator = std::make_unique<PerPixelEquationsValidator>();
+        validator->Compile(perPixelContext.GlslPerPixelCode());
+        m_gpuValidator = std::move(validator);
+    }
+    catch (Renderer::ShaderException& ex)
+    {
+#ifdef MILKDROP_PRESET_DEBUG
+        std::cerr << "[Warp Shader] Error compiling translated per-pixel code, evaluating it on the CPU:" << ex.message() << std::endl;
+#else
+        (void)ex; // silence unused parameter warning
+#endif
+    }
+}
+
+auto PerPixelMesh::EnableGpuPerPixelEquations(const PerPixelContext& perPixelContext) -> bool
+{
+    auto staticShaders = libprojectM::MilkdropPreset::MilkdropStaticShaders::Get();
+    std::string vertexShader = staticShaders->GetPresetWarpVertexShader();
+    vertexShader.insert(vertexShader.find('\n') + 1, "#define PER_PIXEL_EQUATIONS\n");
+    vertexShader.append("\n" + perPixelContext.GlslPerPixelCode());
+
+    try
+    {
+        if (m_warpShader)
+        {
+            m_warpShader->CompileWithVertexShader(vertexShader);
+        }
+        else
+        {
+            m_perPixelEquationsShader.CompileProgram(vertexShader, staticShaders->GetPresetWarpFragmentShader());
+        }
+        m_perPixelEquationsOnGpu = true;
+#ifdef MILKDROP_PRESET_DEBUG
+        std::cerr << "[Warp Shader] GPU per-pixel results match, evaluating per-pixel code in the vertex shader." << std::endl;
+#endif
+        return true;
+    }
+    catch (Renderer::ShaderException& ex)
+    {
+#ifdef MILKDROP_PRESET_DEBUG
+        std::cerr << "[Warp Shader] Error compiling translated per-pixel code, evaluating it on the CPU:" << ex.message() << std::endl;
+#else
+        (void)ex; // silence unused parameter warning
+#endif
+        DisableGpuPerPixelEquations();
+        return false;
+    }
+}
+
+void PerPixelMesh::DisableGpuPerPixelEquations()
+{
+    // The program was already linked successfully with the default vertex shader before.
+    if (m_perPixelEquationsOnGpu && m_warpShader)
+    {
+        m_warpShader->CompileWithVertexShader(libprojectM::MilkdropPreset::MilkdropStaticShaders::Get()->GetPresetWarpVertexShader());
+    }
+
+    m_perPixelEquationsOnGpu = false;
+    m_gpuValidator.reset();
+}
+
+void PerPixelMesh::CheckGpuValidation(const PerPixelContext& perPixelContext)
+{
+    switch (m_gpuValidator->Poll())
+    {
+        case PerPixelEquationsValidator::Result::Match:
+            if (!m_perPixelEquationsOnGpu && ++m_gpuMatchCount >= GpuProbationValidations)
+            {
+                EnableGpuPerPixelEquations(perPixelContext);
+            }
+            break;
+
+        case PerPixelEquationsValidator::Result::Mismatch:
+#ifdef MILKDROP_PRESET_DEBUG
+            std::cerr << "[Per-Pixel Mesh] GPU per-pixel results differ, evaluating per-pixel code on the CPU." << std::endl;
+#endif
+            DisableGpuPerPixelEquations();
+            break;
+
+        case PerPixelEquationsValidator::Result::Idle:
+        case PerPixelEquationsValidator::Result::Pending:
+            break;
+    }
+}
+
+void PerPixelMesh::SubmitGpuValidation(const PresetState& presetState,
+                                       const std::vector<std::pair<std::string, float>>& uniforms,
+                                       int firstRow, int lastRow)
+{
+    auto const first = m_vertices.begin() + firstRow * (m_gridSizeX + 1);
+    auto const last = m_vertices.begin() + lastRow * (m_gridSizeX + 1);
+
+    std::vector<float> inputs;
+    std::vector<float> expected;
+    inputs.reserve((last - first) * PerPixelEquationsValidator::InputsPerVertex);
+    expected.reserve((last - first) * PerPixelEquationsValidator::ResultsPerVertex);
+
+    // Position, radius and angle are followed by the ten motion values in MeshVertex.
+    for (auto vertex = first; vertex != last; ++vertex)
+    {
+        inputs.insert(inputs.end(), &vertex->x, &vertex->x + PerPixelEquationsValidator::InputsPerVertex);
+        expected.insert(expected.end(), &vertex->zoom, &vertex->zoom + PerPixelEquationsValidator::ResultsPerVertex);
+    }
+
+    m_gpuValidator->Submit(inputs, std::move(expected),
+                           {presetState.renderContext.aspectX,
+                            presetState.renderContext.aspectY,
+                            presetState.renderContext.invAspectX,
+                            presetState.renderContext.invAspectY},
+                           uniforms);
+}
+
+auto PerPixelMesh::GpuUniformValues(const PerPixelContext& perPixelContext) -> std::vector<std::pair<std::string, float>>
+{
+    std::vector<std::pair<std::string, float>> values;
+    for (const auto& uniform : perPixelContext.GlslUniforms())
+    {
+        values.emplace_back(uniform.first, static_cast<float>(*uniform.second));
+    }
+    return values;
 }
 
 void PerPixelMesh::Draw(const PresetState& presetState,
@@ -126,11 +299,56 @@ void PerPixelMesh::Draw(const PresetState& presetState,
     // Initialize or recreate the mesh (if grid size changed)
     InitializeMesh(presetState);
 
-    // Calculate the dynamic movement values
+    if (m_gpuValidator)
+    {
+        CheckGpuValidation(perPixelContext);
+    }
+
+    // Calculate the dynamic movement values, unless the vertex shader does it.
+    if (m_perPixelEquationsOnGpu)
+    {
+        LoadPerFrameMotionVariables(perFrameContext, perPixelContext);
+
+        WarpedBlit(presetState, perFrameContext, perPixelContext);
+
+        // Keep comparing a single row with the CPU results, as some values may only leave the
+        // single precision tolerance later, e.g. with a growing time value.
+        if (m_gpuValidator && !m_gpuValidator->IsPending() && ++m_gpuValidationFrame >= GpuValidationInterval &&
+            !presetState.expressionWatchdog.Expired())
+        {
+            m_gpuValidationFrame = 0;
+            int const row = m_gpuValidationRow++ % (m_gridSizeY + 1);
+
+            // Executing the code on the CPU changes the context variables, so this is done after drawing.
+            auto const uniforms = GpuUniformValues(perPixelContext);
+            CalculateMeshRows(presetState, perFrameContext, perPixelContext, row, row + 1, false);
+            if (!presetState.expressionWatchdog.Expired())
+            {
+                SubmitGpuValidation(presetState, uniforms, row, row + 1);
+            }
+        }
+        return;
+    }
+
+    // The GPU gets the same uniform values the CPU code starts with.
+    bool const validateOnGpu = m_gpuValidator && !m_gpuValidator->IsPending();
+    std::vector<std::pair<std::string, float>> uniforms;
+    if (validateOnGpu)
+    {
+        LoadPerFrameMotionVariables(perFrameContext, perPixelContext);
+        uniforms = GpuUniformValues(perPixelContext);
+    }
+
     CalculateMesh(presetState, perFrameContext, perPixelContext);
 
+    // Incomplete meshes contain values from the previous frame.
+    if (validateOnGpu && !presetState.expressionWatchdog.Expired())
+    {
+        SubmitGpuValidation(presetState, uniforms, 0, m_gridSizeY + 1);
+    }
+
     // Render the resulting mesh.
-    WarpedBlit(presetState, perFrameContext);
+    WarpedBlit(presetState, perFrameContext, perPixelContext);
 }
 
 void PerPixelMesh::InitializeMesh(const PresetState& presetState)
@@ -141,9 +359,9 @@ void PerPixelMesh::InitializeMesh(const PresetState& presetState)
         m_gridSizeX = presetState.renderContext.perPixelMeshX;
         m_gridSizeY = presetState.renderContext.perPixelMeshY;
 
-        // Grid size has changed, reallocate vertex buffers
+        // Grid size has changed, reallocate vertex buffers and regenerate the draw indices.
         m_vertices.resize((m_gridSizeX + 1) * (m_gridSizeY + 1));
-        m_listIndices.resize(m_gridSizeX * m_gridSizeY * 6);
+        InitializeIndices();
     }
     else if (m_viewportWidth == presetState.renderContext.viewportSizeX &&
              m_viewportHeight == presetState.renderContext.viewportSizeY)
@@ -180,9 +398,13 @@ void PerPixelMesh::InitializeMesh(const PresetState& presetState)
             vertexIndex++;
         }
     }
+}
 
+void PerPixelMesh::InitializeIndices()
+{
     // Generate triangle lists for drawing the main warp mesh
-    int vertexListIndex{0};
+    std::vector<GLuint> indices(m_gridSizeX * m_gridSizeY * 6);
+    size_t vertexListIndex{0};
     for (int quadrant = 0; quadrant < 4; quadrant++)
     {
         for (int slice = 0; slice < m_gridSizeY / 2; slice++)
@@ -201,97 +423,367 @@ void PerPixelMesh::InitializeMesh(const PresetState& presetState)
                     yReference = m_gridSizeY - 1 - yReference;
                 }
 
-                int const vertex = xReference + yReference * (m_gridSizeX + 1);
+                auto const vertex = static_cast<GLuint>(xReference + yReference * (m_gridSizeX + 1));
 
                 // 0 - 1      3
                 //   /      /
                 // 2      4 - 5
-                m_listIndices.at(vertexListIndex++) = vertex;
-                m_listIndices.at(vertexListIndex++) = vertex + 1;
-                m_listIndices.at(vertexListIndex++) = vertex + m_gridSizeX + 1;
-                m_listIndices.at(vertexListIndex++) = vertex + 1;
-                m_listIndices.at(vertexListIndex++) = vertex + m_gridSizeX + 1;
-                m_listIndices.at(vertexListIndex++) = vertex + m_gridSizeX + 2;
+                indices.at(vertexListIndex++) = vertex;
+                indices.at(vertexListIndex++) = vertex + 1;
+                indices.at(vertexListIndex++) = vertex + m_gridSizeX + 1;
+                indices.at(vertexListIndex++) = vertex + 1;
+                indices.at(vertexListIndex++) = vertex + m_gridSizeX + 1;
+                indices.at(vertexListIndex++) = vertex + m_gridSizeX + 2;
             }
         }
     }
+
+    // Odd grid sizes leave out the center row and column, so not all indices may be used.
+    m_indexCount = static_cast<GLsizei>(vertexListIndex);
+
+    glBindVertexArray(m_vaoID);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * m_indexCount, indices.data(), GL_STATIC_DRAW);
+    glBindVertexArray(0);
+}
+
+void PerPixelMesh::LoadPerFrameMotionVariables(const PerFrameContext& perFrameContext, PerPixelContext& perPixelContext)
+{
+    *perPixelContext.zoom = *perFrameContext.zoom;
+    *perPixelContext.zoomexp = *perFrameContext.zoomexp;
+    *perPixelContext.rot = *perFrameContext.rot;
+    *perPixelContext.warp = *perFrameContext.warp;
+    *perPixelContext.cx = *perFrameContext.cx;
+    *perPixelContext.cy = *perFrameContext.cy;
+    *perPixelContext.dx = *perFrameContext.dx;
+    *perPixelContext.dy = *perFrameContext.dy;
+    *perPixelContext.sx = *perFrameContext.sx;
+    *perPixelContext.sy = *perFrameContext.sy;
 }
 
 void PerPixelMesh::CalculateMesh(const PresetState& presetState, const PerFrameContext& perFrameContext, PerPixelContext& perPixelContext)
 {
-    // Cache some per-frame values as floats
-    float zoom = static_cast<float>(*perFrameContext.zoom);
-    float zoomExp = static_cast<float>(*perFrameContext.zoomexp);
-    float rot = static_cast<float>(*perFrameContext.rot);
-    float warp = static_cast<float>(*perFrameContext.warp);
-    float cx = static_cast<float>(*perFrameContext.cx);
-    float cy = static_cast<float>(*perFrameContext.cy);
-    float dx = static_cast<float>(*perFrameContext.dx);
-    float dy = static_cast<float>(*perFrameContext.dy);
-    float sx = static_cast<float>(*perFrameContext.sx);
-    float sy = static_cast<float>(*perFrameContext.sy);
-
-    int vertex = 0;
-
-    // Can't make this multithreaded as per-pixel code may use gmegabuf or regXX vars.
-    for (int y = 0; y <= m_gridSizeY; y++)
+    // Out of time, keep the previous frame's mesh.
+    if (presetState.expressionWatchdog.CheckExpired())
+    {
+        return;
+    }
+
+    // Variables not referenced by the per-pixel code keep these values for all vertices.
+    LoadPerFrameMotionVariables(perFrameContext, perPixelContext);
+
+    // If the code gives the same result for every vertex, run it only once.
+    bool const vertexIndependent = perPixelContext.perPixelCodeHandle && perPixelContext.IsVertexIndependent();
+    if (vertexIndependent)
+    {
+        perPixelContext.ExecutePerPixelCode(presetState.expressionWatchdog);
+    }
+
+    if (!perPixelContext.perPixelCodeHandle || vertexIndependent)
+    {
+        // Cache the motion values as floats
+        float const zoom = static_cast<float>(*perPixelContext.zoom);
+        float const zoomExp = static_cast<float>(*perPixelContext.zoomexp);
+        float const rot = static_cast<float>(*perPixelContext.rot);
+        float const warp = static_cast<float>(*perPixelContext.warp);
+        float const cx = static_cast<float>(*perPixelContext.cx);
+        float const cy = static_cast<float>(*perPixelContext.cy);
+        float const dx = static_cast<float>(*perPixelContext.dx);
+        float const dy = static_cast<float>(*perPixelContext.dy);
+        float const sx = static_cast<float>(*perPixelContext.sx);
+        float const sy = static_cast<float>(*perPixelContext.sy);
+
+        for (auto& curVertex : m_vertices)
+        {
+            curVertex.zoom = zoom;
+            curVertex.zoomExp = zoomExp;
+            curVertex.rot = rot;
+            curVertex.warp = warp;
+            curVertex.centerX = cx;
+            curVertex.centerY = cy;
+            curVertex.distanceX = dx;
+            curVertex.distanceY = dy;
+            curVertex.stretchX = sx;
+            curVertex.stretchY = sy;
+        }
+        return;
+    }
+
+    // Batched results are checked against the expression library, so they're guaranteed to be identical,
+    // or within the single precision tolerance if built with ENABLE_FLOAT_EXPRESSIONS.
+    bool const batched = perPixelContext.CanExecuteBatched();
+    ExecutePerPixelCode(presetState, perFrameContext, perPixelContext, batched);
+
+    if (batched && !presetState.expressionWatchdog.Expired() && !ValidateBatchedResults(presetState, perFrameContext, perPixelContext))
+    {
+#ifdef MILKDROP_PRESET_DEBUG
+        std::cerr << "[Per-Pixel Mesh] Batched per-pixel results differ, disabling batched execution." << std::endl;
+#endif
+        perPixelContext.DisableBatchedExecution();
+        ExecutePerPixelCode(presetState, perFrameContext, perPixelContext, false);
+    }
+}
+
+void PerPixelMesh::ExecutePerPixelCode(const PresetState& presetState, const PerFrameContext& perFrameContext,
+                                       PerPixelContext& perPixelContext, bool batched)
+{
+    int const rowCount = m_gridSizeY + 1;
+
+    // Per-pixel code using gmegabuf, regXX vars or other state carried over between vertices
+    // must run serially in vertex order to give the same result.
+    auto& workerPool = WorkerPool::Instance();
+    if (!perPixelContext.CanExecuteInParallel() || workerPool.Concurrency() < 2)
+    {
+        CalculateMeshRows(presetState, perFrameContext, perPixelContext, 0, rowCount, batched);
+        return;
+    }
+
+    int const rowsPerTask = std::max(1, MinVerticesPerTask / (m_gridSizeX + 1));
+    size_t const taskCount = static_cast<size_t>((rowCount + rowsPerTask - 1) / rowsPerTask);
+
+    // Prepare the worker contexts on this thread, as they copy the current variables from the main context.
+    size_t const slotCount = std::min(taskCount, workerPool.Concurrency());
+    std::vector<PerPixelContext*> slotContexts(slotCount);
+    for (size_t slot = 0; slot < slotCount; slot++)
+    {
+        slotContexts[slot] = &perPixelContext.WorkerContext(slot);
+    }
+
+    workerPool.ParallelFor(taskCount, [&](size_t task, size_t slot) {
+        int const firstRow = static_cast<int>(task) * rowsPerTask;
+        int const lastRow = std::min(firstRow + rowsPerTask, rowCount);
+        CalculateMeshRows(presetState, perFrameContext, *slotContexts[slot], firstRow, lastRow, batched);
+    });
+}
+
+auto PerPixelMesh::ValidateBatchedResults(const PresetState& presetState, const PerFrameContext& perFrameContext,
+                                          PerPixelContext& perPixelContext) -> bool
+{
+    int const rowCount = m_gridSizeY + 1;
+
+    // Check the whole mesh on the first frame, then one row per frame.
+    int firstRow = 0;
+    int lastRow = rowCount;
+    if (m_batchValidationRow >= 0)
+    {
+        firstRow = m_batchValidationRow % rowCount;
+        lastRow = firstRow + 1;
+    }
+    m_batchValidationRow = lastRow % rowCount;
+
+    auto const first = m_vertices.begin() + firstRow * (m_gridSizeX + 1);
+    auto const last = m_vertices.begin() + lastRow * (m_gridSizeX + 1);
+    VertexList const batchedVertices(first, last);
+
+    CalculateMeshRows(presetState, perFrameContext, perPixelContext, firstRow, lastRow, false);
+
+    return std::equal(first, last, batchedVertices.begin(), [](const MeshVertex& vertex, const MeshVertex& batchedVertex) {
+        return PresetBatchEvaluator::MatchesReference(&vertex.x, &batchedVertex.x, sizeof(MeshVertex) / sizeof(float));
+    });
+}
+
+void PerPixelMesh::CalculateMeshRows(const PresetState& presetState,
+                                     const PerFrameContext& perFrameContext,
+                                     PerPixelContext& perPixelContext,
+                                     int firstRow, int lastRow,
+                                     bool batched)
+{
+    if (batched)
     {
+        CalculateMeshRowsBatched(presetState, perFrameContext, perPixelContext, firstRow, lastRow);
+        return;
+    }
+
+    // The motion variables were set to the per-frame values before. Only those referenced by the
+    // code can change from vertex to vertex, so only these need to be reset.
+    auto const& referenced = perPixelContext.referencedVariables;
+
+    int vertex = firstRow * (m_gridSizeX + 1);
+
+    for (int y = firstRow; y < lastRow; y++)
+    {
+        // Remaining rows keep the previous frame's values.
+        if (presetState.expressionWatchdog.CheckExpired())
+        {
+            return;
+        }
+
         for (int x = 0; x <= m_gridSizeX; x++)
         {
             auto& curVertex = m_vertices[vertex];
 
-            // Execute per-vertex/per-pixel code if the preset uses it.
-            if (perPixelContext.perPixelCodeHandle)
+            if (referenced.x)
             {
                 *perPixelContext.x = static_cast<double>(curVertex.x * 0.5f * presetState.renderContext.aspectX + 0.5f);
+            }
+            if (referenced.y)
+            {
                 *perPixelContext.y = static_cast<double>(curVertex.y * -0.5f * presetState.renderContext.aspectY + 0.5f);
+            }
+            if (referenced.rad)
+            {
                 *perPixelContext.rad = static_cast<double>(curVertex.radius);
+            }
+            if (referenced.ang)
+            {
                 *perPixelContext.ang = static_cast<double>(curVertex.angle);
+            }
+            if (referenced.zoom)
+            {
                 *perPixelContext.zoom = static_cast<double>(*perFrameContext.zoom);
+            }
+            if (referenced.zoomexp)
+            {
                 *perPixelContext.zoomexp = static_cast<double>(*perFrameContext.zoomexp);
+            }
+            if (referenced.rot)
+            {
                 *perPixelContext.rot = static_cast<double>(*perFrameContext.rot);
+            }
+            if (referenced.warp)
+            {
                 *perPixelContext.warp = static_cast<double>(*perFrameContext.warp);
+            }
+            if (referenced.cx)
+            {
                 *perPixelContext.cx = static_cast<double>(*perFrameContext.cx);
+            }
+            if (referenced.cy)
+            {
                 *perPixelContext.cy = static_cast<double>(*perFrameContext.cy);
+            }
+            if (referenced.dx)
+            {
                 *perPixelContext.dx = static_cast<double>(*perFrameContext.dx);
+            }
+            if (referenced.dy)
+            {
                 *perPixelContext.dy = static_cast<double>(*perFrameContext.dy);
+            }
+            if (referenced.sx)
+            {
                 *perPixelContext.sx = static_cast<double>(*perFrameContext.sx);
+            }
+            if (referenced.sy)
+            {
                 *perPixelContext.sy = static_cast<double>(*perFrameContext.sy);
+            }
+
+            perPixelContext.ExecutePerPixelCode(presetState.expressionWatchdog);
+
+            curVertex.zoom = static_cast<float>(*perPixelContext.zoom);
+            curVertex.zoomExp = static_cast<float>(*perPixelContext.zoomexp);
+            curVertex.rot = static_cast<float>(*perPixelContext.rot);
+            curVertex.warp = static_cast<float>(*perPixelContext.warp);
+            curVertex.centerX = static_cast<float>(*perPixelContext.cx);
+            curVertex.centerY = static_cast<float>(*perPixelContext.cy);
+            curVertex.distanceX = static_cast<float>(*perPixelContext.dx);
+            curVertex.distanceY = static_cast<float>(*perPixelContext.dy);
+            curVertex.stretchX = static_cast<float>(*perPixelContext.sx);
+            curVertex.stretchY = static_cast<float>(*perPixelContext.sy);
+
+            vertex++;
+        }
+    }
+}
+
+void PerPixelMesh::CalculateMeshRowsBatched(const PresetState& presetState,
+                                            const PerFrameContext& perFrameContext,
+                                            PerPixelContext& perPixelContext,
+                                            int firstRow, int lastRow)
+{
+    auto const& lanes = perPixelContext.batchLanes;
+    auto const& referenced = perPixelContext.referencedVariables;
+
+    int const firstVertex = firstRow * (m_gridSizeX + 1);
+    int const lastVertex = lastRow * (m_gridSizeX + 1);
+
+    // Motion variables not referenced by the code keep their value, so their lanes are only filled once.
+    struct MotionLane {
+        PresetBatchValue* lane;
+        PresetBatchValue value;
+        bool referenced;
+    };
+    std::array<MotionLane, 10> const motionLanes{{
+        {lanes.zoom, static_cast<PresetBatchValue>(*perFrameContext.zoom), referenced.zoom},
+        {lanes.zoomexp, static_cast<PresetBatchValue>(*perFrameContext.zoomexp), referenced.zoomexp},
+        {lanes.rot, static_cast<PresetBatchValue>(*perFrameContext.rot), referenced.rot},
+        {lanes.warp, static_cast<PresetBatchValue>(*perFrameContext.warp), referenced.warp},
+        {lanes.cx, static_cast<PresetBatchValue>(*perFrameContext.cx), referenced.cx},
+        {lanes.cy, static_cast<PresetBatchValue>(*perFrameContext.cy), referenced.cy},
+        {lanes.dx, static_cast<PresetBatchValue>(*perFrameContext.dx), referenced.dx},
+        {lanes.dy, static_cast<PresetBatchValue>(*perFrameContext.dy), referenced.dy},
+        {lanes.sx, static_cast<PresetBatchValue>(*perFrameContext.sx), referenced.sx},
+        {lanes.sy, static_cast<PresetBatchValue>(*perFrameContext.sy), referenced.sy},
+    }};
+
+    for (const auto& motionLane : motionLanes)
+    {
+        if (!motionLane.referenced)
+        {
+            std::fill_n(motionLane.lane, std::min(PresetBatchEvaluator::BatchSize, static_cast<size_t>(lastVertex - firstVertex)), motionLane.value);
+        }
+    }
+
+    for (int batchStart = firstVertex; batchStart < lastVertex; batchStart += static_cast<int>(PresetBatchEvaluator::BatchSize))
+    {
+        if (presetState.expressionWatchdog.CheckExpired())
+        {
+            return;
+        }
 
-                perPixelContext.ExecutePerPixelCode();
-
-                curVertex.zoom = static_cast<float>(*perPixelContext.zoom);
-                curVertex.zoomExp = static_cast<float>(*perPixelContext.zoomexp);
-                curVertex.rot = static_cast<float>(*perPixelContext.rot);
-                curVertex.warp = static_cast<float>(*perPixelContext.warp);
-                curVertex.centerX = static_cast<float>(*perPixelContext.cx);
-                curVertex.centerY = static_cast<float>(*perPixelContext.cy);
-                curVertex.distanceX = static_cast<float>(*perPixelContext.dx);
-                curVertex.distanceY = static_cast<float>(*perPixelContext.dy);
-                curVertex.stretchX = static_cast<float>(*perPixelContext.sx);
-                curVertex.stretchY = static_cast<float>(*perPixelContext.sy);
+        size_t const count = std::min(PresetBatchEvaluator::BatchSize, static_cast<size_t>(lastVertex - batchStart));
+        auto* const vertices = &m_vertices[batchStart];
+
+        // Same values and conversions as in the unbatched loop.
+        for (size_t lane = 0; lane < count; lane++)
+        {
+            if (referenced.x)
+            {
+                lanes.x[lane] = static_cast<PresetBatchValue>(vertices[lane].x * 0.5f * presetState.renderContext.aspectX + 0.5f);
             }
-            else
+            if (referenced.y)
+            {
+                lanes.y[lane] = static_cast<PresetBatchValue>(vertices[lane].y * -0.5f * presetState.renderContext.aspectY + 0.5f);
+            }
+            if (referenced.rad)
+            {
+                lanes.rad[lane] = static_cast<PresetBatchValue>(vertices[lane].radius);
+            }
+            if (referenced.ang)
             {
-                curVertex.zoom = zoom;
-                curVertex.zoomExp = zoomExp;
-                curVertex.rot = rot;
-                curVertex.warp = warp;
-                curVertex.centerX = cx;
-                curVertex.centerY = cy;
-                curVertex.distanceX = dx;
-                curVertex.distanceY = dy;
-                curVertex.stretchX = sx;
-                curVertex.stretchY = sy;
+                lanes.ang[lane] = static_cast<PresetBatchValue>(vertices[lane].angle);
             }
+        }
+        for (const auto& motionLane : motionLanes)
+        {
+            if (motionLane.referenced)
+            {
+                std::fill_n(motionLane.lane, count, motionLane.value);
+            }
+        }
 
-            vertex++;
+        perPixelContext.ExecutePerPixelCodeBatch(count);
+
+        for (size_t lane = 0; lane < count; lane++)
+        {
+            auto& curVertex = vertices[lane];
+            curVertex.zoom = static_cast<float>(lanes.zoom[lane]);
+            curVertex.zoomExp = static_cast<float>(lanes.zoomexp[lane]);
+            curVertex.rot = static_cast<float>(lanes.rot[lane]);
+            curVertex.warp = static_cast<float>(lanes.warp[lane]);
+            curVertex.centerX = static_cast<float>(lanes.cx[lane]);
+            curVertex.centerY = static_cast<float>(lanes.cy[lane]);
+            curVertex.distanceX = static_cast<float>(lanes.dx[lane]);
+            curVertex.distanceY = static_cast<float>(lanes.dy[lane]);
+            curVertex.stretchX = static_cast<float>(lanes.sx[lane]);
+            curVertex.stretchY = static_cast<float>(lanes.sy[lane]);
         }
     }
 }
 
 void PerPixelMesh::WarpedBlit(const PresetState& presetState,
-                              const PerFrameContext& perFrameContext)
+                              const PerFrameContext& perFrameContext,
+                              const PerPixelContext& perPixelContext)
 {
     // Warp stuff
     float const warpTime = presetState.renderContext.time * presetState.warpAnimSpeed;
@@ -321,22 +813,23 @@ void PerPixelMesh::WarpedBlit(const PresetState& presetState,
 
     if (!m_warpShader)
     {
-        m_perPixelMeshShader.Bind();
-        m_perPixelMeshShader.SetUniformMat4x4("vertex_transformation", PresetState::orthogonalProjection);
-        m_perPixelMeshShader.SetUniformInt("texture_sampler", 0);
-        m_perPixelMeshShader.SetUniformFloat4("aspect", {presetState.renderContext.aspectX,
-                                                         presetState.renderContext.aspectY,
-                                                         presetState.renderContext.invAspectX,
-                                                         presetState.renderContext.invAspectY});
-        m_perPixelMeshShader.SetUniformFloat("warpTime", warpTime);
-        m_perPixelMeshShader.SetUniformFloat("warpScaleInverse", warpScaleInverse);
-        m_perPixelMeshShader.SetUniformFloat4("warpFactors", warpFactors);
-        m_perPixelMeshShader.SetUniformFloat2("texelOffset", texelOffsets);
-        m_perPixelMeshShader.SetUniformFloat("decay", decay);
+        auto& shader = m_perPixelEquationsOnGpu ? m_perPixelEquationsShader : m_perPixelMeshShader;
+        shader.Bind();
+        shader.SetUniformMat4x4("vertex_transformation", PresetState::orthogonalProjection);
+        shader.SetUniformInt("texture_sampler", 0);
+        shader.SetUniformFloat4("aspect", {presetState.renderContext.aspectX,
+                                           presetState.renderContext.aspectY,
+                                           presetState.renderContext.invAspectX,
+                                           presetState.renderContext.invAspectY});
+        shader.SetUniformFloat("warpTime", warpTime);
+        shader.SetUniformFloat("warpScaleInverse", warpScaleInverse);
+        shader.SetUniformFloat4("warpFactors", warpFactors);
+        shader.SetUniformFloat2("texelOffset", texelOffsets);
+        shader.SetUniformFloat("decay", decay);
     }
     else
     {
-        m_warpShader->LoadVariables(presetState, perFrameContext);
+        m_warpShader->LoadVariables(presetState);
         auto& shader = m_warpShader->Shader();
         shader.SetUniformFloat4("aspect", {presetState.renderContext.aspectX,
                                            presetState.renderContext.aspectY,
@@ -349,6 +842,15 @@ void PerPixelMesh::WarpedBlit(const PresetState& presetState,
         shader.SetUniformFloat("decay", decay);
     }
 
+    if (m_perPixelEquationsOnGpu)
+    {
+        auto& shader = m_warpShader ? m_warpShader->Shader() : m_perPixelEquationsShader;
+        for (const auto& uniform : perPixelContext.GlslUniforms())
+        {
+            shader.SetUniformFloat(uniform.first.c_str(), static_cast<float>(*uniform.second));
+        }
+    }
+
     assert(!presetState.mainTexture.expired());
     presetState.mainTexture.lock()->Bind(0);
 
@@ -366,31 +868,9 @@ void PerPixelMesh::WarpedBlit(const PresetState& presetState,
     glBindVertexArray(m_vaoID);
     glBindBuffer(GL_ARRAY_BUFFER, m_vboID);
 
-    int trianglesPerBatch = static_cast<int>(m_drawVertices.size() / 3 - 4);
-    int triangleCount = m_gridSizeX * m_gridSizeY * 2; // Two triangles per quad/grid cell.
-    int sourceIndex = 0;
-
-    while (sourceIndex < triangleCount * 3)
-    {
-        int trianglesQueued = 0;
-        int vertex = 0;
-        while (trianglesQueued < trianglesPerBatch && sourceIndex < triangleCount * 3)
-        {
-            // Copy one triangle/3 vertices
-            for (int i = 0; i < 3; i++)
-            {
-                m_drawVertices[vertex++] = m_vertices[m_listIndices[sourceIndex++]];
-            }
-
-            trianglesQueued++;
-        }
-
-        if (trianglesQueued > 0)
-        {
-            glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(MeshVertex) * trianglesQueued * 3, m_drawVertices.data());
-            glDrawArrays(GL_TRIANGLES, 0, trianglesQueued * 3);
-        }
-    }
+    // Orphan the previous buffer contents, so the driver doesn't need to wait for the last draw call.
+    glBufferData(GL_ARRAY_BUFFER, sizeof(MeshVertex) * m_vertices.size(), m_vertices.data(), GL_STREAM_DRAW);
+    glDrawElements(GL_TRIANGLES, m_indexCount, GL_UNSIGNED_INT, nullptr);
 
     glBindVertexArray(0);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
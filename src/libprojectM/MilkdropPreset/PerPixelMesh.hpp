@@ -4,6 +4,9 @@
 #include <Renderer/Shader.hpp>
 
 #include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
 #include <vector>
 
 namespace libprojectM {
@@ -13,6 +16,7 @@ class PresetState;
 class PerFrameContext;
 class PerPixelContext;
 class MilkdropShader;
+class PerPixelEquationsValidator;
 
 /**
  * @brief The "per-pixel" transformation mesh.
@@ -32,6 +36,8 @@ class PerPixelMesh : public Renderer::RenderItem
 public:
     PerPixelMesh();
 
+    ~PerPixelMesh() override;
+
     void InitVertexAttrib() override;
 
     /**
@@ -40,14 +46,45 @@ public:
      */
     void LoadWarpShader(const PresetState& presetState);
 
+    /**
+     * @brief Loads the textures referenced by the warp shader.
+     * @param presetState The preset state to retrieve the textures from.
+     */
+    void LoadWarpShaderTextures(PresetState& presetState);
+
+    /**
+     * @brief Translates the warp shader into GLSL without using OpenGL.
+     * If the shader can't be translated, the preset is drawn without it.
+     * @param presetState The preset state to retrieve the blur textures from.
+     */
+    void TranspileWarpShader(const PresetState& presetState);
+
+    /**
+     * @brief Starts compiling the translated warp shader in the background, if supported.
+     * @return The program being compiled, or an empty pointer if there is none.
+     */
+    auto StartCompilingWarpShader() const -> Renderer::ShaderCache::ProgramPtr;
+
     /**
      * @brief Loads the required textures and compiles the warp shader.
+     *
+     * If the per-pixel code could be translated to GLSL, a validation program evaluating the code on
+     * the GPU is compiled. The code is only evaluated in the warp vertex shader after the GPU results
+     * matched the CPU results a few times, see Draw().
+     *
      * @param presetState The preset state to retrieve the configuration values from.
+     * @param perPixelContext The per-pixel code context with the translated per-pixel code.
      */
-    void CompileWarpShader(PresetState& presetState);
+    void CompileWarpShader(PresetState& presetState, const PerPixelContext& perPixelContext);
 
     /**
      * @brief Renders the transformation mesh.
+     *
+     * While the per-pixel code is evaluated on the CPU, the results are compared to the GPU results
+     * if a validation program is available. After GpuProbationValidations matching frames, the code is
+     * evaluated in the warp vertex shader, and one mesh row is still compared every GpuValidationInterval
+     * frames. On the first mismatch, the code is evaluated on the CPU for the rest of the preset's lifetime.
+     *
      * @param presetState The preset state to retrieve the configuration values from.
      * @param presetPerFrameContext The per-frame context to retrieve the initial vars from.
      * @param perPixelContext The per-pixel code context to use.
@@ -58,6 +95,9 @@ public:
 
 
 private:
+    static constexpr int GpuProbationValidations{3}; //!< Number of matching whole-mesh GPU validations before evaluating the per-pixel code on the GPU.
+    static constexpr int GpuValidationInterval{30};  //!< Number of frames between validating a single mesh row while evaluating on the GPU.
+
     /**
      * Warp mesh vertex with all required attributes.
      */
@@ -94,9 +134,22 @@ private:
      */
     void InitializeMesh(const PresetState& presetState);
 
+    /**
+     * @brief Generates the triangle list indices for the current grid size and uploads them into the element buffer.
+     */
+    void InitializeIndices();
+
+    /**
+     * @brief Loads the per-frame motion values into the per-pixel context.
+     * @param presetPerFrameContext The per-frame context to retrieve the initial vars from.
+     * @param perPixelContext The per-pixel code context to use.
+     */
+    void LoadPerFrameMotionVariables(const PerFrameContext& perFrameContext, PerPixelContext& perPixelContext);
+
     /**
      * @brief Executes the per-pixel code and calculates the u/v coordinates.
      * The x/y coordinates are either a static grid or computed by the per-vertex expression.
+     * Code which doesn't depend on the vertex position is only executed once for the whole mesh.
      * @param presetState The preset state to retrieve the configuration values from.
      * @param presetPerFrameContext The per-frame context to retrieve the initial vars from.
      * @param perPixelContext The per-pixel code context to use.
@@ -105,11 +158,106 @@ private:
                        const PerFrameContext& perFrameContext,
                        PerPixelContext& perPixelContext);
 
+    /**
+     * @brief Executes the per-pixel code for all vertices, using multiple threads if possible.
+     * @param presetState The preset state to retrieve the configuration values from.
+     * @param presetPerFrameContext The per-frame context to retrieve the initial vars from.
+     * @param perPixelContext The per-pixel code context to use.
+     * @param batched If true, the code is executed using the batched evaluator.
+     */
+    void ExecutePerPixelCode(const PresetState& presetState,
+                             const PerFrameContext& perFrameContext,
+                             PerPixelContext& perPixelContext,
+                             bool batched);
+
+    /**
+     * @brief Recalculates some vertices using the expression library and compares them to the batched results.
+     *
+     * The whole mesh is checked on the first frame, then one row per frame.
+     *
+     * @param presetState The preset state to retrieve the configuration values from.
+     * @param presetPerFrameContext The per-frame context to retrieve the initial vars from.
+     * @param perPixelContext The per-pixel code context to use.
+     * @return True if the results match, see BatchEvaluator::MatchesReference(), false if not.
+     */
+    auto ValidateBatchedResults(const PresetState& presetState,
+                                const PerFrameContext& perFrameContext,
+                                PerPixelContext& perPixelContext) -> bool;
+
+    /**
+     * @brief Executes the per-pixel code for a range of mesh rows.
+     * @param presetState The preset state to retrieve the configuration values from.
+     * @param presetPerFrameContext The per-frame context to retrieve the initial vars from.
+     * @param perPixelContext The per-pixel code context to use.
+     * @param firstRow The first row to calculate.
+     * @param lastRow The row after the last row to calculate.
+     * @param batched If true, the code is executed using the batched evaluator.
+     */
+    void CalculateMeshRows(const PresetState& presetState,
+                           const PerFrameContext& perFrameContext,
+                           PerPixelContext& perPixelContext,
+                           int firstRow, int lastRow,
+                           bool batched);
+
+    /**
+     * @brief Executes the per-pixel code for a range of mesh rows in batches of vertices.
+     * @param presetState The preset state to retrieve the configuration values from.
+     * @param presetPerFrameContext The per-frame context to retrieve the initial vars from.
+     * @param perPixelContext The per-pixel code context to use.
+     * @param firstRow The first row to calculate.
+     * @param lastRow The row after the last row to calculate.
+     */
+    void CalculateMeshRowsBatched(const PresetState& presetState,
+                                  const PerFrameContext& perFrameContext,
+                                  PerPixelContext& perPixelContext,
+                                  int firstRow, int lastRow);
+
+    /**
+     * @brief Links the warp shader with the vertex shader evaluating the per-pixel code.
+     * @param perPixelContext The per-pixel code context with the translated per-pixel code.
+     * @return True if the per-pixel code is now evaluated on the GPU, false if compiling failed.
+     */
+    auto EnableGpuPerPixelEquations(const PerPixelContext& perPixelContext) -> bool;
+
+    /**
+     * @brief Stops evaluating the per-pixel code on the GPU and drops the validation program.
+     */
+    void DisableGpuPerPixelEquations();
+
+    /**
+     * @brief Checks the result of the last GPU validation and switches between CPU and GPU evaluation.
+     * @param perPixelContext The per-pixel code context with the translated per-pixel code.
+     */
+    void CheckGpuValidation(const PerPixelContext& perPixelContext);
+
+    /**
+     * @brief Submits the CPU results of a range of mesh rows for comparison with the GPU results.
+     * @param presetState The preset state to retrieve the configuration values from.
+     * @param uniforms The values of the translated code's uniforms the CPU results were calculated with.
+     * @param firstRow The first row to compare.
+     * @param lastRow The row after the last row to compare.
+     */
+    void SubmitGpuValidation(const PresetState& presetState,
+                             const std::vector<std::pair<std::string, float>>& uniforms,
+                             int firstRow, int lastRow);
+
+    /**
+     * @brief Returns the current values of the translated code's uniforms.
+     * @param perPixelContext The per-pixel code context with the translated per-pixel code.
+     * @return The uniform names and values.
+     */
+    static auto GpuUniformValues(const PerPixelContext& perPixelContext) -> std::vector<std::pair<std::string, float>>;
+
     /**
      * @brief Draws the warp mesh with or without a warp shader.
      * If the preset doesn't use a warp shader, a default textured shader is used.
+     * @param presetState The preset state to retrieve the configuration values from.
+     * @param presetPerFrameContext The per-frame context to retrieve the initial vars from.
+     * @param perPixelContext The per-pixel code context with the GPU per-pixel code uniform values.
      */
-    void WarpedBlit(const PresetState& presetState, const PerFrameContext& perFrameContext);
+    void WarpedBlit(const PresetState& presetState,
+                    const PerFrameContext& perFrameContext,
+                    const PerPixelContext& perPixelContext);
 
     int m_gridSizeX{}; //!< Warp mesh X resolution.
     int m_gridSizeY{}; //!< Warp mesh Y resolution.
@@ -119,10 +267,18 @@ private:
 
     VertexList m_vertices; //!< The calculated mesh vertices.
 
-    std::vector<int> m_listIndices; //!< List of vertex indices to render.
-    VertexList m_drawVertices;      //!< Temp data buffer for the vertices to be drawn.
+    int m_batchValidationRow{-1}; //!< Next mesh row to check batched per-pixel results for, -1 to check the whole mesh.
+
+    GLuint m_elementBuffer{}; //!< Element buffer holding the triangle list indices of the mesh.
+    GLsizei m_indexCount{};   //!< Number of indices in the element buffer.
 
     Renderer::Shader m_perPixelMeshShader;                            //!< Special shader which calculates the per-pixel UV coordinates.
+    Renderer::Shader m_perPixelEquationsShader;                       //!< Same as m_perPixelMeshShader, but also evaluates the per-pixel code.
+    bool m_perPixelEquationsOnGpu{false};                             //!< True if the per-pixel code is evaluated in the vertex shader.
+    std::unique_ptr<PerPixelEquationsValidator> m_gpuValidator;       //!< Compares GPU and CPU per-pixel results. Null if the code can't be evaluated on the GPU.
+    int m_gpuMatchCount{};                                            //!< Number of matching whole-mesh validations so far.
+    int m_gpuValidationFrame{};                                       //!< Frames since the last validation while evaluating on the GPU.
+    int m_gpuValidationRow{};                                         //!< Next mesh row to validate while evaluating on the GPU.
     std::unique_ptr<MilkdropShader> m_warpShader;           //!< The warp shader. Either preset-defined or a default shader.
     Renderer::Sampler m_perPixelSampler{GL_CLAMP_TO_EDGE, GL_LINEAR}; //!< The main texture sampler.
 };
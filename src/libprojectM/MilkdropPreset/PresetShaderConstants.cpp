@@ -0,0 +1,173 @@
+#include "PresetShaderConstants.hpp"
+
+#include "BlurTexture.hpp"
+#include "PerFrameContext.hpp"
+#include "PresetState.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/mat4x4.hpp>
+
+#include <cmath>
+#include <cstdlib>
+
+namespace libprojectM {
+namespace MilkdropPreset {
+
+constexpr GLuint PresetShaderConstants::BindingPoint;
+const char* const PresetShaderConstants::BlockName = "PresetShaderConstants";
+
+namespace {
+
+auto FloatRand() -> float
+{
+    return static_cast<float>(rand() % 7381) / 7380.0f;
+}
+
+auto RotationMatrix(const glm::vec3& angles, const glm::vec3& translation) -> glm::mat3x4
+{
+    glm::mat4 const rotationX = glm::rotate(glm::mat4(1.0f), angles.x, glm::vec3(1.0f, 0.0f, 0.0f));
+    glm::mat4 const rotationY = glm::rotate(glm::mat4(1.0f), angles.y, glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4 const rotationZ = glm::rotate(glm::mat4(1.0f), angles.z, glm::vec3(0.0f, 0.0f, 1.0f));
+
+    glm::mat4 const randomTranslation = glm::translate(glm::mat4(1.0f), translation);
+
+    return glm::mat3x4(rotationY * (rotationZ * (randomTranslation * rotationX)));
+}
+
+} // anonymous namespace
+
+PresetShaderConstants::PresetShaderConstants()
+    : m_randValues(FloatRand(), FloatRand(), FloatRand(), FloatRand())
+{
+    static_assert(sizeof(Block) == (2 + 14 + QVarCount / 4) * sizeof(glm::vec4) + 24 * sizeof(glm::mat3x4),
+                  "The constants block must not contain any padding.");
+
+    for (size_t index = 0; index < m_randTranslation.size(); index++)
+    {
+        float const rotMult = 0.9f * powf(static_cast<float>(index) / 8.0f, 3.2f);
+        m_randTranslation[index] = {FloatRand() * 2 - 1, FloatRand() * 2 - 1, FloatRand() * 2 - 1};
+        m_randRotationCenters[index] = {FloatRand() * 6.28f, FloatRand() * 6.28f, FloatRand() * 6.28f};
+        m_randRotationSpeeds[index] = {(FloatRand() * 2 - 1) * rotMult, (FloatRand() * 2 - 1) * rotMult, (FloatRand() * 2 - 1) * rotMult};
+    }
+
+    glGenBuffers(1, &m_uboID);
+    glBindBuffer(GL_UNIFORM_BUFFER, m_uboID);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(Block), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+PresetShaderConstants::~PresetShaderConstants()
+{
+    glDeleteBuffers(1, &m_uboID);
+}
+
+void PresetShaderConstants::Update(const PresetState& presetState, const PerFrameContext& perFrameContext)
+{
+    // These are the inputs: http://www.geisswerks.com/milkdrop/milkdrop_preset_authoring.html#3f6
+
+    auto floatTime = static_cast<float>(presetState.renderContext.time);
+    auto timeSincePresetStartWrapped = floatTime - static_cast<int>(floatTime / 10000.0) * 10000;
+    auto mipX = logf(static_cast<float>(presetState.renderContext.viewportSizeX)) / logf(2.0f);
+    auto mipY = logf(static_cast<float>(presetState.renderContext.viewportSizeY)) / logf(2.0f);
+    auto mipAvg = 0.5f * (mipX + mipY);
+
+    BlurTexture::Values blurMin;
+    BlurTexture::Values blurMax;
+    BlurTexture::GetSafeBlurMinMaxValues(perFrameContext, blurMin, blurMax);
+
+    Block block;
+
+    block.randFrame = {FloatRand(), FloatRand(), FloatRand(), FloatRand()};
+    block.randPreset = m_randValues;
+
+    block.c[0] = {presetState.renderContext.aspectX,
+                  presetState.renderContext.aspectY,
+                  1.0f / presetState.renderContext.aspectX,
+                  1.0f / presetState.renderContext.aspectY};
+    block.c[1] = {0.0, 0.0, 0.0, 0.0};
+    block.c[2] = {timeSincePresetStartWrapped,
+                  presetState.renderContext.fps,
+                  presetState.renderContext.frame,
+                  presetState.renderContext.progress};
+    block.c[3] = {presetState.audioData->Bass() / 100,
+                  presetState.audioData->Mid() / 100,
+                  presetState.audioData->Treb() / 100,
+                  presetState.audioData->Vol() / 100};
+    block.c[4] = {presetState.audioData->BassAtt() / 100,
+                  presetState.audioData->MidAtt() / 100,
+                  presetState.audioData->TrebAtt() / 100,
+                  presetState.audioData->VolAtt() / 100};
+    block.c[5] = {blurMax[0] - blurMin[0],
+                  blurMin[0],
+                  blurMax[1] - blurMin[1],
+                  blurMin[1]};
+    block.c[6] = {blurMax[2] - blurMin[2],
+                  blurMin[2],
+                  blurMin[0],
+                  blurMax[0]};
+    block.c[7] = {presetState.renderContext.viewportSizeX,
+                  presetState.renderContext.viewportSizeY,
+                  1.0f / static_cast<float>(presetState.renderContext.viewportSizeX),
+                  1.0f / static_cast<float>(presetState.renderContext.viewportSizeY)};
+    block.c[8] = {0.5f + 0.5f * cosf(floatTime * 0.329f + 1.2f),
+                  0.5f + 0.5f * cosf(floatTime * 1.293f + 3.9f),
+                  0.5f + 0.5f * cosf(floatTime * 5.070f + 2.5f),
+                  0.5f + 0.5f * cosf(floatTime * 20.051f + 5.4f)};
+    block.c[9] = {0.5f + 0.5f * sinf(floatTime * 0.329f + 1.2f),
+                  0.5f + 0.5f * sinf(floatTime * 1.293f + 3.9f),
+                  0.5f + 0.5f * sinf(floatTime * 5.070f + 2.5f),
+                  0.5f + 0.5f * sinf(floatTime * 20.051f + 5.4f)};
+    block.c[10] = {0.5f + 0.5f * cosf(floatTime * 0.0050f + 2.7f),
+                   0.5f + 0.5f * cosf(floatTime * 0.0085f + 5.3f),
+                   0.5f + 0.5f * cosf(floatTime * 0.0133f + 4.5f),
+                   0.5f + 0.5f * cosf(floatTime * 0.0217f + 3.8f)};
+    block.c[11] = {0.5f + 0.5f * sinf(floatTime * 0.0050f + 2.7f),
+                   0.5f + 0.5f * sinf(floatTime * 0.0085f + 5.3f),
+                   0.5f + 0.5f * sinf(floatTime * 0.0133f + 4.5f),
+                   0.5f + 0.5f * sinf(floatTime * 0.0217f + 3.8f)};
+    block.c[12] = {mipX,
+                   mipY,
+                   mipAvg,
+                   0};
+    block.c[13] = {blurMin[1],
+                   blurMax[1],
+                   blurMin[2],
+                   blurMax[2]};
+
+    // _qa.x, _qa.y, _qa.z, _qa.w, _qb.x, _qb.y ... alias q1 to q32
+    for (int i = 0; i < QVarCount; i += 4)
+    {
+        block.q[i / 4] = {presetState.frameQVariables[i],
+                          presetState.frameQVariables[i + 1],
+                          presetState.frameQVariables[i + 2],
+                          presetState.frameQVariables[i + 3]};
+    }
+
+    // rot_s1 to rot_uf4 rotate at different speeds around random centers.
+    for (size_t i = 0; i < m_randTranslation.size(); i++)
+    {
+        block.rot[i] = RotationMatrix(m_randRotationCenters[i] + m_randRotationSpeeds[i] * floatTime, m_randTranslation[i]);
+    }
+
+    // The last 4 are totally random, each frame
+    for (size_t i = m_randTranslation.size(); i < block.rot.size(); i++)
+    {
+        glm::vec3 const angles{FloatRand() * 6.28f, FloatRand() * 6.28f, FloatRand() * 6.28f};
+        block.rot[i] = RotationMatrix(angles, {FloatRand(), FloatRand(), FloatRand()});
+    }
+
+    // Orphan the previous contents, so the driver doesn't need to wait for the last frame's draw calls.
+    glBindBuffer(GL_UNIFORM_BUFFER, m_uboID);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(Block), &block, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    Bind();
+}
+
+void PresetShaderConstants::Bind() const
+{
+    glBindBufferBase(GL_UNIFORM_BUFFER, BindingPoint, m_uboID);
+}
+
+} // namespace MilkdropPreset
+} // namespace libprojectM
@@ -0,0 +1,85 @@
+/**
+ * @file PresetShaderConstants.hpp
+ * @brief Holds the per-frame constants of the Milkdrop warp and composite shaders.
+ */
+#pragma once
+
+#include "Constants.hpp"
+
+#include <projectM-opengl.h>
+
+#include <glm/mat3x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#include <array>
+
+namespace libprojectM {
+namespace MilkdropPreset {
+
+class PerFrameContext;
+class PresetState;
+
+/**
+ * @brief Holds the per-frame constants of the Milkdrop warp and composite shaders.
+ *
+ * The constants (_c0 to _c13, the q variables, the random values and the rot_* matrices) are the
+ * same for both preset shaders. They're calculated once per frame and uploaded into a single
+ * uniform buffer, which is bound to the "PresetShaderConstants" uniform block of both shaders.
+ */
+class PresetShaderConstants
+{
+public:
+    static constexpr GLuint BindingPoint{0}; //!< Uniform buffer binding point of the constants block.
+    static const char* const BlockName;     //!< Name of the uniform block in the preset shader header.
+
+    /**
+     * @brief Constructor. Creates the uniform buffer and the per-preset random values.
+     */
+    PresetShaderConstants();
+
+    /**
+     * @brief Destructor. Deletes the uniform buffer.
+     */
+    ~PresetShaderConstants();
+
+    PresetShaderConstants(const PresetShaderConstants&) = delete;
+    auto operator=(const PresetShaderConstants&) -> PresetShaderConstants& = delete;
+
+    /**
+     * @brief Calculates the constants for the current frame and uploads them into the uniform buffer.
+     * Also binds the buffer.
+     * @param presetState The preset state to pull the values from.
+     * @param perFrameContext The per-frame context with dynamically calculated values.
+     */
+    void Update(const PresetState& presetState, const PerFrameContext& perFrameContext);
+
+    /**
+     * @brief Binds the uniform buffer to the constants binding point.
+     */
+    void Bind() const;
+
+private:
+    /**
+     * @brief The uniform block contents, in std140 layout.
+     *
+     * The member order must match the PresetShaderConstants cbuffer in PresetShaderHeaderGlsl330.inc.
+     */
+    struct Block {
+        glm::vec4 randFrame;                    //!< rand_frame
+        glm::vec4 randPreset;                   //!< rand_preset
+        std::array<glm::vec4, 14> c;            //!< _c0 to _c13
+        std::array<glm::vec4, QVarCount / 4> q; //!< _qa to _qh
+        std::array<glm::mat3x4, 24> rot;        //!< rot_s1 to rot_rand4
+    };
+
+    GLuint m_uboID{}; //!< The uniform buffer object ID.
+
+    glm::vec4 m_randValues{};                          //!< Random values which don't change every frame.
+    std::array<glm::vec3, 20> m_randTranslation{};     //!< Random translation vectors which don't change every frame.
+    std::array<glm::vec3, 20> m_randRotationCenters{}; //!< Random rotation center vectors which don't change every frame.
+    std::array<glm::vec3, 20> m_randRotationSpeeds{};  //!< Random rotation speeds which don't change every frame.
+};
+
+} // namespace MilkdropPreset
+} // namespace libprojectM
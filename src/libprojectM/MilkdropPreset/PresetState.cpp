@@ -21,6 +21,10 @@ PresetState::PresetState()
                                     staticShaders->GetUntexturedDrawFragmentShader());
     texturedShader.CompileProgram(staticShaders->GetTexturedDrawVertexShader(),
                                   staticShaders->GetTexturedDrawFragmentShader());
+    untexturedShapeShader.CompileProgram(staticShaders->GetShapeVertexShader(),
+                                         staticShaders->GetUntexturedDrawFragmentShader());
+    texturedShapeShader.CompileProgram(staticShaders->GetShapeVertexShader(),
+                                       staticShaders->GetTexturedDrawFragmentShader());
 
     std::random_device randomDevice;
     std::mt19937 randomGenerator(randomDevice());
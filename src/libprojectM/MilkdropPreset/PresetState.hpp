@@ -8,6 +8,8 @@
 #include "Constants.hpp"
 
 #include "BlurTexture.hpp"
+#include "ExpressionWatchdog.hpp"
+#include "PresetShaderConstants.hpp"
 
 #include <Audio/FrameAudioData.hpp>
 
@@ -130,8 +132,8 @@ public:
     double globalRegisters[100]{};                   //!< Global reg00-reg99 variables.
     std::array<double, QVarCount> frameQVariables{}; //!< Q variables after per-frame code evaluation.
 
-    libprojectM::Audio::FrameAudioData audioData; //!< Holds audio/spectrum data and values for beat detection.
-    Renderer::RenderContext renderContext;        //!< Current renderer state data like viewport size and generic shaders.
+    libprojectM::Audio::FrameAudioData::Ptr audioData{std::make_shared<libprojectM::Audio::FrameAudioData>()}; //!< Shared audio/spectrum data and values for beat detection.
+    Renderer::RenderContext renderContext;                                                                      //!< Current renderer state data like viewport size and generic shaders.
 
     std::string perFrameInitCode; //!< Preset init code, run once on load.
     std::string perFrameCode;     //!< Preset per-frame code, run once at the start of each frame.
@@ -147,11 +149,15 @@ public:
     std::string warpShader;      //!< Warp shader code.
     std::string compositeShader; //!< Composite shader code.
 
-    Renderer::Shader untexturedShader; //!< Shader used to draw untextured primitives, e.g. waveforms.
-    Renderer::Shader texturedShader;   //!< Shader used to draw textured primitives, e.g. textured shapes and the warp mesh.
+    Renderer::Shader untexturedShader;      //!< Shader used to draw untextured primitives, e.g. waveforms.
+    Renderer::Shader texturedShader;        //!< Shader used to draw textured primitives, e.g. textured shapes and the warp mesh.
+    Renderer::Shader untexturedShapeShader; //!< Shader used to draw instanced untextured custom shapes.
+    Renderer::Shader texturedShapeShader;   //!< Shader used to draw instanced textured custom shapes.
 
     std::weak_ptr<Renderer::Texture> mainTexture; //!< A weak reference to the main texture in the preset framebuffer.
     BlurTexture blurTexture;                      //!< The blur textures used in this preset. Contents depend on the shader code using GetBlurX().
+    ExpressionWatchdog expressionWatchdog;        //!< Limits the time spent evaluating expression code in each frame.
+    PresetShaderConstants shaderConstants;        //!< Per-frame constants of the warp and composite shaders.
 
     std::map<int, Renderer::TextureSamplerDescriptor> randomTextureDescriptors; //!< Descriptors for random texture IDs. Should be the same across both warp and comp shaders.
 
@@ -0,0 +1,9 @@
+precision mediump float;
+
+// Only needed to link the per-pixel validation program, which is drawn with rasterization disabled.
+
+out vec4 color;
+
+void main() {
+    color = vec4(0.0);
+}
@@ -0,0 +1,34 @@
+precision highp float;
+
+// Evaluates the translated preset per-pixel code for a list of mesh vertices. The results are
+// captured with transform feedback and compared to the CPU results by PerPixelEquationsValidator.
+
+layout(location = 0) in vec2 vertex_position;
+layout(location = 1) in vec2 rad_ang;
+
+uniform vec4 aspect;
+
+out float result_zoom;
+out float result_zoomexp;
+out float result_rot;
+out float result_warp;
+out float result_cx;
+out float result_cy;
+out float result_dx;
+out float result_dy;
+out float result_sx;
+out float result_sy;
+
+// Translated preset per-pixel code, appended to this shader by PerPixelEquationsValidator.
+void PerPixelEquations(float x, float y, float rad, float ang,
+                       out float zoom, out float zoomexp, out float rot, out float warp,
+                       out float cx, out float cy, out float dx, out float dy, out float sx, out float sy);
+
+void main() {
+    // Same inputs as in the warp vertex shader.
+    PerPixelEquations(vertex_position.x * 0.5 * aspect.x + 0.5, vertex_position.y * -0.5 * aspect.y + 0.5, rad_ang.x, rad_ang.y,
+                      result_zoom, result_zoomexp, result_rot, result_warp,
+                      result_cx, result_cy, result_dx, result_dy, result_sx, result_sy);
+
+    gl_Position = vec4(0.0, 0.0, 0.0, 1.0);
+}
@@ -1,12 +1,13 @@
+#ifdef PER_PIXEL_EQUATIONS
+// The per-pixel code inputs must be calculated in full precision, same as for the validation on the CPU.
+precision highp float;
+#else
 precision mediump float;
+#endif
 
 #define pos vertex_position
 #define radius rad_ang.x
 #define angle rad_ang.y
-#define zoom transforms.x
-#define zoomExp transforms.y
-#define rot transforms.z
-#define warp transforms.w
 
 #define aspectX aspect.x
 #define aspectY aspect.y
@@ -32,9 +33,30 @@ out vec4 frag_COLOR;
 out vec4 frag_TEXCOORD0;
 out vec2 frag_TEXCOORD1;
 
+#ifdef PER_PIXEL_EQUATIONS
+// Translated preset per-pixel code, appended to this shader by PerPixelMesh.
+void PerPixelEquations(float x, float y, float rad, float ang,
+                       out float zoom, out float zoomexp, out float rot, out float warp,
+                       out float cx, out float cy, out float dx, out float dy, out float sx, out float sy);
+#endif
+
 void main() {
     gl_Position = vertex_transformation * vec4(pos, 0.0, 1.0);
 
+    float zoom = transforms.x;
+    float zoomExp = transforms.y;
+    float rot = transforms.z;
+    float warp = transforms.w;
+    vec2 center = warp_center;
+    vec2 translation = warp_distance;
+    vec2 stretchXY = stretch;
+
+#ifdef PER_PIXEL_EQUATIONS
+    PerPixelEquations(pos.x * 0.5 * aspectX + 0.5, pos.y * -0.5 * aspectY + 0.5, radius, angle,
+                      zoom, zoomExp, rot, warp,
+                      center.x, center.y, translation.x, translation.y, stretchXY.x, stretchXY.y);
+#endif
+
     float zoom2 = pow(zoom, pow(zoomExp, radius * 2.0 - 1.0));
     float zoom2Inverse = 1.0 / zoom2;
 
@@ -47,8 +69,8 @@ void main() {
                             pos.y * 0.5 + 0.5 + texelOffset.y);
 
     // Stretch on X, Y
-    u = (u - warp_center.x) / stretch.x + warp_center.x;
-    v = (v - warp_center.y) / stretch.y + warp_center.y;
+    u = (u - center.x) / stretchXY.x + center.x;
+    v = (v - center.y) / stretchXY.y + center.y;
 
     // Warping
     u += warp * 0.0035 * sin(warpTime * 0.333 + warpScaleInverse * (pos.x * warpFactors.x - pos.y * warpFactors.w));
@@ -57,17 +79,17 @@ void main() {
     v += warp * 0.0035 * sin(warpTime * 0.825 + warpScaleInverse * (pos.x * warpFactors.x + pos.y * warpFactors.w));
 
     // Rotation
-    float u2 = u - warp_center.x;
-    float v2 = v - warp_center.y;
+    float u2 = u - center.x;
+    float v2 = v - center.y;
 
     float cosRotation = cos(rot);
     float sinRotation = sin(rot);
-    u = u2 * cosRotation - v2 * sinRotation + warp_center.x;
-    v = u2 * sinRotation + v2 * cosRotation + warp_center.y;
+    u = u2 * cosRotation - v2 * sinRotation + center.x;
+    v = u2 * sinRotation + v2 * cosRotation + center.y;
 
     // Translation
-    u -= warp_distance.x;
-    v -= warp_distance.y;
+    u -= translation.x;
+    v -= translation.y;
 
     // Undo aspect ratio fix
     u = (u - 0.5) * invAspectX + 0.5;
@@ -0,0 +1,38 @@
+precision highp float;
+
+// Unit circle corner (x, y) and 0.0 for the center vertex or 1.0 for the rim vertices.
+layout(location = 0) in vec3 vertex_corner;
+
+// Per-instance attributes.
+layout(location = 1) in vec4 instance_position; // Center x, center y, radius & angle
+layout(location = 2) in vec2 instance_texture;  // Texture angle & zoom
+layout(location = 3) in vec4 instance_color;
+layout(location = 4) in vec4 instance_color2;
+layout(location = 5) in vec4 instance_border_color;
+
+uniform mat4 vertex_transformation;
+uniform float aspect_y;
+uniform float texture_aspect_y;
+uniform vec2 position_offset;
+uniform bool draw_border;
+
+out vec4 fragment_color;
+out vec2 fragment_texture;
+
+vec2 rotate(vec2 corner, float angle)
+{
+    float c = cos(angle);
+    float s = sin(angle);
+    return vec2(corner.x * c - corner.y * s, corner.y * c + corner.x * s);
+}
+
+void main(){
+    vec2 rim = rotate(vertex_corner.xy, instance_position.w);
+    vec2 position = instance_position.xy + instance_position.z * vec2(rim.x * aspect_y, rim.y) + position_offset;
+
+    vec2 texture_rim = rotate(vertex_corner.xy, instance_texture.x) * 0.5 / instance_texture.y;
+
+    gl_Position = vertex_transformation * vec4(position, 0.0, 1.0);
+    fragment_color = draw_border ? instance_border_color : mix(instance_color, instance_color2, vertex_corner.z);
+    fragment_texture = vec2(0.5 + texture_rim.x * texture_aspect_y, 0.5 + texture_rim.y);
+}
@@ -1,8 +1,10 @@
 #include "ShapePerFrameContext.hpp"
 
+#include "CodeAnalysis.hpp"
 #include "CustomShape.hpp"
 #include "MilkdropPresetExceptions.hpp"
 #include "PerFrameContext.hpp"
+#include "WorkerPool.hpp"
 
 #ifdef MILKDROP_PRESET_DEBUG
 #include <iostream>
@@ -14,8 +16,37 @@
 namespace libprojectM {
 namespace MilkdropPreset {
 
+namespace {
+
+/**
+ * Returns the variables set by LoadStateVariables() before executing the per-frame code for each instance.
+ */
+auto PerInstanceVariables() -> CodeAnalysis::VariableSet
+{
+    CodeAnalysis::VariableSet variables{
+        "time", "fps", "frame", "progress", "bass", "mid", "treb", "bass_att", "mid_att", "treb_att",
+        "x", "y", "rad", "ang", "tex_ang", "tex_zoom", "sides", "textured", "instance", "num_inst",
+        "additive", "thick", "r", "g", "b", "a", "r2", "g2", "b2", "a2",
+        "border_r", "border_g", "border_b", "border_a"};
+
+    for (int q = 0; q < QVarCount; q++)
+    {
+        variables.insert("q" + std::to_string(q + 1));
+    }
+    for (int t = 0; t < TVarCount; t++)
+    {
+        variables.insert("t" + std::to_string(t + 1));
+    }
+
+    return variables;
+}
+
+} // namespace
+
 ShapePerFrameContext::ShapePerFrameContext(projectm_eval_mem_buffer gmegabuf, PRJM_EVAL_F (*globalRegisters)[100])
     : perFrameCodeContext(projectm_eval_context_create(gmegabuf, globalRegisters))
+    , m_gmegabuf(gmegabuf)
+    , m_globalRegisters(globalRegisters)
 {
 }
 
@@ -92,12 +123,12 @@ void ShapePerFrameContext::LoadStateVariables(const PresetState& state,
     *frame = static_cast<double>(state.renderContext.frame);
     *fps = static_cast<double>(state.renderContext.fps);
     *progress = static_cast<double>(state.renderContext.progress);
-    *bass = static_cast<double>(state.audioData.bass);
-    *mid = static_cast<double>(state.audioData.mid);
-    *treb = static_cast<double>(state.audioData.treb);
-    *bass_att = static_cast<double>(state.audioData.bassAtt);
-    *mid_att = static_cast<double>(state.audioData.midAtt);
-    *treb_att = static_cast<double>(state.audioData.trebAtt);
+    *bass = static_cast<double>(state.audioData->Bass());
+    *mid = static_cast<double>(state.audioData->Mid());
+    *treb = static_cast<double>(state.audioData->Treb());
+    *bass_att = static_cast<double>(state.audioData->BassAtt());
+    *mid_att = static_cast<double>(state.audioData->MidAtt());
+    *treb_att = static_cast<double>(state.audioData->TrebAtt());
 
     for (int q = 0; q < QVarCount; q++)
     {
@@ -133,6 +164,21 @@ void ShapePerFrameContext::LoadStateVariables(const PresetState& state,
     *border_g = static_cast<double>(shape.m_border_g);
     *border_b = static_cast<double>(shape.m_border_b);
     *border_a = static_cast<double>(shape.m_border_a);
+
+    for (auto& variable : m_instanceVariables)
+    {
+        variable.second = *variable.first;
+    }
+}
+
+void ShapePerFrameContext::LoadInstanceVariables(int inst)
+{
+    for (const auto& variable : m_instanceVariables)
+    {
+        *variable.first = variable.second;
+    }
+
+    *instance = static_cast<double>(inst);
 }
 
 void ShapePerFrameContext::EvaluateInitCode(const std::string& perFrameInitCode,
@@ -184,16 +230,124 @@ void ShapePerFrameContext::CompilePerFrameCode(const std::string& perFrameCode,
 #endif
         throw MilkdropCompileException("Could not compile custom shape " + std::to_string(shape.m_index) + " per-frame code");
     }
+
+    m_perFrameJit = ExpressionJit::Compile(perFrameCode, perFrameCodeContext);
+
+    m_perFrameCode = perFrameCode;
+
+    CodeAnalysis const analysis(perFrameCode);
+    auto const perInstanceVariables = PerInstanceVariables();
+    m_canExecuteInParallel = analysis.IsParallelSafe(perInstanceVariables);
+
+    // Builtin variables not written by the code keep their loaded values from one instance to the next.
+    m_instanceVariableNames.clear();
+    for (const auto& name : perInstanceVariables)
+    {
+        if (name != "instance" && (!analysis.IsValid() || analysis.WrittenVariables().count(name) > 0))
+        {
+            m_instanceVariableNames.push_back(name);
+        }
+    }
+    BindInstanceVariables();
+
+#ifdef MILKDROP_PRESET_DEBUG
+    std::cerr << "[Preset] Custom shape " << shape.m_index << " instances " << (m_canExecuteInParallel ? "can" : "can't") << " be evaluated in parallel." << std::endl;
+#endif
+
+    CreateWorkerContexts(analysis, shape);
 }
 
 
-void ShapePerFrameContext::ExecutePerFrameCode()
+void ShapePerFrameContext::ExecutePerFrameCode(const ExpressionWatchdog& watchdog)
 {
-    if (perFrameCodeHandle != nullptr)
+    if (m_perFrameJit)
+    {
+        m_perFrameJit->Execute(perFrameCodeHandle, *frame, watchdog);
+    }
+    else if (perFrameCodeHandle != nullptr)
     {
         projectm_eval_code_execute(perFrameCodeHandle);
     }
 }
 
+auto ShapePerFrameContext::CanExecuteInParallel() const -> bool
+{
+    return m_canExecuteInParallel;
+}
+
+auto ShapePerFrameContext::WorkerContext(size_t slot) -> ShapePerFrameContext&
+{
+    if (slot == 0 || slot > m_workerContexts.size())
+    {
+        return *this;
+    }
+
+    auto& context = *m_workerContexts[slot - 1];
+    for (const auto& variable : context.m_sharedVariables)
+    {
+        *variable.first = *variable.second;
+    }
+    return context;
+}
+
+void ShapePerFrameContext::BindInstanceVariables()
+{
+    m_instanceVariables.clear();
+    for (const auto& name : m_instanceVariableNames)
+    {
+        m_instanceVariables.emplace_back(projectm_eval_context_register_variable(perFrameCodeContext, name.c_str()), 0.0);
+    }
+}
+
+void ShapePerFrameContext::CreateWorkerContexts(const CodeAnalysis& analysis, const CustomShape& shape)
+{
+    m_workerContexts.clear();
+
+    auto const concurrency = WorkerPool::Instance().Concurrency();
+    if (!m_canExecuteInParallel || concurrency < 2)
+    {
+        return;
+    }
+
+    for (size_t slot = 1; slot < concurrency; slot++)
+    {
+        auto context = std::make_unique<ShapePerFrameContext>(m_gmegabuf, m_globalRegisters);
+        context->RegisterBuiltinVariables();
+        context->CloneCompiledCode(*this, shape);
+
+        // All builtin variables are reset for each instance, but user variables set by the
+        // init code need to be copied.
+        for (const auto& name : analysis.ReadVariables())
+        {
+            context->m_sharedVariables.emplace_back(projectm_eval_context_register_variable(context->perFrameCodeContext, name.c_str()),
+                                                    projectm_eval_context_register_variable(perFrameCodeContext, name.c_str()));
+        }
+
+        m_workerContexts.push_back(std::move(context));
+    }
+}
+
+void ShapePerFrameContext::CloneCompiledCode(const ShapePerFrameContext& other, const CustomShape& shape)
+{
+    // The expression library has no way to share a code handle between contexts.
+    perFrameCodeHandle = projectm_eval_code_compile(perFrameCodeContext, other.m_perFrameCode.c_str());
+    if (perFrameCodeHandle == nullptr)
+    {
+        throw MilkdropCompileException("Could not compile custom shape " + std::to_string(shape.m_index) + " per-frame code");
+    }
+
+    if (other.m_perFrameJit)
+    {
+        m_perFrameJit = other.m_perFrameJit->Rebind([this](const std::string& name) {
+            return reinterpret_cast<double*>(projectm_eval_context_register_variable(perFrameCodeContext, name.c_str()));
+        });
+    }
+
+    m_perFrameCode = other.m_perFrameCode;
+    m_canExecuteInParallel = other.m_canExecuteInParallel;
+    m_instanceVariableNames = other.m_instanceVariableNames;
+    BindInstanceVariables();
+}
+
 } // namespace MilkdropPreset
 } // namespace libprojectM
@@ -1,10 +1,17 @@
 #pragma once
 
+#include "ExpressionJit.hpp"
 #include "PresetState.hpp"
 
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
 namespace libprojectM {
 namespace MilkdropPreset {
 
+class CodeAnalysis;
 class PerFrameContext;
 class CustomShape;
 
@@ -39,6 +46,17 @@ public:
                             CustomShape& shape,
                             int inst);
 
+    /**
+     * @brief Prepares the variables for the next instance after LoadStateVariables() was called for a previous one.
+     *
+     * The frame values loaded by LoadStateVariables() are shared by all instances evaluated on this
+     * context. Only the builtin variables the per-frame code can change are restored to their loaded
+     * values, instead of reloading all of them.
+     *
+     * @param inst The current shape instance.
+     */
+    void LoadInstanceVariables(int inst);
+
     /**
      * @brief Compiles and runs the preset init code.
      * @throws MilkdropCompileException Thrown if one of the custom shape init code couldn't be compiled.
@@ -57,8 +75,34 @@ public:
 
     /**
      * @brief Executes the per-frame code with the current state.
+     * @param watchdog Aborts loops in native code once the expression time budget is used up.
+     */
+    void ExecutePerFrameCode(const ExpressionWatchdog& watchdog);
+
+    /**
+     * @brief Returns whether the shape instances can be evaluated on multiple contexts in parallel.
+     *
+     * This is the case if the per-frame code doesn't use any state which carries over from one
+     * instance to the next, i.e. memory buffers, global registers, random numbers or variables read
+     * before they are assigned, except those reset by LoadStateVariables() for each instance.
+     *
+     * @return True if the instances can be evaluated in parallel with identical results, false if not.
+     */
+    auto CanExecuteInParallel() const -> bool;
+
+    /**
+     * @brief Returns a context to evaluate shape instances on the given worker thread slot.
+     *
+     * Slot 0 is this context. All other slots use a clone with the same global memory buffer, global
+     * registers and code, created by CompilePerFrameCode() if the instances can be evaluated in
+     * parallel. The variables read by the code, e.g. those set by the init code, are copied from this
+     * context on each call, so this must be called on the render thread before evaluating instances
+     * on another thread.
+     *
+     * @param slot The worker thread slot.
+     * @return The context to use on the given slot.
      */
-    void ExecutePerFrameCode();
+    auto WorkerContext(size_t slot) -> ShapePerFrameContext&;
 
     projectm_eval_context* perFrameCodeContext{nullptr}; //!< The code runtime context, holds memory buffers and variables.
     projectm_eval_code* perFrameCodeHandle{nullptr};     //!< The compiled per-frame code handle.
@@ -100,6 +144,41 @@ public:
     PRJM_EVAL_F* instance{};
     PRJM_EVAL_F* tex_zoom{};
     PRJM_EVAL_F* tex_ang{};
+
+private:
+    /**
+     * @brief Registers the builtin variables listed in m_instanceVariableNames.
+     */
+    void BindInstanceVariables();
+
+    /**
+     * @brief Creates the clones for all worker slots if the instances can be evaluated in parallel.
+     * @param analysis The analysis of the per-frame code.
+     * @param shape The shape this context belongs to.
+     */
+    void CreateWorkerContexts(const CodeAnalysis& analysis, const CustomShape& shape);
+
+    /**
+     * @brief Sets up this clone with the compiled code of another context.
+     *
+     * The native code is rebound to this context's variables instead of being compiled again. Only
+     * the expression library needs to compile the code again, as its code handles are tied to a context.
+     *
+     * @throws MilkdropCompileException Thrown if the per-frame code couldn't be compiled.
+     * @param other The context to take the compiled code from.
+     * @param shape The shape this context belongs to.
+     */
+    void CloneCompiledCode(const ShapePerFrameContext& other, const CustomShape& shape);
+
+    projectm_eval_mem_buffer m_gmegabuf{};        //!< The global memory buffer, used for creating worker contexts.
+    PRJM_EVAL_F (*m_globalRegisters)[100]{};      //!< The global registers, used for creating worker contexts.
+    std::string m_perFrameCode;                   //!< The compiled per-frame code, used for creating worker contexts.
+    bool m_canExecuteInParallel{false};           //!< True if the per-frame code has no cross-instance state.
+    std::unique_ptr<ExpressionJit> m_perFrameJit; //!< Native code for the per-frame code, if supported.
+    std::vector<std::unique_ptr<ShapePerFrameContext>> m_workerContexts; //!< Cloned contexts for worker slots 1 and above.
+    std::vector<std::pair<PRJM_EVAL_F*, const PRJM_EVAL_F*>> m_sharedVariables; //!< Variables copied from the main context into this clone.
+    std::vector<std::string> m_instanceVariableNames;                          //!< Builtin variables the code may write.
+    std::vector<std::pair<PRJM_EVAL_F*, PRJM_EVAL_F>> m_instanceVariables;      //!< Builtin variables the code may write and their values after LoadStateVariables().
 };
 
 } // namespace MilkdropPreset
@@ -142,17 +142,17 @@ void Waveform::ModulateOpacityByVolume(const PerFrameContext& presetPerFrameCont
     //set an upper and lower bound and linearly
     //calculate the opacity from 0=lower to 1=upper
     //based on current volume
-    if (m_presetState.audioData.vol <= m_presetState.modWaveAlphaStart)
+    if (m_presetState.audioData->Vol() <= m_presetState.modWaveAlphaStart)
     {
         m_tempAlpha = 0.0;
     }
-    else if (m_presetState.audioData.vol >= m_presetState.modWaveAlphaEnd)
+    else if (m_presetState.audioData->Vol() >= m_presetState.modWaveAlphaEnd)
     {
         m_tempAlpha = static_cast<float>(*presetPerFrameContext.wave_a);
     }
     else
     {
-        m_tempAlpha = static_cast<float>(*presetPerFrameContext.wave_a) * ((m_presetState.audioData.vol - m_presetState.modWaveAlphaStart) / (m_presetState.modWaveAlphaEnd - m_presetState.modWaveAlphaStart));
+        m_tempAlpha = static_cast<float>(*presetPerFrameContext.wave_a) * ((m_presetState.audioData->Vol() - m_presetState.modWaveAlphaStart) / (m_presetState.modWaveAlphaEnd - m_presetState.modWaveAlphaStart));
     }
 }
 
@@ -212,7 +212,7 @@ void Waveform::MaximizeColors(const PerFrameContext& presetPerFrameContext)
             m_tempAlpha *= 0.44f;
         }
         m_tempAlpha *= 1.3f;
-        m_tempAlpha *= std::pow(m_presetState.audioData.treb, 2.0f);
+        m_tempAlpha *= std::pow(m_presetState.audioData->Treb(), 2.0f);
     }
 
     if (m_presetState.modWaveAlphaByvolume)
@@ -72,12 +72,12 @@ void WaveformPerFrameContext::LoadStateVariables(PresetState& state, const PerFr
     *frame = static_cast<double>(state.renderContext.frame);
     *fps = static_cast<double>(state.renderContext.fps);
     *progress = static_cast<double>(state.renderContext.progress);
-    *bass = static_cast<double>(state.audioData.bass);
-    *mid = static_cast<double>(state.audioData.mid);
-    *treb = static_cast<double>(state.audioData.treb);
-    *bass_att = static_cast<double>(state.audioData.bassAtt);
-    *mid_att = static_cast<double>(state.audioData.midAtt);
-    *treb_att = static_cast<double>(state.audioData.trebAtt);
+    *bass = static_cast<double>(state.audioData->Bass());
+    *mid = static_cast<double>(state.audioData->Mid());
+    *treb = static_cast<double>(state.audioData->Treb());
+    *bass_att = static_cast<double>(state.audioData->BassAtt());
+    *mid_att = static_cast<double>(state.audioData->MidAtt());
+    *treb_att = static_cast<double>(state.audioData->TrebAtt());
 
     for (int q = 0; q < QVarCount; q++)
     {
@@ -145,11 +145,17 @@ void WaveformPerFrameContext::CompilePerFrameCode(const std::string& perFrameCod
 #endif
         throw MilkdropCompileException("Could not compile custom wave " + std::to_string(waveform.m_index) + " per-frame code");
     }
+
+    m_perFrameJit = ExpressionJit::Compile(perFrameCode, perFrameCodeContext);
 }
 
-void WaveformPerFrameContext::ExecutePerFrameCode()
+void WaveformPerFrameContext::ExecutePerFrameCode(const ExpressionWatchdog& watchdog)
 {
-    if (perFrameCodeHandle != nullptr)
+    if (m_perFrameJit)
+    {
+        m_perFrameJit->Execute(perFrameCodeHandle, *frame, watchdog);
+    }
+    else if (perFrameCodeHandle != nullptr)
     {
         projectm_eval_code_execute(perFrameCodeHandle);
     }
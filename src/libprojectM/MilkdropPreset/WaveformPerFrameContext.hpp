@@ -1,7 +1,10 @@
 #pragma once
 
+#include "ExpressionJit.hpp"
 #include "PresetState.hpp"
 
+#include <memory>
+
 namespace libprojectM {
 namespace MilkdropPreset {
 
@@ -51,8 +54,9 @@ public:
 
     /**
      * @brief Executes the per-frame code with the current state.
+     * @param watchdog Aborts loops in native code once the expression time budget is used up.
      */
-    void ExecutePerFrameCode();
+    void ExecutePerFrameCode(const ExpressionWatchdog& watchdog);
 
     projectm_eval_context* perFrameCodeContext{nullptr}; //!< The code runtime context, holds memory buffers and variables.
     projectm_eval_code* perFrameCodeHandle{nullptr}; //!< The compiled per-frame code handle.
@@ -74,6 +78,9 @@ public:
     PRJM_EVAL_F* b{};
     PRJM_EVAL_F* a{};
     PRJM_EVAL_F* samples{};
+
+private:
+    std::unique_ptr<ExpressionJit> m_perFrameJit; //!< Native code for the per-frame code, if supported.
 };
 
 } // namespace MilkdropPreset
@@ -1,9 +1,12 @@
 #include "WaveformPerPointContext.hpp"
 
+#include "CodeAnalysis.hpp"
 #include "CustomWaveform.hpp"
 #include "MilkdropPresetExceptions.hpp"
 #include "PerFrameContext.hpp"
 
+#include <algorithm>
+
 #ifdef MILKDROP_PRESET_DEBUG
 #include <iostream>
 #endif
@@ -14,6 +17,16 @@
 namespace libprojectM {
 namespace MilkdropPreset {
 
+namespace {
+
+/**
+ * Variables which are set by CustomWaveform before executing the per-point code for each point.
+ */
+const CodeAnalysis::VariableSet PerPointVariables{
+    "sample", "value1", "value2", "x", "y", "r", "g", "b", "a"};
+
+} // namespace
+
 WaveformPerPointContext::WaveformPerPointContext(projectm_eval_mem_buffer gmegabuf, PRJM_EVAL_F (*globalRegisters)[100])
     : perPointCodeContext(projectm_eval_context_create(gmegabuf, globalRegisters))
 {
@@ -106,15 +119,100 @@ void WaveformPerPointContext::CompilePerPointCode(const std::string& perPointCod
 #endif
         throw MilkdropCompileException("Could not compile custom wave " + std::to_string(waveform.m_index) + " per-point code");
     }
+
+    m_perPointJit = ExpressionJit::Compile(perPointCode, perPointCodeContext);
+
+    CodeAnalysis const analysis(perPointCode);
+
+    referencedVariables.sample = analysis.References("sample");
+    referencedVariables.value1 = analysis.References("value1");
+    referencedVariables.value2 = analysis.References("value2");
+    referencedVariables.r = analysis.References("r");
+    referencedVariables.g = analysis.References("g");
+    referencedVariables.b = analysis.References("b");
+    referencedVariables.a = analysis.References("a");
+
+    for (int q = 0; q < QVarCount; q++)
+    {
+        referencedVariables.q[q] = analysis.References("q" + std::to_string(q + 1));
+    }
+
+    for (int t = 0; t < TVarCount; t++)
+    {
+        referencedVariables.t[t] = analysis.References("t" + std::to_string(t + 1));
+    }
+
+    if (analysis.IsParallelSafe(PerPointVariables))
+    {
+        CreateBatchEvaluator(perPointCode);
+    }
 }
 
-void WaveformPerPointContext::ExecutePerPointCode()
+void WaveformPerPointContext::ExecutePerPointCode(const ExpressionWatchdog& watchdog)
 {
-    if (perPointCodeHandle != nullptr)
+    if (m_perPointJit)
+    {
+        m_perPointJit->Execute(perPointCodeHandle, *frame, watchdog);
+    }
+    else if (perPointCodeHandle != nullptr)
     {
         projectm_eval_code_execute(perPointCodeHandle);
     }
 }
 
+auto WaveformPerPointContext::CanExecuteBatched() const -> bool
+{
+    return m_batchEvaluator != nullptr;
+}
+
+void WaveformPerPointContext::DisableBatchedExecution()
+{
+    m_batchEvaluator.reset();
+    m_batchInputs.clear();
+    batchLanes = {};
+}
+
+void WaveformPerPointContext::ExecutePerPointCodeBatch(size_t count)
+{
+    for (const auto& input : m_batchInputs)
+    {
+        std::fill_n(input.first, count, static_cast<PresetBatchValue>(*input.second));
+    }
+
+    m_batchEvaluator->Execute(count);
+}
+
+void WaveformPerPointContext::CreateBatchEvaluator(const std::string& perPointCode)
+{
+    ExpressionTree const tree(perPointCode);
+    if (tree.Root() == nullptr)
+    {
+        return;
+    }
+
+    m_batchEvaluator = std::make_unique<PresetBatchEvaluator>(*tree.Root(),
+                                                              std::vector<std::string>(PerPointVariables.begin(), PerPointVariables.end()));
+
+    batchLanes.sample = m_batchEvaluator->Lanes("sample");
+    batchLanes.value1 = m_batchEvaluator->Lanes("value1");
+    batchLanes.value2 = m_batchEvaluator->Lanes("value2");
+    batchLanes.x = m_batchEvaluator->Lanes("x");
+    batchLanes.y = m_batchEvaluator->Lanes("y");
+    batchLanes.r = m_batchEvaluator->Lanes("r");
+    batchLanes.g = m_batchEvaluator->Lanes("g");
+    batchLanes.b = m_batchEvaluator->Lanes("b");
+    batchLanes.a = m_batchEvaluator->Lanes("a");
+
+    // All other variables read by the code are loaded from the expression context.
+    for (const auto& name : m_batchEvaluator->ReadVariables())
+    {
+        if (PerPointVariables.find(name) == PerPointVariables.end())
+        {
+            m_batchInputs.emplace_back(m_batchEvaluator->Lanes(name),
+                                       projectm_eval_context_register_variable(perPointCodeContext, name.c_str()));
+        }
+    }
+}
+
 } // namespace MilkdropPreset
 } // namespace libprojectM
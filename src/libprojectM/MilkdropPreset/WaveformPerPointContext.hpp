@@ -1,7 +1,14 @@
 #pragma once
 
+#include "BatchEvaluator.hpp"
+#include "ExpressionJit.hpp"
 #include "PresetState.hpp"
 
+#include <bitset>
+#include <memory>
+#include <utility>
+#include <vector>
+
 namespace libprojectM {
 namespace MilkdropPreset {
 
@@ -11,6 +18,40 @@ class PerFrameContext;
 class WaveformPerPointContext
 {
 public:
+    /**
+     * @brief Lanes of the per-point variables for batched execution.
+     */
+    struct BatchLanes {
+        PresetBatchValue* sample{};
+        PresetBatchValue* value1{};
+        PresetBatchValue* value2{};
+        PresetBatchValue* x{};
+        PresetBatchValue* y{};
+        PresetBatchValue* r{};
+        PresetBatchValue* g{};
+        PresetBatchValue* b{};
+        PresetBatchValue* a{};
+    };
+
+    /**
+     * @brief Flags for the per-point input variables referenced by the per-point code.
+     *
+     * Variables the code doesn't reference keep their value, so they don't need to be set for each
+     * point. x and y are always set, as they also carry the point position if the code doesn't
+     * change it. The q and t flags also skip copying unused variables from the per-frame context.
+     */
+    struct ReferencedVariables {
+        std::bitset<QVarCount> q{~0ULL};
+        std::bitset<TVarCount> t{~0ULL};
+        bool sample{true};
+        bool value1{true};
+        bool value2{true};
+        bool r{true};
+        bool g{true};
+        bool b{true};
+        bool a{true};
+    };
+
     /**
      * @brief Constructor. Creates a new waveform per-point state object.
      * @param gmegabuf The global memory buffer to use in the code context.
@@ -42,8 +83,34 @@ public:
 
     /**
      * @brief Executes the per-point code with the current state.
+     * @param watchdog Aborts loops in native code once the expression time budget is used up.
      */
-    void ExecutePerPointCode();
+    void ExecutePerPointCode(const ExpressionWatchdog& watchdog);
+
+    /**
+     * @brief Returns whether the per-point code can be executed in batches.
+     *
+     * Requires the code to not carry any state from one point to the next and to only use the
+     * operations supported by BatchEvaluator.
+     *
+     * @return True if ExecutePerPointCodeBatch() can be used, false if not.
+     */
+    auto CanExecuteBatched() const -> bool;
+
+    /**
+     * @brief Disables batched execution, e.g. if the results differ from the expression library.
+     */
+    void DisableBatchedExecution();
+
+    /**
+     * @brief Executes the per-point code for a batch of points.
+     *
+     * The per-point inputs are read from batchLanes, all other variables are taken from the
+     * expression context. The results are written to batchLanes.
+     *
+     * @param count The number of points, at most BatchEvaluator::BatchSize.
+     */
+    void ExecutePerPointCodeBatch(size_t count);
 
     projectm_eval_context* perPointCodeContext{nullptr}; //!< The code runtime context, holds memory buffers and variables.
     projectm_eval_code* perPointCodeHandle{nullptr}; //!< The compiled waveform per-point code handle.
@@ -69,6 +136,20 @@ public:
     PRJM_EVAL_F* g{};
     PRJM_EVAL_F* b{};
     PRJM_EVAL_F* a{};
+
+    ReferencedVariables referencedVariables; //!< Per-point variables the per-point code reads or writes.
+    BatchLanes batchLanes;                   //!< Per-point variable lanes for ExecutePerPointCodeBatch().
+
+private:
+    /**
+     * @brief Creates the batched evaluator if the per-point code only uses supported operations.
+     * @param perPointCode The per-point code.
+     */
+    void CreateBatchEvaluator(const std::string& perPointCode);
+
+    std::unique_ptr<PresetBatchEvaluator> m_batchEvaluator;                //!< Batched evaluator for the per-point code, if supported.
+    std::vector<std::pair<PresetBatchValue*, PRJM_EVAL_F*>> m_batchInputs; //!< Lanes filled from context variables before each batch.
+    std::unique_ptr<ExpressionJit> m_perPointJit;                          //!< Native code for the per-point code, if supported.
 };
 
 } // namespace MilkdropPreset
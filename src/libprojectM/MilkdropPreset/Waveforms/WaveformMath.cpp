@@ -18,33 +18,18 @@ auto WaveformMath::GetVertices(const PresetState& presetState,
 
     using libprojectM::Audio::WaveformSamples;
 
-    // Get the correct audio sample type for the current waveform mode.
-    if (IsSpectrumWave())
-    {
-        std::copy(begin(presetState.audioData.spectrumLeft),
-                  begin(presetState.audioData.spectrumLeft) + Audio::SpectrumSamples,
-                  begin(m_pcmDataL));
-
-        std::copy(begin(presetState.audioData.spectrumRight),
-                  begin(presetState.audioData.spectrumRight) + Audio::SpectrumSamples,
-                  begin(m_pcmDataR));
-    }
-    else
-    {
-        std::copy(begin(presetState.audioData.waveformLeft),
-                  begin(presetState.audioData.waveformLeft) + Audio::WaveformSamples,
-                  begin(m_pcmDataL));
-
-        std::copy(begin(presetState.audioData.waveformRight),
-                  begin(presetState.audioData.waveformRight) + Audio::WaveformSamples,
-                  begin(m_pcmDataR));
-    }
+    // Get the correct audio sample type for the current waveform mode, reading directly from the shared snapshot.
+    const auto& audioData = *presetState.audioData;
+    const bool spectrumWave = IsSpectrumWave();
+    const float* sourceL = spectrumWave ? audioData.spectrumLeft.data() : audioData.waveformLeft.data();
+    const float* sourceR = spectrumWave ? audioData.spectrumRight.data() : audioData.waveformRight.data();
+    const size_t sourceSamples = spectrumWave ? Audio::SpectrumSamples : Audio::WaveformSamples;
 
     // Scale and smooth waveform data
     float scale = presetState.waveScale / 128.0f;
     // The first sample gets scaled directly because it is not mixed with other samples.
-    m_pcmDataL[0] *= scale;
-    m_pcmDataR[0] *= scale;
+    m_pcmDataL[0] = sourceL[0] * scale;
+    m_pcmDataR[0] = sourceR[0] * scale;
     /* If s[i] is output sample i and p[i] is input sample i, then:
      * s[0] = waveScale*p[i];
      * s[i] = waveScale*(1-waveSmoothing)*p[i] + waveSmoothing*s[i-1]
@@ -53,7 +38,13 @@ auto WaveformMath::GetVertices(const PresetState& presetState,
     float mix2 = presetState.waveSmoothing; // amount of previous sample to add to this sample
     float mix1 = scale * (1.0f - mix2); // amount to scale this sample
     // Scale and mix samples after the first one.
-    for (size_t i = 1; i < m_pcmDataL.size(); ++i)
+    for (size_t i = 1; i < sourceSamples; ++i)
+    {
+        m_pcmDataL[i] = sourceL[i]*mix1 + m_pcmDataL[i-1]*mix2;
+        m_pcmDataR[i] = sourceR[i]*mix1 + m_pcmDataR[i-1]*mix2;
+    }
+    // Samples beyond the audio data are smoothed in place, using their values from the previous frame as input.
+    for (size_t i = sourceSamples; i < m_pcmDataL.size(); ++i)
     {
         m_pcmDataL[i] = m_pcmDataL[i]*mix1 + m_pcmDataL[i-1]*mix2;
         m_pcmDataR[i] = m_pcmDataR[i]*mix1 + m_pcmDataR[i-1]*mix2;
@@ -0,0 +1,124 @@
+#include "WorkerPool.hpp"
+
+namespace libprojectM {
+namespace MilkdropPreset {
+
+WorkerPool::WorkerPool(size_t workerCount)
+{
+    m_workers.reserve(workerCount);
+    for (size_t worker = 0; worker < workerCount; worker++)
+    {
+        m_workers.emplace_back(&WorkerPool::WorkerLoop, this, worker + 1);
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_jobMutex);
+        m_stop = true;
+    }
+    m_jobAvailable.notify_all();
+
+    for (auto& worker : m_workers)
+    {
+        worker.join();
+    }
+}
+
+auto WorkerPool::Instance() -> WorkerPool&
+{
+    static WorkerPool pool(std::thread::hardware_concurrency() > 1 ? std::thread::hardware_concurrency() - 1 : 0);
+    return pool;
+}
+
+auto WorkerPool::Concurrency() const -> size_t
+{
+    return m_workers.size() + 1;
+}
+
+void WorkerPool::ParallelFor(size_t taskCount, const TaskFunction& function)
+{
+    if (m_workers.empty() || taskCount < 2)
+    {
+        for (size_t task = 0; task < taskCount; task++)
+        {
+            function(task, 0);
+        }
+        return;
+    }
+
+    std::lock_guard<std::mutex> callerLock(m_callerMutex);
+
+    {
+        std::lock_guard<std::mutex> lock(m_jobMutex);
+        m_function = &function;
+        m_taskCount = taskCount;
+        m_nextTask = 0;
+        m_busyWorkers = m_workers.size();
+        m_jobGeneration++;
+    }
+    m_jobAvailable.notify_all();
+
+    RunTasks(0);
+
+    // Workers may still be running their last task, which uses the function.
+    std::unique_lock<std::mutex> lock(m_jobMutex);
+    m_jobFinished.wait(lock, [this]() {
+        return m_busyWorkers == 0;
+    });
+    m_function = nullptr;
+}
+
+void WorkerPool::WorkerLoop(size_t slot)
+{
+    uint64_t lastGeneration{0};
+
+    std::unique_lock<std::mutex> lock(m_jobMutex);
+    while (true)
+    {
+        m_jobAvailable.wait(lock, [this, lastGeneration]() {
+            return m_stop || m_jobGeneration != lastGeneration;
+        });
+
+        if (m_stop)
+        {
+            return;
+        }
+
+        lastGeneration = m_jobGeneration;
+
+        lock.unlock();
+        RunTasks(slot);
+        lock.lock();
+
+        m_busyWorkers--;
+        if (m_busyWorkers == 0)
+        {
+            m_jobFinished.notify_one();
+        }
+    }
+}
+
+void WorkerPool::RunTasks(size_t slot)
+{
+    while (true)
+    {
+        size_t task{};
+        const TaskFunction* function{};
+        {
+            std::lock_guard<std::mutex> lock(m_jobMutex);
+            if (m_nextTask >= m_taskCount)
+            {
+                return;
+            }
+            task = m_nextTask++;
+            function = m_function;
+        }
+
+        (*function)(task, slot);
+    }
+}
+
+} // namespace MilkdropPreset
+} // namespace libprojectM
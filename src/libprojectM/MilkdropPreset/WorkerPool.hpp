@@ -0,0 +1,95 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace libprojectM {
+namespace MilkdropPreset {
+
+/**
+ * @brief A pool of worker threads for splitting per-vertex code execution into parallel tasks.
+ *
+ * ParallelFor() distributes a number of tasks over the workers and the calling thread, which also
+ * executes tasks instead of just waiting. Each task is passed the index of the executing thread
+ * ("slot"), which is always smaller than Concurrency(). Callers use it to select per-thread data,
+ * e.g. a cloned expression context, so no two tasks running at the same time share the same data.
+ *
+ * Calls to ParallelFor() from different threads are serialized. Tasks must not throw exceptions or
+ * call ParallelFor() on the same pool again.
+ */
+class WorkerPool
+{
+public:
+    using TaskFunction = std::function<void(size_t task, size_t slot)>;
+
+    /**
+     * @brief Creates a pool with the given number of worker threads.
+     * @param workerCount Number of threads to start in addition to the calling thread. Can be 0.
+     */
+    explicit WorkerPool(size_t workerCount);
+
+    /**
+     * @brief Stops and joins all worker threads.
+     */
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    auto operator=(const WorkerPool&) -> WorkerPool& = delete;
+
+    /**
+     * @brief Returns the shared pool, creating it on first use.
+     *
+     * The shared pool runs one thread per available hardware thread, including the calling thread.
+     *
+     * @return The process-wide worker pool.
+     */
+    static auto Instance() -> WorkerPool&;
+
+    /**
+     * @brief Returns the maximum number of threads executing tasks, including the calling thread.
+     * @return The number of worker threads plus one.
+     */
+    auto Concurrency() const -> size_t;
+
+    /**
+     * @brief Executes the given function for each task index from 0 to taskCount - 1 and waits for all tasks.
+     * @param taskCount The number of tasks to run.
+     * @param function The function to run, called with the task index and the executing thread's slot.
+     */
+    void ParallelFor(size_t taskCount, const TaskFunction& function);
+
+private:
+    /**
+     * Worker thread main loop, waits for new jobs and runs tasks until all are taken.
+     * @param slot The slot index passed to the task function.
+     */
+    void WorkerLoop(size_t slot);
+
+    /**
+     * Runs tasks of the current job until all tasks have been taken.
+     * @param slot The slot index passed to the task function.
+     */
+    void RunTasks(size_t slot);
+
+    std::vector<std::thread> m_workers; //!< The worker threads.
+
+    std::mutex m_callerMutex; //!< Serializes ParallelFor() calls from different threads.
+
+    std::mutex m_jobMutex;                  //!< Protects the job state below.
+    std::condition_variable m_jobAvailable; //!< Wakes up the workers if a new job was started.
+    std::condition_variable m_jobFinished;  //!< Wakes up the caller if all workers finished the job.
+    uint64_t m_jobGeneration{0};            //!< Incremented for each new job.
+    const TaskFunction* m_function{nullptr}; //!< The current job's function.
+    size_t m_taskCount{0};                  //!< Number of tasks in the current job.
+    size_t m_nextTask{0};                   //!< Next task index to hand out.
+    size_t m_busyWorkers{0};                //!< Number of workers still working on the current job.
+    bool m_stop{false};                     //!< Tells the workers to exit.
+};
+
+} // namespace MilkdropPreset
+} // namespace libprojectM
@@ -3,10 +3,12 @@
 #include <Audio/FrameAudioData.hpp>
 
 #include <Renderer/RenderContext.hpp>
+#include <Renderer/ShaderCache.hpp>
 #include <Renderer/Texture.hpp>
 
 #include <memory>
 #include <string>
+#include <vector>
 
 namespace libprojectM {
 
@@ -21,12 +23,53 @@ public:
      */
     virtual void Initialize(const Renderer::RenderContext& renderContext) = 0;
 
+    /**
+     * @brief Compiles the preset's expression code and runs its init code.
+     *
+     * Doesn't use OpenGL, so it can be called on a worker thread while other presets are rendered,
+     * as long as no other thread uses this preset at the same time. If not called before,
+     * Initialize() does this on the rendering thread.
+     *
+     * @param renderContext A render context with the initial data.
+     */
+    virtual void CompileCode(const Renderer::RenderContext& renderContext) = 0;
+
+    /**
+     * @brief Loads the textures used by the preset's shaders.
+     *
+     * Must be called on the rendering thread before TranspileShaders(). If not called before,
+     * Initialize() does this.
+     *
+     * @param renderContext A render context with the initial data.
+     */
+    virtual void LoadShaderTextures(const Renderer::RenderContext& renderContext) = 0;
+
+    /**
+     * @brief Translates the preset's shaders into GLSL without compiling them.
+     *
+     * Doesn't use OpenGL, so it can be called on a worker thread like CompileCode(). Does nothing
+     * if LoadShaderTextures() wasn't called before or the shaders were already translated. The GLSL
+     * code is compiled in Initialize().
+     */
+    virtual void TranspileShaders() = 0;
+
+    /**
+     * @brief Starts compiling the translated GLSL shaders in the background, if the driver supports it.
+     *
+     * Must be called on the rendering thread after TranspileShaders(). Initialize() then uses the
+     * compiled programs, only waiting for those the driver didn't finish yet.
+     *
+     * @return The programs being compiled, which must be kept until Initialize() was called. Empty
+     *         if the driver can't compile in the background.
+     */
+    virtual auto StartCompilingShaders() -> std::vector<Renderer::ShaderCache::ProgramPtr> = 0;
+
     /**
      * @brief Renders the preset into the current framebuffer.
-     * @param audioData Audio data to be used by the preset.
+     * @param audioData Shared audio data snapshot to be used by the preset.
      * @param renderContext The current render context data.
      */
-    virtual void RenderFrame(const libprojectM::Audio::FrameAudioData& audioData,
+    virtual void RenderFrame(const libprojectM::Audio::FrameAudioData::Ptr& audioData,
                              const Renderer::RenderContext& renderContext) = 0;
 
     /**
@@ -47,6 +90,14 @@ public:
     virtual void DrawInitialImage(const std::shared_ptr<Renderer::Texture>& image,
                                   const Renderer::RenderContext& renderContext) = 0;
 
+    /**
+     * @brief Returns whether the preset exceeded the expression time budget.
+     * If true, the preset no longer evaluates its expression code and frames may be incomplete.
+     * @see Renderer::RenderContext::expressionDeadline
+     * @return True if evaluation was cut short, false otherwise.
+     */
+    virtual auto ExpressionTimeBudgetExceeded() const -> bool = 0;
+
     inline void SetFilename(const std::string& filename)
     {
         m_filename = filename;
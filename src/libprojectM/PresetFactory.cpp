@@ -23,4 +23,14 @@ std::string PresetFactory::Protocol(const std::string& url, std::string& path)
     return url.substr(0, pos);
 }
 
+std::unique_ptr<Preset> PresetFactory::LoadPresetFromFile(const std::string& filename)
+{
+    return CreatePreset(ParsePresetFromFile(filename));
+}
+
+std::unique_ptr<Preset> PresetFactory::LoadPresetFromStream(std::istream& data)
+{
+    return CreatePreset(ParsePresetFromStream(data));
+}
+
 } // namespace libprojectM
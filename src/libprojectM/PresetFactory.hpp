@@ -6,6 +6,18 @@
 
 namespace libprojectM {
 
+/**
+ * @brief Preset data read and parsed by a PresetFactory, but not yet turned into a Preset.
+ *
+ * Holds no OpenGL resources, so it can be created on a worker thread and passed to the rendering
+ * thread. The contents are only known to the factory which created it.
+ */
+class ParsedPreset
+{
+public:
+    virtual ~ParsedPreset() = default;
+};
+
 class PresetFactory
 {
 
@@ -30,16 +42,42 @@ public:
     /**
      * @brief Constructs a new preset from a local file
      * @param filename The preset filename
-     * @returns A valid preset object
+     * @returns A valid preset object, or nullptr if the URL isn't supported.
      */
-    virtual std::unique_ptr<Preset> LoadPresetFromFile(const std::string& filename) = 0;
+    std::unique_ptr<Preset> LoadPresetFromFile(const std::string& filename);
 
     /**
      * @brief Constructs a new preset from a stream
      * @param data The preset data stream
      * @returns A valid preset object
      */
-    virtual std::unique_ptr<Preset> LoadPresetFromStream(std::istream& data) = 0;
+    std::unique_ptr<Preset> LoadPresetFromStream(std::istream& data);
+
+    /**
+     * @brief Reads and parses a local file without creating the preset.
+     *
+     * Doesn't use OpenGL, so it can be called on a worker thread. The result is passed to
+     * CreatePreset() on the rendering thread.
+     *
+     * @param filename The preset filename
+     * @returns The parsed preset, or nullptr if the URL isn't supported.
+     */
+    virtual std::unique_ptr<ParsedPreset> ParsePresetFromFile(const std::string& filename) = 0;
+
+    /**
+     * @brief Parses preset data from a stream without creating the preset.
+     * @see ParsePresetFromFile()
+     * @param data The preset data stream
+     * @returns The parsed preset.
+     */
+    virtual std::unique_ptr<ParsedPreset> ParsePresetFromStream(std::istream& data) = 0;
+
+    /**
+     * @brief Constructs a new preset from parsed data, allocating its OpenGL resources.
+     * @param parsedPreset Data returned by ParsePresetFromFile() or ParsePresetFromStream() of this factory.
+     * @returns A valid preset object, or nullptr if parsedPreset is nullptr.
+     */
+    virtual std::unique_ptr<Preset> CreatePreset(std::unique_ptr<ParsedPreset> parsedPreset) = 0;
 
     /**
      * Returns a space separated list of supported extensions
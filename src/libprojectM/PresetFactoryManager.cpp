@@ -61,12 +61,39 @@ void PresetFactoryManager::registerFactory(const std::string& extensions, Preset
 
 
 std::unique_ptr<Preset> PresetFactoryManager::CreatePresetFromFile(const std::string& filename)
+{
+    return CreatePreset(filename, ParsePresetFile(filename));
+}
+
+std::unique_ptr<ParsedPreset> PresetFactoryManager::ParsePresetFile(const std::string& filename)
+{
+    try
+    {
+        const std::string extension = "." + ParseExtension(filename);
+
+        return factory(extension).ParsePresetFromFile(filename);
+    }
+    catch (const PresetFactoryException&)
+    {
+        throw;
+    }
+    catch (const std::exception& e)
+    {
+        throw PresetFactoryException(e.what());
+    }
+    catch (...)
+    {
+        throw PresetFactoryException("Uncaught preset factory exception");
+    }
+}
+
+std::unique_ptr<Preset> PresetFactoryManager::CreatePreset(const std::string& filename, std::unique_ptr<ParsedPreset> parsedPreset)
 {
     try
     {
         const std::string extension = "." + ParseExtension(filename);
 
-        return factory(extension).LoadPresetFromFile(filename);
+        return factory(extension).CreatePreset(std::move(parsedPreset));
     }
     catch (const PresetFactoryException&)
     {
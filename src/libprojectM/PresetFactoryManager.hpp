@@ -66,6 +66,27 @@ public:
      */
     std::unique_ptr<Preset> CreatePresetFromFile(const std::string& filename);
 
+    /**
+     * @brief Reads and parses a preset file or URL without creating the preset.
+     *
+     * Doesn't use OpenGL, so it can be called on a worker thread. Pass the result to CreatePreset()
+     * on the rendering thread.
+     *
+     * @param filename The filename/URL to load.
+     * @throws PresetFactoryException If the file couldn't be read or parsed.
+     * @return The parsed preset, or nullptr if the URL isn't supported.
+     */
+    std::unique_ptr<ParsedPreset> ParsePresetFile(const std::string& filename);
+
+    /**
+     * @brief Creates a preset from data returned by ParsePresetFile().
+     * @param filename The same filename/URL passed to ParsePresetFile().
+     * @param parsedPreset The parsed preset data.
+     * @throws PresetFactoryException If any error occurs during preset creation.
+     * @return A valid pointer to the created preset, or nullptr if parsedPreset is nullptr.
+     */
+    std::unique_ptr<Preset> CreatePreset(const std::string& filename, std::unique_ptr<ParsedPreset> parsedPreset);
+
     /**
      * @brief Loads a preset from a stream.
      * @param extension The "original" extension. Used to determine preset data format.
@@ -0,0 +1,497 @@
+#include "PresetLoader.hpp"
+
+#include "Preset.hpp"
+#include "PresetFactory.hpp"
+#include "PresetFactoryManager.hpp"
+
+#include <Renderer/Shader.hpp>
+
+#include <algorithm>
+#include <iterator>
+#include <system_error>
+
+// Fall back to boost if compiler doesn't support C++17
+#include PROJECTM_FILESYSTEM_INCLUDE
+
+namespace libprojectM {
+
+constexpr uint32_t PresetLoader::DefaultPrefetchLimit;
+
+PresetLoader::PresetLoader(PresetFactoryManager& presetFactoryManager)
+    : m_presetFactoryManager(presetFactoryManager)
+{
+}
+
+PresetLoader::~PresetLoader()
+{
+    if (m_thread.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopRequested = true;
+        }
+        m_condition.notify_one();
+
+        m_thread.join();
+    }
+
+    // Remaining presets are destroyed here, on the rendering thread.
+}
+
+void PresetLoader::Load(const std::string& presetFilename, bool smoothTransition, const Renderer::RenderContext& renderContext)
+{
+    Cancel();
+
+    Job job;
+    job.renderContext = renderContext;
+    job.result = std::make_unique<Result>();
+    job.result->filename = presetFilename;
+    job.result->smoothTransition = smoothTransition;
+    // The worker checks whether the file changed since prefetching, so it isn't accessed on this thread.
+    job.result->preset = RemovePrefetchedPreset(presetFilename, job.fileStamp);
+    job.checkFileStamp = job.result->preset != nullptr;
+
+    m_loading = true;
+
+    if (!StartThread())
+    {
+        // Run all steps right away.
+        if (!job.result->preset)
+        {
+            ParsePreset(job);
+            if (job.result->errorMessage.empty())
+            {
+                CreatePreset(job);
+            }
+        }
+        if (job.result->errorMessage.empty())
+        {
+            CompileCode(job);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        job.generation = m_generation;
+        if (m_threadAvailable)
+        {
+            m_pendingJobs.push_front(std::move(job));
+        }
+        else
+        {
+            m_finishedJobs.push_back(std::move(job));
+        }
+    }
+    m_condition.notify_one();
+}
+
+void PresetLoader::Cancel()
+{
+    m_loading = false;
+    m_compilingResult.reset();
+
+    // Outdated jobs are taken out of the queues and destroyed outside the lock. Prefetch jobs are kept.
+    std::deque<Job> outdatedJobs;
+    auto const takeLoadJobs = [&outdatedJobs](std::deque<Job>& jobs) {
+        auto const firstLoadJob = std::stable_partition(jobs.begin(), jobs.end(), [](const Job& job) { return job.prefetch; });
+        std::move(firstLoadJob, jobs.end(), std::back_inserter(outdatedJobs));
+        jobs.erase(firstLoadJob, jobs.end());
+    };
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_generation++;
+    takeLoadJobs(m_pendingJobs);
+    takeLoadJobs(m_parsedJobs);
+    takeLoadJobs(m_finishedJobs);
+    lock.unlock();
+}
+
+auto PresetLoader::IsLoading() const -> bool
+{
+    return m_loading;
+}
+
+auto PresetLoader::Update(const Renderer::RenderContext& renderContext) -> std::unique_ptr<Result>
+{
+    std::unique_ptr<Result> result;
+    std::deque<Job> parsedJobs;
+    std::deque<Job> finishedJobs;
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    parsedJobs.swap(m_parsedJobs);
+    finishedJobs.swap(m_finishedJobs);
+    auto const generation = m_generation;
+    lock.unlock();
+
+    for (auto& job : finishedJobs)
+    {
+        if (job.prefetch)
+        {
+            StorePrefetchedPreset(job);
+        }
+        else if (job.generation == generation)
+        {
+            result = std::move(job.result);
+        }
+    }
+
+    // Create the preset objects on this thread, then hand them back to the worker for compiling.
+    for (auto& job : parsedJobs)
+    {
+        job.outdatedPreset.reset();
+        if (job.prefetch ? !PrefetchRequested(job.result->filename) : job.generation != generation)
+        {
+            continue;
+        }
+
+        job.renderContext = renderContext;
+        CreatePreset(job);
+
+        lock.lock();
+        if (!job.result->errorMessage.empty())
+        {
+            m_finishedJobs.push_back(std::move(job));
+        }
+        else if (job.prefetch)
+        {
+            m_pendingJobs.push_back(std::move(job));
+        }
+        else
+        {
+            m_pendingJobs.push_front(std::move(job));
+        }
+        lock.unlock();
+        m_condition.notify_one();
+    }
+
+    // Let the driver compile the shaders in the background, and only return the preset once done.
+    if (result && result->errorMessage.empty())
+    {
+        result->shaderPrograms = result->preset->StartCompilingShaders();
+        m_compilingResult = std::move(result);
+    }
+
+    if (m_compilingResult &&
+        std::all_of(m_compilingResult->shaderPrograms.begin(), m_compilingResult->shaderPrograms.end(),
+                    [](const Renderer::ShaderCache::ProgramPtr& program) { return Renderer::Shader::CompileProgramFinished(*program); }))
+    {
+        result = std::move(m_compilingResult);
+    }
+
+    if (result)
+    {
+        m_loading = false;
+    }
+
+    // Outdated presets are destroyed here, on the rendering thread.
+    return result;
+}
+
+void PresetLoader::Prefetch(const std::string& presetFilename, const Renderer::RenderContext& renderContext)
+{
+    std::string path;
+    auto const protocol = PresetFactory::Protocol(presetFilename, path);
+    if ((!protocol.empty() && protocol != "file") || m_prefetchLimit == 0)
+    {
+        return;
+    }
+
+    auto const prefetchedPreset = std::find_if(m_prefetchedPresets.begin(), m_prefetchedPresets.end(),
+                                               [&presetFilename](const PrefetchedPreset& entry) { return entry.filename == presetFilename; });
+    if (prefetchedPreset != m_prefetchedPresets.end())
+    {
+        m_prefetchedPresets.splice(m_prefetchedPresets.begin(), m_prefetchedPresets, prefetchedPreset);
+        return;
+    }
+
+    if (PrefetchRequested(presetFilename))
+    {
+        return;
+    }
+
+    // Without a worker thread, prefetching would block just like loading the preset.
+    if (!StartThread())
+    {
+        return;
+    }
+
+    Job job;
+    job.prefetch = true;
+    job.renderContext = renderContext;
+    job.result = std::make_unique<Result>();
+    job.result->filename = presetFilename;
+
+    m_prefetchRequests.push_back(presetFilename);
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pendingJobs.push_back(std::move(job));
+    }
+    m_condition.notify_one();
+}
+
+auto PresetLoader::IsPrefetched(const std::string& presetFilename) const -> bool
+{
+    return std::any_of(m_prefetchedPresets.begin(), m_prefetchedPresets.end(),
+                       [&presetFilename](const PrefetchedPreset& entry) { return entry.filename == presetFilename; });
+}
+
+auto PresetLoader::TakePrefetchedPreset(const std::string& presetFilename) -> std::unique_ptr<Preset>
+{
+    FileStamp prefetchedFileStamp;
+    auto preset = RemovePrefetchedPreset(presetFilename, prefetchedFileStamp);
+    if (!preset)
+    {
+        return {};
+    }
+
+    // Don't use an outdated preset if the file was changed since prefetching it.
+    FileStamp fileStamp;
+    if (!ReadFileStamp(presetFilename, fileStamp) || !(fileStamp == prefetchedFileStamp))
+    {
+        return {};
+    }
+
+    return preset;
+}
+
+void PresetLoader::ClearPrefetchedPresets()
+{
+    m_prefetchRequests.clear();
+    ShrinkPrefetchedPresets(0);
+}
+
+void PresetLoader::SetPrefetchLimit(uint32_t count)
+{
+    m_prefetchLimit = count;
+    ShrinkPrefetchedPresets(m_prefetchLimit);
+}
+
+auto PresetLoader::PrefetchLimit() const -> uint32_t
+{
+    return m_prefetchLimit;
+}
+
+auto PresetLoader::PrefetchedPresetCount() const -> size_t
+{
+    return m_prefetchedPresets.size();
+}
+
+auto PresetLoader::StartThread() -> bool
+{
+    if (m_thread.joinable() || !m_threadAvailable)
+    {
+        return m_threadAvailable;
+    }
+
+    try
+    {
+        m_thread = std::thread(&PresetLoader::Run, this);
+    }
+    catch (const std::system_error&)
+    {
+        // No thread support, e.g. Emscripten builds without pthreads.
+        m_threadAvailable = false;
+    }
+
+    return m_threadAvailable;
+}
+
+void PresetLoader::Run()
+{
+    while (true)
+    {
+        Job job;
+
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock, [this] { return m_stopRequested || !m_pendingJobs.empty(); });
+
+            if (m_stopRequested)
+            {
+                return;
+            }
+
+            job = std::move(m_pendingJobs.front());
+            m_pendingJobs.pop_front();
+        }
+
+        // A prefetched preset is only used if the file didn't change since.
+        if (job.checkFileStamp)
+        {
+            job.checkFileStamp = false;
+
+            FileStamp fileStamp;
+            if (!ReadFileStamp(job.result->filename, fileStamp) || !(fileStamp == job.fileStamp))
+            {
+                job.outdatedPreset = std::move(job.result->preset);
+            }
+        }
+
+        // New jobs are parsed first. Once the rendering thread created the preset, the code is compiled.
+        bool const parse = !job.result->preset;
+        if (parse)
+        {
+            ParsePreset(job);
+        }
+        else
+        {
+            CompileCode(job);
+        }
+
+        // The job is handed back even if outdated, as the preset must be destroyed on the rendering thread.
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (parse && job.result->errorMessage.empty())
+        {
+            m_parsedJobs.push_back(std::move(job));
+        }
+        else
+        {
+            m_finishedJobs.push_back(std::move(job));
+        }
+    }
+}
+
+void PresetLoader::ParsePreset(Job& job)
+{
+    // The file version is read first, so changes while parsing are detected when loading the preset.
+    if (job.prefetch && !ReadFileStamp(job.result->filename, job.fileStamp))
+    {
+        job.result->errorMessage = "Could not read preset file \"" + job.result->filename + "\".";
+        return;
+    }
+
+    try
+    {
+        job.parsedPreset = m_presetFactoryManager.ParsePresetFile(job.result->filename);
+        if (!job.parsedPreset)
+        {
+            job.result->errorMessage = "Unsupported preset URL \"" + job.result->filename + "\".";
+        }
+    }
+    catch (const std::exception& ex)
+    {
+        job.result->errorMessage = ex.what();
+    }
+}
+
+void PresetLoader::CreatePreset(Job& job)
+{
+    try
+    {
+        job.result->preset = m_presetFactoryManager.CreatePreset(job.result->filename, std::move(job.parsedPreset));
+        if (!job.result->preset)
+        {
+            job.result->errorMessage = "Unsupported preset URL \"" + job.result->filename + "\".";
+            return;
+        }
+        job.result->preset->LoadShaderTextures(job.renderContext);
+    }
+    catch (const std::exception& ex)
+    {
+        job.result->errorMessage = ex.what();
+    }
+}
+
+void PresetLoader::CompileCode(Job& job)
+{
+    try
+    {
+        // The init code of prefetched presets runs when they are loaded, with the render context at that time.
+        if (!job.prefetch)
+        {
+            job.result->preset->CompileCode(job.renderContext);
+        }
+        job.result->preset->TranspileShaders();
+    }
+    catch (const std::exception& ex)
+    {
+        job.result->errorMessage = ex.what();
+    }
+}
+
+auto PresetLoader::RemovePrefetchedPreset(const std::string& presetFilename, FileStamp& fileStamp) -> std::unique_ptr<Preset>
+{
+    // A preset which is still being prefetched is loaded again, so the result can be dropped.
+    m_prefetchRequests.erase(std::remove(m_prefetchRequests.begin(), m_prefetchRequests.end(), presetFilename), m_prefetchRequests.end());
+
+    auto const prefetchedPreset = std::find_if(m_prefetchedPresets.begin(), m_prefetchedPresets.end(),
+                                               [&presetFilename](const PrefetchedPreset& entry) { return entry.filename == presetFilename; });
+    if (prefetchedPreset == m_prefetchedPresets.end())
+    {
+        return {};
+    }
+
+    auto preset = std::move(prefetchedPreset->preset);
+    fileStamp = prefetchedPreset->fileStamp;
+    m_prefetchedPresets.erase(prefetchedPreset);
+
+    return preset;
+}
+
+void PresetLoader::StorePrefetchedPreset(Job& job)
+{
+    // Drop presets loaded or cleared while being prefetched.
+    if (!PrefetchRequested(job.result->filename))
+    {
+        return;
+    }
+    m_prefetchRequests.erase(std::find(m_prefetchRequests.begin(), m_prefetchRequests.end(), job.result->filename));
+
+    if (!job.result->errorMessage.empty() || m_prefetchLimit == 0)
+    {
+        return;
+    }
+
+    ShrinkPrefetchedPresets(m_prefetchLimit - 1);
+
+    PrefetchedPreset prefetchedPreset;
+    prefetchedPreset.filename = job.result->filename;
+    prefetchedPreset.fileStamp = job.fileStamp;
+    prefetchedPreset.preset = std::move(job.result->preset);
+    m_prefetchedPresets.push_front(std::move(prefetchedPreset));
+}
+
+auto PresetLoader::PrefetchRequested(const std::string& presetFilename) const -> bool
+{
+    return std::find(m_prefetchRequests.begin(), m_prefetchRequests.end(), presetFilename) != m_prefetchRequests.end();
+}
+
+void PresetLoader::ShrinkPrefetchedPresets(size_t count)
+{
+    while (m_prefetchedPresets.size() > count)
+    {
+        m_prefetchedPresets.pop_back();
+    }
+}
+
+auto PresetLoader::ReadFileStamp(const std::string& presetFilename, FileStamp& fileStamp) -> bool
+{
+    using namespace PROJECTM_FILESYSTEM_NAMESPACE::filesystem;
+
+    std::string filePath;
+    auto const protocol = PresetFactory::Protocol(presetFilename, filePath);
+    if (!protocol.empty() && protocol != "file")
+    {
+        return false;
+    }
+
+    try
+    {
+        path const presetPath(filePath);
+        fileStamp.size = file_size(presetPath);
+#ifdef PROJECTM_FILESYSTEM_USE_BOOST
+        fileStamp.modificationTime = static_cast<int64_t>(last_write_time(presetPath));
+#else
+        fileStamp.modificationTime = static_cast<int64_t>(last_write_time(presetPath).time_since_epoch().count());
+#endif
+    }
+    catch (const std::exception&)
+    {
+        return false;
+    }
+
+    return true;
+}
+
+} // namespace libprojectM
@@ -0,0 +1,294 @@
+/**
+ * @file PresetLoader.hpp
+ * @brief Loads presets in the background while the current preset keeps rendering.
+ */
+#pragma once
+
+#include <Renderer/RenderContext.hpp>
+#include <Renderer/ShaderCache.hpp>
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace libprojectM {
+
+class ParsedPreset;
+class Preset;
+class PresetFactoryManager;
+
+/**
+ * @class PresetLoader
+ * @brief Loads presets in the background while the current preset keeps rendering.
+ *
+ * Creating a preset is split into the parts which require the OpenGL context and the parts which
+ * don't, alternating between a worker thread and the rendering thread:
+ * 1. The worker reads and parses the preset file.
+ * 2. Update() creates the preset object with its OpenGL resources and loads the shader textures.
+ * 3. The worker compiles the expression code, runs the init code and translates the preset
+ *    shaders into GLSL, see Preset::CompileCode() and Preset::TranspileShaders().
+ * 4. Update() starts compiling the GLSL shaders, see Preset::StartCompilingShaders(). If the
+ *    driver supports parallel shader compilation, the preset is returned once the driver finished
+ *    all programs, otherwise right away. The caller starts the transition, which links the GLSL
+ *    shaders in Preset::Initialize() or uses the already linked programs.
+ *
+ * Only the most recent request is loaded. Starting a new one or calling Cancel() discards any
+ * preset still being loaded. Presets are always destroyed on the rendering thread.
+ *
+ * Presets which will probably be loaded soon, e.g. the next playlist items, can be prepared ahead
+ * of time with Prefetch(). This runs steps 1 to 3, except for compiling the expression code, as the
+ * init code must run with the render context of the actual switch. Load() then only compiles the
+ * code of a prefetched preset. Prefetched presets are kept until loaded, and only used if the file's
+ * modification time and size didn't change. For Load(), the worker thread checks this. The number of
+ * prefetched presets is limited. Load requests take priority over prefetching.
+ *
+ * All public methods must be called from the rendering thread. If no threads are available, e.g. in
+ * Emscripten builds without pthreads, all steps run in Load() instead and Prefetch() does nothing.
+ */
+class PresetLoader
+{
+public:
+    /**
+     * @brief The outcome of a load request.
+     */
+    struct Result {
+        std::string filename;           //!< The requested preset filename or URL.
+        bool smoothTransition{false};   //!< The requested transition type.
+        std::unique_ptr<Preset> preset; //!< The loaded preset. Must not be used if errorMessage isn't empty.
+        std::string errorMessage;       //!< The reason loading failed, or empty if the preset was loaded.
+
+        std::vector<Renderer::ShaderCache::ProgramPtr> shaderPrograms; //!< Programs compiled in the background, kept until the preset is initialized.
+    };
+
+    static constexpr uint32_t DefaultPrefetchLimit{4}; //!< Default maximum number of prefetched presets.
+
+    /**
+     * @brief Constructor.
+     * @param presetFactoryManager The factory manager used to create presets. Must outlive this object.
+     */
+    explicit PresetLoader(PresetFactoryManager& presetFactoryManager);
+
+    /**
+     * @brief Destructor. Waits for the worker thread to finish and destroys all pending presets.
+     */
+    ~PresetLoader();
+
+    PresetLoader(const PresetLoader&) = delete;
+    auto operator=(const PresetLoader&) -> PresetLoader& = delete;
+
+    /**
+     * @brief Starts loading a preset in the background. Discards any previous request.
+     * Uses the prefetched preset if available. The worker thread loads the file again if it was
+     * changed since prefetching it.
+     * @param presetFilename The preset filename or URL to load.
+     * @param smoothTransition The transition type to pass on with the result.
+     * @param renderContext The render context used to run the preset's init code.
+     */
+    void Load(const std::string& presetFilename, bool smoothTransition, const Renderer::RenderContext& renderContext);
+
+    /**
+     * @brief Discards the current request, if any.
+     */
+    void Cancel();
+
+    /**
+     * @brief Returns whether a preset is currently being loaded.
+     * @return true if a request is pending, false if not.
+     */
+    auto IsLoading() const -> bool;
+
+    /**
+     * @brief Creates the presets parsed by the worker thread, and returns the result once finished.
+     * Never waits for the worker thread or the shader compiler. Call once per frame.
+     * @param renderContext The current render context, used to create the parsed presets.
+     * @return The request result, or an empty pointer if there is none or it isn't finished yet.
+     */
+    auto Update(const Renderer::RenderContext& renderContext) -> std::unique_ptr<Result>;
+
+    /**
+     * @brief Prepares a preset in the background, so a later Load() of the same file is quicker.
+     *
+     * Only local files and "file://" URLs are prefetched, other URLs are ignored. Requesting a
+     * preset which is already prefetched marks it as recently requested.
+     *
+     * @param presetFilename The preset filename or URL, exactly as later passed to Load().
+     * @param renderContext The render context used to create the preset.
+     */
+    void Prefetch(const std::string& presetFilename, const Renderer::RenderContext& renderContext);
+
+    /**
+     * @brief Returns whether a prefetched preset is available.
+     * @param presetFilename The preset filename or URL.
+     * @return true if the preset was prefetched and not loaded since, false if not.
+     */
+    auto IsPrefetched(const std::string& presetFilename) const -> bool;
+
+    /**
+     * @brief Removes a prefetched preset and returns it, if the file didn't change since.
+     *
+     * Checks the file on the calling thread, so only use it for loading presets synchronously.
+     * The preset's code isn't compiled yet. Preset::Initialize() does this.
+     *
+     * @param presetFilename The preset filename or URL.
+     * @return The prefetched preset, or an empty pointer if there is none or the file was changed.
+     */
+    auto TakePrefetchedPreset(const std::string& presetFilename) -> std::unique_ptr<Preset>;
+
+    /**
+     * @brief Destroys all prefetched presets and discards the pending prefetch requests.
+     * Must be called if the texture manager is replaced.
+     */
+    void ClearPrefetchedPresets();
+
+    /**
+     * @brief Sets the maximum number of prefetched presets.
+     * Drops the least recently requested prefetched presets until the new limit is met.
+     * @param count The maximum number of presets. 0 disables prefetching.
+     */
+    void SetPrefetchLimit(uint32_t count);
+
+    /**
+     * @brief Returns the maximum number of prefetched presets.
+     * @return The maximum number of presets.
+     */
+    auto PrefetchLimit() const -> uint32_t;
+
+    /**
+     * @brief Returns the number of presets currently prefetched.
+     * @return The number of prefetched presets.
+     */
+    auto PrefetchedPresetCount() const -> size_t;
+
+private:
+    /**
+     * @brief Identifies a version of a preset file.
+     */
+    struct FileStamp {
+        int64_t modificationTime{}; //!< The file modification time, in file system specific units.
+        uintmax_t size{};           //!< The file size in bytes.
+
+        auto operator==(const FileStamp& other) const -> bool
+        {
+            return modificationTime == other.modificationTime && size == other.size;
+        }
+    };
+
+    /**
+     * @brief A request handed between the rendering and worker threads.
+     */
+    struct Job {
+        uint32_t generation{};                      //!< Request counter value, used to discard outdated jobs.
+        bool prefetch{false};                       //!< If true, the preset is prefetched instead of loaded.
+        bool checkFileStamp{false};                 //!< If true, the worker loads the file again if it doesn't match fileStamp anymore.
+        FileStamp fileStamp;                        //!< The version of the prefetched file.
+        Renderer::RenderContext renderContext;      //!< Render context for loading textures and running the init code.
+        std::unique_ptr<ParsedPreset> parsedPreset; //!< The parsed preset file, until the preset is created.
+        std::unique_ptr<Result> result;             //!< The preset and the outcome.
+        std::unique_ptr<Preset> outdatedPreset;     //!< A prefetched preset replaced because the file changed, destroyed on the rendering thread.
+    };
+
+    /**
+     * @brief A prefetched preset, waiting to be loaded.
+     */
+    struct PrefetchedPreset {
+        std::string filename;           //!< The preset filename or URL as passed to Prefetch().
+        FileStamp fileStamp;            //!< The version of the file the preset was created from.
+        std::unique_ptr<Preset> preset; //!< The preset with translated shaders.
+    };
+
+    /**
+     * @brief Starts the worker thread if it isn't running yet.
+     * @return true if the thread is running, false if threads are not available on this platform.
+     */
+    auto StartThread() -> bool;
+
+    /**
+     * @brief Worker thread main loop.
+     */
+    void Run();
+
+    /**
+     * @brief Reads and parses the preset file of a job, storing any error in the result.
+     * Runs on the worker thread.
+     * @param job The job to process.
+     */
+    void ParsePreset(Job& job);
+
+    /**
+     * @brief Creates the preset from the parsed data and loads its textures, storing any error in the result.
+     * Runs on the rendering thread.
+     * @param job The job to process.
+     */
+    void CreatePreset(Job& job);
+
+    /**
+     * @brief Compiles the preset code and translates the shaders of a job, storing any error in the result.
+     * Prefetch jobs only translate the shaders. Runs on the worker thread.
+     * @param job The job to process.
+     */
+    static void CompileCode(Job& job);
+
+    /**
+     * @brief Removes a prefetched preset from the list without checking the file.
+     * @param presetFilename The preset filename or URL.
+     * @param[out] fileStamp The version of the file the preset was created from.
+     * @return The prefetched preset, or an empty pointer if there is none.
+     */
+    auto RemovePrefetchedPreset(const std::string& presetFilename, FileStamp& fileStamp) -> std::unique_ptr<Preset>;
+
+    /**
+     * @brief Keeps the preset of a finished prefetch job, if it's still requested and the limit isn't zero.
+     * @param job The finished prefetch job.
+     */
+    void StorePrefetchedPreset(Job& job);
+
+    /**
+     * @brief Returns whether a preset is currently being prefetched.
+     * @param presetFilename The preset filename or URL.
+     * @return true if the prefetch request is pending, false if not.
+     */
+    auto PrefetchRequested(const std::string& presetFilename) const -> bool;
+
+    /**
+     * @brief Drops the least recently requested prefetched presets until at most the given number is left.
+     * @param count The maximum number of prefetched presets.
+     */
+    void ShrinkPrefetchedPresets(size_t count);
+
+    /**
+     * @brief Reads the modification time and size of a local preset file.
+     * @param presetFilename The preset filename or "file://" URL.
+     * @param[out] fileStamp The file version.
+     * @return true if the file exists and could be queried, false if not.
+     */
+    static auto ReadFileStamp(const std::string& presetFilename, FileStamp& fileStamp) -> bool;
+
+    PresetFactoryManager& m_presetFactoryManager; //!< Creates the preset objects.
+
+    std::thread m_thread;         //!< The worker thread.
+    bool m_threadAvailable{true}; //!< False if the worker thread couldn't be started.
+    bool m_loading{false};        //!< True while a request is pending. Only used by the rendering thread.
+
+    std::unique_ptr<Result> m_compilingResult; //!< Loaded preset waiting for the driver to compile its shaders. Only used by the rendering thread.
+
+    std::list<PrefetchedPreset> m_prefetchedPresets; //!< Prefetched presets, most recently requested first. Only used by the rendering thread.
+    std::vector<std::string> m_prefetchRequests;     //!< Files currently being prefetched. Only used by the rendering thread.
+    uint32_t m_prefetchLimit{DefaultPrefetchLimit};  //!< Maximum number of prefetched presets.
+
+    mutable std::mutex m_mutex;          //!< Protects the state below.
+    std::condition_variable m_condition; //!< Signals new jobs or stopping to the worker.
+    bool m_stopRequested{false};         //!< If true, the worker thread will exit.
+    uint32_t m_generation{0};            //!< Incremented with each request and cancellation.
+    std::deque<Job> m_pendingJobs;       //!< Jobs waiting for the worker thread to parse the preset file or compile the code. Load jobs are queued first.
+    std::deque<Job> m_parsedJobs;        //!< Jobs waiting for Update() to create the preset.
+    std::deque<Job> m_finishedJobs;      //!< Jobs processed by the worker thread, waiting for Update().
+};
+
+} // namespace libprojectM
@@ -23,20 +23,31 @@
 
 #include "Preset.hpp"
 #include "PresetFactoryManager.hpp"
+#include "PresetLoader.hpp"
 #include "TimeKeeper.hpp"
 
 #include <Audio/PCM.hpp>
 
 #include <Renderer/CopyTexture.hpp>
 #include <Renderer/PresetTransition.hpp>
+#include <Renderer/ShaderCache.hpp>
 #include <Renderer/TextureManager.hpp>
 #include <Renderer/TransitionShaderManager.hpp>
 
 namespace libprojectM {
 
 ProjectM::ProjectM()
+    : ProjectM(Audio::AnalysisSize())
+{
+}
+
+ProjectM::ProjectM(const Audio::AnalysisSize& audioAnalysisSize)
     : m_presetFactoryManager(std::make_unique<PresetFactoryManager>())
+    , m_presetLoader(std::make_unique<PresetLoader>(*m_presetFactoryManager))
+    , m_audioStorage(audioAnalysisSize)
+    , m_shaderCache(std::make_unique<Renderer::ShaderCache>())
 {
+    Renderer::ShaderCache::Scope shaderCacheScope(*m_shaderCache);
     Initialize();
 }
 
@@ -53,12 +64,26 @@ void ProjectM::PresetSwitchFailedEvent(const std::string&, const std::string&) c
 {
 }
 
+void ProjectM::PresetTimeBudgetExceededEvent(const std::string&) const
+{
+}
+
 void ProjectM::LoadPresetFile(const std::string& presetFilename, bool smoothTransition)
 {
+    Renderer::ShaderCache::Scope shaderCacheScope(*m_shaderCache);
+    m_presetLoader->Cancel();
+
     try
     {
+        // A prefetched preset only needs its code and shaders compiled.
+        auto preset = m_presetLoader->TakePrefetchedPreset(presetFilename);
+        if (!preset)
+        {
+            preset = m_presetFactoryManager->CreatePresetFromFile(presetFilename);
+        }
+
         m_textureManager->PurgeTextures();
-        StartPresetTransition(m_presetFactoryManager->CreatePresetFromFile(presetFilename), !smoothTransition);
+        StartPresetTransition(std::move(preset), !smoothTransition);
     }
     catch (const std::exception& ex)
     {
@@ -68,6 +93,9 @@ void ProjectM::LoadPresetFile(const std::string& presetFilename, bool smoothTran
 
 void ProjectM::LoadPresetData(std::istream& presetData, bool smoothTransition)
 {
+    Renderer::ShaderCache::Scope shaderCacheScope(*m_shaderCache);
+    m_presetLoader->Cancel();
+
     try
     {
         m_textureManager->PurgeTextures();
@@ -79,14 +107,31 @@ void ProjectM::LoadPresetData(std::istream& presetData, bool smoothTransition)
     }
 }
 
+void ProjectM::LoadPresetFileAsync(const std::string& presetFilename, bool smoothTransition)
+{
+    m_presetLoader->Load(presetFilename, smoothTransition, GetRenderContext());
+}
+
+auto ProjectM::PresetLoading() const -> bool
+{
+    return m_presetLoader->IsLoading();
+}
+
+void ProjectM::PrefetchPresetFile(const std::string& presetFilename)
+{
+    m_presetLoader->Prefetch(presetFilename, GetRenderContext());
+}
+
 void ProjectM::SetTexturePaths(std::vector<std::string> texturePaths)
 {
     m_textureSearchPaths = std::move(texturePaths);
+    m_presetLoader->ClearPrefetchedPresets();
     m_textureManager = std::make_unique<Renderer::TextureManager>(m_textureSearchPaths);
 }
 
 void ProjectM::ResetTextures()
 {
+    m_presetLoader->ClearPrefetchedPresets();
     m_textureManager = std::make_unique<Renderer::TextureManager>(m_textureSearchPaths);
 }
 
@@ -98,22 +143,33 @@ void ProjectM::RenderFrame()
         return;
     }
 
+    Renderer::ShaderCache::Scope shaderCacheScope(*m_shaderCache);
+
     // Update FPS and other timer values.
     m_timeKeeper->UpdateTimers();
 
-    // Update and retrieve audio data
-    m_audioStorage.UpdateFrameAudioData(m_timeKeeper->SecondsSinceLastFrame(), m_frameCount);
-    auto audioData = m_audioStorage.GetFrameAudioData();
-
-    // Apply beat sensitivity scaling to audio data
-    audioData.bass *= m_beatSensitivity;
-    audioData.bassAtt *= m_beatSensitivity;
-    audioData.mid *= m_beatSensitivity;
-    audioData.midAtt *= m_beatSensitivity;
-    audioData.treb *= m_beatSensitivity;
-    audioData.trebAtt *= m_beatSensitivity;
-    audioData.vol *= m_beatSensitivity;
-    audioData.volAtt *= m_beatSensitivity;
+    // Update and retrieve audio data. The snapshot is shared by all consumers and carries the beat sensitivity.
+    Audio::FrameAudioData::Ptr audioData;
+    if (m_externalAudioAnalyzer.HasPendingData())
+    {
+        // The application already analyzed the audio for this frame.
+        audioData = m_externalAudioAnalyzer.TakeFrameAudioData(m_timeKeeper->SecondsSinceLastFrame(), m_frameCount, m_beatSensitivity);
+    }
+    else if (m_audioAnalysisThread.IsRunning())
+    {
+        // Use the last published result, then let the worker analyze the next frame while this one renders.
+        // The analyzed data is displayed one frame later, so the presentation time is extrapolated.
+        audioData = m_audioAnalysisThread.LatestFrameAudioData();
+        m_audioAnalysisThread.RequestUpdate(m_timeKeeper->SecondsSinceLastFrame(), m_frameCount, m_beatSensitivity,
+                                            m_framePresentationTime + m_timeKeeper->SecondsSinceLastFrame());
+    }
+    else
+    {
+        m_audioStorage.UpdateFrameAudioData(m_timeKeeper->SecondsSinceLastFrame(), m_frameCount, m_framePresentationTime);
+        audioData = m_audioStorage.GetFrameAudioData(m_beatSensitivity);
+    }
+    m_framePresentationTime = std::numeric_limits<double>::quiet_NaN();
+    m_lastFrameAudioData = audioData;
 
     // Check if the preset isn't locked, and we've not already notified the user
     if (!m_presetChangeNotified)
@@ -126,7 +182,7 @@ void ProjectM::RenderFrame()
         }
         else if (m_hardCutEnabled &&
                  m_frameCount > 50 &&
-                 (audioData.vol - m_previousFrameVolume > m_hardCutSensitivity) &&
+                 (audioData->Vol() - m_previousFrameVolume > m_hardCutSensitivity) &&
                  m_timeKeeper->CanHardCut())
         {
             m_presetChangeNotified = true;
@@ -134,6 +190,25 @@ void ProjectM::RenderFrame()
         }
     }
 
+    // Switch to a preset loaded in the background once it is ready.
+    auto loadedPreset = m_presetLoader->Update(GetRenderContext());
+    if (loadedPreset && !loadedPreset->errorMessage.empty())
+    {
+        PresetSwitchFailedEvent(loadedPreset->filename, loadedPreset->errorMessage);
+    }
+    else if (loadedPreset)
+    {
+        try
+        {
+            m_textureManager->PurgeTextures();
+            StartPresetTransition(std::move(loadedPreset->preset), !loadedPreset->smoothTransition);
+        }
+        catch (const std::exception& ex)
+        {
+            PresetSwitchFailedEvent(loadedPreset->filename, ex.what());
+        }
+    }
+
     // If no preset is active, load the idle preset.
     if (!m_activePreset)
     {
@@ -163,6 +238,7 @@ void ProjectM::RenderFrame()
         if (m_transition->IsDone())
         {
             m_activePreset = std::move(m_transitioningPreset);
+            m_activePresetTimeBudgetNotified = m_transitioningPresetTimeBudgetNotified;
             m_transitioningPreset.reset();
             m_transition.reset();
         }
@@ -181,15 +257,22 @@ void ProjectM::RenderFrame()
 
     if (m_transition != nullptr && m_transitioningPreset != nullptr)
     {
-        m_transition->Draw(*m_activePreset, *m_transitioningPreset, renderContext, audioData);
+        m_transition->Draw(*m_activePreset, *m_transitioningPreset, renderContext, *audioData);
     }
     else
     {
         m_textureCopier->Draw(m_activePreset->OutputTexture(), false, false);
     }
 
+    // Report presets which are too slow once, so the application can decide whether to skip them.
+    NotifyTimeBudgetExceeded(*m_activePreset, m_activePresetTimeBudgetNotified);
+    if (m_transitioningPreset != nullptr)
+    {
+        NotifyTimeBudgetExceeded(*m_transitioningPreset, m_transitioningPresetTimeBudgetNotified);
+    }
+
     m_frameCount++;
-    m_previousFrameVolume = audioData.vol;
+    m_previousFrameVolume = audioData->Vol();
 }
 
 void ProjectM::Initialize()
@@ -226,6 +309,15 @@ void ProjectM::LoadIdlePreset()
     assert(m_activePreset);
 }
 
+void ProjectM::NotifyTimeBudgetExceeded(const Preset& preset, bool& notified) const
+{
+    if (!notified && preset.ExpressionTimeBudgetExceeded())
+    {
+        notified = true;
+        PresetTimeBudgetExceededEvent(preset.Filename());
+    }
+}
+
 void ProjectM::SetWindowSize(uint32_t width, uint32_t height)
 {
     /** Stash the new dimensions */
@@ -248,6 +340,7 @@ void ProjectM::StartPresetTransition(std::unique_ptr<Preset>&& preset, bool hard
     if (m_transitioningPreset != nullptr)
     {
         m_activePreset = std::move(m_transitioningPreset);
+        m_activePresetTimeBudgetNotified = m_transitioningPresetTimeBudgetNotified;
         m_transition.reset();
     }
 
@@ -259,11 +352,13 @@ void ProjectM::StartPresetTransition(std::unique_ptr<Preset>&& preset, bool hard
     if (hardCut)
     {
         m_activePreset = std::move(preset);
+        m_activePresetTimeBudgetNotified = false;
         m_timeKeeper->StartPreset();
     }
     else
     {
         m_transitioningPreset = std::move(preset);
+        m_transitioningPresetTimeBudgetNotified = false;
         m_timeKeeper->StartSmoothing();
         m_transition = std::make_unique<Renderer::PresetTransition>(m_transitionShaderManager->RandomTransition(), m_softCutDuration);
     }
@@ -316,6 +411,31 @@ auto ProjectM::GetTimeScale() const -> float
     return m_timeScale;
 }
 
+auto ProjectM::ExpressionTimeBudget() const -> double
+{
+    return m_expressionTimeBudget;
+}
+
+void ProjectM::SetExpressionTimeBudget(double seconds)
+{
+    m_expressionTimeBudget = std::max(0.0, seconds);
+}
+
+void ProjectM::SetShaderCachePath(const std::string& path)
+{
+    Renderer::ShaderCache::SetBinaryCacheDirectory(path);
+}
+
+void ProjectM::SetPresetPrefetchLimit(uint32_t count)
+{
+    m_presetLoader->SetPrefetchLimit(count);
+}
+
+auto ProjectM::PresetPrefetchLimit() const -> uint32_t
+{
+    return m_presetLoader->PrefetchLimit();
+}
+
 auto ProjectM::SoftCutDuration() const -> double
 {
     return m_softCutDuration;
@@ -431,6 +551,38 @@ auto ProjectM::PCM() -> libprojectM::Audio::PCM&
     return m_audioStorage;
 }
 
+void ProjectM::SetAudioAnalysisThreaded(bool enabled)
+{
+    if (enabled)
+    {
+        m_audioAnalysisThread.Start();
+    }
+    else
+    {
+        m_audioAnalysisThread.Stop();
+    }
+}
+
+auto ProjectM::AudioAnalysisThreaded() const -> bool
+{
+    return m_audioAnalysisThread.IsRunning();
+}
+
+void ProjectM::SetFramePresentationTime(double presentationTime)
+{
+    m_framePresentationTime = presentationTime;
+}
+
+auto ProjectM::ExternalAudioAnalyzer() -> Audio::ExternalAnalyzer&
+{
+    return m_externalAudioAnalyzer;
+}
+
+auto ProjectM::LastFrameAudioData() const -> Audio::FrameAudioData::Ptr
+{
+    return m_lastFrameAudioData;
+}
+
 void ProjectM::Touch(float, float, int, int)
 {
     // UNIMPLEMENTED
@@ -466,6 +618,12 @@ auto ProjectM::GetRenderContext() -> Renderer::RenderContext
     ctx.invAspectY = 1.0f / ctx.aspectY;
     ctx.perPixelMeshX = static_cast<int>(m_meshX);
     ctx.perPixelMeshY = static_cast<int>(m_meshY);
+    if (m_expressionTimeBudget > 0.0)
+    {
+        // All presets rendered with this context share the deadline.
+        ctx.expressionDeadline = std::chrono::steady_clock::now() +
+                                 std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(m_expressionTimeBudget));
+    }
     ctx.textureManager = m_textureManager.get();
 
     return ctx;
@@ -24,8 +24,11 @@
 
 #include <Renderer/RenderContext.hpp>
 
+#include <Audio/AnalysisThread.hpp>
+#include <Audio/ExternalAnalyzer.hpp>
 #include <Audio/PCM.hpp>
 
+#include <limits>
 #include <memory>
 #include <string>
 #include <vector>
@@ -36,12 +39,14 @@ namespace Renderer {
 class CopyTexture;
 class PresetTransition;
 class Renderer;
+class ShaderCache;
 class TextureManager;
 class TransitionShaderManager;
 } // namespace Renderer
 
 class Preset;
 class PresetFactoryManager;
+class PresetLoader;
 class TimeKeeper;
 
 class PROJECTM_EXPORT ProjectM
@@ -49,6 +54,12 @@ class PROJECTM_EXPORT ProjectM
 public:
     ProjectM();
 
+    /**
+     * @brief Creates a projectM instance with a custom spectrum analyzer size.
+     * @param audioAnalysisSize The spectrum analyzer size. If invalid, the legacy size is used.
+     */
+    explicit ProjectM(const Audio::AnalysisSize& audioAnalysisSize);
+
     virtual ~ProjectM();
 
     /**
@@ -68,6 +79,16 @@ public:
      */
     virtual void PresetSwitchFailedEvent(const std::string& presetFilename, const std::string& message) const;
 
+    /**
+     * @brief Callback for notifying the integrating app that a preset exceeded the expression time budget.
+     *
+     * Called once per preset. The preset keeps running, but some of its expression code is skipped in
+     * frames which exceed the budget. The app can decide whether to switch to another preset.
+     *
+     * @param presetFilename The filename of the preset. Empty if loaded from a stream.
+     */
+    virtual void PresetTimeBudgetExceededEvent(const std::string& presetFilename) const;
+
     /**
      * @brief Loads the given preset file and performs a smooth or immediate transition.
      * @param presetFilename The preset filename to load.
@@ -76,6 +97,34 @@ public:
      */
     void LoadPresetFile(const std::string& presetFilename, bool smoothTransition);
 
+    /**
+     * @brief Loads the given preset file in the background and transitions to it once it is ready.
+     *
+     * The preset is created immediately, but its expression code is compiled on a worker thread.
+     * The current preset continues to be rendered until the new preset is ready, which usually takes
+     * a few frames. If the preset fails to load, PresetSwitchFailedEvent() is called from RenderFrame().
+     *
+     * Only the most recent request is loaded. Calling LoadPresetFile() or LoadPresetData() discards
+     * any preset still being loaded.
+     *
+     * @param presetFilename The preset filename to load.
+     * @param smoothTransition If set to true, old and new presets will be blended over smoothly.
+     *                         If set to false, the new preset will be rendered immediately.
+     */
+    void LoadPresetFileAsync(const std::string& presetFilename, bool smoothTransition);
+
+    /**
+     * @brief Returns whether a preset is currently being loaded in the background.
+     * @return True if a preset requested via LoadPresetFileAsync() isn't displayed yet, false if not.
+     */
+    auto PresetLoading() const -> bool;
+
+    /**
+     * @brief Prepares a preset in the background, so loading it later only compiles its code and shaders.
+     * @param presetFilename The preset filename or URL, as later passed to LoadPresetFile() or LoadPresetFileAsync().
+     */
+    void PrefetchPresetFile(const std::string& presetFilename);
+
     /**
      * @brief Loads the given preset data and performs a smooth or immediate transition.
      *
@@ -147,6 +196,46 @@ public:
      */
     void SetTargetFramesPerSecond(int32_t fps);
 
+    /**
+     * @brief Returns the maximum time presets may spend evaluating expression code per frame.
+     * @return The time budget in seconds, or 0 if unlimited.
+     */
+    auto ExpressionTimeBudget() const -> double;
+
+    /**
+     * @brief Sets the maximum time presets may spend evaluating expression code per frame.
+     *
+     * The budget applies to the whole frame, so during a transition both presets share it. If a
+     * preset exceeds it, its remaining code isn't evaluated in that and all following frames, and
+     * PresetTimeBudgetExceededEvent() is called once. Only loops in native code are interrupted, so
+     * a single interpreted execution can still take longer.
+     *
+     * @param seconds The time budget in seconds. 0 or less disables the limit.
+     */
+    void SetExpressionTimeBudget(double seconds);
+
+    /**
+     * @brief Sets the directory to store compiled shader program binaries in.
+     *
+     * The binary cache is shared by all projectM instances in the process. The directory must
+     * exist. An empty path disables the binary cache, which is the default.
+     *
+     * @param path The cache directory.
+     */
+    void SetShaderCachePath(const std::string& path);
+
+    /**
+     * @brief Sets the maximum number of prefetched presets.
+     * @param count The maximum number of presets. 0 disables prefetching.
+     */
+    void SetPresetPrefetchLimit(uint32_t count);
+
+    /**
+     * @brief Returns the maximum number of prefetched presets.
+     * @return The maximum number of presets.
+     */
+    auto PresetPrefetchLimit() const -> uint32_t;
+
     auto AspectCorrection() const -> bool;
 
     void SetAspectCorrection(bool enabled);
@@ -175,6 +264,49 @@ public:
 
     auto PCM() -> Audio::PCM&;
 
+    /**
+     * @brief Enables or disables running the audio analysis on a separate worker thread.
+     *
+     * If enabled, the spectrum analysis, waveform alignment and beat detection for the next frame
+     * run in parallel to rendering the current frame. Each frame then uses the audio data analyzed
+     * during the previous frame, adding one frame of latency.
+     *
+     * @param enabled true to run the analysis on a worker thread, false to run it synchronously.
+     */
+    void SetAudioAnalysisThreaded(bool enabled);
+
+    /**
+     * @brief Returns whether the audio analysis runs on a separate worker thread.
+     * @return true if the audio analysis runs on a worker thread, false if it runs synchronously.
+     */
+    auto AudioAnalysisThreaded() const -> bool;
+
+    /**
+     * @brief Sets the host time at which the next rendered frame will be displayed.
+     *
+     * Used together with timestamped audio data to select the audio window which is audible while the
+     * frame is visible. Only applies to the next call of RenderFrame().
+     *
+     * @param presentationTime Host time in seconds, in the same clock as the audio timestamps.
+     */
+    void SetFramePresentationTime(double presentationTime);
+
+    /**
+     * @brief Returns the analyzer for application-supplied audio data.
+     *
+     * If any data was passed to this analyzer, the next frame uses it instead of analyzing the
+     * audio data in PCM().
+     *
+     * @return The external analyzer instance.
+     */
+    auto ExternalAudioAnalyzer() -> Audio::ExternalAnalyzer&;
+
+    /**
+     * @brief Returns the audio data used to render the last frame.
+     * @return The last frame's audio data snapshot. Silent if no frame was rendered yet.
+     */
+    auto LastFrameAudioData() const -> Audio::FrameAudioData::Ptr;
+
     auto WindowWidth() -> int;
 
     auto WindowHeight() -> int;
@@ -186,6 +318,13 @@ private:
 
     void LoadIdlePreset();
 
+    /**
+     * @brief Calls PresetTimeBudgetExceededEvent() if the preset exceeded the budget in the last frame.
+     * @param preset The preset to check.
+     * @param notified Stores whether the event was already sent for the preset.
+     */
+    void NotifyTimeBudgetExceeded(const Preset& preset, bool& notified) const;
+
     auto GetRenderContext() -> Renderer::RenderContext;
 
     uint32_t m_meshX{32};              //!< Per-point mesh horizontal resolution.
@@ -203,6 +342,8 @@ private:
     bool m_aspectCorrection{true};   //!< If true, corrects aspect ratio for non-rectangular windows.
     float m_easterEgg{1.0};          //!< Random preset duration modifier. See TimeKeeper class.
     float m_previousFrameVolume{};   //!< Volume in previous frame, used for hard cuts.
+    double m_expressionTimeBudget{}; //!< Maximum expression evaluation time per frame in seconds, 0 for unlimited.
+    double m_framePresentationTime{std::numeric_limits<double>::quiet_NaN()}; //!< Presentation time of the next frame, NaN if unknown.
 
     std::vector<std::string> m_textureSearchPaths; ///!< List of paths to search for texture files
 
@@ -211,10 +352,17 @@ private:
 
     bool m_presetLocked{false};         //!< If true, the preset change event will not be sent.
     bool m_presetChangeNotified{false}; //!< Stores whether the user has been notified that projectM wants to switch the preset.
+    bool m_activePresetTimeBudgetNotified{false};        //!< Stores whether the user has been notified that the active preset exceeded the expression time budget.
+    bool m_transitioningPresetTimeBudgetNotified{false}; //!< Stores whether the user has been notified that the transitioning preset exceeded the expression time budget.
 
     std::unique_ptr<PresetFactoryManager> m_presetFactoryManager; //!< Provides access to all available preset factories.
+    std::unique_ptr<PresetLoader> m_presetLoader;                 //!< Loads presets in the background.
 
     Audio::PCM m_audioStorage;                                                    //!< Audio data buffer and analyzer instance.
+    Audio::AnalysisThread m_audioAnalysisThread{m_audioStorage};                  //!< Optional worker thread running the audio analysis.
+    Audio::ExternalAnalyzer m_externalAudioAnalyzer;                              //!< Application-supplied audio data, replacing the analysis if set.
+    Audio::FrameAudioData::Ptr m_lastFrameAudioData{std::make_shared<Audio::FrameAudioData>()}; //!< Audio data used to render the last frame.
+    std::unique_ptr<Renderer::ShaderCache> m_shaderCache;                         //!< Shares linked shader programs between the presets of this instance.
     std::unique_ptr<Renderer::TextureManager> m_textureManager;                   //!< The texture manager.
     std::unique_ptr<Renderer::TransitionShaderManager> m_transitionShaderManager; //!< The transition shader manager.
     std::unique_ptr<Renderer::CopyTexture> m_textureCopier;                       //!< Class that copies textures 1:1 to another texture or framebuffer.
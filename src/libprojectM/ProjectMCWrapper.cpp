@@ -27,6 +27,14 @@ void projectMWrapper::PresetSwitchFailedEvent(const std::string& presetFilename,
     }
 }
 
+void projectMWrapper::PresetTimeBudgetExceededEvent(const std::string& presetFilename) const
+{
+    if (m_presetTimeBudgetExceededEventCallback)
+    {
+        m_presetTimeBudgetExceededEventCallback(presetFilename.c_str(), m_presetTimeBudgetExceededEventUserData);
+    }
+}
+
 } // namespace libprojectM
 
 libprojectM::projectMWrapper* handle_to_instance(projectm_handle instance)
@@ -74,6 +82,28 @@ projectm_handle projectm_create()
     }
 }
 
+projectm_handle projectm_create_with_audio_analysis_size(unsigned int spectrum_samples, unsigned int window_samples)
+{
+    libprojectM::Audio::AnalysisSize analysisSize;
+    analysisSize.spectrumSamples = spectrum_samples;
+    analysisSize.windowSamples = window_samples;
+
+    if (!analysisSize.IsValid())
+    {
+        return nullptr;
+    }
+
+    try
+    {
+        auto projectMInstance = new libprojectM::projectMWrapper(analysisSize);
+        return reinterpret_cast<projectm_handle>(projectMInstance);
+    }
+    catch (...)
+    {
+        return nullptr;
+    }
+}
+
 void projectm_destroy(projectm_handle instance)
 {
     auto projectMInstance = handle_to_instance(instance);
@@ -87,6 +117,30 @@ void projectm_load_preset_file(projectm_handle instance, const char* filename,
     projectMInstance->LoadPresetFile(filename, smooth_transition);
 }
 
+void projectm_load_preset_file_async(projectm_handle instance, const char* filename,
+                                     bool smooth_transition)
+{
+    auto projectMInstance = handle_to_instance(instance);
+    projectMInstance->LoadPresetFileAsync(filename, smooth_transition);
+}
+
+bool projectm_is_preset_loading(projectm_handle instance)
+{
+    auto projectMInstance = handle_to_instance(instance);
+    return projectMInstance->PresetLoading();
+}
+
+void projectm_prefetch_preset_file(projectm_handle instance, const char* filename)
+{
+    if (filename == nullptr)
+    {
+        return;
+    }
+
+    auto projectMInstance = handle_to_instance(instance);
+    projectMInstance->PrefetchPresetFile(filename);
+}
+
 void projectm_load_preset_data(projectm_handle instance, const char* data,
                                bool smooth_transition)
 {
@@ -111,6 +165,14 @@ void projectm_set_preset_switch_failed_event_callback(projectm_handle instance,
     projectMInstance->m_presetSwitchFailedEventUserData = user_data;
 }
 
+void projectm_set_preset_time_budget_exceeded_event_callback(projectm_handle instance,
+                                                             projectm_preset_time_budget_exceeded_event callback, void* user_data)
+{
+    auto projectMInstance = handle_to_instance(instance);
+    projectMInstance->m_presetTimeBudgetExceededEventCallback = callback;
+    projectMInstance->m_presetTimeBudgetExceededEventUserData = user_data;
+}
+
 void projectm_set_texture_search_paths(projectm_handle instance,
                                        const char** texture_search_paths,
                                        size_t count)
@@ -282,6 +344,36 @@ void projectm_set_fps(projectm_handle instance, int32_t fps)
     projectMInstance->SetTargetFramesPerSecond(fps);
 }
 
+void projectm_set_expression_time_budget(projectm_handle instance, double seconds)
+{
+    auto projectMInstance = handle_to_instance(instance);
+    projectMInstance->SetExpressionTimeBudget(seconds);
+}
+
+double projectm_get_expression_time_budget(projectm_handle instance)
+{
+    auto projectMInstance = handle_to_instance(instance);
+    return projectMInstance->ExpressionTimeBudget();
+}
+
+void projectm_set_shader_cache_path(projectm_handle instance, const char* path)
+{
+    auto projectMInstance = handle_to_instance(instance);
+    projectMInstance->SetShaderCachePath(path != nullptr ? path : "");
+}
+
+void projectm_set_preset_prefetch_limit(projectm_handle instance, uint32_t count)
+{
+    auto projectMInstance = handle_to_instance(instance);
+    projectMInstance->SetPresetPrefetchLimit(count);
+}
+
+uint32_t projectm_get_preset_prefetch_limit(projectm_handle instance)
+{
+    auto projectMInstance = handle_to_instance(instance);
+    return projectMInstance->PresetPrefetchLimit();
+}
+
 void projectm_set_aspect_correction(projectm_handle instance, bool enabled)
 {
     auto projectMInstance = handle_to_instance(instance);
@@ -383,6 +475,117 @@ auto projectm_pcm_add_uint8(projectm_handle instance, const uint8_t* samples, un
     PcmAdd(instance, samples, count, channels);
 }
 
+template<class BufferType>
+static auto PcmAddTimestamped(projectm_handle instance, const BufferType* samples, unsigned int count, projectm_channels channels,
+                              double timestamp) -> void
+{
+    auto* projectMInstance = handle_to_instance(instance);
+
+    projectMInstance->PCM().Add(samples, channels, count, timestamp);
+}
+
+auto projectm_pcm_add_float_timestamped(projectm_handle instance, const float* samples, unsigned int count, projectm_channels channels,
+                                        double timestamp) -> void
+{
+    PcmAddTimestamped(instance, samples, count, channels, timestamp);
+}
+
+auto projectm_pcm_add_int16_timestamped(projectm_handle instance, const int16_t* samples, unsigned int count, projectm_channels channels,
+                                        double timestamp) -> void
+{
+    PcmAddTimestamped(instance, samples, count, channels, timestamp);
+}
+
+auto projectm_pcm_add_uint8_timestamped(projectm_handle instance, const uint8_t* samples, unsigned int count, projectm_channels channels,
+                                        double timestamp) -> void
+{
+    PcmAddTimestamped(instance, samples, count, channels, timestamp);
+}
+
+void projectm_pcm_set_sample_rate(projectm_handle instance, unsigned int sample_rate)
+{
+    auto* projectMInstance = handle_to_instance(instance);
+    projectMInstance->PCM().SetSampleRate(sample_rate);
+}
+
+unsigned int projectm_pcm_get_sample_rate(projectm_handle instance)
+{
+    auto* projectMInstance = handle_to_instance(instance);
+    return projectMInstance->PCM().SampleRate();
+}
+
+void projectm_pcm_set_output_latency(projectm_handle instance, double seconds)
+{
+    auto* projectMInstance = handle_to_instance(instance);
+    projectMInstance->PCM().SetOutputLatency(seconds);
+}
+
+double projectm_pcm_get_output_latency(projectm_handle instance)
+{
+    auto* projectMInstance = handle_to_instance(instance);
+    return projectMInstance->PCM().OutputLatency();
+}
+
+void projectm_pcm_set_frame_waveform(projectm_handle instance, const float* left, const float* right)
+{
+    auto* projectMInstance = handle_to_instance(instance);
+    projectMInstance->ExternalAudioAnalyzer().SetWaveform(left, right);
+}
+
+void projectm_pcm_set_frame_spectrum(projectm_handle instance, const float* left, const float* right)
+{
+    auto* projectMInstance = handle_to_instance(instance);
+    projectMInstance->ExternalAudioAnalyzer().SetSpectrum(left, right);
+}
+
+void projectm_pcm_set_frame_beat_values(projectm_handle instance, float bass, float mid, float treb,
+                                        float bass_att, float mid_att, float treb_att)
+{
+    auto* projectMInstance = handle_to_instance(instance);
+    projectMInstance->ExternalAudioAnalyzer().SetBeatValues(bass, mid, treb, bass_att, mid_att, treb_att);
+}
+
+unsigned int projectm_pcm_get_spectrum_samples()
+{
+    return libprojectM::Audio::SpectrumSamples;
+}
+
+const float* projectm_pcm_get_spectrum(projectm_handle instance, projectm_pcm_channel channel)
+{
+    auto* projectMInstance = handle_to_instance(instance);
+
+    // The snapshot is kept alive by the instance until the next frame is rendered.
+    auto const frameData = projectMInstance->LastFrameAudioData();
+    switch (channel)
+    {
+        case PROJECTM_CHANNEL_L:
+            return frameData->spectrumLeft.data();
+
+        case PROJECTM_CHANNEL_R:
+            return frameData->spectrumRight.data();
+    }
+
+    return nullptr;
+}
+
+void projectm_pcm_set_presentation_time(projectm_handle instance, double presentation_time)
+{
+    auto* projectMInstance = handle_to_instance(instance);
+    projectMInstance->SetFramePresentationTime(presentation_time);
+}
+
+void projectm_pcm_set_threaded_analysis(projectm_handle instance, bool enabled)
+{
+    auto* projectMInstance = handle_to_instance(instance);
+    projectMInstance->SetAudioAnalysisThreaded(enabled);
+}
+
+bool projectm_pcm_get_threaded_analysis(projectm_handle instance)
+{
+    auto* projectMInstance = handle_to_instance(instance);
+    return projectMInstance->AudioAnalysisThreaded();
+}
+
 auto projectm_write_debug_image_on_next_frame(projectm_handle, const char*) -> void
 {
     // UNIMPLEMENTED
@@ -30,15 +30,21 @@ namespace libprojectM {
 class projectMWrapper : public ProjectM
 {
 public:
+    using ProjectM::ProjectM;
+
     void PresetSwitchFailedEvent(const std::string& presetFilename,
                                  const std::string& failureMessage) const override;
     void PresetSwitchRequestedEvent(bool isHardCut) const override;
+    void PresetTimeBudgetExceededEvent(const std::string& presetFilename) const override;
 
     projectm_preset_switch_failed_event m_presetSwitchFailedEventCallback{nullptr};
     void* m_presetSwitchFailedEventUserData{nullptr};
 
     projectm_preset_switch_requested_event m_presetSwitchRequestedEventCallback{nullptr};
     void* m_presetSwitchRequestedEventUserData{nullptr};
+
+    projectm_preset_time_budget_exceeded_event m_presetTimeBudgetExceededEventCallback{nullptr};
+    void* m_presetTimeBudgetExceededEventUserData{nullptr};
 };
 
 } // namespace libprojectM
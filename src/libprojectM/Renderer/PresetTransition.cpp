@@ -90,13 +90,13 @@ void PresetTransition::Draw(const Preset& oldPreset,
                                                       rand32(),
                                                       rand32()});
 
-    m_transitionShader->SetUniformFloat3("iBeatValues", {audioData.bass,
-                                                         audioData.mid,
-                                                         audioData.treb});
+    m_transitionShader->SetUniformFloat3("iBeatValues", {audioData.Bass(),
+                                                         audioData.Mid(),
+                                                         audioData.Treb()});
 
-    m_transitionShader->SetUniformFloat3("iBeatAttValues", {audioData.bassAtt,
-                                                            audioData.midAtt,
-                                                            audioData.trebAtt});
+    m_transitionShader->SetUniformFloat3("iBeatAttValues", {audioData.BassAtt(),
+                                                            audioData.MidAtt(),
+                                                            audioData.TrebAtt()});
 
     // Texture samplers
     m_transitionShader->SetUniformInt("iChannel0", 0);
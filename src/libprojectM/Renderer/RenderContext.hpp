@@ -4,6 +4,8 @@
 */
 #pragma once
 
+#include <chrono>
+
 namespace libprojectM {
 namespace Renderer {
 
@@ -29,6 +31,8 @@ public:
     int perPixelMeshX{64}; //!< Per-pixel/per-vertex mesh X resolution.
     int perPixelMeshY{48}; //!< Per-pixel/per-vertex mesh Y resolution.
 
+    std::chrono::steady_clock::time_point expressionDeadline{std::chrono::steady_clock::time_point::max()}; //!< Time at which all presets rendered in this frame must stop evaluating expression code. max() means unlimited.
+
     TextureManager* textureManager{nullptr}; //!< Holds all loaded textures for shader access.
 };
 
@@ -4,52 +4,93 @@
 
 #include <vector>
 
+// Same value for the KHR and ARB extensions, but not defined in all OpenGL headers.
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
 namespace libprojectM {
 namespace Renderer {
 
-Shader::Shader()
-    : m_shaderProgram(glCreateProgram())
-{
-}
+Shader::Shader() = default;
 
-Shader::~Shader()
+Shader::~Shader() = default;
+
+void Shader::CompileProgram(const std::string& vertexShaderSource,
+                            const std::string& fragmentShaderSource)
 {
-    if (m_shaderProgram)
+    m_program.reset();
+
+    // Reuse an identical program which is still in use, or load it from the binary cache.
+    // Without an active cache, the program isn't shared, but the binary cache is still used.
+    ShaderCache unsharedCache;
+    auto* activeCache = ShaderCache::Active();
+    auto& cache = activeCache != nullptr ? *activeCache : unsharedCache;
+    auto const key = cache.Key(vertexShaderSource, fragmentShaderSource);
+
+    auto program = cache.Find(key, vertexShaderSource, fragmentShaderSource);
+    if (!program)
+    {
+        program = cache.LoadBinary(key, vertexShaderSource, fragmentShaderSource);
+        if (program)
+        {
+            CacheUniformLocations(*program);
+            cache.Insert(key, vertexShaderSource, fragmentShaderSource, program);
+        }
+    }
+
+    if (!program)
     {
-        glDeleteProgram(m_shaderProgram);
+        program = LinkProgram(cache, vertexShaderSource, fragmentShaderSource);
+        cache.Insert(key, vertexShaderSource, fragmentShaderSource, program);
     }
+
+    // The program may also have been started by StartCompileProgram() and still be linking.
+    FinishProgram(cache, key, vertexShaderSource, fragmentShaderSource, *program);
+    m_program = std::move(program);
 }
 
-void Shader::CompileProgram(const std::string& vertexShaderSource,
-                            const std::string& fragmentShaderSource)
+auto Shader::StartCompileProgram(const std::string& vertexShaderSource,
+                                 const std::string& fragmentShaderSource) -> ShaderCache::ProgramPtr
 {
-    auto vertexShader = CompileShader(vertexShaderSource, GL_VERTEX_SHADER);
-    auto fragmentShader = CompileShader(fragmentShaderSource, GL_FRAGMENT_SHADER);
-
-    glAttachShader(m_shaderProgram, vertexShader);
-    glAttachShader(m_shaderProgram, fragmentShader);
+    auto* cache = ShaderCache::Active();
+    if (cache == nullptr || !cache->ParallelCompileSupported())
+    {
+        return {};
+    }
 
-    glLinkProgram(m_shaderProgram);
+    auto const key = cache->Key(vertexShaderSource, fragmentShaderSource);
 
-    // Shader objects are no longer needed after linking, free the memory.
-    glDetachShader(m_shaderProgram, vertexShader);
-    glDetachShader(m_shaderProgram, fragmentShader);
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
+    auto program = cache->Find(key, vertexShaderSource, fragmentShaderSource);
+    if (program)
+    {
+        return program;
+    }
 
-    GLint programLinked;
-    glGetProgramiv(m_shaderProgram, GL_LINK_STATUS, &programLinked);
-    if (programLinked == GL_TRUE)
+    program = cache->LoadBinary(key, vertexShaderSource, fragmentShaderSource);
+    if (program)
     {
-        return;
+        CacheUniformLocations(*program);
+    }
+    else
+    {
+        program = LinkProgram(*cache, vertexShaderSource, fragmentShaderSource);
     }
 
-    GLint infoLogLength{};
-    glGetProgramiv(m_shaderProgram, GL_INFO_LOG_LENGTH, &infoLogLength);
-    std::vector<char> message(infoLogLength + 1);
-    glGetProgramInfoLog(m_shaderProgram, infoLogLength, nullptr, message.data());
+    cache->Insert(key, vertexShaderSource, fragmentShaderSource, program);
+    return program;
+}
 
-    throw ShaderException("Error compiling shader: " + std::string(message.data()));
+auto Shader::CompileProgramFinished(const ShaderCache::Program& program) -> bool
+{
+    if (program.attachedShaders.empty())
+    {
+        return true;
+    }
+
+    GLint completed{GL_FALSE};
+    glGetProgramiv(program.id, GL_COMPLETION_STATUS_KHR, &completed);
+    return completed == GL_TRUE;
 }
 
 bool Shader::Validate(std::string& validationMessage) const
@@ -57,14 +98,20 @@ bool Shader::Validate(std::string& validationMessage) const
     GLint result{GL_FALSE};
     int infoLogLength;
 
-    glValidateProgram(m_shaderProgram);
+    if (!m_program)
+    {
+        validationMessage = "Shader program was not compiled.";
+        return false;
+    }
+
+    glValidateProgram(m_program->id);
 
-    glGetProgramiv(m_shaderProgram, GL_VALIDATE_STATUS, &result);
-    glGetProgramiv(m_shaderProgram, GL_INFO_LOG_LENGTH, &infoLogLength);
+    glGetProgramiv(m_program->id, GL_VALIDATE_STATUS, &result);
+    glGetProgramiv(m_program->id, GL_INFO_LOG_LENGTH, &infoLogLength);
     if (infoLogLength > 0)
     {
         std::vector<char> validationErrorMessage(infoLogLength + 1);
-        glGetProgramInfoLog(m_shaderProgram, infoLogLength, nullptr, validationErrorMessage.data());
+        glGetProgramInfoLog(m_program->id, infoLogLength, nullptr, validationErrorMessage.data());
         validationMessage = std::string(validationErrorMessage.data());
     }
 
@@ -73,9 +120,9 @@ bool Shader::Validate(std::string& validationMessage) const
 
 void Shader::Bind() const
 {
-    if (m_shaderProgram > 0)
+    if (m_program)
     {
-        glUseProgram(m_shaderProgram);
+        glUseProgram(m_program->id);
     }
 }
 
@@ -84,9 +131,24 @@ void Shader::Unbind()
     glUseProgram(0);
 }
 
+void Shader::SetUniformBlockBinding(const char* blockName, GLuint bindingPoint) const
+{
+    if (!m_program)
+    {
+        return;
+    }
+
+    auto blockIndex = glGetUniformBlockIndex(m_program->id, blockName);
+    if (blockIndex == GL_INVALID_INDEX)
+    {
+        return;
+    }
+    glUniformBlockBinding(m_program->id, blockIndex, bindingPoint);
+}
+
 void Shader::SetUniformFloat(const char* uniform, float value) const
 {
-    auto location = glGetUniformLocation(m_shaderProgram, uniform);
+    auto location = UniformLocation(uniform);
     if (location < 0)
     {
         return;
@@ -96,7 +158,7 @@ void Shader::SetUniformFloat(const char* uniform, float value) const
 
 void Shader::SetUniformInt(const char* uniform, int value) const
 {
-    auto location = glGetUniformLocation(m_shaderProgram, uniform);
+    auto location = UniformLocation(uniform);
     if (location < 0)
     {
         return;
@@ -106,7 +168,7 @@ void Shader::SetUniformInt(const char* uniform, int value) const
 
 void Shader::SetUniformFloat2(const char* uniform, const glm::vec2& values) const
 {
-    auto location = glGetUniformLocation(m_shaderProgram, uniform);
+    auto location = UniformLocation(uniform);
     if (location < 0)
     {
         return;
@@ -116,7 +178,7 @@ void Shader::SetUniformFloat2(const char* uniform, const glm::vec2& values) cons
 
 void Shader::SetUniformInt2(const char* uniform, const glm::ivec2& values) const
 {
-    auto location = glGetUniformLocation(m_shaderProgram, uniform);
+    auto location = UniformLocation(uniform);
     if (location < 0)
     {
         return;
@@ -126,7 +188,7 @@ void Shader::SetUniformInt2(const char* uniform, const glm::ivec2& values) const
 
 void Shader::SetUniformFloat3(const char* uniform, const glm::vec3& values) const
 {
-    auto location = glGetUniformLocation(m_shaderProgram, uniform);
+    auto location = UniformLocation(uniform);
     if (location < 0)
     {
         return;
@@ -136,7 +198,7 @@ void Shader::SetUniformFloat3(const char* uniform, const glm::vec3& values) cons
 
 void Shader::SetUniformInt3(const char* uniform, const glm::ivec3& values) const
 {
-    auto location = glGetUniformLocation(m_shaderProgram, uniform);
+    auto location = UniformLocation(uniform);
     if (location < 0)
     {
         return;
@@ -146,7 +208,7 @@ void Shader::SetUniformInt3(const char* uniform, const glm::ivec3& values) const
 
 void Shader::SetUniformFloat4(const char* uniform, const glm::vec4& values) const
 {
-    auto location = glGetUniformLocation(m_shaderProgram, uniform);
+    auto location = UniformLocation(uniform);
     if (location < 0)
     {
         return;
@@ -156,7 +218,7 @@ void Shader::SetUniformFloat4(const char* uniform, const glm::vec4& values) cons
 
 void Shader::SetUniformInt4(const char* uniform, const glm::ivec4& values) const
 {
-    auto location = glGetUniformLocation(m_shaderProgram, uniform);
+    auto location = UniformLocation(uniform);
     if (location < 0)
     {
         return;
@@ -166,7 +228,7 @@ void Shader::SetUniformInt4(const char* uniform, const glm::ivec4& values) const
 
 void Shader::SetUniformMat3x4(const char* uniform, const glm::mat3x4& values) const
 {
-    auto location = glGetUniformLocation(m_shaderProgram, uniform);
+    auto location = UniformLocation(uniform);
     if (location < 0)
     {
         return;
@@ -176,7 +238,7 @@ void Shader::SetUniformMat3x4(const char* uniform, const glm::mat3x4& values) co
 
 void Shader::SetUniformMat4x4(const char* uniform, const glm::mat4x4& values) const
 {
-    auto location = glGetUniformLocation(m_shaderProgram, uniform);
+    auto location = UniformLocation(uniform);
     if (location < 0)
     {
         return;
@@ -184,29 +246,159 @@ void Shader::SetUniformMat4x4(const char* uniform, const glm::mat4x4& values) co
     glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(values));
 }
 
-GLuint Shader::CompileShader(const std::string& source, GLenum type)
+auto Shader::LinkProgram(ShaderCache& cache, const std::string& vertexShaderSource,
+                         const std::string& fragmentShaderSource) -> ShaderCache::ProgramPtr
 {
-    GLint shaderCompiled{};
+    auto program = std::make_shared<ShaderCache::Program>();
+
+    GLenum const shaderTypes[]{GL_VERTEX_SHADER, GL_FRAGMENT_SHADER};
+    const std::string* const shaderSources[]{&vertexShaderSource, &fragmentShaderSource};
+    for (size_t index = 0; index < 2; index++)
+    {
+        auto shader = glCreateShader(shaderTypes[index]);
+        const auto* shaderSourceCStr = shaderSources[index]->c_str();
+        glShaderSource(shader, 1, &shaderSourceCStr, nullptr);
+        glCompileShader(shader);
+
+        program->attachedShaders.push_back(shader);
+        glAttachShader(program->id, shader);
+    }
+
+    if (cache.BinaryCacheEnabled())
+    {
+        glProgramParameteri(program->id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
+    // Linking fails if a shader didn't compile, so the compile status is only checked then.
+    glLinkProgram(program->id);
 
-    auto shader = glCreateShader(type);
-    const auto* shaderSourceCStr = source.c_str();
-    glShaderSource(shader, 1, &shaderSourceCStr, nullptr);
+    return program;
+}
 
-    glCompileShader(shader);
+void Shader::FinishProgram(ShaderCache& cache, uint64_t key,
+                           const std::string& vertexShaderSource, const std::string& fragmentShaderSource,
+                           ShaderCache::Program& program)
+{
+    if (!program.attachedShaders.empty())
+    {
+        GLint programLinked{GL_FALSE};
+        glGetProgramiv(program.id, GL_LINK_STATUS, &programLinked);
+        if (programLinked != GL_TRUE)
+        {
+            // Report the first shader compile error, or the link error if all shaders compiled.
+            for (auto shader : program.attachedShaders)
+            {
+                GLint shaderCompiled{GL_FALSE};
+                glGetShaderiv(shader, GL_COMPILE_STATUS, &shaderCompiled);
+                if (shaderCompiled != GL_TRUE)
+                {
+                    program.errorMessage = "Error compiling shader: " + InfoLog(shader, false);
+                    break;
+                }
+            }
+
+            if (program.errorMessage.empty())
+            {
+                program.errorMessage = "Error compiling shader: " + InfoLog(program.id, true);
+            }
+        }
+
+        // Shader objects are no longer needed after linking, free the memory.
+        for (auto shader : program.attachedShaders)
+        {
+            glDetachShader(program.id, shader);
+            glDeleteShader(shader);
+        }
+        program.attachedShaders.clear();
+
+        if (program.errorMessage.empty())
+        {
+            CacheUniformLocations(program);
+            cache.StoreBinary(key, vertexShaderSource, fragmentShaderSource, program);
+        }
+    }
 
-    glGetShaderiv(shader, GL_COMPILE_STATUS, &shaderCompiled);
-    if (shaderCompiled == GL_TRUE)
+    if (!program.errorMessage.empty())
     {
-        return shader;
+        throw ShaderException(program.errorMessage);
     }
+}
 
+auto Shader::InfoLog(GLuint object, bool isProgram) -> std::string
+{
     GLint infoLogLength{};
-    glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &infoLogLength);
+    if (isProgram)
+    {
+        glGetProgramiv(object, GL_INFO_LOG_LENGTH, &infoLogLength);
+    }
+    else
+    {
+        glGetShaderiv(object, GL_INFO_LOG_LENGTH, &infoLogLength);
+    }
+
     std::vector<char> message(infoLogLength + 1);
-    glGetShaderInfoLog(shader, infoLogLength, nullptr, message.data());
-    glDeleteShader(shader);
+    if (isProgram)
+    {
+        glGetProgramInfoLog(object, infoLogLength, nullptr, message.data());
+    }
+    else
+    {
+        glGetShaderInfoLog(object, infoLogLength, nullptr, message.data());
+    }
+
+    return message.data();
+}
+
+void Shader::CacheUniformLocations(ShaderCache::Program& program)
+{
+    program.uniformLocations.clear();
+
+    GLint uniformCount{};
+    GLint maxNameLength{};
+    glGetProgramiv(program.id, GL_ACTIVE_UNIFORMS, &uniformCount);
+    glGetProgramiv(program.id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
 
-    throw ShaderException("Error compiling shader: " + std::string(message.data()));
+    std::vector<char> name(maxNameLength + 1);
+    for (GLint index = 0; index < uniformCount; index++)
+    {
+        GLsizei nameLength{};
+        GLint size{};
+        GLenum type{};
+        glGetActiveUniform(program.id, static_cast<GLuint>(index), maxNameLength, &nameLength, &size, &type, name.data());
+
+        std::string uniformName(name.data(), nameLength);
+        auto location = glGetUniformLocation(program.id, uniformName.c_str());
+
+        // Members of uniform blocks have no location.
+        if (location < 0)
+        {
+            continue;
+        }
+
+        // Arrays are reported as "name[0]", but are also set using the plain name.
+        auto arraySuffix = uniformName.rfind("[0]");
+        if (arraySuffix != std::string::npos && arraySuffix == uniformName.length() - 3)
+        {
+            program.uniformLocations.emplace(uniformName.substr(0, arraySuffix), location);
+        }
+
+        program.uniformLocations.emplace(std::move(uniformName), location);
+    }
+}
+
+auto Shader::UniformLocation(const char* uniform) const -> GLint
+{
+    if (!m_program)
+    {
+        return -1;
+    }
+
+    auto location = m_program->uniformLocations.find(uniform);
+    if (location == m_program->uniformLocations.end())
+    {
+        return -1;
+    }
+    return location->second;
 }
 
 auto Shader::GetShaderLanguageVersion() -> Shader::GlslVersion
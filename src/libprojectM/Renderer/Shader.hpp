@@ -4,6 +4,7 @@
  */
 #pragma once
 
+#include "Renderer/ShaderCache.hpp"
 #include "Renderer/Texture.hpp"
 
 #include <glm/vec2.hpp>
@@ -12,7 +13,6 @@
 #include <glm/mat3x4.hpp>
 #include <glm/mat4x4.hpp>
 
-#include <map>
 #include <string>
 
 namespace libprojectM {
@@ -67,6 +67,10 @@ public:
 
     /**
      * @brief Compiles a vertex and fragment shader into a program.
+     *
+     * If another shader using the active ShaderCache already uses a program built from the same
+     * sources, or the binary cache holds one, that program is used instead.
+     *
      * @throws ShaderException Thrown if compilation of a shader or program linking failed.
      * @param vertexShaderSource The vertex shader source.
      * @param fragmentShaderSource The fragment shader source.
@@ -74,6 +78,30 @@ public:
     void CompileProgram(const std::string& vertexShaderSource,
                         const std::string& fragmentShaderSource);
 
+    /**
+     * @brief Starts compiling and linking a program in the background.
+     *
+     * Only does something if a ShaderCache is active and the driver supports parallel shader
+     * compilation. The program is added to the cache, so a later CompileProgram() call with the
+     * same sources uses it instead of compiling it again, and only waits for the driver if it
+     * didn't finish yet. Compile errors are reported by CompileProgram().
+     *
+     * @param vertexShaderSource The vertex shader source.
+     * @param fragmentShaderSource The fragment shader source.
+     * @return The program, which must be kept until CompileProgram() was called, or an empty
+     *         pointer if the program can't be compiled in the background.
+     */
+    static auto StartCompileProgram(const std::string& vertexShaderSource,
+                                    const std::string& fragmentShaderSource) -> ShaderCache::ProgramPtr;
+
+    /**
+     * @brief Returns whether the driver finished compiling and linking a program.
+     * Never waits for the driver.
+     * @param program A program returned by StartCompileProgram().
+     * @return True if the program is linked or failed to link, false if still in progress.
+     */
+    static auto CompileProgramFinished(const ShaderCache::Program& program) -> bool;
+
     /**
      * @brief Validates that the program can run in the current state.
      * @param validationMessage The error message if validation failed.
@@ -91,6 +119,14 @@ public:
      */
     static void Unbind();
 
+    /**
+     * @brief Assigns a uniform block in the program to a uniform buffer binding point.
+     * Does nothing if the program doesn't contain the block.
+     * @param blockName The uniform block name.
+     * @param bindingPoint The binding point the uniform buffer is bound to.
+     */
+    void SetUniformBlockBinding(const char* blockName, GLuint bindingPoint) const;
+
     /**
      * @brief Sets a single float uniform.
      * The program must be bound before calling this method!
@@ -181,15 +217,55 @@ public:
 
 private:
     /**
-     * @brief Compiles a single shader.
-     * @throws ShaderException Thrown if compilation of the shader failed.
-     * @param source The shader source.
-     * @param type The shader type, e.g. GL_VERTEX_SHADER.
-     * @return The shader ID.
+     * @brief Compiles the shaders and starts linking them into a new program.
+     * Doesn't check the results, so the driver can do the work in the background.
+     * @param cache The cache providing the binary cache settings.
+     * @param vertexShaderSource The vertex shader source.
+     * @param fragmentShaderSource The fragment shader source.
+     * @return The new program.
+     */
+    static auto LinkProgram(ShaderCache& cache, const std::string& vertexShaderSource,
+                            const std::string& fragmentShaderSource) -> ShaderCache::ProgramPtr;
+
+    /**
+     * @brief Checks the link result of a program started with LinkProgram().
+     *
+     * Waits for the driver if it didn't finish yet. On success, the uniform locations are queried
+     * and the binary is stored. Does nothing if the result was checked before.
+     *
+     * @throws ShaderException Thrown if compiling a shader or linking the program failed.
+     * @param cache The cache to store the binary in.
+     * @param key The program cache key.
+     * @param vertexShaderSource The vertex shader source.
+     * @param fragmentShaderSource The fragment shader source.
+     * @param program The program.
+     */
+    static void FinishProgram(ShaderCache& cache, uint64_t key,
+                              const std::string& vertexShaderSource, const std::string& fragmentShaderSource,
+                              ShaderCache::Program& program);
+
+    /**
+     * @brief Returns the info log of a shader or program.
+     * @param object The shader or program ID.
+     * @param isProgram True if the object is a program, false if it is a shader.
+     * @return The info log.
+     */
+    static auto InfoLog(GLuint object, bool isProgram) -> std::string;
+
+    /**
+     * @brief Queries the locations of all active uniforms after the program was linked.
+     * @param program The linked program.
+     */
+    static void CacheUniformLocations(ShaderCache::Program& program);
+
+    /**
+     * @brief Returns the cached location of a uniform.
+     * @param uniform The uniform name.
+     * @return The uniform location, or -1 if the program has no active uniform with this name.
      */
-    auto CompileShader(const std::string& source, GLenum type) -> GLuint;
+    auto UniformLocation(const char* uniform) const -> GLint;
 
-    GLuint m_shaderProgram{}; //!< The program ID.
+    ShaderCache::ProgramPtr m_program; //!< The linked program, possibly shared with other shaders using the same sources.
 };
 
 } // namespace Renderer
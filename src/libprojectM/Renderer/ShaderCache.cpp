@@ -0,0 +1,365 @@
+#include "ShaderCache.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+
+namespace libprojectM {
+namespace Renderer {
+
+namespace {
+
+constexpr uint32_t BinaryFileMagic = 0x42534d50; //!< "PMSB" - projectM shader binary.
+constexpr uint32_t BinaryFileVersion = 2;
+
+/**
+ * @brief Header of a program binary cache file, followed by the vertex and fragment shader sources
+ *        and the binary data.
+ */
+struct BinaryFileHeader {
+    uint32_t magic{BinaryFileMagic};
+    uint32_t version{BinaryFileVersion};
+    uint64_t key{};
+    uint32_t format{};
+    uint32_t vertexSourceSize{};
+    uint32_t fragmentSourceSize{};
+    uint32_t size{};
+};
+
+std::mutex binaryCacheDirectoryMutex; //!< Guards binaryCacheDirectory, as instances may render on different threads.
+std::string binaryCacheDirectory;     //!< Directory to store program binaries in, empty if disabled.
+
+thread_local ShaderCache* activeCache{nullptr}; //!< The cache of the instance currently rendering on this thread.
+
+auto BinaryCacheDirectory() -> std::string
+{
+    std::lock_guard<std::mutex> lock(binaryCacheDirectoryMutex);
+    return binaryCacheDirectory;
+}
+
+auto ReadSource(std::ifstream& file, uint32_t size, const std::string& expectedSource) -> bool
+{
+    if (size != expectedSource.size())
+    {
+        return false;
+    }
+
+    std::string source(size, '\0');
+    file.read(&source[0], static_cast<std::streamsize>(size));
+    return file.gcount() == static_cast<std::streamsize>(size) && source == expectedSource;
+}
+
+auto GetGLString(GLenum name) -> std::string
+{
+    const auto* value = reinterpret_cast<const char*>(glGetString(name));
+    return value != nullptr ? value : "";
+}
+
+} // anonymous namespace
+
+ShaderCache::Program::Program()
+    : id(glCreateProgram())
+{
+}
+
+ShaderCache::Program::~Program()
+{
+    for (auto shader : attachedShaders)
+    {
+        glDeleteShader(shader);
+    }
+
+    if (id)
+    {
+        glDeleteProgram(id);
+    }
+}
+
+ShaderCache::Scope::Scope(ShaderCache& cache)
+    : m_previousCache(activeCache)
+{
+    activeCache = &cache;
+}
+
+ShaderCache::Scope::~Scope()
+{
+    activeCache = m_previousCache;
+}
+
+auto ShaderCache::Active() -> ShaderCache*
+{
+    return activeCache;
+}
+
+void ShaderCache::SetBinaryCacheDirectory(const std::string& path)
+{
+    std::string directory = path;
+
+    // Remove trailing separators, a separator is added when building the file names.
+    while (directory.length() > 1 &&
+           (directory.back() == '/' || directory.back() == '\\'))
+    {
+        directory.pop_back();
+    }
+
+    std::lock_guard<std::mutex> lock(binaryCacheDirectoryMutex);
+    binaryCacheDirectory = std::move(directory);
+}
+
+auto ShaderCache::BinaryCacheEnabled() -> bool
+{
+    if (BinaryCacheDirectory().empty())
+    {
+        return false;
+    }
+
+    if (m_binaryFormatCount < 0)
+    {
+        // Drivers without program binary support report zero formats or an invalid enum error.
+        GLint formatCount{0};
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+        glGetError();
+        m_binaryFormatCount = formatCount;
+    }
+
+    return m_binaryFormatCount > 0;
+}
+
+auto ShaderCache::ParallelCompileSupported() -> bool
+{
+    if (m_parallelCompileSupported < 0)
+    {
+        // The number of compiler threads is left to the driver, which is the initial setting, so
+        // glMaxShaderCompilerThreadsKHR() doesn't need to be called.
+        m_parallelCompileSupported = 0;
+
+        GLint extensionCount{0};
+        glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+        for (GLint index = 0; index < extensionCount; index++)
+        {
+            const auto* extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, static_cast<GLuint>(index)));
+            if (extension != nullptr &&
+                (std::strcmp(extension, "GL_KHR_parallel_shader_compile") == 0 ||
+                 std::strcmp(extension, "GL_ARB_parallel_shader_compile") == 0))
+            {
+                m_parallelCompileSupported = 1;
+                break;
+            }
+        }
+    }
+
+    return m_parallelCompileSupported > 0;
+}
+
+auto ShaderCache::Key(const std::string& vertexShaderSource, const std::string& fragmentShaderSource) -> uint64_t
+{
+    if (m_driverHash == 0)
+    {
+        m_driverHash = Hash(GetGLString(GL_VERSION), Hash(GetGLString(GL_RENDERER), Hash(GetGLString(GL_VENDOR))));
+    }
+
+    // Hash the vertex shader length as well, so moving code between the two shaders changes the key.
+    return Hash(fragmentShaderSource, Hash(vertexShaderSource, Hash(std::to_string(vertexShaderSource.length()), m_driverHash)));
+}
+
+auto ShaderCache::Find(uint64_t key, const std::string& vertexShaderSource, const std::string& fragmentShaderSource) -> ProgramPtr
+{
+    auto entry = m_programs.find(key);
+    if (entry == m_programs.end() ||
+        entry->second.vertexShaderSource != vertexShaderSource ||
+        entry->second.fragmentShaderSource != fragmentShaderSource)
+    {
+        return {};
+    }
+
+    return entry->second.program.lock();
+}
+
+auto ShaderCache::LoadBinary(uint64_t key, const std::string& vertexShaderSource, const std::string& fragmentShaderSource) -> ProgramPtr
+{
+    if (!BinaryCacheEnabled())
+    {
+        return {};
+    }
+
+    GLenum format{};
+    std::vector<char> binary;
+    if (!ReadBinaryFile(BinaryFileName(key), key, vertexShaderSource, fragmentShaderSource, format, binary))
+    {
+        return {};
+    }
+
+    auto program = std::make_shared<Program>();
+    glProgramBinary(program->id, format, binary.data(), static_cast<GLsizei>(binary.size()));
+
+    // The driver rejects binaries from other driver versions or hardware, the caller then recompiles.
+    GLint programLinked{GL_FALSE};
+    glGetProgramiv(program->id, GL_LINK_STATUS, &programLinked);
+    if (programLinked != GL_TRUE)
+    {
+        return {};
+    }
+
+    return program;
+}
+
+void ShaderCache::StoreBinary(uint64_t key, const std::string& vertexShaderSource, const std::string& fragmentShaderSource,
+                              const Program& program)
+{
+    // Another instance may clear the directory concurrently, so check the file name as well.
+    auto const fileName = BinaryFileName(key);
+    if (!BinaryCacheEnabled() || fileName.empty())
+    {
+        return;
+    }
+
+    GLint binaryLength{};
+    glGetProgramiv(program.id, GL_PROGRAM_BINARY_LENGTH, &binaryLength);
+    if (binaryLength <= 0)
+    {
+        return;
+    }
+
+    std::vector<char> binary(binaryLength);
+    GLenum format{};
+    GLsizei writtenLength{};
+    glGetProgramBinary(program.id, binaryLength, &writtenLength, &format, binary.data());
+    if (writtenLength <= 0)
+    {
+        return;
+    }
+    binary.resize(writtenLength);
+
+    // A failed write only means the program is compiled again on the next start.
+    WriteBinaryFile(fileName, key, vertexShaderSource, fragmentShaderSource, format, binary);
+}
+
+void ShaderCache::Insert(uint64_t key, const std::string& vertexShaderSource, const std::string& fragmentShaderSource,
+                         const ProgramPtr& program)
+{
+    // Drop entries of programs no longer in use.
+    for (auto entry = m_programs.begin(); entry != m_programs.end();)
+    {
+        if (entry->second.program.expired())
+        {
+            entry = m_programs.erase(entry);
+        }
+        else
+        {
+            ++entry;
+        }
+    }
+
+    // On a hash collision, the other program stays valid for its users, but is no longer shared.
+    m_programs[key] = {program, vertexShaderSource, fragmentShaderSource};
+}
+
+auto ShaderCache::Hash(const std::string& data, uint64_t seed) -> uint64_t
+{
+    uint64_t hash = seed;
+    for (auto character : data)
+    {
+        hash ^= static_cast<uint8_t>(character);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+auto ShaderCache::WriteBinaryFile(const std::string& fileName, uint64_t key,
+                                  const std::string& vertexShaderSource, const std::string& fragmentShaderSource,
+                                  GLenum format, const std::vector<char>& binary) -> bool
+{
+    BinaryFileHeader header;
+    header.key = key;
+    header.format = static_cast<uint32_t>(format);
+    header.vertexSourceSize = static_cast<uint32_t>(vertexShaderSource.size());
+    header.fragmentSourceSize = static_cast<uint32_t>(fragmentShaderSource.size());
+    header.size = static_cast<uint32_t>(binary.size());
+
+    std::string const temporaryFileName = fileName + ".tmp";
+    {
+        std::ofstream file(temporaryFileName, std::ios::binary | std::ios::trunc);
+        if (!file.good())
+        {
+            return false;
+        }
+
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(vertexShaderSource.data(), static_cast<std::streamsize>(vertexShaderSource.size()));
+        file.write(fragmentShaderSource.data(), static_cast<std::streamsize>(fragmentShaderSource.size()));
+        file.write(binary.data(), static_cast<std::streamsize>(binary.size()));
+        if (!file.good())
+        {
+            file.close();
+            std::remove(temporaryFileName.c_str());
+            return false;
+        }
+    }
+
+    // Rename doesn't replace existing files on all platforms.
+    std::remove(fileName.c_str());
+    if (std::rename(temporaryFileName.c_str(), fileName.c_str()) != 0)
+    {
+        std::remove(temporaryFileName.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+auto ShaderCache::ReadBinaryFile(const std::string& fileName, uint64_t key,
+                                 const std::string& vertexShaderSource, const std::string& fragmentShaderSource,
+                                 GLenum& format, std::vector<char>& binary) -> bool
+{
+    std::ifstream file(fileName, std::ios::binary);
+    if (!file.good())
+    {
+        return false;
+    }
+
+    BinaryFileHeader header;
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!file.good() ||
+        header.magic != BinaryFileMagic ||
+        header.version != BinaryFileVersion ||
+        header.key != key ||
+        header.size == 0)
+    {
+        return false;
+    }
+
+    // The key is only a hash, so the file must also have been written for the very same sources.
+    if (!ReadSource(file, header.vertexSourceSize, vertexShaderSource) ||
+        !ReadSource(file, header.fragmentSourceSize, fragmentShaderSource))
+    {
+        return false;
+    }
+
+    binary.resize(header.size);
+    file.read(binary.data(), static_cast<std::streamsize>(binary.size()));
+    if (file.gcount() != static_cast<std::streamsize>(binary.size()))
+    {
+        binary.clear();
+        return false;
+    }
+
+    format = static_cast<GLenum>(header.format);
+    return true;
+}
+
+auto ShaderCache::BinaryFileName(uint64_t key) -> std::string
+{
+    auto directory = BinaryCacheDirectory();
+    if (directory.empty())
+    {
+        return {};
+    }
+
+    char keyString[17]{};
+    snprintf(keyString, sizeof(keyString), "%016llx", static_cast<unsigned long long>(key));
+    return directory + "/" + keyString + ".bin";
+}
+
+} // namespace Renderer
+} // namespace libprojectM
@@ -0,0 +1,237 @@
+/**
+ * @file ShaderCache.hpp
+ * @brief Shares linked shader programs and stores their binaries on disk.
+ */
+#pragma once
+
+#include <projectM-opengl.h>
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace libprojectM {
+namespace Renderer {
+
+/**
+ * @brief Shares linked shader programs and stores their binaries on disk.
+ *
+ * Programs are keyed by a hash of their vertex and fragment shader sources. As long as any Shader
+ * uses a program, compiling the same sources again returns the existing program instead. This
+ * avoids recompiling the static preset programs on every preset switch. The sources are stored
+ * with each program and compared on every hit, so hash collisions never return the wrong program.
+ *
+ * GL program objects only exist in the context they were created in, so each projectM instance
+ * owns its own cache and makes it active with a Scope while it renders or loads presets. Shaders
+ * compiled while no cache is active don't share their programs.
+ *
+ * If a binary cache directory is set and the driver supports program binaries, newly linked
+ * programs are also written into this directory and loaded from there on the next start. The
+ * directory is shared by all instances in the process. All other methods must be called from the
+ * rendering thread of the instance owning the cache.
+ */
+class ShaderCache
+{
+public:
+    /**
+     * @brief A linked program object, deleted when the last user releases it.
+     */
+    struct Program {
+        Program();
+
+        ~Program();
+
+        Program(const Program&) = delete;
+        auto operator=(const Program&) -> Program& = delete;
+
+        GLuint id{}; //!< The program ID.
+
+        std::vector<GLuint> attachedShaders; //!< Shader objects attached while the program links, empty once the link status was checked.
+        std::string errorMessage;            //!< The reason compiling or linking failed, empty if the program was linked.
+
+        std::map<std::string, GLint, std::less<>> uniformLocations; //!< Locations of the active uniforms, by name.
+    };
+
+    using ProgramPtr = std::shared_ptr<Program>;
+
+    /**
+     * @brief Makes a cache the active one on the current thread while in scope.
+     */
+    class Scope
+    {
+    public:
+        /**
+         * @brief Activates the given cache.
+         * @param cache The cache to use for all shaders compiled in this scope.
+         */
+        explicit Scope(ShaderCache& cache);
+
+        /**
+         * @brief Restores the previously active cache.
+         */
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        auto operator=(const Scope&) -> Scope& = delete;
+
+    private:
+        ShaderCache* m_previousCache{nullptr}; //!< The cache active before this scope.
+    };
+
+    ShaderCache() = default;
+
+    ShaderCache(const ShaderCache&) = delete;
+    auto operator=(const ShaderCache&) -> ShaderCache& = delete;
+
+    /**
+     * @brief Returns the cache active on the current thread.
+     * @return The active cache, or nullptr if no Scope is active.
+     */
+    static auto Active() -> ShaderCache*;
+
+    /**
+     * @brief Sets the directory to store program binaries in.
+     * The directory must exist. An empty path disables the binary cache, which is the default.
+     * @param path The cache directory.
+     */
+    static void SetBinaryCacheDirectory(const std::string& path);
+
+    /**
+     * @brief Returns whether linked programs are stored on disk.
+     * Requires a cache directory and driver support for program binaries.
+     * @return True if the binary cache can be used, false if not.
+     */
+    auto BinaryCacheEnabled() -> bool;
+
+    /**
+     * @brief Returns whether the driver compiles and links programs in the background.
+     * Requires the KHR_parallel_shader_compile or ARB_parallel_shader_compile extension.
+     * @return True if the completion status of programs can be polled, false if not.
+     */
+    auto ParallelCompileSupported() -> bool;
+
+    /**
+     * @brief Calculates the cache key for a pair of shader sources.
+     *
+     * The key also includes the OpenGL vendor, renderer and version strings, so binaries from
+     * other drivers are never loaded.
+     *
+     * @param vertexShaderSource The vertex shader source.
+     * @param fragmentShaderSource The fragment shader source.
+     * @return The cache key.
+     */
+    auto Key(const std::string& vertexShaderSource, const std::string& fragmentShaderSource) -> uint64_t;
+
+    /**
+     * @brief Returns a program linked from the same sources, if still in use.
+     * @param key The program cache key.
+     * @param vertexShaderSource The vertex shader source.
+     * @param fragmentShaderSource The fragment shader source.
+     * @return The existing program, or an empty pointer if there is none.
+     */
+    auto Find(uint64_t key, const std::string& vertexShaderSource, const std::string& fragmentShaderSource) -> ProgramPtr;
+
+    /**
+     * @brief Tries to load a program from the binary cache.
+     * @param key The program cache key.
+     * @param vertexShaderSource The vertex shader source.
+     * @param fragmentShaderSource The fragment shader source.
+     * @return The loaded program, or an empty pointer if there is no valid cached binary.
+     */
+    auto LoadBinary(uint64_t key, const std::string& vertexShaderSource, const std::string& fragmentShaderSource) -> ProgramPtr;
+
+    /**
+     * @brief Writes the binary of a linked program into the cache directory.
+     * Does nothing if the binary cache isn't enabled.
+     * @param key The program cache key.
+     * @param vertexShaderSource The vertex shader source.
+     * @param fragmentShaderSource The fragment shader source.
+     * @param program The linked program.
+     */
+    void StoreBinary(uint64_t key, const std::string& vertexShaderSource, const std::string& fragmentShaderSource,
+                     const Program& program);
+
+    /**
+     * @brief Adds a linked program to the cache.
+     * @param key The program cache key.
+     * @param vertexShaderSource The vertex shader source.
+     * @param fragmentShaderSource The fragment shader source.
+     * @param program The linked program.
+     */
+    void Insert(uint64_t key, const std::string& vertexShaderSource, const std::string& fragmentShaderSource,
+                const ProgramPtr& program);
+
+    /**
+     * @brief Hashes a string using 64-bit FNV-1a.
+     * Unlike std::hash, the result is the same on all platforms and runs.
+     * @param data The data to hash.
+     * @param seed The hash of the previous data, to hash multiple strings in sequence.
+     * @return The hash value.
+     */
+    static auto Hash(const std::string& data, uint64_t seed = 14695981039346656037ULL) -> uint64_t;
+
+    /**
+     * @brief Writes a program binary cache file.
+     *
+     * The file is first written under a temporary name and then renamed, so other processes never
+     * read a partially written file.
+     *
+     * The shader sources are stored along with the binary, so a file is never used for other
+     * sources with the same key.
+     *
+     * @param fileName The cache file name.
+     * @param key The program cache key, stored in the file for validation.
+     * @param vertexShaderSource The vertex shader source, stored in the file for validation.
+     * @param fragmentShaderSource The fragment shader source, stored in the file for validation.
+     * @param format The driver-specific binary format.
+     * @param binary The program binary.
+     * @return True if the file was written, false if not.
+     */
+    static auto WriteBinaryFile(const std::string& fileName, uint64_t key,
+                                const std::string& vertexShaderSource, const std::string& fragmentShaderSource,
+                                GLenum format, const std::vector<char>& binary) -> bool;
+
+    /**
+     * @brief Reads a program binary cache file.
+     * @param fileName The cache file name.
+     * @param key The expected program cache key.
+     * @param vertexShaderSource The expected vertex shader source.
+     * @param fragmentShaderSource The expected fragment shader source.
+     * @param[out] format The driver-specific binary format.
+     * @param[out] binary The program binary.
+     * @return True if the file exists and was written for the given key and sources, false if not.
+     */
+    static auto ReadBinaryFile(const std::string& fileName, uint64_t key,
+                               const std::string& vertexShaderSource, const std::string& fragmentShaderSource,
+                               GLenum& format, std::vector<char>& binary) -> bool;
+
+private:
+    /**
+     * @brief A program in use and the sources it was linked from.
+     */
+    struct Entry {
+        std::weak_ptr<Program> program;   //!< The program, expired if no longer used.
+        std::string vertexShaderSource;   //!< The vertex shader source.
+        std::string fragmentShaderSource; //!< The fragment shader source.
+    };
+
+    /**
+     * @brief Returns the cache file name for a program.
+     * @param key The program cache key.
+     * @return The full path of the cache file, or an empty string if no directory is set.
+     */
+    static auto BinaryFileName(uint64_t key) -> std::string;
+
+    std::unordered_map<uint64_t, Entry> m_programs; //!< Programs currently in use, by key.
+
+    int m_binaryFormatCount{-1};        //!< Number of binary formats supported by the driver, -1 if not yet queried.
+    int m_parallelCompileSupported{-1}; //!< 1 if the driver compiles programs in the background, 0 if not, -1 if not yet queried.
+    uint64_t m_driverHash{};            //!< Hash of the driver identification strings, 0 if not yet calculated.
+};
+
+} // namespace Renderer
+} // namespace libprojectM
@@ -1,6 +1,7 @@
 #include "Playlist.hpp"
 
 #include <algorithm>
+#include <numeric>
 
 // Fall back to boost if compiler doesn't support C++17
 #include PROJECTM_FILESYSTEM_INCLUDE
@@ -35,6 +36,7 @@ bool Playlist::Empty() const
 void Playlist::Clear()
 {
     m_presetHistory.clear();
+    m_upcomingPresets.clear();
     m_items.clear();
 }
 
@@ -66,6 +68,7 @@ bool Playlist::AddItem(const std::string& filename, uint32_t index, bool allowDu
     }
 
     m_presetHistory.clear();
+    m_upcomingPresets.clear();
     if (index >= m_items.size())
     {
         m_items.emplace_back(filename);
@@ -84,6 +87,7 @@ auto Playlist::AddPath(const std::string& path, uint32_t index, bool recursive,
     uint32_t presetsAdded{0};
 
     m_presetHistory.clear();
+    m_upcomingPresets.clear();
     if (recursive)
     {
         try
@@ -141,6 +145,7 @@ auto Playlist::RemoveItem(uint32_t index) -> bool
     }
 
     m_presetHistory.clear();
+    m_upcomingPresets.clear();
     m_items.erase(m_items.cbegin() + index);
 
     return true;
@@ -149,6 +154,10 @@ auto Playlist::RemoveItem(uint32_t index) -> bool
 
 void Playlist::SetShuffle(bool enabled)
 {
+    if (enabled != m_shuffle)
+    {
+        m_upcomingPresets.clear();
+    }
     m_shuffle = enabled;
 }
 
@@ -173,6 +182,7 @@ void Playlist::Sort(uint32_t startIndex, uint32_t count,
     }
 
     m_presetHistory.clear();
+    m_upcomingPresets.clear();
 
     std::sort(m_items.begin() + startIndex,
               m_items.begin() + startIndex + count,
@@ -220,8 +230,7 @@ auto Playlist::NextPresetIndex() -> uint32_t
 
     if (m_shuffle)
     {
-        std::uniform_int_distribution<uint32_t> randomDistribution(0, static_cast<uint32_t>(m_items.size()));
-        m_currentPosition = randomDistribution(m_randomGenerator);
+        m_currentPosition = NextShuffledPresetIndex();
     }
     else
     {
@@ -247,8 +256,7 @@ auto Playlist::PreviousPresetIndex() -> uint32_t
 
     if (m_shuffle)
     {
-        std::uniform_int_distribution<uint32_t> randomDistribution(0, static_cast<uint32_t>(m_items.size()));
-        m_currentPosition = randomDistribution(m_randomGenerator);
+        m_currentPosition = NextShuffledPresetIndex();
     }
     else
     {
@@ -265,6 +273,38 @@ auto Playlist::PreviousPresetIndex() -> uint32_t
     return m_currentPosition;
 }
 
+
+auto Playlist::UpcomingPresetIndices(uint32_t count) -> std::vector<uint32_t>
+{
+    std::vector<uint32_t> upcomingPresets;
+    if (m_items.empty())
+    {
+        return upcomingPresets;
+    }
+
+    upcomingPresets.reserve(count);
+
+    if (m_shuffle)
+    {
+        while (m_upcomingPresets.size() < count)
+        {
+            AddShuffleRound();
+        }
+
+        upcomingPresets.assign(m_upcomingPresets.begin(), m_upcomingPresets.begin() + count);
+    }
+    else
+    {
+        for (uint32_t offset = 1; offset <= count; offset++)
+        {
+            upcomingPresets.push_back(static_cast<uint32_t>((m_currentPosition + offset) % m_items.size()));
+        }
+    }
+
+    return upcomingPresets;
+}
+
+
 auto Playlist::LastPresetIndex() -> uint32_t
 {
     if (m_items.empty())
@@ -276,6 +316,7 @@ auto Playlist::LastPresetIndex() -> uint32_t
     {
         m_currentPosition = m_presetHistory.back();
         m_presetHistory.pop_back();
+        RemoveCurrentPresetFromUpcoming();
     }
     else
     {
@@ -320,6 +361,8 @@ auto Playlist::SetPresetIndex(uint32_t presetIndex) -> uint32_t
         m_currentPosition = 0;
     }
 
+    RemoveCurrentPresetFromUpcoming();
+
     return m_currentPosition;
 }
 
@@ -359,6 +402,7 @@ auto Playlist::ApplyFilter() -> uint32_t
     if (itemsRemoved != 0)
     {
         m_presetHistory.clear();
+        m_upcomingPresets.clear();
     }
 
     return itemsRemoved;
@@ -381,5 +425,45 @@ void Playlist::AddCurrentPresetIndexToHistory()
 }
 
 
+auto Playlist::NextShuffledPresetIndex() -> uint32_t
+{
+    if (m_upcomingPresets.empty())
+    {
+        AddShuffleRound();
+    }
+
+    auto const presetIndex = m_upcomingPresets.front();
+    m_upcomingPresets.pop_front();
+
+    return presetIndex;
+}
+
+
+void Playlist::AddShuffleRound()
+{
+    std::vector<uint32_t> round(m_items.size());
+    std::iota(round.begin(), round.end(), 0);
+    std::shuffle(round.begin(), round.end(), m_randomGenerator);
+
+    // Don't play the same preset twice in a row where two rounds meet.
+    auto const previousPresetIndex = m_upcomingPresets.empty() ? m_currentPosition : m_upcomingPresets.back();
+    if (round.size() > 1 && round.front() == previousPresetIndex)
+    {
+        std::swap(round.front(), round.back());
+    }
+
+    m_upcomingPresets.insert(m_upcomingPresets.end(), round.begin(), round.end());
+}
+
+
+void Playlist::RemoveCurrentPresetFromUpcoming()
+{
+    if (!m_upcomingPresets.empty() && m_upcomingPresets.front() == m_currentPosition)
+    {
+        m_upcomingPresets.pop_front();
+    }
+}
+
+
 } // namespace Playlist
 } // namespace libprojectM
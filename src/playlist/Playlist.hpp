@@ -4,6 +4,7 @@
 #include "Item.hpp"
 
 #include <cstdint>
+#include <deque>
 #include <limits>
 #include <list>
 #include <random>
@@ -172,7 +173,8 @@ public:
      * @brief Returns the next preset index that should be played.
      *
      * Each call will either increment the current index, or select a random preset, depending on
-     * the shuffle setting.
+     * the shuffle setting. In shuffle mode, every preset is played once in random order before
+     * any preset is repeated.
      *
      * @throws PlaylistEmptyException Thrown if the playlist is currently empty.
      * @return The index of the next playlist item to be played.
@@ -183,13 +185,26 @@ public:
      * @brief Returns the previous preset index in the playlist.
      *
      * Each call will either decrement the current index, or select a random preset, depending on
-     * the shuffle setting.
+     * the shuffle setting. In shuffle mode, presets are taken from the same random order as in
+     * NextPresetIndex().
      *
      * @throws PlaylistEmptyException Thrown if the playlist is currently empty.
      * @return The index of the previous playlist item.
      */
     virtual auto PreviousPresetIndex() -> uint32_t;
 
+    /**
+     * @brief Returns the preset indices NextPresetIndex() will return next, without changing the position.
+     *
+     * In shuffle mode, the random order is determined here if needed, and subsequent calls to
+     * NextPresetIndex() will return the same indices. The order is discarded if the playlist
+     * contents or the shuffle setting change.
+     *
+     * @param count The number of indices to return.
+     * @return The upcoming preset indices, or an empty list if the playlist is empty.
+     */
+    virtual auto UpcomingPresetIndices(uint32_t count) -> std::vector<uint32_t>;
+
     /**
      * @brief Returns the last preset index that has been played.
      *
@@ -247,11 +262,29 @@ private:
      */
     void AddCurrentPresetIndexToHistory();
 
+    /**
+     * @brief Returns the next index from the shuffled playback order, adding a new round if needed.
+     * @return The next random preset index.
+     */
+    auto NextShuffledPresetIndex() -> uint32_t;
+
+    /**
+     * @brief Appends one round with all playlist indices in random order to the upcoming presets.
+     */
+    void AddShuffleRound();
+
+    /**
+     * @brief Removes the current preset from the front of the upcoming presets.
+     * Used after jumping to a preset directly, so it isn't played twice in a row.
+     */
+    void RemoveCurrentPresetFromUpcoming();
+
     std::vector<Item> m_items;         //!< All items in the current playlist.
     class Filter m_filter;             //!< Item filter.
     bool m_shuffle{false};             //!< True if shuffle mode is enabled, false to play presets in order.
     uint32_t m_currentPosition{0};       //!< Current playlist position.
     std::list<uint32_t> m_presetHistory; //!< The playback history.
+    std::deque<uint32_t> m_upcomingPresets; //!< Shuffled playback order, in rounds containing each index once.
 
     std::default_random_engine m_randomGenerator;
 };
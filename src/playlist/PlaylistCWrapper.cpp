@@ -116,6 +116,30 @@ auto PlaylistCWrapper::RetryCount() -> uint32_t
 }
 
 
+void PlaylistCWrapper::SetPrefetchDepth(uint32_t prefetchDepth)
+{
+    m_prefetchDepth = prefetchDepth;
+}
+
+
+auto PlaylistCWrapper::PrefetchDepth() -> uint32_t
+{
+    return m_prefetchDepth;
+}
+
+
+void PlaylistCWrapper::SetAsyncLoading(bool enabled)
+{
+    m_asyncLoading = enabled;
+}
+
+
+auto PlaylistCWrapper::AsyncLoading() -> bool
+{
+    return m_asyncLoading;
+}
+
+
 void PlaylistCWrapper::SetPresetSwitchedCallback(projectm_playlist_preset_switched_event callback, void* userData)
 {
     m_presetSwitchedEventCallback = callback;
@@ -146,13 +170,41 @@ void PlaylistCWrapper::PlayPresetIndex(uint32_t index, bool hardCut, bool resetF
         return;
     }
 
-    projectm_load_preset_file(m_projectMInstance,
-                              playlistItems.at(index).Filename().c_str(), !hardCut);
+    if (m_asyncLoading)
+    {
+        // If loading fails, OnPresetSwitchFailed() is called from within a later
+        // projectm_opengl_render_frame() call.
+        projectm_load_preset_file_async(m_projectMInstance,
+                                        playlistItems.at(index).Filename().c_str(), !hardCut);
+    }
+    else
+    {
+        projectm_load_preset_file(m_projectMInstance,
+                                  playlistItems.at(index).Filename().c_str(), !hardCut);
+    }
 
     if (m_presetSwitchedEventCallback != nullptr)
     {
         m_presetSwitchedEventCallback(hardCut, index, m_presetSwitchedEventUserData);
     }
+
+    PrefetchUpcomingPresets();
+}
+
+
+void PlaylistCWrapper::PrefetchUpcomingPresets()
+{
+    if (m_projectMInstance == nullptr || m_prefetchDepth == 0)
+    {
+        return;
+    }
+
+    // The callback above may have changed the playlist, so the items are fetched again.
+    const auto& playlistItems = Items();
+    for (auto index : UpcomingPresetIndices(m_prefetchDepth))
+    {
+        projectm_prefetch_preset_file(m_projectMInstance, playlistItems.at(index).Filename().c_str());
+    }
 }
 
 
@@ -472,6 +524,34 @@ void projectm_playlist_set_retry_count(projectm_playlist_handle instance, uint32
 }
 
 
+uint32_t projectm_playlist_get_prefetch_depth(projectm_playlist_handle instance)
+{
+    auto* playlist = playlist_handle_to_instance(instance);
+    return playlist->PrefetchDepth();
+}
+
+
+void projectm_playlist_set_prefetch_depth(projectm_playlist_handle instance, uint32_t prefetch_depth)
+{
+    auto* playlist = playlist_handle_to_instance(instance);
+    playlist->SetPrefetchDepth(prefetch_depth);
+}
+
+
+bool projectm_playlist_get_async_loading(projectm_playlist_handle instance)
+{
+    auto* playlist = playlist_handle_to_instance(instance);
+    return playlist->AsyncLoading();
+}
+
+
+void projectm_playlist_set_async_loading(projectm_playlist_handle instance, bool enabled)
+{
+    auto* playlist = playlist_handle_to_instance(instance);
+    playlist->SetAsyncLoading(enabled);
+}
+
+
 auto projectm_playlist_get_position(projectm_playlist_handle instance) -> uint32_t
 {
     auto* playlist = playlist_handle_to_instance(instance);
@@ -66,6 +66,31 @@ public:
      */
     virtual auto RetryCount() -> uint32_t;
 
+    /**
+     * @brief Sets the number of upcoming presets prepared ahead after each preset switch.
+     * @param prefetchDepth The number of presets to prefetch. 0 disables prefetching.
+     */
+    virtual void SetPrefetchDepth(uint32_t prefetchDepth);
+
+    /**
+     * @brief Returns the number of upcoming presets prepared ahead after each preset switch.
+     * @return The number of presets to prefetch.
+     */
+    virtual auto PrefetchDepth() -> uint32_t;
+
+    /**
+     * @brief Sets whether presets are loaded in the background.
+     * @param enabled True to load presets with projectm_load_preset_file_async(), false to load
+     *                them synchronously with projectm_load_preset_file().
+     */
+    virtual void SetAsyncLoading(bool enabled);
+
+    /**
+     * @brief Returns whether presets are loaded in the background.
+     * @return True if presets are loaded asynchronously, false if not.
+     */
+    virtual auto AsyncLoading() -> bool;
+
     /**
      * @brief Sets the preset switched callback.
      * @param callback The callback pointer.
@@ -96,12 +121,19 @@ public:
     auto GetLastNavigationDirection() const -> NavigationDirection;
 
 private:
+    /**
+     * @brief Asks projectM to prepare the next presets in the background.
+     */
+    void PrefetchUpcomingPresets();
+
     projectm_handle m_projectMInstance{nullptr}; //!< The projectM instance handle this instance is connected to.
 
     uint32_t m_presetSwitchRetryCount{5};  //!< Number of switch retries before sending the failure event to the application.
     uint32_t m_presetSwitchFailedCount{0}; //!< Number of retries since the last preset switch.
+    uint32_t m_prefetchDepth{1};           //!< Number of upcoming presets to prefetch after each switch.
 
     bool m_hardCutRequested{false}; //!< Stores the type of the last requested switch attempt.
+    bool m_asyncLoading{false};     //!< If true, presets are loaded in the background.
 
     projectm_playlist_preset_switched_event m_presetSwitchedEventCallback{nullptr}; //!< Preset switched callback pointer set by the application.
     void* m_presetSwitchedEventUserData{nullptr};                                   //!< Context data pointer set by the application.
@@ -47,7 +47,11 @@ PROJECTM_PLAYLIST_EXPORT bool projectm_playlist_get_shuffle(projectm_playlist_ha
 
 /**
  * @brief Sets the number of retries after failed preset switches.
- * @note Don't set this value too high, as each retry is done recursively.
+ *
+ * If async loading is enabled, failures are reported and retried from within
+ * projectm_opengl_render_frame(), usually a few frames after the switch was requested.
+ *
+ * @note Don't set this value too high, as each retry is done recursively when loading synchronously.
  * @param instance The playlist manager instance.
  * @param retry_count The number of retries after failed preset switches. Default is 5. Set to 0
  *                    to simply forward the failure event from projectM.
@@ -61,6 +65,55 @@ PROJECTM_PLAYLIST_EXPORT void projectm_playlist_set_retry_count(projectm_playlis
  */
 PROJECTM_PLAYLIST_EXPORT uint32_t projectm_playlist_get_retry_count(projectm_playlist_handle instance);
 
+/**
+ * @brief Sets the number of upcoming presets prepared ahead after each preset switch.
+ *
+ * After switching to a preset, the playlist asks projectM to read, parse and translate the shaders
+ * of the next presets in the background via projectm_prefetch_preset_file(), so the next automatic
+ * or "next" switch only has to compile the preset. In shuffle mode, the random order is determined
+ * in advance to know which presets come next.
+ *
+ * The number of prefetched presets kept by projectM is limited, see
+ * projectm_set_preset_prefetch_limit().
+ *
+ * @param instance The playlist manager instance.
+ * @param prefetch_depth The number of presets to prefetch. Default is 1. Set to 0 to disable
+ *                       prefetching.
+ */
+PROJECTM_PLAYLIST_EXPORT void projectm_playlist_set_prefetch_depth(projectm_playlist_handle instance, uint32_t prefetch_depth);
+
+/**
+ * @brief Returns the number of upcoming presets prepared ahead after each preset switch.
+ * @param instance The playlist manager instance.
+ * @return The number of presets to prefetch.
+ */
+PROJECTM_PLAYLIST_EXPORT uint32_t projectm_playlist_get_prefetch_depth(projectm_playlist_handle instance);
+
+/**
+ * @brief Enables or disables loading presets in the background.
+ *
+ * By default, the playlist switches presets with projectm_load_preset_file(), so the new preset is
+ * displayed when the playback function returns, and failures are reported before it returns.
+ *
+ * With async loading enabled, the playlist uses projectm_load_preset_file_async() instead, which
+ * avoids stalling the rendering thread. The playback functions then return immediately and the
+ * current preset stays visible until the new one is ready a few frames later. Note that in this
+ * mode, the preset switched callback is called when the switch is requested, even if the preset
+ * later fails to load. Failures are reported and retried from within projectm_opengl_render_frame().
+ *
+ * @param instance The playlist manager instance.
+ * @param enabled True to load presets asynchronously, false to load them synchronously. Default is
+ *                false.
+ */
+PROJECTM_PLAYLIST_EXPORT void projectm_playlist_set_async_loading(projectm_playlist_handle instance, bool enabled);
+
+/**
+ * @brief Returns whether presets are loaded in the background.
+ * @param instance The playlist manager instance.
+ * @return True if async loading is enabled, false otherwise.
+ */
+PROJECTM_PLAYLIST_EXPORT bool projectm_playlist_get_async_loading(projectm_playlist_handle instance);
+
 /**
  * @brief Plays the preset at the requested playlist position and returns the actual playlist index.
  *
@@ -0,0 +1,265 @@
+#include "Audio/AudioConstants.hpp"
+#include "Audio/Loudness.hpp"
+#include "Audio/MilkdropFFT.hpp"
+#include "Audio/PCM.hpp"
+#include "Audio/StereoFFT.hpp"
+#include "Audio/WaveformAligner.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <vector>
+
+using namespace libprojectM::Audio;
+
+namespace {
+
+/**
+ * Creates a deterministic test signal: two sine waves plus some noise, using the internal sample range.
+ */
+auto TestSignal(unsigned int seed) -> std::vector<float>
+{
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<float> noise(-8.0f, 8.0f);
+
+    std::vector<float> samples(AudioBufferSamples);
+    for (size_t i = 0; i < samples.size(); i++)
+    {
+        float const time = static_cast<float>(i) / 44100.0f;
+        samples[i] = 64.0f * std::sin(2.0f * 3.14159265f * 110.0f * time) +
+                     32.0f * std::sin(2.0f * 3.14159265f * 2500.0f * time) +
+                     noise(generator);
+    }
+    return samples;
+}
+
+/**
+ * Converts a sample in the range -1 to 1 into the given input sample type.
+ */
+template<typename SampleType>
+auto ToSampleType(float sample) -> SampleType;
+
+template<>
+auto ToSampleType<float>(float sample) -> float
+{
+    return sample;
+}
+
+template<>
+auto ToSampleType<int16_t>(float sample) -> int16_t
+{
+    return static_cast<int16_t>(sample * 32767.0f);
+}
+
+template<>
+auto ToSampleType<uint8_t>(float sample) -> uint8_t
+{
+    return static_cast<uint8_t>(128.0f + sample * 127.0f);
+}
+
+/**
+ * Creates a deterministic interleaved input block, as passed to PCM::Add(), from the test signal.
+ */
+template<typename SampleType>
+auto InputBlock(uint32_t channels, size_t count) -> std::vector<SampleType>
+{
+    std::vector<SampleType> block(count * channels);
+    for (uint32_t channel = 0; channel < channels; channel++)
+    {
+        auto const signal = TestSignal(channel);
+        for (size_t i = 0; i < count; i++)
+        {
+            block[i * channels + channel] = ToSampleType<SampleType>(signal[i % signal.size()] / 128.0f);
+        }
+    }
+    return block;
+}
+
+/**
+ * Creates a sequence of deterministic spectra, using the stereo FFT on the test signal.
+ */
+auto TestSpectra(size_t count) -> std::vector<SpectrumBuffer>
+{
+    StereoFFT fft(WaveformSamples, SpectrumSamples, true);
+    std::vector<SpectrumBuffer> spectra(count);
+    SpectrumBuffer unused{};
+    for (size_t i = 0; i < count; i++)
+    {
+        auto const signal = TestSignal(static_cast<unsigned int>(i));
+        fft.TimeToFrequencyDomain(signal.data(), signal.data(), spectra[i].data(), unused.data());
+    }
+    return spectra;
+}
+
+/**
+ * Gives access to the scalar error sum code for comparison.
+ */
+class ScalarWaveformAligner : public WaveformAligner
+{
+public:
+    ScalarWaveformAligner()
+    {
+        m_vectorizedErrorSums = false;
+    }
+};
+
+/**
+ * Aligns a sequence of frames of a slowly moving test signal, as done once per channel and frame.
+ */
+template<class Aligner>
+void AlignFrames(benchmark::State& state)
+{
+    Aligner aligner;
+
+    std::vector<WaveformBuffer> frames(16);
+    for (size_t frame = 0; frame < frames.size(); frame++)
+    {
+        auto const samples = TestSignal(static_cast<unsigned int>(frame));
+        std::copy(samples.begin(), samples.end(), frames[frame].begin());
+    }
+
+    size_t frame{};
+    for (auto _ : state)
+    {
+        auto waveform = frames[frame++ % frames.size()];
+        aligner.Align(waveform);
+        benchmark::DoNotOptimize(waveform.data());
+    }
+}
+
+} // namespace
+
+static void BM_MilkdropFFT_Stereo(benchmark::State& state)
+{
+    MilkdropFFT fft(WaveformSamples, SpectrumSamples, true);
+    auto const left = TestSignal(1);
+    auto const right = TestSignal(2);
+    std::vector<float> spectrumLeft;
+    std::vector<float> spectrumRight;
+
+    for (auto _ : state)
+    {
+        fft.TimeToFrequencyDomain(left, spectrumLeft);
+        fft.TimeToFrequencyDomain(right, spectrumRight);
+        benchmark::DoNotOptimize(spectrumLeft.data());
+        benchmark::DoNotOptimize(spectrumRight.data());
+    }
+}
+BENCHMARK(BM_MilkdropFFT_Stereo);
+
+static void BM_StereoFFT(benchmark::State& state)
+{
+    StereoFFT fft(WaveformSamples, SpectrumSamples, true);
+    auto const left = TestSignal(1);
+    auto const right = TestSignal(2);
+    std::vector<float> spectrumLeft(SpectrumSamples);
+    std::vector<float> spectrumRight(SpectrumSamples);
+
+    for (auto _ : state)
+    {
+        fft.TimeToFrequencyDomain(left.data(), right.data(), spectrumLeft.data(), spectrumRight.data());
+        benchmark::DoNotOptimize(spectrumLeft.data());
+        benchmark::DoNotOptimize(spectrumRight.data());
+        benchmark::ClobberMemory();
+    }
+}
+BENCHMARK(BM_StereoFFT);
+
+static void BM_WaveformAligner_Align(benchmark::State& state)
+{
+    AlignFrames<WaveformAligner>(state);
+}
+BENCHMARK(BM_WaveformAligner_Align);
+
+static void BM_WaveformAligner_Align_Scalar(benchmark::State& state)
+{
+    AlignFrames<ScalarWaveformAligner>(state);
+}
+BENCHMARK(BM_WaveformAligner_Align_Scalar);
+
+/**
+ * Adds blocks of 512 samples. The input buffer is drained outside the timed region before it runs full.
+ * Argument: number of channels.
+ */
+template<typename SampleType>
+static void BM_PCM_Add(benchmark::State& state)
+{
+    static constexpr size_t blockSize = 512;
+    static constexpr size_t blocksUntilFull = SampleRingBuffer::Capacity / blockSize;
+
+    auto const channels = static_cast<uint32_t>(state.range(0));
+    auto const block = InputBlock<SampleType>(channels, blockSize);
+    auto pcm = std::make_unique<PCM>();
+
+    size_t blocksAdded{};
+    for (auto _ : state)
+    {
+        pcm->Add(block.data(), channels, blockSize);
+
+        if (++blocksAdded == blocksUntilFull)
+        {
+            state.PauseTiming();
+            pcm->UpdateFrameAudioData(1.0 / 60.0, 0);
+            blocksAdded = 0;
+            state.ResumeTiming();
+        }
+    }
+
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * blockSize));
+}
+BENCHMARK_TEMPLATE(BM_PCM_Add, float)->ArgName("channels")->Arg(1)->Arg(2);
+BENCHMARK_TEMPLATE(BM_PCM_Add, int16_t)->ArgName("channels")->Arg(1)->Arg(2);
+BENCHMARK_TEMPLATE(BM_PCM_Add, uint8_t)->ArgName("channels")->Arg(1)->Arg(2);
+
+/**
+ * Updates the three beat detection bands, as done once per frame.
+ */
+static void BM_Loudness_Update(benchmark::State& state)
+{
+    auto const spectra = TestSpectra(16);
+    Loudness bass{Loudness::Band::Bass};
+    Loudness middles{Loudness::Band::Middles};
+    Loudness treble{Loudness::Band::Treble};
+
+    uint32_t frame{};
+    for (auto _ : state)
+    {
+        auto const& spectrum = spectra[frame % spectra.size()];
+        bass.Update(spectrum, 1.0 / 60.0, frame);
+        middles.Update(spectrum, 1.0 / 60.0, frame);
+        treble.Update(spectrum, 1.0 / 60.0, frame);
+        frame++;
+        benchmark::DoNotOptimize(bass.CurrentRelative() + middles.CurrentRelative() + treble.CurrentRelative());
+    }
+}
+BENCHMARK(BM_Loudness_Update);
+
+/**
+ * Complete per-frame analysis, including adding one frame worth of stereo float audio at 60 FPS.
+ * Argument: number of analyzed frequencies, see AnalysisSize. 512 is the legacy Milkdrop size.
+ */
+static void BM_PCM_UpdateFrameAudioData(benchmark::State& state)
+{
+    static constexpr size_t samplesPerFrame = 735;
+
+    AnalysisSize size;
+    size.spectrumSamples = static_cast<uint32_t>(state.range(0));
+    size.windowSamples = size.spectrumSamples * WaveformSamples / SpectrumSamples;
+
+    auto pcm = std::make_unique<PCM>(size);
+    auto const block = InputBlock<float>(2, samplesPerFrame * 16);
+
+    uint32_t frame{};
+    for (auto _ : state)
+    {
+        pcm->Add(block.data() + (frame % 16) * samplesPerFrame * 2, 2, samplesPerFrame);
+        pcm->UpdateFrameAudioData(1.0 / 60.0, frame++);
+        benchmark::ClobberMemory();
+    }
+}
+BENCHMARK(BM_PCM_UpdateFrameAudioData)->ArgName("spectrum")->RangeMultiplier(2)->Range(AnalysisSize::MinSpectrumSamples, AnalysisSize::MaxSpectrumSamples);
@@ -0,0 +1,291 @@
+#include "MilkdropPreset/ExpressionJit.hpp"
+#include "MilkdropPreset/PerPixelContext.hpp"
+#include "MilkdropPreset/WorkerPool.hpp"
+
+#include <projectm-eval.h>
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace libprojectM::MilkdropPreset;
+
+namespace {
+
+/**
+ * Typical pure per-pixel code, using temporaries, audio values and all common motion variables.
+ */
+constexpr auto PerPixelCode = "d = sqrt(sqr(x - 0.5) + sqr(y - 0.5));\n"
+                              "zoom = zoom + 0.04 * sin(d * 12 - time * 2) * (1 + bass_att);\n"
+                              "rot = rot + 0.02 * cos(ang * 3 + time) * mid;\n"
+                              "dx = dx + 0.005 * sin(y * 8 + time);\n"
+                              "dy = dy + 0.005 * cos(x * 8 + time);\n"
+                              "warp = if(above(rad, 0.6), warp * 0.5, warp);";
+
+constexpr int MeshSizeX = 96;
+constexpr int MeshSizeY = 72;
+constexpr int RowsPerTask = 4;
+
+/**
+ * Adds thread counts of 1, 2, 4 etc. up to the number of hardware threads.
+ */
+void ThreadCounts(benchmark::internal::Benchmark* benchmark)
+{
+    int const hardwareThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    for (int threads = 1; threads < hardwareThreads; threads *= 2)
+    {
+        benchmark->Arg(threads);
+    }
+    benchmark->Arg(hardwareThreads);
+}
+
+} // namespace
+
+/**
+ * Runs the per-pixel code over a full warp mesh, sharding the rows over cloned contexts the same
+ * way PerPixelMesh does. Compare the items/s values to see the scaling with the thread count.
+ * Argument: number of threads, including the calling thread.
+ */
+static void BM_PerPixel_Mesh(benchmark::State& state)
+{
+    auto const threads = static_cast<size_t>(state.range(0));
+
+    auto* globalMemory = projectm_eval_memory_buffer_create();
+    PRJM_EVAL_F globalRegisters[100]{};
+
+    {
+        WorkerPool pool(threads - 1);
+        PerPixelContext context(globalMemory, &globalRegisters);
+        ExpressionWatchdog const watchdog; // Without a budget, never expires.
+        context.RegisterBuiltinVariables();
+        context.CompilePerPixelCode(PerPixelCode);
+        if (!context.CanExecuteInParallel())
+        {
+            state.SkipWithError("Benchmark per-pixel code is not parallel-safe.");
+        }
+
+        int const rowCount = MeshSizeY + 1;
+        size_t const taskCount = static_cast<size_t>((rowCount + RowsPerTask - 1) / RowsPerTask);
+        std::vector<float> results((MeshSizeX + 1) * rowCount * 4);
+        std::vector<PerPixelContext*> slotContexts(pool.Concurrency());
+
+        int frame{};
+        for (auto _ : state)
+        {
+            *context.time = frame / 60.0;
+            *context.bass_att = 1.0 + 0.5 * std::sin(frame * 0.1);
+            *context.mid = 1.0;
+            frame++;
+
+            for (size_t slot = 0; slot < slotContexts.size(); slot++)
+            {
+                slotContexts[slot] = &context.WorkerContext(slot);
+            }
+
+            pool.ParallelFor(taskCount, [&](size_t task, size_t slot) {
+                auto& slotContext = *slotContexts[slot];
+                int const firstRow = static_cast<int>(task) * RowsPerTask;
+                int const lastRow = std::min(firstRow + RowsPerTask, rowCount);
+                for (int y = firstRow; y < lastRow; y++)
+                {
+                    for (int x = 0; x <= MeshSizeX; x++)
+                    {
+                        double const posX = static_cast<double>(x) / MeshSizeX;
+                        double const posY = static_cast<double>(y) / MeshSizeY;
+                        *slotContext.x = posX;
+                        *slotContext.y = posY;
+                        *slotContext.rad = std::hypot(posX - 0.5, posY - 0.5);
+                        *slotContext.ang = std::atan2(posY - 0.5, posX - 0.5);
+                        *slotContext.zoom = 1.0;
+                        *slotContext.rot = 0.0;
+                        *slotContext.warp = 1.0;
+                        *slotContext.dx = 0.0;
+                        *slotContext.dy = 0.0;
+
+                        slotContext.ExecutePerPixelCode(watchdog);
+
+                        auto* result = &results[(y * (MeshSizeX + 1) + x) * 4];
+                        result[0] = static_cast<float>(*slotContext.zoom);
+                        result[1] = static_cast<float>(*slotContext.rot);
+                        result[2] = static_cast<float>(*slotContext.dx);
+                        result[3] = static_cast<float>(*slotContext.dy);
+                    }
+                }
+            });
+
+            benchmark::DoNotOptimize(results.data());
+            benchmark::ClobberMemory();
+        }
+
+        state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * (MeshSizeX + 1) * rowCount));
+    }
+
+    projectm_eval_memory_buffer_destroy(globalMemory);
+}
+BENCHMARK(BM_PerPixel_Mesh)->ArgName("threads")->Apply(ThreadCounts)->UseRealTime();
+
+/**
+ * Runs the per-pixel code over a full warp mesh on a single thread, either once per vertex
+ * using the expression library or in batches using the BatchEvaluator.
+ * Argument: 0 for per-vertex execution, 1 for batched execution.
+ */
+static void BM_PerPixel_Batched(benchmark::State& state)
+{
+    bool const batched = state.range(0) != 0;
+
+    auto* globalMemory = projectm_eval_memory_buffer_create();
+    PRJM_EVAL_F globalRegisters[100]{};
+
+    {
+        PerPixelContext context(globalMemory, &globalRegisters);
+        ExpressionWatchdog const watchdog; // Without a budget, never expires.
+        context.RegisterBuiltinVariables();
+        context.CompilePerPixelCode(PerPixelCode);
+        if (batched && !context.CanExecuteBatched())
+        {
+            state.SkipWithError("Benchmark per-pixel code can't be executed in batches.");
+        }
+
+        int const vertexCount = (MeshSizeX + 1) * (MeshSizeY + 1);
+        std::vector<float> results(vertexCount * 4);
+        auto const& lanes = context.batchLanes;
+
+        int frame{};
+        for (auto _ : state)
+        {
+            *context.time = frame / 60.0;
+            *context.bass_att = 1.0 + 0.5 * std::sin(frame * 0.1);
+            *context.mid = 1.0;
+            frame++;
+
+            for (int batchStart = 0; batchStart < vertexCount; batchStart += static_cast<int>(BatchEvaluator::BatchSize))
+            {
+                int const count = std::min(static_cast<int>(BatchEvaluator::BatchSize), vertexCount - batchStart);
+                for (int lane = 0; lane < count; lane++)
+                {
+                    int const vertex = batchStart + lane;
+                    double const posX = static_cast<double>(vertex % (MeshSizeX + 1)) / MeshSizeX;
+                    double const posY = static_cast<double>(vertex / (MeshSizeX + 1)) / MeshSizeY;
+                    double const rad = std::hypot(posX - 0.5, posY - 0.5);
+                    double const ang = std::atan2(posY - 0.5, posX - 0.5);
+
+                    if (batched)
+                    {
+                        lanes.x[lane] = posX;
+                        lanes.y[lane] = posY;
+                        lanes.rad[lane] = rad;
+                        lanes.ang[lane] = ang;
+                        lanes.zoom[lane] = 1.0;
+                        lanes.rot[lane] = 0.0;
+                        lanes.warp[lane] = 1.0;
+                        lanes.dx[lane] = 0.0;
+                        lanes.dy[lane] = 0.0;
+                        continue;
+                    }
+
+                    *context.x = posX;
+                    *context.y = posY;
+                    *context.rad = rad;
+                    *context.ang = ang;
+                    *context.zoom = 1.0;
+                    *context.rot = 0.0;
+                    *context.warp = 1.0;
+                    *context.dx = 0.0;
+                    *context.dy = 0.0;
+
+                    context.ExecutePerPixelCode(watchdog);
+
+                    auto* result = &results[vertex * 4];
+                    result[0] = static_cast<float>(*context.zoom);
+                    result[1] = static_cast<float>(*context.rot);
+                    result[2] = static_cast<float>(*context.dx);
+                    result[3] = static_cast<float>(*context.dy);
+                }
+
+                if (batched)
+                {
+                    context.ExecutePerPixelCodeBatch(static_cast<size_t>(count));
+                    for (int lane = 0; lane < count; lane++)
+                    {
+                        auto* result = &results[(batchStart + lane) * 4];
+                        result[0] = static_cast<float>(lanes.zoom[lane]);
+                        result[1] = static_cast<float>(lanes.rot[lane]);
+                        result[2] = static_cast<float>(lanes.dx[lane]);
+                        result[3] = static_cast<float>(lanes.dy[lane]);
+                    }
+                }
+            }
+
+            benchmark::DoNotOptimize(results.data());
+            benchmark::ClobberMemory();
+        }
+
+        state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * vertexCount));
+    }
+
+    projectm_eval_memory_buffer_destroy(globalMemory);
+}
+BENCHMARK(BM_PerPixel_Batched)->ArgName("batched")->Arg(0)->Arg(1);
+
+/**
+ * Runs the per-pixel code once per vertex, either in the expression library interpreter or as
+ * native code generated by ExpressionJit.
+ * Argument: 0 for the interpreter, 1 for native code.
+ */
+static void BM_Expression_Native(benchmark::State& state)
+{
+    bool const native = state.range(0) != 0;
+
+    auto* globalMemory = projectm_eval_memory_buffer_create();
+    PRJM_EVAL_F globalRegisters[100]{};
+    auto* context = projectm_eval_context_create(globalMemory, &globalRegisters);
+    auto* code = projectm_eval_code_compile(context, PerPixelCode);
+    auto jit = ExpressionJit::Compile(PerPixelCode, context);
+    if (native && jit == nullptr)
+    {
+        state.SkipWithError("Native code generation is not available on this platform.");
+    }
+
+    auto* x = projectm_eval_context_register_variable(context, "x");
+    auto* y = projectm_eval_context_register_variable(context, "y");
+    auto* zoom = projectm_eval_context_register_variable(context, "zoom");
+    auto* time = projectm_eval_context_register_variable(context, "time");
+
+    int const vertexCount = (MeshSizeX + 1) * (MeshSizeY + 1);
+    int frame{};
+    for (auto _ : state)
+    {
+        *time = frame / 60.0;
+        frame++;
+
+        for (int vertex = 0; vertex < vertexCount; vertex++)
+        {
+            *x = static_cast<double>(vertex % (MeshSizeX + 1)) / MeshSizeX;
+            *y = static_cast<double>(vertex / (MeshSizeX + 1)) / MeshSizeY;
+            *zoom = 1.0;
+
+            if (native)
+            {
+                jit->ExecuteNative();
+            }
+            else
+            {
+                projectm_eval_code_execute(code);
+            }
+        }
+
+        benchmark::DoNotOptimize(*zoom);
+    }
+
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * vertexCount));
+
+    jit.reset();
+    projectm_eval_code_destroy(code);
+    projectm_eval_context_destroy(context);
+    projectm_eval_memory_buffer_destroy(globalMemory);
+}
+BENCHMARK(BM_Expression_Native)->ArgName("native")->Arg(0)->Arg(1);
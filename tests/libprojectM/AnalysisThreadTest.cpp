@@ -0,0 +1,125 @@
+#include "Audio/AnalysisThread.hpp"
+#include "Audio/PCM.hpp"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cmath>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace libprojectM::Audio;
+
+namespace {
+
+auto StereoSine(size_t frame) -> std::vector<float>
+{
+    std::vector<float> samples(AudioBufferSamples * 2);
+    for (size_t i = 0; i < AudioBufferSamples; i++)
+    {
+        auto const time = static_cast<float>(frame * AudioBufferSamples + i) / 44100.0f;
+        samples[i * 2] = 0.5f * std::sin(2.0f * 3.14159265f * 220.0f * time);
+        samples[i * 2 + 1] = 0.25f * std::sin(2.0f * 3.14159265f * 3000.0f * time);
+    }
+    return samples;
+}
+
+void ExpectEqual(const FrameAudioData& actual, const FrameAudioData& expected)
+{
+    EXPECT_EQ(actual.bass, expected.bass);
+    EXPECT_EQ(actual.bassAtt, expected.bassAtt);
+    EXPECT_EQ(actual.mid, expected.mid);
+    EXPECT_EQ(actual.midAtt, expected.midAtt);
+    EXPECT_EQ(actual.treb, expected.treb);
+    EXPECT_EQ(actual.trebAtt, expected.trebAtt);
+    EXPECT_EQ(actual.vol, expected.vol);
+    EXPECT_EQ(actual.volAtt, expected.volAtt);
+    EXPECT_EQ(actual.waveformLeft, expected.waveformLeft);
+    EXPECT_EQ(actual.waveformRight, expected.waveformRight);
+    EXPECT_EQ(actual.spectrumLeft, expected.spectrumLeft);
+    EXPECT_EQ(actual.spectrumRight, expected.spectrumRight);
+}
+
+} // namespace
+
+TEST(projectMAnalysisThread, StartAndStop)
+{
+    auto pcm = std::make_unique<PCM>();
+    AnalysisThread thread(*pcm);
+
+    EXPECT_FALSE(thread.IsRunning());
+    ASSERT_TRUE(thread.Start());
+    EXPECT_TRUE(thread.IsRunning());
+    EXPECT_TRUE(thread.Start());
+
+    thread.Stop();
+    EXPECT_FALSE(thread.IsRunning());
+    thread.Stop();
+    EXPECT_FALSE(thread.IsRunning());
+}
+
+TEST(projectMAnalysisThread, MatchesSynchronousAnalysis)
+{
+    auto threadedPcm = std::make_unique<PCM>();
+    auto synchronousPcm = std::make_unique<PCM>();
+    AnalysisThread thread(*threadedPcm);
+
+    for (uint32_t frame = 0; frame < 10; frame++)
+    {
+        auto const samples = StereoSine(frame);
+        threadedPcm->Add(samples.data(), 2, AudioBufferSamples);
+        synchronousPcm->Add(samples.data(), 2, AudioBufferSamples);
+
+        // Stopping waits for the pending request to be processed.
+        ASSERT_TRUE(thread.Start());
+        thread.RequestUpdate(1.0 / 60.0, frame, 1.0f);
+        thread.Stop();
+
+        synchronousPcm->UpdateFrameAudioData(1.0 / 60.0, frame);
+
+        ExpectEqual(*thread.LatestFrameAudioData(), *synchronousPcm->GetFrameAudioData());
+    }
+}
+
+TEST(projectMAnalysisThread, ConcurrentAddUpdateAndRead)
+{
+    auto pcm = std::make_unique<PCM>();
+    AnalysisThread thread(*pcm);
+    ASSERT_TRUE(thread.Start());
+
+    std::atomic<bool> running{true};
+
+    // Right channel is always the negated left channel, which must be preserved in every snapshot.
+    std::thread producer([&pcm, &running]() {
+        std::vector<float> samples(128 * 2);
+        float value{0.0f};
+        while (running.load())
+        {
+            for (size_t i = 0; i < 128; i++)
+            {
+                value = value >= 1.0f ? -1.0f : value + 1.0f / 256.0f;
+                samples[i * 2] = value;
+                samples[i * 2 + 1] = -value;
+            }
+            pcm->Add(samples.data(), 2, 128);
+            std::this_thread::yield();
+        }
+    });
+
+    for (uint32_t frame = 0; frame < 500; frame++)
+    {
+        auto const snapshot = thread.LatestFrameAudioData();
+        auto const& data = *snapshot;
+        thread.RequestUpdate(1.0 / 60.0, frame, 1.0f);
+
+        for (size_t i = 0; i < WaveformSamples; i++)
+        {
+            ASSERT_EQ(data.waveformRight[i], -data.waveformLeft[i]) << "Frame " << frame << ", sample " << i;
+        }
+    }
+
+    running = false;
+    producer.join();
+    thread.Stop();
+}
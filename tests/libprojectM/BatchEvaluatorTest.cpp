@@ -0,0 +1,404 @@
+#include <gtest/gtest.h>
+
+#include <MilkdropPreset/BatchEvaluator.hpp>
+#include <MilkdropPreset/PresetFileParser.hpp>
+#include <Renderer/FileScanner.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <set>
+#include <string>
+#include <vector>
+
+using libprojectM::MilkdropPreset::BatchEvaluator;
+using libprojectM::MilkdropPreset::ExpressionNode;
+using libprojectM::MilkdropPreset::ExpressionOperation;
+using libprojectM::MilkdropPreset::ExpressionTree;
+using libprojectM::MilkdropPreset::FloatBatchEvaluator;
+using libprojectM::MilkdropPreset::PresetFileParser;
+
+namespace {
+
+void CollectVariableNames(const ExpressionNode& node, std::set<std::string>& names)
+{
+    if (node.operation == ExpressionOperation::Variable || node.operation == ExpressionOperation::Assign)
+    {
+        names.insert(node.name);
+    }
+
+    for (const auto& argument : node.arguments)
+    {
+        CollectVariableNames(*argument, names);
+    }
+}
+
+/**
+ * Returns the value of a variable in the given lane, either varying over the lanes like the
+ * per-vertex or per-point inputs, or the same arbitrary but deterministic value in all lanes.
+ */
+auto InitialValue(const std::string& name, size_t lane) -> double
+{
+    auto const position = static_cast<double>(lane) / static_cast<double>(BatchEvaluator::BatchSize - 1);
+    if (name == "x" || name == "sample")
+    {
+        return position;
+    }
+    if (name == "y")
+    {
+        return 1.0 - position;
+    }
+    if (name == "rad")
+    {
+        return position * 0.7;
+    }
+    if (name == "ang")
+    {
+        return position * 6.28 - 3.14;
+    }
+    if (name == "value1" || name == "value2")
+    {
+        return std::sin(position * 20.0) * 0.4;
+    }
+
+    double seed = 0.125;
+    for (auto character : name)
+    {
+        seed = std::fmod(seed * 7.31 + static_cast<double>(character) * 0.377, 4.0);
+    }
+    return seed - 2.0;
+}
+
+/**
+ * Returns a preset file path relative to the bundled presets directory, with forward slashes.
+ */
+auto RelativePresetPath(const std::string& presetFile) -> std::string
+{
+    auto path = presetFile;
+    std::replace(path.begin(), path.end(), '\\', '/');
+    auto const presetsDirLength = std::strlen(PROJECTM_PRESETS_DIR);
+    if (path.compare(0, presetsDirLength, PROJECTM_PRESETS_DIR) == 0)
+    {
+        path.erase(0, presetsDirLength + 1);
+    }
+    return path;
+}
+
+/**
+ * Reads the list of code known to diverge in single precision. Each line contains the preset path
+ * relative to the presets directory and the code name, separated by a colon. Lines starting with
+ * "#" are comments.
+ */
+auto ReadDivergingCodeList() -> std::set<std::string>
+{
+    std::set<std::string> entries;
+    std::ifstream file(PROJECTM_TEST_DATA_DIR "/BatchEvaluator/single-precision-diverging.txt");
+    std::string line;
+    while (std::getline(file, line))
+    {
+        if (!line.empty() && line.back() == '\r')
+        {
+            line.pop_back();
+        }
+        if (!line.empty() && line[0] != '#')
+        {
+            entries.insert(line);
+        }
+    }
+    return entries;
+}
+
+} // namespace
+
+TEST(projectMBatchEvaluator, EvaluatesAllLanes)
+{
+    ExpressionTree const tree("d = sqrt(sqr(x) + sqr(y)); zoom = zoom + d * scale;");
+    ASSERT_NE(tree.Root(), nullptr);
+
+    BatchEvaluator evaluator(*tree.Root(), {"x", "y", "zoom"});
+    auto* x = evaluator.Lanes("x");
+    auto* y = evaluator.Lanes("y");
+    auto* zoom = evaluator.Lanes("zoom");
+    auto* scale = evaluator.Lanes("scale");
+    ASSERT_NE(x, nullptr);
+    ASSERT_NE(y, nullptr);
+    ASSERT_NE(zoom, nullptr);
+    ASSERT_NE(scale, nullptr);
+
+    for (size_t lane = 0; lane < BatchEvaluator::BatchSize; lane++)
+    {
+        x[lane] = static_cast<double>(lane);
+        y[lane] = 1.0;
+        zoom[lane] = 1.0;
+        scale[lane] = 0.5;
+    }
+
+    evaluator.Execute(BatchEvaluator::BatchSize);
+
+    for (size_t lane = 0; lane < BatchEvaluator::BatchSize; lane++)
+    {
+        auto const expected = 1.0 + std::sqrt(static_cast<double>(lane * lane) + 1.0) * 0.5;
+        EXPECT_DOUBLE_EQ(zoom[lane], expected) << "Lane " << lane;
+    }
+}
+
+TEST(projectMBatchEvaluator, OnlyExecutesRequestedLanes)
+{
+    ExpressionTree const tree("x = x + 1");
+    ASSERT_NE(tree.Root(), nullptr);
+
+    BatchEvaluator evaluator(*tree.Root(), {"x"});
+    auto* x = evaluator.Lanes("x");
+    std::fill_n(x, BatchEvaluator::BatchSize, 1.0);
+
+    evaluator.Execute(3);
+
+    EXPECT_EQ(x[0], 2.0);
+    EXPECT_EQ(x[2], 2.0);
+    EXPECT_EQ(x[3], 1.0);
+}
+
+TEST(projectMBatchEvaluator, ConditionalAssignmentIsMasked)
+{
+    ExpressionTree const tree("if(above(x, 2), y = 10, z = 20); w = below(x, 2) ? 1 : 2;");
+    ASSERT_NE(tree.Root(), nullptr);
+
+    BatchEvaluator evaluator(*tree.Root(), {"x", "y", "z", "w"});
+    auto* x = evaluator.Lanes("x");
+    auto* y = evaluator.Lanes("y");
+    auto* z = evaluator.Lanes("z");
+    auto* w = evaluator.Lanes("w");
+
+    for (size_t lane = 0; lane < 4; lane++)
+    {
+        x[lane] = static_cast<double>(lane);
+        y[lane] = -1.0;
+        z[lane] = -1.0;
+    }
+
+    evaluator.Execute(4);
+
+    EXPECT_EQ(y[0], -1.0);
+    EXPECT_EQ(z[0], 20.0);
+    EXPECT_EQ(y[2], -1.0);
+    EXPECT_EQ(z[2], 20.0);
+    EXPECT_EQ(y[3], 10.0);
+    EXPECT_EQ(z[3], -1.0);
+
+    EXPECT_EQ(w[0], 1.0);
+    EXPECT_EQ(w[2], 2.0);
+    EXPECT_EQ(w[3], 2.0);
+}
+
+TEST(projectMBatchEvaluator, LogicalOperatorsAndComparisons)
+{
+    ExpressionTree const tree("a = x > 0 && x < 3; b = x == 2 || !x; c = equal(x, 1.000000001);");
+    ASSERT_NE(tree.Root(), nullptr);
+
+    BatchEvaluator evaluator(*tree.Root(), {"x", "a", "b", "c"});
+    auto* x = evaluator.Lanes("x");
+    for (size_t lane = 0; lane < 4; lane++)
+    {
+        x[lane] = static_cast<double>(lane);
+    }
+
+    evaluator.Execute(4);
+
+    auto* a = evaluator.Lanes("a");
+    auto* b = evaluator.Lanes("b");
+    auto* c = evaluator.Lanes("c");
+    EXPECT_EQ(a[0], 0.0);
+    EXPECT_EQ(a[1], 1.0);
+    EXPECT_EQ(a[3], 0.0);
+    EXPECT_EQ(b[0], 1.0);
+    EXPECT_EQ(b[1], 0.0);
+    EXPECT_EQ(b[2], 1.0);
+    EXPECT_EQ(c[0], 0.0);
+    EXPECT_EQ(c[1], 1.0);
+}
+
+TEST(projectMBatchEvaluator, DivisionByZero)
+{
+    ExpressionTree const tree("a = 1 / x; b = 7 % x;");
+    ASSERT_NE(tree.Root(), nullptr);
+
+    BatchEvaluator evaluator(*tree.Root(), {"x", "a", "b"});
+    auto* x = evaluator.Lanes("x");
+    x[0] = 0.0;
+    x[1] = 2.0;
+
+    evaluator.Execute(2);
+
+    EXPECT_EQ(evaluator.Lanes("a")[0], 0.0);
+    EXPECT_EQ(evaluator.Lanes("a")[1], 0.5);
+    EXPECT_EQ(evaluator.Lanes("b")[0], 0.0);
+    EXPECT_EQ(evaluator.Lanes("b")[1], 1.0);
+}
+
+TEST(projectMBatchEvaluator, ReadVariables)
+{
+    ExpressionTree const tree("zoom = zoom * q1 + time");
+    ASSERT_NE(tree.Root(), nullptr);
+
+    BatchEvaluator const evaluator(*tree.Root(), {"x", "zoom"});
+    auto const& readVariables = evaluator.ReadVariables();
+
+    EXPECT_NE(std::find(readVariables.begin(), readVariables.end(), "zoom"), readVariables.end());
+    EXPECT_NE(std::find(readVariables.begin(), readVariables.end(), "q1"), readVariables.end());
+    EXPECT_NE(std::find(readVariables.begin(), readVariables.end(), "time"), readVariables.end());
+    EXPECT_EQ(std::find(readVariables.begin(), readVariables.end(), "x"), readVariables.end());
+}
+
+TEST(projectMBatchEvaluator, SinglePrecisionLanes)
+{
+    ExpressionTree const tree("d = sqrt(sqr(x) + sqr(y)); zoom = zoom + sin(d) * scale; w = if(above(x, 3), 1, 2);");
+    ASSERT_NE(tree.Root(), nullptr);
+
+    FloatBatchEvaluator evaluator(*tree.Root(), {"x", "y", "zoom", "w"});
+    auto* x = evaluator.Lanes("x");
+    auto* y = evaluator.Lanes("y");
+    auto* zoom = evaluator.Lanes("zoom");
+    auto* scale = evaluator.Lanes("scale");
+    ASSERT_NE(x, nullptr);
+    ASSERT_NE(scale, nullptr);
+
+    for (size_t lane = 0; lane < FloatBatchEvaluator::BatchSize; lane++)
+    {
+        x[lane] = static_cast<float>(lane);
+        y[lane] = 1.0f;
+        zoom[lane] = 1.0f;
+        scale[lane] = 0.5f;
+    }
+
+    evaluator.Execute(FloatBatchEvaluator::BatchSize);
+
+    for (size_t lane = 0; lane < FloatBatchEvaluator::BatchSize; lane++)
+    {
+        auto const expected = 1.0 + std::sin(std::sqrt(static_cast<double>(lane * lane) + 1.0)) * 0.5;
+        EXPECT_TRUE(FloatBatchEvaluator::WithinTolerance(expected, zoom[lane])) << "Lane " << lane << ": " << zoom[lane] << ", expected " << expected;
+        EXPECT_EQ(evaluator.Lanes("w")[lane], lane > 3 ? 1.0f : 2.0f);
+    }
+}
+
+TEST(projectMBatchEvaluator, MatchesReference)
+{
+    float const expected[3]{1.0f, -0.25f, 100.0f};
+    float const close[3]{1.0001f, -0.2501f, 100.01f};
+    float const different[3]{1.0f, -0.26f, 100.0f};
+
+    EXPECT_TRUE(BatchEvaluator::MatchesReference(expected, expected, 3));
+    EXPECT_FALSE(BatchEvaluator::MatchesReference(expected, close, 3));
+    EXPECT_TRUE(FloatBatchEvaluator::MatchesReference(expected, close, 3));
+    EXPECT_FALSE(FloatBatchEvaluator::MatchesReference(expected, different, 3));
+}
+
+/**
+ * Evaluates the per-pixel and per-point code of all bundled presets once in double and once in
+ * single precision, and checks that the values used for rendering stay within the tolerance used
+ * to validate the single precision results at runtime. Some presets amplify rounding differences,
+ * e.g. by multiplying with large factors before taking the sine. These fall back to the interpreter
+ * at runtime if built with ENABLE_FLOAT_EXPRESSIONS, and are listed in
+ * data/BatchEvaluator/single-precision-diverging.txt. The test fails if any other code diverges,
+ * or if listed code doesn't diverge anymore.
+ */
+TEST(projectMBatchEvaluator, BundledPresetsMatchInSinglePrecision)
+{
+    auto const knownDivergingCode = ReadDivergingCodeList();
+    ASSERT_FALSE(knownDivergingCode.empty());
+
+    std::vector<std::string> presetFiles;
+    std::vector<std::string> extensions{".milk"};
+    libprojectM::Renderer::FileScanner scanner({PROJECTM_PRESETS_DIR}, extensions);
+    scanner.Scan([&presetFiles](const std::string& path, const std::string&) {
+        presetFiles.push_back(path);
+    });
+    ASSERT_FALSE(presetFiles.empty());
+
+    std::vector<std::string> const perPixelOutputs{"zoom", "zoomexp", "rot", "warp", "cx", "cy", "dx", "dy", "sx", "sy"};
+    std::vector<std::string> const perPointOutputs{"x", "y", "r", "g", "b", "a"};
+
+    size_t evaluatedCount{};
+    std::set<std::string> divergingCode;
+    for (const auto& presetFile : presetFiles)
+    {
+        PresetFileParser parser;
+        if (!parser.Read(presetFile))
+        {
+            continue;
+        }
+
+        struct Code {
+            std::string name;
+            std::string source;
+            const std::vector<std::string>* outputs;
+        };
+        std::vector<Code> codes{{"per_pixel_", parser.GetCode("per_pixel_"), &perPixelOutputs}};
+        for (int index = 0; index < 4; index++)
+        {
+            auto const name = "wave_" + std::to_string(index) + "_per_point";
+            codes.push_back({name, parser.GetCode(name), &perPointOutputs});
+        }
+
+        for (const auto& code : codes)
+        {
+            ExpressionTree const tree(code.source);
+            if (code.source.empty() || tree.Root() == nullptr)
+            {
+                continue;
+            }
+            evaluatedCount++;
+
+            std::set<std::string> names;
+            CollectVariableNames(*tree.Root(), names);
+            names.insert(code.outputs->begin(), code.outputs->end());
+            std::vector<std::string> const variables(names.begin(), names.end());
+
+            BatchEvaluator doubleEvaluator(*tree.Root(), variables);
+            FloatBatchEvaluator floatEvaluator(*tree.Root(), variables);
+            for (const auto& name : variables)
+            {
+                for (size_t lane = 0; lane < BatchEvaluator::BatchSize; lane++)
+                {
+                    auto const value = InitialValue(name, lane);
+                    doubleEvaluator.Lanes(name)[lane] = value;
+                    floatEvaluator.Lanes(name)[lane] = static_cast<float>(value);
+                }
+            }
+
+            doubleEvaluator.Execute(BatchEvaluator::BatchSize);
+            floatEvaluator.Execute(BatchEvaluator::BatchSize);
+
+            auto const entry = RelativePresetPath(presetFile) + ":" + code.name;
+            bool const known = knownDivergingCode.find(entry) != knownDivergingCode.end();
+            bool diverges{false};
+            for (const auto& name : *code.outputs)
+            {
+                for (size_t lane = 0; lane < BatchEvaluator::BatchSize && !diverges; lane++)
+                {
+                    // The host converts all results to single precision.
+                    auto const expected = static_cast<double>(static_cast<float>(doubleEvaluator.Lanes(name)[lane]));
+                    auto const actual = static_cast<double>(floatEvaluator.Lanes(name)[lane]);
+                    if (!FloatBatchEvaluator::WithinTolerance(expected, actual))
+                    {
+                        EXPECT_TRUE(known) << entry << " diverges in single precision: "
+                                           << name << " is " << actual << ", expected " << expected;
+                        diverges = true;
+                    }
+                }
+            }
+
+            if (diverges)
+            {
+                divergingCode.insert(entry);
+            }
+        }
+    }
+
+    ASSERT_GT(evaluatedCount, 0U);
+
+    for (const auto& entry : knownDivergingCode)
+    {
+        EXPECT_NE(divergingCode.find(entry), divergingCode.end()) << entry << " is listed as diverging, but matches in single precision.";
+    }
+}
@@ -0,0 +1,121 @@
+#include <gtest/gtest.h>
+
+#include <MilkdropPreset/CodeAnalysis.hpp>
+
+using libprojectM::MilkdropPreset::CodeAnalysis;
+
+namespace {
+
+const CodeAnalysis::VariableSet ResetVariables{
+    "x", "y", "rad", "ang",
+    "zoom", "zoomexp", "rot", "warp", "cx", "cy", "dx", "dy", "sx", "sy"};
+
+} // namespace
+
+TEST(projectMCodeAnalysis, ReadAndWrittenVariables)
+{
+    CodeAnalysis const analysis("zoom = zoom + 0.1 * sin(ang * 3 + Time); Rot += q1;");
+
+    ASSERT_TRUE(analysis.IsValid());
+    EXPECT_EQ(analysis.ReadVariables(), CodeAnalysis::VariableSet({"zoom", "ang", "time", "rot", "q1"}));
+    EXPECT_EQ(analysis.WrittenVariables(), CodeAnalysis::VariableSet({"zoom", "rot"}));
+}
+
+TEST(projectMCodeAnalysis, CommentsAreIgnored)
+{
+    CodeAnalysis const analysis("// megabuf(0) = 1;\n"
+                                "dx = 0.01; /* reg00 = rand(5); */ dy = -0.01;");
+
+    EXPECT_FALSE(analysis.UsesMemoryBuffers());
+    EXPECT_FALSE(analysis.WritesGlobalRegisters());
+    EXPECT_FALSE(analysis.UsesRandom());
+    EXPECT_EQ(analysis.WrittenVariables(), CodeAnalysis::VariableSet({"dx", "dy"}));
+}
+
+TEST(projectMCodeAnalysis, ComparisonsAreNotAssignments)
+{
+    CodeAnalysis const analysis("zoom = if(above(rad, 0.5) == 1, 1.1, zoom <= 0.9);");
+
+    EXPECT_EQ(analysis.WrittenVariables(), CodeAnalysis::VariableSet({"zoom"}));
+    EXPECT_EQ(analysis.ReadVariables(), CodeAnalysis::VariableSet({"rad", "zoom"}));
+}
+
+TEST(projectMCodeAnalysis, LocalVariables)
+{
+    CodeAnalysis const analysis("t = sin(rad); u = u + 1; v = ang * v; zoom = t; w += 1; s = 2; s = s * 2;");
+
+    EXPECT_EQ(analysis.LocalVariables(), CodeAnalysis::VariableSet({"t", "zoom", "s"}));
+}
+
+TEST(projectMCodeAnalysis, ConditionalAssignmentIsNotLocal)
+{
+    CodeAnalysis const analysis("t = if(above(x, 0.5), 1, 0); cond ? u = 1 : u = 2; if(t, v = 1, 0); rot = u + v;");
+
+    EXPECT_EQ(analysis.LocalVariables(), CodeAnalysis::VariableSet({"t", "rot"}));
+}
+
+TEST(projectMCodeAnalysis, ReferencedVariables)
+{
+    CodeAnalysis const analysis("zoom = zoom + 0.1 * sin(ang); dx += 0.01; megabuf(x) = 1;");
+
+    EXPECT_TRUE(analysis.References("zoom"));
+    EXPECT_TRUE(analysis.References("ang"));
+    EXPECT_TRUE(analysis.References("dx"));
+    EXPECT_TRUE(analysis.References("x"));
+    EXPECT_FALSE(analysis.References("y"));
+    EXPECT_FALSE(analysis.References("rot"));
+
+    CodeAnalysis const malformed("zoom = sin((x);");
+    EXPECT_TRUE(malformed.References("y"));
+}
+
+TEST(projectMCodeAnalysis, PureCodeIsParallelSafe)
+{
+    CodeAnalysis const analysis("d = sqrt(sqr(x - 0.5) + sqr(y - 0.5));\n"
+                                "zoom = zoom + 0.05 * sin(d * 10 + time) * bass_att;\n"
+                                "rot = rot + q1 * 0.1 * reg00;\n"
+                                "dx = $pi * 0.001; dy = .5e-3;");
+
+    ASSERT_TRUE(analysis.IsValid());
+    EXPECT_TRUE(analysis.IsParallelSafe(ResetVariables));
+}
+
+TEST(projectMCodeAnalysis, MemoryBuffersAreNotParallelSafe)
+{
+    EXPECT_FALSE(CodeAnalysis("zoom = megabuf(x * 100);").IsParallelSafe(ResetVariables));
+    EXPECT_FALSE(CodeAnalysis("gmegabuf(0) = zoom;").IsParallelSafe(ResetVariables));
+    EXPECT_FALSE(CodeAnalysis("zoom = buf[3];").IsParallelSafe(ResetVariables));
+    EXPECT_FALSE(CodeAnalysis("memset(0, 0, 100);").IsParallelSafe(ResetVariables));
+}
+
+TEST(projectMCodeAnalysis, GlobalRegisterWritesAreNotParallelSafe)
+{
+    CodeAnalysis const analysis("REG05 = reg05 + 1; zoom = reg05;");
+
+    EXPECT_TRUE(analysis.WritesGlobalRegisters());
+    EXPECT_FALSE(analysis.IsParallelSafe(ResetVariables));
+}
+
+TEST(projectMCodeAnalysis, RandomIsNotParallelSafe)
+{
+    EXPECT_FALSE(CodeAnalysis("dx = rand(10) * 0.001;").IsParallelSafe(ResetVariables));
+}
+
+TEST(projectMCodeAnalysis, CarriedOverStateIsNotParallelSafe)
+{
+    EXPECT_FALSE(CodeAnalysis("n = n + 1; rot = n * 0.001;").IsParallelSafe(ResetVariables));
+    EXPECT_FALSE(CodeAnalysis("q1 += 1; zoom = q1;").IsParallelSafe(ResetVariables));
+    EXPECT_FALSE(CodeAnalysis("zoom = t; t = x;").IsParallelSafe(ResetVariables));
+    EXPECT_FALSE(CodeAnalysis("time = time * 2;").IsParallelSafe(ResetVariables));
+}
+
+TEST(projectMCodeAnalysis, MalformedCodeIsNotParallelSafe)
+{
+    CodeAnalysis const unbalanced("zoom = sin((x);");
+    EXPECT_FALSE(unbalanced.IsValid());
+    EXPECT_FALSE(unbalanced.IsParallelSafe(ResetVariables));
+
+    CodeAnalysis const assign("assign(zoom, 2);");
+    EXPECT_FALSE(assign.IsValid());
+    EXPECT_FALSE(assign.IsParallelSafe(ResetVariables));
+}
@@ -0,0 +1,478 @@
+#include <gtest/gtest.h>
+
+#include <MilkdropPreset/BatchEvaluator.hpp>
+#include <MilkdropPreset/ExpressionJit.hpp>
+#include <MilkdropPreset/PresetFileParser.hpp>
+#include <Renderer/FileScanner.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+using libprojectM::MilkdropPreset::BatchEvaluator;
+using libprojectM::MilkdropPreset::ExpressionJit;
+using libprojectM::MilkdropPreset::ExpressionNode;
+using libprojectM::MilkdropPreset::ExpressionOperation;
+using libprojectM::MilkdropPreset::ExpressionTree;
+using libprojectM::MilkdropPreset::ExpressionWatchdog;
+using libprojectM::MilkdropPreset::PresetFileParser;
+
+namespace {
+
+/**
+ * Variable storage for JIT code not bound to an expression library context.
+ */
+class Variables
+{
+public:
+    auto Resolver() -> ExpressionJit::VariableResolver
+    {
+        return [this](const std::string& name) {
+            return &m_values[name];
+        };
+    }
+
+    auto operator[](const std::string& name) -> double&
+    {
+        return m_values[name];
+    }
+
+private:
+    std::map<std::string, double> m_values; //!< Node-based, so addresses stay valid.
+};
+
+void CollectVariableNames(const ExpressionNode& node, std::set<std::string>& names)
+{
+    if (node.operation == ExpressionOperation::Variable || node.operation == ExpressionOperation::Assign)
+    {
+        names.insert(node.name);
+    }
+
+    for (const auto& argument : node.arguments)
+    {
+        CollectVariableNames(*argument, names);
+    }
+}
+
+/**
+ * Compares bitwise, so 0.0 and -0.0 are different, but treats all NaN values as equal.
+ */
+auto SameValue(double left, double right) -> bool
+{
+    return (std::isnan(left) && std::isnan(right)) || std::memcmp(&left, &right, sizeof(double)) == 0;
+}
+
+} // namespace
+
+TEST(projectMExpressionJit, MatchesBatchEvaluator)
+{
+    if (!ExpressionJit::IsAvailable())
+    {
+        GTEST_SKIP() << "Native code generation is not available on this platform.";
+    }
+
+    const std::vector<std::string> codes{
+        "r = x + y * 2 - x / y;",
+        "r = x % y; s = -x; t = sqr(x) + sqrt(y) + abs(x);",
+        "r = x ^ y; s = pow(y, 2); t = atan2(x, y);",
+        "r = sin(x) + cos(y) + tan(x) + asin(0.5) + acos(0.25) + atan(y);",
+        "r = exp(x) + log(abs(y)) + log10(abs(x) + 1);",
+        "r = sign(x) + floor(y) + ceil(x) + min(x, y) + max(x, y);",
+        "r = (x == y) + (x != y) * 2 + (x === y) * 4 + (x !== y) * 8;",
+        "r = (x < y) + (x > y) * 2 + (x <= y) * 4 + (x >= y) * 8 + equal(x, y) * 16;",
+        "r = (x && y) + (x || y) * 2 + !x * 4 + bnot(y) * 8;",
+        "r = if(above(x, y), x, y); s = x > 0 ? (t = 1) : (t = 2);",
+        "r = x; r += y; r *= 2; r -= 1; r /= y; s = exec2(x = 3, x + y);"};
+
+    const std::vector<double> values{0.0, -0.0, 1.0, -1.5, 2.25, 7.0, 1e-301, -3e8,
+                                     std::numeric_limits<double>::quiet_NaN(),
+                                     std::numeric_limits<double>::infinity()};
+
+    for (const auto& code : codes)
+    {
+        ExpressionTree const tree(code);
+        ASSERT_NE(tree.Root(), nullptr) << code;
+
+        BatchEvaluator batch(*tree.Root(), {"x", "y", "r", "s", "t"});
+        Variables variables;
+        auto jit = ExpressionJit::Compile(*tree.Root(), variables.Resolver());
+        ASSERT_NE(jit, nullptr) << code;
+
+        for (auto x : values)
+        {
+            for (auto y : values)
+            {
+                for (const auto& name : {"x", "y", "r", "s", "t"})
+                {
+                    auto const initialValue = std::string(name) == "x" ? x : (std::string(name) == "y" ? y : 0.5);
+                    batch.Lanes(name)[0] = initialValue;
+                    variables[name] = initialValue;
+                }
+
+                batch.Execute(1);
+                jit->ExecuteNative();
+
+                for (const auto& name : {"x", "y", "r", "s", "t"})
+                {
+                    EXPECT_TRUE(SameValue(variables[name], batch.Lanes(name)[0]))
+                        << code << " with x = " << x << ", y = " << y << ": " << name << " is "
+                        << variables[name] << ", expected " << batch.Lanes(name)[0];
+                }
+            }
+        }
+    }
+}
+
+TEST(projectMExpressionJit, EvaluatesBranchesLazily)
+{
+    if (!ExpressionJit::IsAvailable())
+    {
+        GTEST_SKIP() << "Native code generation is not available on this platform.";
+    }
+
+    ExpressionTree const tree("if(above(x, 0), y = 1, z = 2); band(0, a = 5); bor(1, b = 5); c = band(x, d = 3);");
+    ASSERT_NE(tree.Root(), nullptr);
+
+    Variables variables;
+    auto jit = ExpressionJit::Compile(*tree.Root(), variables.Resolver());
+    ASSERT_NE(jit, nullptr);
+
+    variables["x"] = 1.0;
+    jit->ExecuteNative();
+
+    EXPECT_EQ(variables["y"], 1.0);
+    EXPECT_EQ(variables["z"], 0.0);
+    EXPECT_EQ(variables["a"], 0.0);
+    EXPECT_EQ(variables["b"], 0.0);
+    EXPECT_EQ(variables["c"], 1.0);
+    EXPECT_EQ(variables["d"], 3.0);
+
+    variables["x"] = -1.0;
+    variables["y"] = 0.0;
+    jit->ExecuteNative();
+
+    EXPECT_EQ(variables["y"], 0.0);
+    EXPECT_EQ(variables["z"], 2.0);
+}
+
+TEST(projectMExpressionJit, ExecutesLoops)
+{
+    if (!ExpressionJit::IsAvailable())
+    {
+        GTEST_SKIP() << "Native code generation is not available on this platform.";
+    }
+
+    ExpressionTree const tree("i = 0; s = 0; loop(n, s += i; i += 1);"
+                              "j = 0; while(j += 1; j < 5);"
+                              "k = 0; loop(3, loop(4, k += 1));"
+                              "w = 0; while(w += 1);",
+                              true);
+    ASSERT_NE(tree.Root(), nullptr);
+
+    Variables variables;
+    auto jit = ExpressionJit::Compile(*tree.Root(), variables.Resolver());
+    ASSERT_NE(jit, nullptr);
+
+    variables["n"] = 10.9;
+    EXPECT_TRUE(jit->ExecuteNative());
+
+    EXPECT_EQ(variables["i"], 10.0);
+    EXPECT_EQ(variables["s"], 45.0);
+    EXPECT_EQ(variables["j"], 5.0);
+    EXPECT_EQ(variables["k"], 12.0);
+    EXPECT_EQ(variables["w"], 1048576.0);
+
+    // The count is limited like in the expression library, while negative counts run no iterations.
+    variables["n"] = 1e9;
+    jit->ExecuteNative();
+    EXPECT_EQ(variables["i"], 1048576.0);
+
+    variables["n"] = -5.0;
+    jit->ExecuteNative();
+    EXPECT_EQ(variables["i"], 0.0);
+}
+
+TEST(projectMExpressionJit, AbortsLoopsAfterDeadline)
+{
+    if (!ExpressionJit::IsAvailable())
+    {
+        GTEST_SKIP() << "Native code generation is not available on this platform.";
+    }
+
+    // Without a deadline, this would run for about 10^12 iterations.
+    ExpressionTree const tree("before = 1; loop(1000000, loop(1000000, x += 1)); after = 1;", true);
+    ASSERT_NE(tree.Root(), nullptr);
+
+    Variables variables;
+    auto jit = ExpressionJit::Compile(*tree.Root(), variables.Resolver());
+    ASSERT_NE(jit, nullptr);
+
+    ExpressionWatchdog watchdog;
+    watchdog.StartFrame(ExpressionWatchdog::Clock::now() + std::chrono::milliseconds(5));
+
+    auto const start = ExpressionWatchdog::Clock::now();
+    EXPECT_FALSE(jit->ExecuteNative(&watchdog));
+    EXPECT_LT(ExpressionWatchdog::Clock::now() - start, std::chrono::seconds(1));
+
+    EXPECT_TRUE(watchdog.Expired());
+    EXPECT_EQ(variables["before"], 1.0);
+    EXPECT_GT(variables["x"], 0.0);
+    EXPECT_EQ(variables["after"], 0.0);
+
+    // Once expired, the next execution returns at the first check.
+    variables["x"] = 0.0;
+    EXPECT_FALSE(jit->ExecuteNative(&watchdog));
+    EXPECT_EQ(variables["x"], static_cast<double>(1000000 % 1024));
+}
+
+TEST(projectMExpressionJit, ReturnsNullIfVariableCantBeResolved)
+{
+    ExpressionTree const tree("x = y + 1;");
+    ASSERT_NE(tree.Root(), nullptr);
+
+    auto jit = ExpressionJit::Compile(*tree.Root(), [](const std::string&) -> double* {
+        return nullptr;
+    });
+
+    EXPECT_EQ(jit, nullptr);
+}
+
+TEST(projectMExpressionJit, ListsDistinctVariables)
+{
+    if (!ExpressionJit::IsAvailable())
+    {
+        GTEST_SKIP() << "Native code generation is not available on this platform.";
+    }
+
+    ExpressionTree const tree("x = y + 1; y = x * x; z = 2;");
+    ASSERT_NE(tree.Root(), nullptr);
+
+    Variables variables;
+    auto jit = ExpressionJit::Compile(*tree.Root(), variables.Resolver());
+    ASSERT_NE(jit, nullptr);
+
+    EXPECT_EQ(jit->Variables().size(), 3U);
+}
+
+TEST(projectMExpressionJit, RebindUsesOtherVariables)
+{
+    if (!ExpressionJit::IsAvailable())
+    {
+        GTEST_SKIP() << "Native code generation is not available on this platform.";
+    }
+
+    ExpressionTree const tree("x = y + 1; z = x * y;");
+    ASSERT_NE(tree.Root(), nullptr);
+
+    Variables variables;
+    auto jit = ExpressionJit::Compile(*tree.Root(), variables.Resolver());
+    ASSERT_NE(jit, nullptr);
+
+    Variables otherVariables;
+    auto rebound = jit->Rebind(otherVariables.Resolver());
+    ASSERT_NE(rebound, nullptr);
+    EXPECT_EQ(rebound->Variables().size(), 3U);
+
+    variables["y"] = 2.0;
+    otherVariables["y"] = 3.0;
+    rebound->ExecuteNative();
+
+    EXPECT_EQ(otherVariables["x"], 4.0);
+    EXPECT_EQ(otherVariables["z"], 12.0);
+    EXPECT_EQ(variables["x"], 0.0);
+
+    jit->ExecuteNative();
+
+    EXPECT_EQ(variables["z"], 6.0);
+    EXPECT_EQ(otherVariables["z"], 12.0);
+
+    EXPECT_EQ(jit->Rebind([](const std::string&) -> double* {
+        return nullptr;
+    }),
+              nullptr);
+}
+
+TEST(projectMExpressionJit, FallsBackToInterpreterOnMismatch)
+{
+    if (!ExpressionJit::IsAvailable() || sizeof(PRJM_EVAL_F) != sizeof(double))
+    {
+        GTEST_SKIP() << "Native code generation is not available on this platform.";
+    }
+
+    PRJM_EVAL_F globalRegisters[100]{};
+    auto* globalMemory = projectm_eval_memory_buffer_create();
+    auto* context = projectm_eval_context_create(globalMemory, &globalRegisters);
+    ExpressionWatchdog const watchdog;
+
+    // Native code compiled from different code than the interpreter code simulates a code generation bug.
+    auto* interpreterCode = projectm_eval_code_compile(context, "x = x + 2;");
+    ASSERT_NE(interpreterCode, nullptr);
+    auto jit = ExpressionJit::Compile("x = x + 1;", context);
+    ASSERT_NE(jit, nullptr);
+
+    auto* x = projectm_eval_context_register_variable(context, "x");
+    *x = 1.0;
+
+    jit->Execute(interpreterCode, 0.0, watchdog);
+    EXPECT_TRUE(jit->IsDisabled());
+    EXPECT_EQ(*x, 3.0);
+
+    jit->Execute(interpreterCode, 0.0, watchdog);
+    EXPECT_EQ(*x, 5.0);
+
+    projectm_eval_code_destroy(interpreterCode);
+    projectm_eval_context_destroy(context);
+    projectm_eval_memory_buffer_destroy(globalMemory);
+}
+
+TEST(projectMExpressionJit, ValidatesSampledFrames)
+{
+    if (!ExpressionJit::IsAvailable() || sizeof(PRJM_EVAL_F) != sizeof(double))
+    {
+        GTEST_SKIP() << "Native code generation is not available on this platform.";
+    }
+
+    PRJM_EVAL_F globalRegisters[100]{};
+    auto* globalMemory = projectm_eval_memory_buffer_create();
+    auto* context = projectm_eval_context_create(globalMemory, &globalRegisters);
+    ExpressionWatchdog const watchdog;
+
+    // Both only differ once y is set, so the mismatch is only found by a later validation.
+    auto* interpreterCode = projectm_eval_code_compile(context, "x = y * 2;");
+    ASSERT_NE(interpreterCode, nullptr);
+    auto jit = ExpressionJit::Compile("x = y * 3;", context);
+    ASSERT_NE(jit, nullptr);
+
+    auto* y = projectm_eval_context_register_variable(context, "y");
+
+    for (uint32_t execution = 0; execution < ExpressionJit::ValidatedExecutions; execution++)
+    {
+        jit->Execute(interpreterCode, 0.0, watchdog);
+    }
+    ASSERT_FALSE(jit->IsDisabled());
+
+    // No more checks in the current frame and the following unsampled frames.
+    *y = 1.0;
+    for (int execution = 0; execution < 5000; execution++)
+    {
+        jit->Execute(interpreterCode, 0.0, watchdog);
+    }
+    for (uint32_t frame = 1; frame < ExpressionJit::ValidationFrameInterval; frame++)
+    {
+        jit->Execute(interpreterCode, static_cast<double>(frame), watchdog);
+    }
+    EXPECT_FALSE(jit->IsDisabled());
+
+    // One execution of the next sampled frame is checked.
+    jit->Execute(interpreterCode, static_cast<double>(ExpressionJit::ValidationFrameInterval), watchdog);
+    EXPECT_TRUE(jit->IsDisabled());
+
+    projectm_eval_code_destroy(interpreterCode);
+    projectm_eval_context_destroy(context);
+    projectm_eval_memory_buffer_destroy(globalMemory);
+}
+
+/**
+ * Runs the expression code of all bundled presets for a number of frames, once with the interpreter
+ * and once as native code, starting from the same variable values, and compares the final values
+ * of all variables used by the code.
+ */
+TEST(projectMExpressionJit, BundledPresetsMatchInterpreter)
+{
+    if (!ExpressionJit::IsAvailable() || sizeof(PRJM_EVAL_F) != sizeof(double))
+    {
+        GTEST_SKIP() << "Native code generation is not available on this platform.";
+    }
+
+    constexpr int Frames = 8;
+
+    std::vector<std::string> presetFiles;
+    std::vector<std::string> extensions{".milk"};
+    libprojectM::Renderer::FileScanner scanner({PROJECTM_PRESETS_DIR}, extensions);
+    scanner.Scan([&presetFiles](const std::string& path, const std::string&) {
+        presetFiles.push_back(path);
+    });
+    ASSERT_FALSE(presetFiles.empty());
+
+    size_t compiledCount{};
+    for (const auto& presetFile : presetFiles)
+    {
+        PresetFileParser parser;
+        if (!parser.Read(presetFile))
+        {
+            continue;
+        }
+
+        std::vector<std::string> codes{parser.GetCode("per_frame_"), parser.GetCode("per_pixel_")};
+        for (int index = 0; index < 4; index++)
+        {
+            codes.push_back(parser.GetCode("wave_" + std::to_string(index) + "_per_frame"));
+            codes.push_back(parser.GetCode("wave_" + std::to_string(index) + "_per_point"));
+            codes.push_back(parser.GetCode("shape_" + std::to_string(index) + "_per_frame"));
+        }
+
+        for (const auto& code : codes)
+        {
+            ExpressionTree const tree(code, true);
+            if (code.empty() || tree.Root() == nullptr)
+            {
+                continue;
+            }
+
+            PRJM_EVAL_F interpreterRegisters[100]{};
+            PRJM_EVAL_F nativeRegisters[100]{};
+            auto* globalMemory = projectm_eval_memory_buffer_create();
+            auto* interpreterContext = projectm_eval_context_create(globalMemory, &interpreterRegisters);
+            auto* nativeContext = projectm_eval_context_create(globalMemory, &nativeRegisters);
+
+            auto* interpreterCode = projectm_eval_code_compile(interpreterContext, code.c_str());
+            auto jit = interpreterCode != nullptr ? ExpressionJit::Compile(code, nativeContext) : nullptr;
+            if (jit != nullptr)
+            {
+                compiledCount++;
+
+                // Start from the same, arbitrary but deterministic, variable values.
+                std::set<std::string> names;
+                CollectVariableNames(*tree.Root(), names);
+                double seed = 0.125;
+                for (const auto& name : names)
+                {
+                    seed = std::fmod(seed * 7.31 + 0.377, 4.0) - 2.0;
+                    *projectm_eval_context_register_variable(interpreterContext, name.c_str()) = seed;
+                    *projectm_eval_context_register_variable(nativeContext, name.c_str()) = seed;
+                }
+
+                for (int frame = 0; frame < Frames; frame++)
+                {
+                    projectm_eval_code_execute(interpreterCode);
+                    jit->ExecuteNative();
+                }
+
+                for (const auto& name : names)
+                {
+                    auto const expected = *projectm_eval_context_register_variable(interpreterContext, name.c_str());
+                    auto const actual = *projectm_eval_context_register_variable(nativeContext, name.c_str());
+                    EXPECT_TRUE(SameValue(expected, actual))
+                        << presetFile << "\n"
+                        << code << "\n"
+                        << name << " is " << actual << ", expected " << expected;
+                }
+            }
+
+            if (interpreterCode != nullptr)
+            {
+                projectm_eval_code_destroy(interpreterCode);
+            }
+            projectm_eval_context_destroy(nativeContext);
+            projectm_eval_context_destroy(interpreterContext);
+            projectm_eval_memory_buffer_destroy(globalMemory);
+        }
+    }
+
+    EXPECT_GT(compiledCount, 0U);
+}
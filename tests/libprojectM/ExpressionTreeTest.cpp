@@ -0,0 +1,262 @@
+#include <gtest/gtest.h>
+
+#include <MilkdropPreset/BatchEvaluator.hpp>
+#include <MilkdropPreset/ExpressionTree.hpp>
+#include <MilkdropPreset/PresetFileParser.hpp>
+#include <Renderer/FileScanner.hpp>
+
+#include <projectm-eval.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <regex>
+#include <set>
+#include <string>
+#include <vector>
+
+using libprojectM::MilkdropPreset::BatchEvaluator;
+using libprojectM::MilkdropPreset::ExpressionOperation;
+using libprojectM::MilkdropPreset::ExpressionTree;
+using libprojectM::MilkdropPreset::PresetFileParser;
+
+namespace {
+
+/**
+ * Returns all names in the source code which aren't followed by an opening parenthesis.
+ * Also finds names the parser might have missed, e.g. in a dropped statement.
+ */
+auto SourceVariableNames(const std::string& code) -> std::vector<std::string>
+{
+    static const std::regex namePattern(R"((^|[^A-Za-z0-9_.$])([A-Za-z_][A-Za-z0-9_]*)(?!\s*\())");
+
+    std::set<std::string> names;
+    for (auto match = std::sregex_iterator(code.begin(), code.end(), namePattern); match != std::sregex_iterator(); ++match)
+    {
+        auto name = (*match)[2].str();
+        std::transform(name.begin(), name.end(), name.begin(), [](unsigned char character) {
+            return static_cast<char>(std::tolower(character));
+        });
+        names.insert(name);
+    }
+    return {names.begin(), names.end()};
+}
+
+/**
+ * Compares bitwise, so 0.0 and -0.0 are different, but treats all NaN values as equal.
+ */
+auto SameValue(double left, double right) -> bool
+{
+    return (std::isnan(left) && std::isnan(right)) || std::memcmp(&left, &right, sizeof(double)) == 0;
+}
+
+} // namespace
+
+TEST(projectMExpressionTree, RootIsSequence)
+{
+    ExpressionTree const tree("zoom = 1.5");
+
+    ASSERT_NE(tree.Root(), nullptr);
+    EXPECT_EQ(tree.Root()->operation, ExpressionOperation::Sequence);
+    ASSERT_EQ(tree.Root()->arguments.size(), 1);
+
+    const auto& assignment = *tree.Root()->arguments[0];
+    EXPECT_EQ(assignment.operation, ExpressionOperation::Assign);
+    EXPECT_EQ(assignment.name, "zoom");
+    ASSERT_EQ(assignment.arguments.size(), 1);
+    EXPECT_EQ(assignment.arguments[0]->operation, ExpressionOperation::Constant);
+    EXPECT_DOUBLE_EQ(assignment.arguments[0]->value, 1.5);
+}
+
+TEST(projectMExpressionTree, OperatorPrecedence)
+{
+    ExpressionTree const tree("a = b + c * d ^ 2");
+
+    ASSERT_NE(tree.Root(), nullptr);
+    const auto& add = *tree.Root()->arguments[0]->arguments[0];
+    ASSERT_EQ(add.operation, ExpressionOperation::Add);
+    EXPECT_EQ(add.arguments[0]->name, "b");
+
+    const auto& multiply = *add.arguments[1];
+    ASSERT_EQ(multiply.operation, ExpressionOperation::Multiply);
+    EXPECT_EQ(multiply.arguments[0]->name, "c");
+    EXPECT_EQ(multiply.arguments[1]->operation, ExpressionOperation::Power);
+}
+
+TEST(projectMExpressionTree, CompoundAssignment)
+{
+    ExpressionTree const tree("rot += 0.1;");
+
+    ASSERT_NE(tree.Root(), nullptr);
+    const auto& assignment = *tree.Root()->arguments[0];
+    ASSERT_EQ(assignment.operation, ExpressionOperation::Assign);
+    EXPECT_EQ(assignment.name, "rot");
+
+    const auto& add = *assignment.arguments[0];
+    ASSERT_EQ(add.operation, ExpressionOperation::Add);
+    EXPECT_EQ(add.arguments[0]->operation, ExpressionOperation::Variable);
+    EXPECT_EQ(add.arguments[0]->name, "rot");
+}
+
+TEST(projectMExpressionTree, FunctionsAreMappedToOperations)
+{
+    ExpressionTree const tree("x = if(above(rad, 0.5), sin(ang), bnot(y)); y = a ? b : c");
+
+    ASSERT_NE(tree.Root(), nullptr);
+    ASSERT_EQ(tree.Root()->arguments.size(), 2);
+
+    const auto& conditional = *tree.Root()->arguments[0]->arguments[0];
+    ASSERT_EQ(conditional.operation, ExpressionOperation::If);
+    ASSERT_EQ(conditional.arguments.size(), 3);
+    EXPECT_EQ(conditional.arguments[0]->operation, ExpressionOperation::Greater);
+    EXPECT_EQ(conditional.arguments[1]->operation, ExpressionOperation::Sin);
+    EXPECT_EQ(conditional.arguments[2]->operation, ExpressionOperation::Not);
+
+    EXPECT_EQ(tree.Root()->arguments[1]->arguments[0]->operation, ExpressionOperation::If);
+}
+
+TEST(projectMExpressionTree, Constants)
+{
+    ExpressionTree const tree("a = $PI; b = $x10; c = .25");
+
+    ASSERT_NE(tree.Root(), nullptr);
+    EXPECT_DOUBLE_EQ(tree.Root()->arguments[0]->arguments[0]->value, 3.14159265358979323846);
+    EXPECT_DOUBLE_EQ(tree.Root()->arguments[1]->arguments[0]->value, 16.0);
+    EXPECT_DOUBLE_EQ(tree.Root()->arguments[2]->arguments[0]->value, 0.25);
+}
+
+TEST(projectMExpressionTree, UnsupportedCode)
+{
+    EXPECT_EQ(ExpressionTree("megabuf(0) = 1").Root(), nullptr);
+    EXPECT_EQ(ExpressionTree("x = rand(10)").Root(), nullptr);
+    EXPECT_EQ(ExpressionTree("loop(10, x += 1)").Root(), nullptr);
+    EXPECT_EQ(ExpressionTree("x = sin(1, 2)").Root(), nullptr);
+    EXPECT_EQ(ExpressionTree("x = (1 + 2").Root(), nullptr);
+    EXPECT_EQ(ExpressionTree("1 = x").Root(), nullptr);
+}
+
+TEST(projectMExpressionTree, LoopsOnlyParsedIfAllowed)
+{
+    EXPECT_EQ(ExpressionTree("while(x += 1; x < 10)").Root(), nullptr);
+
+    ExpressionTree const tree("loop(10, x += 1); while(x -= 1; x > 0)", true);
+
+    ASSERT_NE(tree.Root(), nullptr);
+    ASSERT_EQ(tree.Root()->arguments.size(), 2);
+
+    const auto& loop = *tree.Root()->arguments[0];
+    ASSERT_EQ(loop.operation, ExpressionOperation::Loop);
+    ASSERT_EQ(loop.arguments.size(), 2);
+    EXPECT_EQ(loop.arguments[0]->operation, ExpressionOperation::Constant);
+    EXPECT_EQ(loop.arguments[1]->operation, ExpressionOperation::Assign);
+
+    const auto& whileLoop = *tree.Root()->arguments[1];
+    ASSERT_EQ(whileLoop.operation, ExpressionOperation::While);
+    ASSERT_EQ(whileLoop.arguments.size(), 1);
+    EXPECT_EQ(whileLoop.arguments[0]->operation, ExpressionOperation::Sequence);
+
+    EXPECT_EQ(ExpressionTree("loop(10)", true).Root(), nullptr);
+}
+
+/**
+ * ExpressionJit, BatchEvaluator and GlslTranslator use this parser instead of the expression
+ * library's parser. Runs the code of all bundled presets with both, starting from several sets of
+ * variable values, and compares the values of all names in the code, so any difference in parsing,
+ * e.g. operator precedence or dropped statements, makes the results differ.
+ */
+TEST(projectMExpressionTree, BundledPresetsParseLikeExpressionLibrary)
+{
+    if (sizeof(PRJM_EVAL_F) != sizeof(double))
+    {
+        GTEST_SKIP() << "The expression library uses single precision.";
+    }
+
+    constexpr int Frames = 4;
+    constexpr int ValueSets = 3;
+
+    std::vector<std::string> presetFiles;
+    std::vector<std::string> extensions{".milk"};
+    libprojectM::Renderer::FileScanner scanner({PROJECTM_PRESETS_DIR}, extensions);
+    scanner.Scan([&presetFiles](const std::string& path, const std::string&) {
+        presetFiles.push_back(path);
+    });
+    ASSERT_FALSE(presetFiles.empty());
+
+    size_t comparedCount{};
+    for (const auto& presetFile : presetFiles)
+    {
+        PresetFileParser parser;
+        if (!parser.Read(presetFile))
+        {
+            continue;
+        }
+
+        std::vector<std::string> codes{parser.GetCode("per_frame_"), parser.GetCode("per_pixel_")};
+        for (int index = 0; index < 4; index++)
+        {
+            codes.push_back(parser.GetCode("wave_" + std::to_string(index) + "_per_frame"));
+            codes.push_back(parser.GetCode("wave_" + std::to_string(index) + "_per_point"));
+            codes.push_back(parser.GetCode("shape_" + std::to_string(index) + "_per_frame"));
+        }
+
+        for (const auto& code : codes)
+        {
+            ExpressionTree const tree(code);
+            if (code.empty() || tree.Root() == nullptr)
+            {
+                continue;
+            }
+
+            auto const names = SourceVariableNames(code);
+
+            for (int valueSet = 0; valueSet < ValueSets; valueSet++)
+            {
+                PRJM_EVAL_F registers[100]{};
+                auto* globalMemory = projectm_eval_memory_buffer_create();
+                auto* context = projectm_eval_context_create(globalMemory, &registers);
+                auto* interpreterCode = projectm_eval_code_compile(context, code.c_str());
+                if (interpreterCode == nullptr)
+                {
+                    projectm_eval_context_destroy(context);
+                    projectm_eval_memory_buffer_destroy(globalMemory);
+                    break;
+                }
+
+                BatchEvaluator evaluator(*tree.Root(), names);
+
+                // Arbitrary but deterministic values, different for each set.
+                double seed = 0.125 + 0.25 * valueSet;
+                for (const auto& name : names)
+                {
+                    seed = std::fmod(seed * 7.31 + 0.377, 4.0) - 2.0;
+                    *projectm_eval_context_register_variable(context, name.c_str()) = seed;
+                    evaluator.Lanes(name)[0] = seed;
+                }
+
+                for (int frame = 0; frame < Frames; frame++)
+                {
+                    projectm_eval_code_execute(interpreterCode);
+                    evaluator.Execute(1);
+                }
+
+                for (const auto& name : names)
+                {
+                    auto const expected = *projectm_eval_context_register_variable(context, name.c_str());
+                    auto const actual = evaluator.Lanes(name)[0];
+                    EXPECT_TRUE(SameValue(expected, actual))
+                        << presetFile << "\n"
+                        << code << "\n"
+                        << name << " is " << actual << ", expected " << expected;
+                }
+                comparedCount++;
+
+                projectm_eval_code_destroy(interpreterCode);
+                projectm_eval_context_destroy(context);
+                projectm_eval_memory_buffer_destroy(globalMemory);
+            }
+        }
+    }
+
+    EXPECT_GT(comparedCount, 0U);
+}
@@ -0,0 +1,90 @@
+#include <gtest/gtest.h>
+
+#include <MilkdropPreset/ExpressionWatchdog.hpp>
+
+#include <chrono>
+#include <thread>
+
+using libprojectM::MilkdropPreset::ExpressionWatchdog;
+
+namespace {
+
+auto DeadlineIn(std::chrono::milliseconds budget) -> ExpressionWatchdog::Clock::time_point
+{
+    return ExpressionWatchdog::Clock::now() + budget;
+}
+
+} // namespace
+
+TEST(projectMExpressionWatchdog, DisabledWithoutBudget)
+{
+    ExpressionWatchdog watchdog;
+    watchdog.StartFrame(ExpressionWatchdog::Clock::time_point::max());
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+
+    EXPECT_FALSE(watchdog.CheckExpired());
+    EXPECT_FALSE(watchdog.Expired());
+}
+
+TEST(projectMExpressionWatchdog, ExpiresAfterBudget)
+{
+    ExpressionWatchdog watchdog;
+    watchdog.StartFrame(DeadlineIn(std::chrono::seconds(10)));
+
+    EXPECT_FALSE(watchdog.CheckExpired());
+
+    watchdog.StartFrame(DeadlineIn(std::chrono::milliseconds(1)));
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+
+    // Only a check marks the frame as cut short.
+    EXPECT_FALSE(watchdog.Expired());
+    EXPECT_TRUE(watchdog.CheckExpired());
+    EXPECT_TRUE(watchdog.Expired());
+}
+
+TEST(projectMExpressionWatchdog, StaysExpiredInFollowingFrames)
+{
+    ExpressionWatchdog watchdog;
+    watchdog.StartFrame(DeadlineIn(std::chrono::milliseconds(1)));
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    ASSERT_TRUE(watchdog.CheckExpired());
+
+    watchdog.StartFrame(DeadlineIn(std::chrono::seconds(10)));
+
+    EXPECT_TRUE(watchdog.Expired());
+    EXPECT_TRUE(watchdog.CheckExpired());
+}
+
+TEST(projectMExpressionWatchdog, DisablingResetsExpiration)
+{
+    ExpressionWatchdog watchdog;
+    watchdog.StartFrame(DeadlineIn(std::chrono::milliseconds(1)));
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    ASSERT_TRUE(watchdog.CheckExpired());
+
+    watchdog.StartFrame(ExpressionWatchdog::Clock::time_point::max());
+
+    EXPECT_FALSE(watchdog.Expired());
+    EXPECT_FALSE(watchdog.CheckExpired());
+
+    watchdog.StartFrame(DeadlineIn(std::chrono::seconds(10)));
+
+    EXPECT_FALSE(watchdog.CheckExpired());
+}
+
+TEST(projectMExpressionWatchdog, PresetsShareFrameDeadline)
+{
+    // During a transition, both presets are rendered with the same deadline. Time used by the
+    // first preset isn't available to the second one.
+    auto const deadline = DeadlineIn(std::chrono::milliseconds(5));
+
+    ExpressionWatchdog firstPreset;
+    firstPreset.StartFrame(deadline);
+    EXPECT_FALSE(firstPreset.CheckExpired());
+    std::this_thread::sleep_for(std::chrono::milliseconds(6));
+
+    ExpressionWatchdog secondPreset;
+    secondPreset.StartFrame(deadline);
+    EXPECT_TRUE(secondPreset.CheckExpired());
+}
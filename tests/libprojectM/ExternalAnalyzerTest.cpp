@@ -0,0 +1,93 @@
+#include "Audio/ExternalAnalyzer.hpp"
+#include "Audio/Loudness.hpp"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <array>
+#include <vector>
+
+using namespace libprojectM::Audio;
+
+TEST(projectMExternalAnalyzer, NoDataByDefault)
+{
+    ExternalAnalyzer analyzer;
+
+    EXPECT_FALSE(analyzer.HasPendingData());
+    EXPECT_EQ(analyzer.TakeFrameAudioData(1.0 / 60.0, 0, 1.0f), nullptr);
+}
+
+TEST(projectMExternalAnalyzer, SuppliedDataIsUsedOnce)
+{
+    ExternalAnalyzer analyzer;
+
+    std::vector<float> waveformLeft(WaveformSamples);
+    std::vector<float> waveformRight(WaveformSamples);
+    for (size_t i = 0; i < WaveformSamples; i++)
+    {
+        waveformLeft[i] = static_cast<float>(i);
+        waveformRight[i] = -static_cast<float>(i);
+    }
+
+    std::vector<float> spectrumLeft(SpectrumSamples, 2.0f);
+    std::vector<float> spectrumRight(SpectrumSamples, 3.0f);
+
+    analyzer.SetWaveform(waveformLeft.data(), waveformRight.data());
+    analyzer.SetSpectrum(spectrumLeft.data(), spectrumRight.data());
+    analyzer.SetBeatValues(1.0f, 1.1f, 1.2f, 0.9f, 0.8f, 0.7f);
+    EXPECT_TRUE(analyzer.HasPendingData());
+
+    auto const data = analyzer.TakeFrameAudioData(1.0 / 60.0, 0, 2.0f);
+    ASSERT_NE(data, nullptr);
+    EXPECT_FALSE(analyzer.HasPendingData());
+
+    for (size_t i = 0; i < WaveformSamples; i++)
+    {
+        EXPECT_FLOAT_EQ(data->waveformLeft[i], waveformLeft[i]);
+        EXPECT_FLOAT_EQ(data->waveformRight[i], waveformRight[i]);
+    }
+    for (size_t i = 0; i < SpectrumSamples; i++)
+    {
+        EXPECT_FLOAT_EQ(data->spectrumLeft[i], 2.0f);
+        EXPECT_FLOAT_EQ(data->spectrumRight[i], 3.0f);
+    }
+
+    EXPECT_FLOAT_EQ(data->Bass(), 2.0f);
+    EXPECT_FLOAT_EQ(data->Mid(), 2.2f);
+    EXPECT_FLOAT_EQ(data->Treb(), 2.4f);
+    EXPECT_FLOAT_EQ(data->BassAtt(), 1.8f);
+    EXPECT_FLOAT_EQ(data->MidAtt(), 1.6f);
+    EXPECT_FLOAT_EQ(data->TrebAtt(), 1.4f);
+    EXPECT_FLOAT_EQ(data->vol, (1.0f + 1.1f + 1.2f) * 0.333f);
+
+    EXPECT_EQ(analyzer.TakeFrameAudioData(1.0 / 60.0, 1, 2.0f), nullptr);
+}
+
+TEST(projectMExternalAnalyzer, BeatValuesAreCalculatedFromSpectrum)
+{
+    ExternalAnalyzer analyzer;
+    Loudness bass{Loudness::Band::Bass};
+    Loudness treble{Loudness::Band::Treble};
+
+    std::array<float, SpectrumSamples> spectrum{};
+    for (uint32_t frame = 0; frame < 10; frame++)
+    {
+        // Alternating loud and quiet bass.
+        spectrum.fill(1.0f);
+        std::fill(spectrum.begin(), spectrum.begin() + 40, frame % 2 == 0 ? 10.0f : 1.0f);
+
+        analyzer.SetSpectrum(spectrum.data(), spectrum.data());
+        auto const data = analyzer.TakeFrameAudioData(1.0 / 60.0, frame, 1.0f);
+        ASSERT_NE(data, nullptr);
+
+        bass.Update(spectrum, 1.0 / 60.0, frame);
+        treble.Update(spectrum, 1.0 / 60.0, frame);
+
+        EXPECT_FLOAT_EQ(data->bass, bass.CurrentRelative()) << "Frame " << frame;
+        EXPECT_FLOAT_EQ(data->bassAtt, bass.AverageRelative()) << "Frame " << frame;
+        EXPECT_FLOAT_EQ(data->treb, treble.CurrentRelative()) << "Frame " << frame;
+
+        // No waveform supplied, so it's silent.
+        EXPECT_FLOAT_EQ(data->waveformLeft[0], 0.0f);
+    }
+}
@@ -0,0 +1,101 @@
+#include "Audio/AnalysisThread.hpp"
+#include "Audio/FrameAudioData.hpp"
+#include "Audio/PCM.hpp"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <set>
+#include <type_traits>
+#include <vector>
+
+using namespace libprojectM::Audio;
+
+static_assert(!std::is_copy_constructible<FrameAudioData>::value, "FrameAudioData must not be copyable");
+static_assert(!std::is_copy_assignable<FrameAudioData>::value, "FrameAudioData must not be copyable");
+
+namespace {
+
+/**
+ * Simulates the consumers of a frame's audio data, e.g. the active and transitioning presets,
+ * which keep a reference to the snapshot until the next frame.
+ */
+struct Consumer {
+    FrameAudioData::Ptr audioData;
+};
+
+void AddSamples(PCM& pcm, uint32_t frame)
+{
+    std::vector<float> samples(AudioBufferSamples * 2);
+    for (size_t i = 0; i < samples.size(); i++)
+    {
+        samples[i] = static_cast<float>((frame * 7 + i) % 64) / 64.0f - 0.5f;
+    }
+    pcm.Add(samples.data(), 2, AudioBufferSamples);
+}
+
+} // namespace
+
+TEST(projectMFrameAudioData, BeatSensitivityIsAppliedByAccessors)
+{
+    auto pcm = std::make_unique<PCM>();
+    AddSamples(*pcm, 0);
+    pcm->UpdateFrameAudioData(1.0 / 60.0, 0);
+
+    auto const unscaled = pcm->GetFrameAudioData();
+    auto const scaled = pcm->GetFrameAudioData(2.0f);
+
+    EXPECT_FLOAT_EQ(unscaled->beatSensitivity, 1.0f);
+    EXPECT_FLOAT_EQ(scaled->beatSensitivity, 2.0f);
+
+    // Raw values are not modified, only the accessors apply the sensitivity.
+    EXPECT_EQ(scaled->bass, unscaled->bass);
+    EXPECT_EQ(scaled->volAtt, unscaled->volAtt);
+
+    EXPECT_FLOAT_EQ(scaled->Bass(), unscaled->bass * 2.0f);
+    EXPECT_FLOAT_EQ(scaled->BassAtt(), unscaled->bassAtt * 2.0f);
+    EXPECT_FLOAT_EQ(scaled->Mid(), unscaled->mid * 2.0f);
+    EXPECT_FLOAT_EQ(scaled->MidAtt(), unscaled->midAtt * 2.0f);
+    EXPECT_FLOAT_EQ(scaled->Treb(), unscaled->treb * 2.0f);
+    EXPECT_FLOAT_EQ(scaled->TrebAtt(), unscaled->trebAtt * 2.0f);
+    EXPECT_FLOAT_EQ(scaled->Vol(), unscaled->vol * 2.0f);
+    EXPECT_FLOAT_EQ(scaled->VolAtt(), unscaled->volAtt * 2.0f);
+}
+
+TEST(projectMFrameAudioData, OneSnapshotPerFrame)
+{
+    static constexpr uint32_t frameCount = 20;
+
+    auto pcm = std::make_unique<PCM>();
+    AnalysisThread thread(*pcm);
+
+    // Keep all snapshots alive, so no address is reused and each distinct pointer is a distinct copy.
+    std::vector<FrameAudioData::Ptr> allSnapshots;
+    std::set<const FrameAudioData*> distinctSnapshots;
+
+    for (uint32_t frame = 0; frame < frameCount; frame++)
+    {
+        AddSamples(*pcm, frame);
+
+        ASSERT_TRUE(thread.Start());
+        thread.RequestUpdate(1.0 / 60.0, frame, 1.5f);
+        thread.Stop();
+
+        // Hand the frame's data to several consumers and query it repeatedly.
+        Consumer activePreset{thread.LatestFrameAudioData()};
+        Consumer transitioningPreset{thread.LatestFrameAudioData()};
+        Consumer transition{activePreset.audioData};
+
+        EXPECT_EQ(activePreset.audioData, transitioningPreset.audioData);
+        EXPECT_EQ(activePreset.audioData, transition.audioData);
+
+        // Thread, three consumers and this local copy of the pointer.
+        auto const snapshot = thread.LatestFrameAudioData();
+        EXPECT_EQ(snapshot.use_count(), 5);
+
+        distinctSnapshots.insert(snapshot.get());
+        allSnapshots.push_back(snapshot);
+    }
+
+    EXPECT_EQ(distinctSnapshots.size(), frameCount);
+}
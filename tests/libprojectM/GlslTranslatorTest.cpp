@@ -0,0 +1,77 @@
+#include <gtest/gtest.h>
+
+#include <MilkdropPreset/GlslTranslator.hpp>
+
+using libprojectM::MilkdropPreset::ExpressionTree;
+using libprojectM::MilkdropPreset::GlslTranslator;
+
+namespace {
+
+const std::vector<std::string> Inputs{"x", "y"};
+const std::vector<std::string> Outputs{"zoom", "rot"};
+
+} // namespace
+
+TEST(projectMGlslTranslator, GeneratesFunction)
+{
+    ExpressionTree const tree("d = sqrt(sqr(x - 0.5) + sqr(y - 0.5)); zoom = zoom + d * q1;");
+    ASSERT_NE(tree.Root(), nullptr);
+
+    GlslTranslator const translator(*tree.Root(), "PerPixelEquations", Inputs, Outputs);
+
+    ASSERT_TRUE(translator.IsValid());
+    auto const& source = translator.Source();
+    EXPECT_NE(source.find("void PerPixelEquations(float v_x, float v_y, out float v_zoom, out float v_rot)"), std::string::npos);
+    EXPECT_NE(source.find("uniform float u_q1;"), std::string::npos);
+    EXPECT_NE(source.find("v_zoom = u_zoom;"), std::string::npos);
+    EXPECT_NE(source.find("float v_d = 0.0;"), std::string::npos);
+}
+
+TEST(projectMGlslTranslator, Uniforms)
+{
+    ExpressionTree const tree("zoom = zoom * q1 + x; t = time;");
+    ASSERT_NE(tree.Root(), nullptr);
+
+    GlslTranslator const translator(*tree.Root(), "PerPixelEquations", Inputs, Outputs);
+
+    ASSERT_TRUE(translator.IsValid());
+    EXPECT_EQ(translator.Uniforms(), std::vector<std::string>({"zoom", "rot", "q1", "time"}));
+    EXPECT_EQ(GlslTranslator::UniformName("q1"), "u_q1");
+}
+
+TEST(projectMGlslTranslator, ConstantsUseClassicLocale)
+{
+    ExpressionTree const tree("zoom = 1.5;");
+    ASSERT_NE(tree.Root(), nullptr);
+
+    GlslTranslator const translator(*tree.Root(), "PerPixelEquations", Inputs, Outputs);
+
+    ASSERT_TRUE(translator.IsValid());
+    EXPECT_NE(translator.Source().find("(v_zoom = 1.500000000e+00)"), std::string::npos);
+}
+
+TEST(projectMGlslTranslator, UntranslatableCode)
+{
+    ExpressionTree const hugeConstant("zoom = 1e300;");
+    ASSERT_NE(hugeConstant.Root(), nullptr);
+    EXPECT_FALSE(GlslTranslator(*hugeConstant.Root(), "PerPixelEquations", Inputs, Outputs).IsValid());
+
+    ExpressionTree const reservedName("my__var = 1; zoom = my__var;");
+    ASSERT_NE(reservedName.Root(), nullptr);
+    EXPECT_FALSE(GlslTranslator(*reservedName.Root(), "PerPixelEquations", Inputs, Outputs).IsValid());
+}
+
+TEST(projectMGlslTranslator, DomainSensitiveFunctionsUseWrappers)
+{
+    ExpressionTree const tree("zoom = asin(x) + acos(y) + log(x) + log10(y) + exp(x) + pow(x, y) + x % y + x / y;");
+    ASSERT_NE(tree.Root(), nullptr);
+
+    GlslTranslator const translator(*tree.Root(), "PerPixelEquations", Inputs, Outputs);
+
+    ASSERT_TRUE(translator.IsValid());
+    auto const& source = translator.Source();
+    for (const auto* wrapper : {"pp_asin(v_x)", "pp_acos(v_y)", "pp_log(v_x)", "pp_log10(v_y)", "pp_exp(v_x)", "pp_pow(v_x, v_y)", "pp_mod(v_x, v_y)", "pp_div(v_x, v_y)"})
+    {
+        EXPECT_NE(source.find(wrapper), std::string::npos) << wrapper;
+    }
+}
@@ -0,0 +1,395 @@
+#include "Audio/PCM.hpp"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace libprojectM::Audio;
+
+TEST(projectMPCM, AddAndUpdateSingleThread)
+{
+    auto pcm = std::make_unique<PCM>();
+
+    std::vector<float> samples(AudioBufferSamples * 2);
+    for (size_t i = 0; i < AudioBufferSamples; i++)
+    {
+        samples[i * 2] = static_cast<float>(i + 1) / 1024.0f;
+        samples[i * 2 + 1] = -static_cast<float>(i + 1) / 1024.0f;
+    }
+
+    pcm->Add(samples.data(), 2, AudioBufferSamples);
+    pcm->UpdateFrameAudioData(1.0 / 60.0, 0);
+
+    auto const data = pcm->GetFrameAudioData();
+
+    // First frame is never shifted by the aligner.
+    for (size_t i = 0; i < WaveformSamples; i++)
+    {
+        EXPECT_FLOAT_EQ(data->waveformLeft[i], 128.0f * static_cast<float>(i + 1) / 1024.0f);
+        EXPECT_FLOAT_EQ(data->waveformRight[i], -data->waveformLeft[i]);
+    }
+}
+
+TEST(projectMPCM, MonoInputIsDuplicated)
+{
+    auto pcm = std::make_unique<PCM>();
+
+    std::vector<int16_t> samples(AudioBufferSamples, 16384);
+
+    pcm->Add(samples.data(), 1, samples.size());
+    pcm->UpdateFrameAudioData(1.0 / 60.0, 0);
+
+    auto const data = pcm->GetFrameAudioData();
+
+    for (size_t i = 0; i < WaveformSamples; i++)
+    {
+        EXPECT_FLOAT_EQ(data->waveformLeft[i], 64.0f);
+        EXPECT_FLOAT_EQ(data->waveformRight[i], 64.0f);
+    }
+}
+
+TEST(projectMPCM, ConcurrentProducerAndConsumer)
+{
+    // Each sample is a running counter, the right channel is the negated left channel.
+    // Values are kept below 2^24 / 128 so they stay exact after scaling.
+    static constexpr size_t blockSize = 512;
+    static constexpr size_t blockCount = 200;
+
+    auto pcm = std::make_unique<PCM>();
+    std::atomic<size_t> samplesAdded{0};
+    std::atomic<bool> producerDone{false};
+
+    std::thread producer([&]() {
+        std::vector<float> block(blockSize * 2);
+        size_t counter{1};
+        for (size_t blockIndex = 0; blockIndex < blockCount; blockIndex++)
+        {
+            for (size_t i = 0; i < blockSize; i++)
+            {
+                block[i * 2] = static_cast<float>(counter);
+                block[i * 2 + 1] = -static_cast<float>(counter);
+                counter++;
+            }
+            pcm->Add(block.data(), 2, blockSize);
+            samplesAdded += blockSize;
+            std::this_thread::yield();
+        }
+        producerDone = true;
+    });
+
+    // Wait until the history is filled completely once.
+    while (samplesAdded.load() < AudioBufferSamples)
+    {
+        std::this_thread::yield();
+    }
+
+    uint32_t frame{0};
+    size_t checkedFrames{0};
+    do
+    {
+        pcm->UpdateFrameAudioData(1.0 / 60.0, frame++);
+        auto const data = pcm->GetFrameAudioData();
+
+        // The aligner may shift the window, but the valid samples must always be contiguous.
+        for (size_t i = 0; i < WaveformSamples; i++)
+        {
+            ASSERT_FLOAT_EQ(data->waveformRight[i], -data->waveformLeft[i]) << "Channel mismatch in frame " << frame << " at sample " << i;
+            if (i > 0)
+            {
+                ASSERT_FLOAT_EQ(data->waveformLeft[i] - data->waveformLeft[i - 1], 128.0f) << "Torn window in frame " << frame << " at sample " << i;
+            }
+        }
+        checkedFrames++;
+    } while (!producerDone.load());
+
+    producer.join();
+
+    // Last frame must contain the final samples.
+    pcm->UpdateFrameAudioData(1.0 / 60.0, frame++);
+    auto const data = pcm->GetFrameAudioData();
+    EXPECT_GT(checkedFrames, 0U);
+    EXPECT_GT(data->waveformLeft[0], 0.0f);
+}
+
+TEST(projectMPCM, ConcurrentOverflowKeepsNewestSamples)
+{
+    // Same sample layout as above, but the consumer stalls long enough for the input buffer to overflow.
+    static constexpr size_t blockSize = 512;
+    static constexpr size_t blockCount = 200;
+
+    auto pcm = std::make_unique<PCM>();
+    std::atomic<size_t> samplesAdded{0};
+    std::atomic<bool> producerDone{false};
+
+    std::thread producer([&]() {
+        std::vector<float> block(blockSize * 2);
+        size_t counter{1};
+        for (size_t blockIndex = 0; blockIndex < blockCount; blockIndex++)
+        {
+            for (size_t i = 0; i < blockSize; i++)
+            {
+                block[i * 2] = static_cast<float>(counter);
+                block[i * 2 + 1] = -static_cast<float>(counter);
+                counter++;
+            }
+            pcm->Add(block.data(), 2, blockSize);
+            samplesAdded += blockSize;
+        }
+        producerDone = true;
+    });
+
+    uint32_t frame{0};
+    bool done{false};
+    while (!done)
+    {
+        done = producerDone.load();
+        size_t const publishedSamples = samplesAdded.load();
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+
+        pcm->UpdateFrameAudioData(1.0 / 60.0, frame++);
+        auto const data = pcm->GetFrameAudioData();
+
+        if (publishedSamples < AudioBufferSamples)
+        {
+            continue;
+        }
+
+        // The window must contain samples at least as new as those published before the update,
+        // not the older ones left over from before the stall.
+        ASSERT_GE(data->waveformLeft[0], 128.0f * static_cast<float>(publishedSamples - AudioBufferSamples + 1)) << "Stale window in frame " << frame;
+        for (size_t i = 1; i < WaveformSamples; i++)
+        {
+            ASSERT_FLOAT_EQ(data->waveformRight[i], -data->waveformLeft[i]) << "Channel mismatch in frame " << frame << " at sample " << i;
+            ASSERT_FLOAT_EQ(data->waveformLeft[i] - data->waveformLeft[i - 1], 128.0f) << "Torn window in frame " << frame << " at sample " << i;
+        }
+    }
+
+    producer.join();
+}
+
+/**
+ * Adds a float ramp to the PCM instance. Sample n has the value n / 8192, which is n / 64 after scaling.
+ */
+static void AddRamp(PCM& pcm, size_t firstSample, size_t count, double timestamp = -1.0)
+{
+    std::vector<float> samples(count * 2);
+    for (size_t i = 0; i < count; i++)
+    {
+        samples[i * 2] = static_cast<float>(firstSample + i) / 8192.0f;
+        samples[i * 2 + 1] = samples[i * 2];
+    }
+
+    if (timestamp < 0.0)
+    {
+        pcm.Add(samples.data(), 2, count);
+    }
+    else
+    {
+        pcm.Add(samples.data(), 2, count, timestamp);
+    }
+}
+
+TEST(projectMPCM, OutputLatencySelectsOlderWindow)
+{
+    auto pcm = std::make_unique<PCM>();
+    pcm->SetSampleRate(1000);
+    pcm->SetOutputLatency(1.0);
+
+    AddRamp(*pcm, 0, 4096);
+    pcm->UpdateFrameAudioData(1.0 / 60.0, 0);
+
+    // Window ends 1000 samples before the newest sample.
+    auto const data = pcm->GetFrameAudioData();
+    EXPECT_FLOAT_EQ(data->waveformLeft[0], static_cast<float>(4096 - 1000 - AudioBufferSamples) / 64.0f);
+}
+
+TEST(projectMPCM, OutputLatencyIsLimitedByHistory)
+{
+    auto pcm = std::make_unique<PCM>();
+    pcm->SetSampleRate(1000);
+    pcm->SetOutputLatency(10.0);
+
+    AddRamp(*pcm, 0, 4096);
+    pcm->UpdateFrameAudioData(1.0 / 60.0, 0);
+
+    // Only 4096 samples were added, so the oldest possible window starts at the first sample.
+    auto const data = pcm->GetFrameAudioData();
+    EXPECT_FLOAT_EQ(data->waveformLeft[0], 0.0f);
+    EXPECT_FLOAT_EQ(data->waveformLeft[1], 1.0f / 64.0f);
+}
+
+TEST(projectMPCM, PresentationTimeSelectsTimestampedWindow)
+{
+    static constexpr size_t blockSize = 512;
+
+    for (double outputLatency : {0.0, 0.1})
+    {
+        auto pcm = std::make_unique<PCM>();
+        pcm->SetSampleRate(1000);
+        pcm->SetOutputLatency(outputLatency);
+
+        // Eight blocks, the first sample being played at 10 seconds.
+        for (size_t block = 0; block < 8; block++)
+        {
+            AddRamp(*pcm, block * blockSize, blockSize, 10.0 + static_cast<double>(block * blockSize) / 1000.0);
+        }
+
+        // Sample 2000 is due at 12 seconds.
+        pcm->UpdateFrameAudioData(1.0 / 60.0, 0, 12.0);
+
+        auto const data = pcm->GetFrameAudioData();
+        auto const expectedEnd = 2000.0f - static_cast<float>(outputLatency * 1000.0);
+        EXPECT_FLOAT_EQ(data->waveformLeft[0], (expectedEnd - AudioBufferSamples) / 64.0f) << "Output latency " << outputLatency;
+    }
+}
+
+TEST(projectMPCM, OverflowKeepsNewestSamples)
+{
+    auto pcm = std::make_unique<PCM>();
+
+    // Five times the input buffer capacity without the consumer reading anything.
+    for (size_t block = 0; block < 80; block++)
+    {
+        AddRamp(*pcm, block * 512, 512);
+    }
+    pcm->UpdateFrameAudioData(1.0 / 60.0, 0);
+
+    auto const data = pcm->GetFrameAudioData();
+    EXPECT_FLOAT_EQ(data->waveformLeft[0], static_cast<float>(80 * 512 - AudioBufferSamples) / 64.0f);
+}
+
+TEST(projectMPCM, OverflowKeepsTimestampPositions)
+{
+    auto pcm = std::make_unique<PCM>();
+    pcm->SetSampleRate(1000);
+
+    for (size_t block = 0; block < 80; block++)
+    {
+        AddRamp(*pcm, block * 512, 512, 10.0 + static_cast<double>(block * 512) / 1000.0);
+    }
+
+    // Sample 40000 is due at 50 seconds. The overwritten samples must not shift the positions.
+    pcm->UpdateFrameAudioData(1.0 / 60.0, 0, 50.0);
+
+    auto const data = pcm->GetFrameAudioData();
+    EXPECT_FLOAT_EQ(data->waveformLeft[0], static_cast<float>(40000 - AudioBufferSamples) / 64.0f);
+}
+
+TEST(projectMPCM, PresentationTimeWithoutTimestampsUsesNewestWindow)
+{
+    auto pcm = std::make_unique<PCM>();
+
+    AddRamp(*pcm, 0, 4096);
+    pcm->UpdateFrameAudioData(1.0 / 60.0, 0, 12.0);
+
+    auto const data = pcm->GetFrameAudioData();
+    EXPECT_FLOAT_EQ(data->waveformLeft[0], static_cast<float>(4096 - AudioBufferSamples) / 64.0f);
+}
+
+TEST(projectMPCM, FuturePresentationTimeIsClampedToNewestWindow)
+{
+    auto pcm = std::make_unique<PCM>();
+    pcm->SetSampleRate(1000);
+
+    AddRamp(*pcm, 0, 4096, 10.0);
+    pcm->UpdateFrameAudioData(1.0 / 60.0, 0, 100.0);
+
+    auto const data = pcm->GetFrameAudioData();
+    EXPECT_FLOAT_EQ(data->waveformLeft[0], static_cast<float>(4096 - AudioBufferSamples) / 64.0f);
+}
+
+TEST(projectMPCM, InvalidAnalysisSizeFallsBackToLegacy)
+{
+    AnalysisSize size;
+    size.spectrumSamples = 1000;
+    size.windowSamples = 480;
+    EXPECT_FALSE(size.IsValid());
+
+    auto pcm = std::make_unique<PCM>(size);
+    EXPECT_TRUE(pcm->GetAnalysisSize().IsLegacy());
+
+    size.spectrumSamples = 256;
+    size.windowSamples = 513;
+    EXPECT_FALSE(size.IsValid());
+}
+
+/**
+ * Analyzes a signal with the given spectrum analyzer size.
+ */
+static auto Analyze(const std::vector<float>& samples, const AnalysisSize& size) -> FrameAudioData::Ptr
+{
+    auto pcm = std::make_unique<PCM>(size);
+    pcm->Add(samples.data(), 2, samples.size() / 2);
+    pcm->UpdateFrameAudioData(1.0 / 60.0, 0);
+    return pcm->GetFrameAudioData();
+}
+
+/**
+ * Returns analyzer sizes with the same time/frequency ratio as the legacy size.
+ */
+static auto ScaledAnalysisSize(uint32_t spectrumSamples) -> AnalysisSize
+{
+    AnalysisSize size;
+    size.spectrumSamples = spectrumSamples;
+    size.windowSamples = spectrumSamples * WaveformSamples / SpectrumSamples;
+    return size;
+}
+
+TEST(projectMPCM, AnalysisSizesDetectSameFrequency)
+{
+    // Sine wave centered on legacy spectrum bin 40.
+    static constexpr size_t sineBin = 40;
+    std::vector<float> samples(8192 * 2);
+    for (size_t i = 0; i < 8192; i++)
+    {
+        samples[i * 2] = 0.5f * static_cast<float>(std::sin(2.0 * 3.141592653589793 * sineBin * static_cast<double>(i) / 1024.0));
+        samples[i * 2 + 1] = samples[i * 2];
+    }
+
+    auto const legacy = Analyze(samples, AnalysisSize());
+    ASSERT_EQ(std::max_element(legacy->spectrumLeft.begin(), legacy->spectrumLeft.end()) - legacy->spectrumLeft.begin(), sineBin);
+
+    for (uint32_t spectrumSamples : {128, 256, 1024, 2048, 4096})
+    {
+        auto const data = Analyze(samples, ScaledAnalysisSize(spectrumSamples));
+        auto const peak = std::max_element(data->spectrumLeft.begin(), data->spectrumLeft.end());
+
+        EXPECT_NEAR(peak - data->spectrumLeft.begin(), sineBin, 1) << "Spectrum size " << spectrumSamples;
+        EXPECT_FLOAT_EQ(data->spectrumRight[sineBin], data->spectrumLeft[sineBin]) << "Spectrum size " << spectrumSamples;
+    }
+}
+
+TEST(projectMPCM, AnalysisSizesKeepBroadbandLevel)
+{
+    // Deterministic white noise.
+    std::vector<float> samples(8192 * 2);
+    uint32_t state{12345};
+    for (auto& sample : samples)
+    {
+        state = state * 1664525u + 1013904223u;
+        sample = static_cast<float>(state >> 8) / static_cast<float>(1 << 23) - 1.0f;
+    }
+
+    auto const averageLevel = [](const FrameAudioData::Ptr& data) {
+        double sum{};
+        for (auto value : data->spectrumLeft)
+        {
+            sum += value;
+        }
+        return sum / SpectrumSamples;
+    };
+
+    double const legacyLevel = averageLevel(Analyze(samples, AnalysisSize()));
+
+    for (uint32_t spectrumSamples : {128, 256, 1024, 2048, 4096})
+    {
+        double const level = averageLevel(Analyze(samples, ScaledAnalysisSize(spectrumSamples)));
+        EXPECT_NEAR(level / legacyLevel, 1.0, 0.2) << "Spectrum size " << spectrumSamples;
+    }
+}
@@ -0,0 +1,201 @@
+#include <gtest/gtest.h>
+
+#include <MilkdropPreset/BatchEvaluator.hpp>
+#include <MilkdropPreset/GlslTranslator.hpp>
+#include <MilkdropPreset/PerPixelEquationsValidator.hpp>
+
+#include "SurfacelessGLContext.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <string>
+#include <vector>
+
+using libprojectM::MilkdropPreset::BatchEvaluator;
+using libprojectM::MilkdropPreset::ExpressionTree;
+using libprojectM::MilkdropPreset::GlslTranslator;
+using libprojectM::MilkdropPreset::PerPixelEquationsValidator;
+
+namespace {
+
+const std::vector<std::string> Inputs{"x", "y", "rad", "ang"};
+const std::vector<std::string> Outputs{"zoom", "zoomexp", "rot", "warp", "cx", "cy", "dx", "dy", "sx", "sy"};
+
+const std::map<std::string, double> UniformValues{
+    {"zoom", 1.01}, {"zoomexp", 1.0}, {"rot", 0.01}, {"warp", 1.0}, {"cx", 0.5}, {"cy", 0.5}, {"dx", 0.0}, {"dy", 0.0},
+    {"sx", 1.0}, {"sy", 1.0}, {"time", 12.3}, {"bass_att", 1.2}, {"mid", 0.8}, {"q1", 0.3}};
+
+constexpr int GridSizeX{48};
+constexpr int GridSizeY{36};
+constexpr float AspectX{1.0f};
+constexpr float AspectY{0.75f};
+
+class projectMPerPixelEquationsValidator : public testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        auto const error = m_glContext.Create();
+        if (!error.empty())
+        {
+            GTEST_SKIP() << error;
+        }
+    }
+
+    /**
+     * Returns the validator inputs for the whole mesh, the same values as stored in PerPixelMesh.
+     */
+    static auto MeshInputs() -> std::vector<float>
+    {
+        std::vector<float> inputs;
+        for (int gridY = 0; gridY <= GridSizeY; gridY++)
+        {
+            for (int gridX = 0; gridX <= GridSizeX; gridX++)
+            {
+                float const x = static_cast<float>(gridX) / static_cast<float>(GridSizeX) * 2.0f - 1.0f;
+                float const y = static_cast<float>(gridY) / static_cast<float>(GridSizeY) * 2.0f - 1.0f;
+                inputs.insert(inputs.end(), {x, y, hypotf(x * AspectX, y * AspectY), atan2f(y * AspectY, x * AspectX)});
+            }
+        }
+        return inputs;
+    }
+
+    /**
+     * Evaluates the code on the CPU for each mesh vertex, with the same input conversions as PerPixelMesh.
+     */
+    static auto CpuResults(const ExpressionTree& tree, const std::vector<float>& inputs) -> std::vector<float>
+    {
+        std::vector<std::string> variables(Inputs);
+        variables.insert(variables.end(), Outputs.begin(), Outputs.end());
+        BatchEvaluator evaluator(*tree.Root(), variables);
+
+        for (const auto& name : evaluator.ReadVariables())
+        {
+            auto const value = UniformValues.find(name);
+            std::fill_n(evaluator.Lanes(name), BatchEvaluator::BatchSize, value != UniformValues.end() ? value->second : 0.0);
+        }
+
+        size_t const vertexCount = inputs.size() / PerPixelEquationsValidator::InputsPerVertex;
+        std::vector<float> results;
+        for (size_t batchStart = 0; batchStart < vertexCount; batchStart += BatchEvaluator::BatchSize)
+        {
+            size_t const count = std::min(BatchEvaluator::BatchSize, vertexCount - batchStart);
+            for (size_t lane = 0; lane < count; lane++)
+            {
+                const float* vertex = &inputs[(batchStart + lane) * PerPixelEquationsValidator::InputsPerVertex];
+                evaluator.Lanes("x")[lane] = static_cast<double>(vertex[0] * 0.5f * AspectX + 0.5f);
+                evaluator.Lanes("y")[lane] = static_cast<double>(vertex[1] * -0.5f * AspectY + 0.5f);
+                evaluator.Lanes("rad")[lane] = static_cast<double>(vertex[2]);
+                evaluator.Lanes("ang")[lane] = static_cast<double>(vertex[3]);
+                for (const auto& name : Outputs)
+                {
+                    evaluator.Lanes(name)[lane] = UniformValues.at(name);
+                }
+            }
+
+            evaluator.Execute(count);
+
+            for (size_t lane = 0; lane < count; lane++)
+            {
+                for (const auto& name : Outputs)
+                {
+                    results.push_back(static_cast<float>(evaluator.Lanes(name)[lane]));
+                }
+            }
+        }
+        return results;
+    }
+
+    /**
+     * Runs the translated code on the GPU and compares the results with the CPU results.
+     */
+    static auto Validate(const std::string& code, float cpuResultOffset = 0.0f) -> PerPixelEquationsValidator::Result
+    {
+        ExpressionTree const tree(code);
+        EXPECT_NE(tree.Root(), nullptr);
+        if (tree.Root() == nullptr)
+        {
+            return PerPixelEquationsValidator::Result::Idle;
+        }
+
+        GlslTranslator const translator(*tree.Root(), "PerPixelEquations", Inputs, Outputs);
+        EXPECT_TRUE(translator.IsValid());
+
+        std::vector<std::pair<std::string, float>> uniforms;
+        for (const auto& name : translator.Uniforms())
+        {
+            auto const value = UniformValues.find(name);
+            uniforms.emplace_back(GlslTranslator::UniformName(name), value != UniformValues.end() ? static_cast<float>(value->second) : 0.0f);
+        }
+
+        auto const inputs = MeshInputs();
+        auto expected = CpuResults(tree, inputs);
+        for (auto& value : expected)
+        {
+            value += cpuResultOffset;
+        }
+
+        PerPixelEquationsValidator validator;
+        validator.Compile(translator.Source());
+        validator.Submit(inputs, std::move(expected), {AspectX, AspectY, 1.0f / AspectX, 1.0f / AspectY}, uniforms);
+        EXPECT_TRUE(validator.IsPending());
+
+        auto const result = validator.Poll(true);
+        EXPECT_FALSE(validator.IsPending());
+        EXPECT_EQ(validator.Results().size(), inputs.size() / PerPixelEquationsValidator::InputsPerVertex * PerPixelEquationsValidator::ResultsPerVertex);
+        return result;
+    }
+
+    SurfacelessGLContext m_glContext;
+};
+
+} // namespace
+
+TEST_F(projectMPerPixelEquationsValidator, MatchesCpuResults)
+{
+    EXPECT_EQ(Validate("d = sqrt(sqr(x - 0.5) + sqr(y - 0.5));"
+                       "zoom = zoom + 0.04 * sin(d * 12 - time * 2) * (1 + bass_att);"
+                       "rot = rot + 0.02 * cos(ang * 3 + time) * mid;"
+                       "dx = dx + 0.005 * sin(y * 8 + time); dy = dy + 0.005 * cos(x * 8 + time);"
+                       "warp = if(above(rad, 0.6), warp * 0.5, warp);"),
+              PerPixelEquationsValidator::Result::Match);
+
+    EXPECT_EQ(Validate("t = x * 3; u = 0; if(below(t, 1.5), u = 1, u = -1); cx = u * 0.5 + 0.5;"
+                       "sx = 1 + (x > 0.3 && y < 0.7) * 0.1 + (x < 0.1 || !y) * 0.2;"
+                       "zoomexp = 1 + exp(-rad) * 0.1 + log(1 + x) * 0.1 + log10(1 + y) * 0.1;"
+                       "cy = atan2(y - 0.5, x - 0.5) * 0.1 + atan(x) * 0.1 + asin(y * 0.5) * 0.1 + acos(x * 0.5) * 0.1;"),
+              PerPixelEquationsValidator::Result::Match);
+}
+
+TEST_F(projectMPerPixelEquationsValidator, MatchesOutsideOfFunctionDomains)
+{
+    // GLSL leaves these undefined, the wrappers return the same values as the expression library.
+    EXPECT_EQ(Validate("zoom = asin(rad + 1.5); zoomexp = acos(-2 - x); rot = log(-1 - y); warp = log(0 * x);"
+                       "cx = log10(-x - 0.5); cy = pow(-1 - x, 0.5); dx = pow(0 * x, -1); dy = pow(-2 - x, 3);"
+                       "sx = pow(0 * x, 0); sy = exp(100 + x);"),
+              PerPixelEquationsValidator::Result::Match);
+
+    // Integer conversions of operands outside the int range, zero and -1 divisors.
+    EXPECT_EQ(Validate("zoom = (x * 1e12 + 1) % 7; rot = 1e10 % (y + 3); warp = 5 % (0 * x); cx = 7 % (0 * x - 1);"
+                       "cy = (-5 - x * 1e12) % 3; dx = (x + 17) % (-4);"),
+              PerPixelEquationsValidator::Result::Match);
+}
+
+TEST_F(projectMPerPixelEquationsValidator, DetectsMismatch)
+{
+    EXPECT_EQ(Validate("zoom = zoom + sin(x * 10) * 0.1;", 0.01f), PerPixelEquationsValidator::Result::Mismatch);
+}
+
+TEST_F(projectMPerPixelEquationsValidator, IdleWithoutSubmission)
+{
+    ExpressionTree const tree("zoom = x;");
+    ASSERT_NE(tree.Root(), nullptr);
+    GlslTranslator const translator(*tree.Root(), "PerPixelEquations", Inputs, Outputs);
+
+    PerPixelEquationsValidator validator;
+    validator.Compile(translator.Source());
+
+    EXPECT_FALSE(validator.IsPending());
+    EXPECT_EQ(validator.Poll(true), PerPixelEquationsValidator::Result::Idle);
+}
@@ -0,0 +1,548 @@
+#include <gtest/gtest.h>
+
+#include <Preset.hpp>
+#include <PresetFactoryManager.hpp>
+#include <PresetLoader.hpp>
+
+#include <Renderer/Shader.hpp>
+#include <Renderer/ShaderCache.hpp>
+#include <Renderer/TextureManager.hpp>
+
+#include <projectM-4/projectM.h>
+
+#include "SurfacelessGLContext.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+static constexpr auto presetLoaderTestDataPath{PROJECTM_TEST_DATA_DIR "/PresetLoader/"};
+
+using libprojectM::PresetFactoryManager;
+using libprojectM::PresetLoader;
+
+namespace {
+
+const std::string ShadersPreset{std::string(presetLoaderTestDataPath) + "Shaders.milk"};
+const std::string MissingPreset{std::string(presetLoaderTestDataPath) + "Missing.milk"};
+
+auto ReadFile(const std::string& filename) -> std::string
+{
+    std::ifstream file(filename, std::ios::binary);
+    return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+}
+
+/**
+ * Copies the test preset into the temp directory, so it can be modified.
+ */
+auto CopyPreset(const std::string& name) -> std::string
+{
+    auto const filename = testing::TempDir() + name;
+    std::ofstream(filename, std::ios::binary | std::ios::trunc) << ReadFile(ShadersPreset);
+    return filename;
+}
+
+class projectMPresetLoader : public testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        auto const error = m_glContext.Create();
+        if (!error.empty())
+        {
+            GTEST_SKIP() << error;
+        }
+
+        m_textureManager = std::make_unique<libprojectM::Renderer::TextureManager>(std::vector<std::string>{});
+        m_presetFactoryManager.initialize();
+
+        m_renderContext.viewportSizeX = 64;
+        m_renderContext.viewportSizeY = 48;
+        m_renderContext.textureManager = m_textureManager.get();
+    }
+
+    /**
+     * Calls Update() once per "frame" until a result is returned, giving up after a few seconds.
+     */
+    auto WaitForResult(PresetLoader& loader) -> std::unique_ptr<PresetLoader::Result>
+    {
+        for (int i = 0; i < 1000; i++)
+        {
+            auto result = loader.Update(m_renderContext);
+            if (result)
+            {
+                return result;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        return {};
+    }
+
+    /**
+     * Calls Update() for a while, expecting no result.
+     */
+    void ExpectNoResult(PresetLoader& loader)
+    {
+        for (int i = 0; i < 50; i++)
+        {
+            EXPECT_EQ(loader.Update(m_renderContext), nullptr);
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+    }
+
+    /**
+     * Calls Update() once per "frame" until the preset is prefetched, giving up after a few seconds.
+     */
+    auto WaitUntilPrefetched(PresetLoader& loader, const std::string& filename) -> bool
+    {
+        for (int i = 0; i < 1000; i++)
+        {
+            EXPECT_EQ(loader.Update(m_renderContext), nullptr);
+            if (loader.IsPrefetched(filename))
+            {
+                return true;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        return false;
+    }
+
+    SurfacelessGLContext m_glContext;
+    std::unique_ptr<libprojectM::Renderer::TextureManager> m_textureManager;
+    PresetFactoryManager m_presetFactoryManager;
+    libprojectM::Renderer::RenderContext m_renderContext;
+};
+
+/**
+ * Creates a projectM instance using a surfaceless OpenGL context.
+ */
+class projectMAsyncPresetLoading : public testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        auto const error = m_glContext.Create();
+        if (!error.empty())
+        {
+            GTEST_SKIP() << error;
+        }
+
+        m_projectM = projectm_create();
+        ASSERT_NE(m_projectM, nullptr);
+
+        projectm_set_window_size(m_projectM, 64, 48);
+        projectm_set_preset_switch_failed_event_callback(m_projectM, &projectMAsyncPresetLoading::PresetSwitchFailed, this);
+    }
+
+    void TearDown() override
+    {
+        if (m_projectM != nullptr)
+        {
+            projectm_destroy(m_projectM);
+        }
+    }
+
+    static void PresetSwitchFailed(const char* presetFilename, const char*, void* userData)
+    {
+        static_cast<projectMAsyncPresetLoading*>(userData)->m_failedPresets.emplace_back(presetFilename);
+    }
+
+    /**
+     * Renders frames until no preset is loading anymore, giving up after a few seconds.
+     */
+    auto RenderUntilLoaded() -> bool
+    {
+        for (int i = 0; i < 1000; i++)
+        {
+            projectm_opengl_render_frame(m_projectM);
+            if (!projectm_is_preset_loading(m_projectM))
+            {
+                return true;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        return false;
+    }
+
+    SurfacelessGLContext m_glContext;
+    projectm_handle m_projectM{nullptr};
+    std::vector<std::string> m_failedPresets;
+};
+
+} // namespace
+
+TEST_F(projectMPresetLoader, LoadsPreset)
+{
+    PresetLoader loader(m_presetFactoryManager);
+    EXPECT_FALSE(loader.IsLoading());
+
+    loader.Load(ShadersPreset, true, m_renderContext);
+    EXPECT_TRUE(loader.IsLoading());
+
+    auto result = WaitForResult(loader);
+    ASSERT_NE(result, nullptr);
+    EXPECT_FALSE(loader.IsLoading());
+    EXPECT_EQ(result->filename, ShadersPreset);
+    EXPECT_TRUE(result->smoothTransition);
+    EXPECT_EQ(result->errorMessage, "");
+    ASSERT_NE(result->preset, nullptr);
+    EXPECT_EQ(result->preset->Filename(), "Shaders.milk");
+
+    // The shaders are compiled on this thread.
+    result->preset->Initialize(m_renderContext);
+
+    ExpectNoResult(loader);
+}
+
+TEST_F(projectMPresetLoader, CompilesShadersInBackground)
+{
+    libprojectM::Renderer::ShaderCache shaderCache;
+    libprojectM::Renderer::ShaderCache::Scope shaderCacheScope(shaderCache);
+    if (!shaderCache.ParallelCompileSupported())
+    {
+        GTEST_SKIP() << "Driver doesn't support parallel shader compilation.";
+    }
+
+    PresetLoader loader(m_presetFactoryManager);
+    loader.Load(ShadersPreset, true, m_renderContext);
+
+    auto result = WaitForResult(loader);
+    ASSERT_NE(result, nullptr);
+    ASSERT_EQ(result->errorMessage, "");
+
+    // The warp and composite shaders are linked before the preset is returned.
+    ASSERT_EQ(result->shaderPrograms.size(), 2u);
+    for (const auto& program : result->shaderPrograms)
+    {
+        EXPECT_TRUE(libprojectM::Renderer::Shader::CompileProgramFinished(*program));
+    }
+
+    // Initializing the preset uses these programs instead of compiling the shaders again.
+    result->preset->Initialize(m_renderContext);
+    for (const auto& program : result->shaderPrograms)
+    {
+        EXPECT_EQ(program->errorMessage, "");
+        EXPECT_GT(program.use_count(), 1);
+    }
+}
+
+TEST_F(projectMPresetLoader, ReportsMissingFile)
+{
+    PresetLoader loader(m_presetFactoryManager);
+
+    loader.Load(MissingPreset, false, m_renderContext);
+
+    auto result = WaitForResult(loader);
+    ASSERT_NE(result, nullptr);
+    EXPECT_FALSE(loader.IsLoading());
+    EXPECT_EQ(result->filename, MissingPreset);
+    EXPECT_FALSE(result->smoothTransition);
+    EXPECT_NE(result->errorMessage, "");
+}
+
+TEST_F(projectMPresetLoader, NewRequestDiscardsPrevious)
+{
+    PresetLoader loader(m_presetFactoryManager);
+
+    loader.Load(MissingPreset, false, m_renderContext);
+    loader.Load(ShadersPreset, false, m_renderContext);
+
+    // The missing file fails quickly, but only the last request is returned.
+    auto result = WaitForResult(loader);
+    ASSERT_NE(result, nullptr);
+    EXPECT_EQ(result->filename, ShadersPreset);
+    EXPECT_EQ(result->errorMessage, "");
+    EXPECT_NE(result->preset, nullptr);
+
+    ExpectNoResult(loader);
+}
+
+TEST_F(projectMPresetLoader, NewRequestDiscardsFinishedResult)
+{
+    PresetLoader loader(m_presetFactoryManager);
+
+    loader.Load(MissingPreset, false, m_renderContext);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    loader.Load(ShadersPreset, false, m_renderContext);
+
+    auto result = WaitForResult(loader);
+    ASSERT_NE(result, nullptr);
+    EXPECT_EQ(result->filename, ShadersPreset);
+}
+
+TEST_F(projectMPresetLoader, CancelDiscardsRequest)
+{
+    PresetLoader loader(m_presetFactoryManager);
+
+    loader.Load(ShadersPreset, false, m_renderContext);
+    loader.Update(m_renderContext);
+    loader.Cancel();
+    EXPECT_FALSE(loader.IsLoading());
+
+    ExpectNoResult(loader);
+    EXPECT_FALSE(loader.IsLoading());
+
+    // The loader can be used again after cancelling.
+    loader.Load(ShadersPreset, false, m_renderContext);
+    auto result = WaitForResult(loader);
+    ASSERT_NE(result, nullptr);
+    EXPECT_NE(result->preset, nullptr);
+}
+
+TEST_F(projectMPresetLoader, DestroyedWhileLoading)
+{
+    {
+        PresetLoader loader(m_presetFactoryManager);
+        loader.Load(ShadersPreset, false, m_renderContext);
+        loader.Update(m_renderContext);
+    }
+
+    SUCCEED();
+}
+
+TEST_F(projectMPresetLoader, LoadsPrefetchedPreset)
+{
+    PresetLoader loader(m_presetFactoryManager);
+
+    loader.Prefetch(ShadersPreset, m_renderContext);
+    ASSERT_TRUE(WaitUntilPrefetched(loader, ShadersPreset));
+    EXPECT_EQ(loader.PrefetchedPresetCount(), 1);
+
+    loader.Load(ShadersPreset, true, m_renderContext);
+    EXPECT_FALSE(loader.IsPrefetched(ShadersPreset));
+    EXPECT_EQ(loader.PrefetchedPresetCount(), 0);
+
+    auto result = WaitForResult(loader);
+    ASSERT_NE(result, nullptr);
+    EXPECT_EQ(result->errorMessage, "");
+    ASSERT_NE(result->preset, nullptr);
+    EXPECT_EQ(result->preset->Filename(), "Shaders.milk");
+
+    result->preset->Initialize(m_renderContext);
+}
+
+TEST_F(projectMPresetLoader, PrefetchingKeepsLoadRequest)
+{
+    PresetLoader loader(m_presetFactoryManager);
+
+    loader.Load(ShadersPreset, false, m_renderContext);
+    loader.Prefetch(CopyPreset("PrefetchingKeepsLoadRequest.milk"), m_renderContext);
+
+    auto result = WaitForResult(loader);
+    ASSERT_NE(result, nullptr);
+    EXPECT_EQ(result->filename, ShadersPreset);
+    EXPECT_NE(result->preset, nullptr);
+}
+
+TEST_F(projectMPresetLoader, CancelKeepsPrefetchRequests)
+{
+    PresetLoader loader(m_presetFactoryManager);
+
+    loader.Prefetch(ShadersPreset, m_renderContext);
+    loader.Load(MissingPreset, false, m_renderContext);
+    loader.Cancel();
+
+    EXPECT_TRUE(WaitUntilPrefetched(loader, ShadersPreset));
+}
+
+TEST_F(projectMPresetLoader, TakePrefetchedPreset)
+{
+    PresetLoader loader(m_presetFactoryManager);
+
+    EXPECT_EQ(loader.TakePrefetchedPreset(ShadersPreset), nullptr);
+
+    loader.Prefetch(ShadersPreset, m_renderContext);
+    ASSERT_TRUE(WaitUntilPrefetched(loader, ShadersPreset));
+
+    // The code is compiled when initializing the preset.
+    auto preset = loader.TakePrefetchedPreset(ShadersPreset);
+    ASSERT_NE(preset, nullptr);
+    preset->Initialize(m_renderContext);
+
+    // Each prefetched preset is only used once.
+    EXPECT_FALSE(loader.IsPrefetched(ShadersPreset));
+    EXPECT_EQ(loader.TakePrefetchedPreset(ShadersPreset), nullptr);
+}
+
+TEST_F(projectMPresetLoader, IgnoresChangedPrefetchedFile)
+{
+    PresetLoader loader(m_presetFactoryManager);
+    auto const filename = CopyPreset("IgnoresChangedPrefetchedFile.milk");
+
+    loader.Prefetch(filename, m_renderContext);
+    ASSERT_TRUE(WaitUntilPrefetched(loader, filename));
+
+    std::ofstream(filename, std::ios::binary | std::ios::app) << "per_frame_2=zoom=1.02;\n";
+
+    EXPECT_EQ(loader.TakePrefetchedPreset(filename), nullptr);
+    EXPECT_FALSE(loader.IsPrefetched(filename));
+    EXPECT_EQ(loader.PrefetchedPresetCount(), 0);
+}
+
+TEST_F(projectMPresetLoader, IgnoresDeletedPrefetchedFile)
+{
+    PresetLoader loader(m_presetFactoryManager);
+    auto const filename = CopyPreset("IgnoresDeletedPrefetchedFile.milk");
+
+    loader.Prefetch(filename, m_renderContext);
+    ASSERT_TRUE(WaitUntilPrefetched(loader, filename));
+
+    std::remove(filename.c_str());
+
+    EXPECT_EQ(loader.TakePrefetchedPreset(filename), nullptr);
+}
+
+TEST_F(projectMPresetLoader, LoadReloadsChangedPrefetchedFile)
+{
+    PresetLoader loader(m_presetFactoryManager);
+    auto const filename = CopyPreset("LoadReloadsChangedPrefetchedFile.milk");
+
+    loader.Prefetch(filename, m_renderContext);
+    ASSERT_TRUE(WaitUntilPrefetched(loader, filename));
+
+    std::ofstream(filename, std::ios::binary | std::ios::app) << "per_frame_2=zoom=1.02;\n";
+
+    // The worker thread notices the change and loads the file again.
+    loader.Load(filename, false, m_renderContext);
+    EXPECT_EQ(loader.PrefetchedPresetCount(), 0);
+
+    auto result = WaitForResult(loader);
+    ASSERT_NE(result, nullptr);
+    EXPECT_EQ(result->errorMessage, "");
+    EXPECT_NE(result->preset, nullptr);
+}
+
+TEST_F(projectMPresetLoader, LoadFailsForDeletedPrefetchedFile)
+{
+    PresetLoader loader(m_presetFactoryManager);
+    auto const filename = CopyPreset("LoadFailsForDeletedPrefetchedFile.milk");
+
+    loader.Prefetch(filename, m_renderContext);
+    ASSERT_TRUE(WaitUntilPrefetched(loader, filename));
+
+    std::remove(filename.c_str());
+
+    loader.Load(filename, false, m_renderContext);
+
+    auto result = WaitForResult(loader);
+    ASSERT_NE(result, nullptr);
+    EXPECT_NE(result->errorMessage, "");
+    EXPECT_EQ(result->preset, nullptr);
+}
+
+TEST_F(projectMPresetLoader, PrefetchLimit)
+{
+    PresetLoader loader(m_presetFactoryManager);
+    EXPECT_EQ(loader.PrefetchLimit(), PresetLoader::DefaultPrefetchLimit);
+
+    auto const first = CopyPreset("PrefetchLimitFirst.milk");
+    auto const second = CopyPreset("PrefetchLimitSecond.milk");
+
+    // Only one preset is kept, the least recently requested one is dropped.
+    loader.SetPrefetchLimit(1);
+    loader.Prefetch(first, m_renderContext);
+    ASSERT_TRUE(WaitUntilPrefetched(loader, first));
+    loader.Prefetch(second, m_renderContext);
+    ASSERT_TRUE(WaitUntilPrefetched(loader, second));
+    EXPECT_FALSE(loader.IsPrefetched(first));
+    EXPECT_EQ(loader.PrefetchedPresetCount(), 1);
+
+    // 0 drops all prefetched presets and disables prefetching.
+    loader.SetPrefetchLimit(0);
+    EXPECT_FALSE(loader.IsPrefetched(second));
+    EXPECT_EQ(loader.PrefetchedPresetCount(), 0);
+
+    loader.Prefetch(first, m_renderContext);
+    EXPECT_FALSE(WaitUntilPrefetched(loader, first));
+}
+
+TEST_F(projectMPresetLoader, ClearPrefetchedPresets)
+{
+    PresetLoader loader(m_presetFactoryManager);
+    auto const first = CopyPreset("ClearPrefetchedPresetsFirst.milk");
+    auto const second = CopyPreset("ClearPrefetchedPresetsSecond.milk");
+
+    loader.Prefetch(first, m_renderContext);
+    ASSERT_TRUE(WaitUntilPrefetched(loader, first));
+
+    // Pending prefetch requests are discarded as well.
+    loader.Prefetch(second, m_renderContext);
+    loader.ClearPrefetchedPresets();
+    EXPECT_FALSE(loader.IsPrefetched(first));
+    EXPECT_EQ(loader.PrefetchedPresetCount(), 0);
+    ExpectNoResult(loader);
+    EXPECT_FALSE(loader.IsPrefetched(second));
+}
+
+TEST_F(projectMPresetLoader, OnlyPrefetchesLocalFiles)
+{
+    PresetLoader loader(m_presetFactoryManager);
+
+    loader.Prefetch("idle://", m_renderContext);
+    ExpectNoResult(loader);
+    EXPECT_FALSE(loader.IsPrefetched("idle://"));
+}
+
+TEST_F(projectMAsyncPresetLoading, LoadsPresetInBackground)
+{
+    EXPECT_FALSE(projectm_is_preset_loading(m_projectM));
+
+    projectm_load_preset_file_async(m_projectM, ShadersPreset.c_str(), false);
+    EXPECT_TRUE(projectm_is_preset_loading(m_projectM));
+
+    EXPECT_TRUE(RenderUntilLoaded());
+    EXPECT_TRUE(m_failedPresets.empty());
+}
+
+TEST_F(projectMAsyncPresetLoading, ReportsFailureWhenRendering)
+{
+    projectm_load_preset_file_async(m_projectM, MissingPreset.c_str(), true);
+    EXPECT_TRUE(projectm_is_preset_loading(m_projectM));
+    EXPECT_TRUE(m_failedPresets.empty());
+
+    EXPECT_TRUE(RenderUntilLoaded());
+    ASSERT_EQ(m_failedPresets.size(), 1);
+    EXPECT_EQ(m_failedPresets.front(), MissingPreset);
+}
+
+TEST_F(projectMAsyncPresetLoading, NewRequestReplacesPrevious)
+{
+    projectm_load_preset_file_async(m_projectM, MissingPreset.c_str(), false);
+    projectm_load_preset_file_async(m_projectM, ShadersPreset.c_str(), false);
+
+    EXPECT_TRUE(RenderUntilLoaded());
+    EXPECT_TRUE(m_failedPresets.empty());
+}
+
+TEST_F(projectMAsyncPresetLoading, SynchronousLoadCancelsRequest)
+{
+    projectm_load_preset_file_async(m_projectM, MissingPreset.c_str(), false);
+    projectm_load_preset_file(m_projectM, ShadersPreset.c_str(), false);
+    EXPECT_FALSE(projectm_is_preset_loading(m_projectM));
+
+    for (int i = 0; i < 50; i++)
+    {
+        projectm_opengl_render_frame(m_projectM);
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    EXPECT_TRUE(m_failedPresets.empty());
+}
+
+TEST_F(projectMAsyncPresetLoading, LoadsPrefetchedPreset)
+{
+    projectm_prefetch_preset_file(m_projectM, ShadersPreset.c_str());
+    for (int i = 0; i < 50; i++)
+    {
+        projectm_opengl_render_frame(m_projectM);
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+
+    projectm_load_preset_file_async(m_projectM, ShadersPreset.c_str(), false);
+    EXPECT_TRUE(RenderUntilLoaded());
+    EXPECT_TRUE(m_failedPresets.empty());
+}
@@ -0,0 +1,167 @@
+#include "Audio/SampleConverter.hpp"
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <vector>
+
+using libprojectM::Audio::SampleConverter;
+
+namespace {
+
+/**
+ * Creates random samples, with the first few values set to the range limits.
+ */
+template<typename SampleType>
+auto RandomSamples(size_t count) -> std::vector<SampleType>;
+
+template<>
+auto RandomSamples<float>(size_t count) -> std::vector<float>
+{
+    std::mt19937 generator(12345);
+    std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+    std::vector<float> samples(count);
+    for (auto& sample : samples)
+    {
+        sample = distribution(generator);
+    }
+    samples[0] = -1.0f;
+    samples[1] = 1.0f;
+    samples[2] = 0.0f;
+    samples[3] = 1e-40f; // Denormal
+    return samples;
+}
+
+template<>
+auto RandomSamples<int16_t>(size_t count) -> std::vector<int16_t>
+{
+    std::mt19937 generator(12345);
+    std::uniform_int_distribution<int> distribution(-32768, 32767);
+    std::vector<int16_t> samples(count);
+    for (auto& sample : samples)
+    {
+        sample = static_cast<int16_t>(distribution(generator));
+    }
+    samples[0] = -32768;
+    samples[1] = 32767;
+    samples[2] = 0;
+    return samples;
+}
+
+template<>
+auto RandomSamples<uint8_t>(size_t count) -> std::vector<uint8_t>
+{
+    std::mt19937 generator(12345);
+    std::uniform_int_distribution<int> distribution(0, 255);
+    std::vector<uint8_t> samples(count);
+    for (auto& sample : samples)
+    {
+        sample = static_cast<uint8_t>(distribution(generator));
+    }
+    samples[0] = 0;
+    samples[1] = 255;
+    samples[2] = 128;
+    return samples;
+}
+
+/**
+ * Compares the output of the given kernel with the scalar implementation for
+ * various channel counts, lengths and input alignments.
+ */
+template<typename SampleType>
+void CompareWithScalar(SampleConverter::Kernel kernel)
+{
+    SampleConverter const scalar(SampleConverter::Kernel::Scalar);
+    SampleConverter const vectorized(kernel);
+    ASSERT_EQ(vectorized.ActiveKernel(), kernel);
+
+    static constexpr size_t maxCount = 133;
+    static constexpr uint32_t maxChannels = 6;
+    auto const samples = RandomSamples<SampleType>(maxCount * maxChannels + 3);
+
+    for (uint32_t channels = 1; channels <= maxChannels; channels++)
+    {
+        for (size_t count = 0; count <= maxCount; count++)
+        {
+            for (size_t misalignment = 0; misalignment < 3; misalignment++)
+            {
+                std::vector<float> expectedLeft(count + 1, -999.0f);
+                std::vector<float> expectedRight(count + 1, -999.0f);
+                std::vector<float> actualLeft(count + 1, -999.0f);
+                std::vector<float> actualRight(count + 1, -999.0f);
+
+                scalar.Convert(samples.data() + misalignment, channels, expectedLeft.data(), expectedRight.data(), count);
+                vectorized.Convert(samples.data() + misalignment, channels, actualLeft.data(), actualRight.data(), count);
+
+                // Results must be bit-exact, and the kernel must not write past the end.
+                for (size_t i = 0; i <= count; i++)
+                {
+                    ASSERT_EQ(actualLeft[i], expectedLeft[i]) << "channels=" << channels << " count=" << count << " index=" << i;
+                    ASSERT_EQ(actualRight[i], expectedRight[i]) << "channels=" << channels << " count=" << count << " index=" << i;
+                }
+            }
+        }
+    }
+}
+
+void CompareAllTypesWithScalar(SampleConverter::Kernel kernel)
+{
+    if (!SampleConverter::IsSupported(kernel))
+    {
+        GTEST_SKIP() << "Kernel not supported on this CPU.";
+    }
+
+    CompareWithScalar<float>(kernel);
+    CompareWithScalar<int16_t>(kernel);
+    CompareWithScalar<uint8_t>(kernel);
+}
+
+} // namespace
+
+TEST(projectMSampleConverter, ScalarScaling)
+{
+    SampleConverter const converter(SampleConverter::Kernel::Scalar);
+
+    float left[2]{};
+    float right[2]{};
+
+    float const floatSamples[4]{1.0f, -0.5f, 0.25f, 0.0f};
+    converter.Convert(floatSamples, 2, left, right, 2);
+    EXPECT_FLOAT_EQ(left[0], 128.0f);
+    EXPECT_FLOAT_EQ(right[0], -64.0f);
+    EXPECT_FLOAT_EQ(left[1], 32.0f);
+    EXPECT_FLOAT_EQ(right[1], 0.0f);
+
+    int16_t const int16Samples[2]{-32768, 16384};
+    converter.Convert(int16Samples, 1, left, right, 2);
+    EXPECT_FLOAT_EQ(left[0], -128.0f);
+    EXPECT_FLOAT_EQ(right[0], -128.0f);
+    EXPECT_FLOAT_EQ(left[1], 64.0f);
+    EXPECT_FLOAT_EQ(right[1], 64.0f);
+
+    uint8_t const uint8Samples[2]{0, 192};
+    converter.Convert(uint8Samples, 2, left, right, 1);
+    EXPECT_FLOAT_EQ(left[0], -128.0f);
+    EXPECT_FLOAT_EQ(right[0], 64.0f);
+}
+
+TEST(projectMSampleConverter, BestKernelIsSupported)
+{
+    EXPECT_TRUE(SampleConverter::IsSupported(SampleConverter::BestKernel()));
+    EXPECT_EQ(SampleConverter().ActiveKernel(), SampleConverter::BestKernel());
+}
+
+TEST(projectMSampleConverter, SSE2MatchesScalar)
+{
+    CompareAllTypesWithScalar(SampleConverter::Kernel::SSE2);
+}
+
+TEST(projectMSampleConverter, AVX2MatchesScalar)
+{
+    CompareAllTypesWithScalar(SampleConverter::Kernel::AVX2);
+}
+
+TEST(projectMSampleConverter, NEONMatchesScalar)
+{
+    CompareAllTypesWithScalar(SampleConverter::Kernel::NEON);
+}
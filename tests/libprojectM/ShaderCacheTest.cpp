@@ -0,0 +1,113 @@
+#include <gtest/gtest.h>
+
+#include <Renderer/ShaderCache.hpp>
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+using libprojectM::Renderer::ShaderCache;
+
+namespace {
+
+const std::string VertexShader{"void main() { gl_Position = vec4(0.0); }"};
+const std::string FragmentShader{"out vec4 color; void main() { color = vec4(1.0); }"};
+
+auto TemporaryFileName() -> std::string
+{
+    return testing::TempDir() + "projectM-shader-cache-test.bin";
+}
+
+} // anonymous namespace
+
+TEST(projectMShaderCache, HashIsStable)
+{
+    // Reference values of 64-bit FNV-1a.
+    EXPECT_EQ(ShaderCache::Hash(""), 14695981039346656037ULL);
+    EXPECT_EQ(ShaderCache::Hash("a"), 0xaf63dc4c8601ec8cULL);
+    EXPECT_EQ(ShaderCache::Hash("foobar"), 0x85944171f73967e8ULL);
+
+    EXPECT_EQ(ShaderCache::Hash("bar", ShaderCache::Hash("foo")), ShaderCache::Hash("foobar"));
+    EXPECT_NE(ShaderCache::Hash("void main() {}"), ShaderCache::Hash("void main() { }"));
+}
+
+TEST(projectMShaderCache, BinaryFileRoundTrip)
+{
+    auto const fileName = TemporaryFileName();
+    std::vector<char> const binary{'p', 'r', 'o', 'g', '\0', 'r', 'a', 'm'};
+
+    ASSERT_TRUE(ShaderCache::WriteBinaryFile(fileName, 1234, VertexShader, FragmentShader, 0x8741, binary));
+
+    // Overwrites an existing file.
+    ASSERT_TRUE(ShaderCache::WriteBinaryFile(fileName, 5678, VertexShader, FragmentShader, 0x8742, binary));
+
+    GLenum format{};
+    std::vector<char> readBinary;
+    ASSERT_TRUE(ShaderCache::ReadBinaryFile(fileName, 5678, VertexShader, FragmentShader, format, readBinary));
+    EXPECT_EQ(format, 0x8742u);
+    EXPECT_EQ(readBinary, binary);
+
+    std::remove(fileName.c_str());
+}
+
+TEST(projectMShaderCache, BinaryFileKeyMismatch)
+{
+    auto const fileName = TemporaryFileName();
+    ASSERT_TRUE(ShaderCache::WriteBinaryFile(fileName, 1234, VertexShader, FragmentShader, 0x8741, {'a', 'b', 'c'}));
+
+    GLenum format{};
+    std::vector<char> binary;
+    EXPECT_FALSE(ShaderCache::ReadBinaryFile(fileName, 4321, VertexShader, FragmentShader, format, binary));
+
+    std::remove(fileName.c_str());
+}
+
+TEST(projectMShaderCache, BinaryFileInvalid)
+{
+    auto const fileName = TemporaryFileName();
+    GLenum format{};
+    std::vector<char> binary;
+
+    std::remove(fileName.c_str());
+    EXPECT_FALSE(ShaderCache::ReadBinaryFile(fileName, 1234, VertexShader, FragmentShader, format, binary));
+
+    // Truncated file.
+    ASSERT_TRUE(ShaderCache::WriteBinaryFile(fileName, 1234, VertexShader, FragmentShader, 0x8741, {'a', 'b', 'c', 'd'}));
+    {
+        std::ifstream input(fileName, std::ios::binary);
+        std::string contents((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+        input.close();
+
+        std::ofstream output(fileName, std::ios::binary | std::ios::trunc);
+        output.write(contents.data(), static_cast<std::streamsize>(contents.size() - 2));
+    }
+    EXPECT_FALSE(ShaderCache::ReadBinaryFile(fileName, 1234, VertexShader, FragmentShader, format, binary));
+
+    // Not a cache file at all.
+    {
+        std::ofstream output(fileName, std::ios::binary | std::ios::trunc);
+        output << "This is not a shader binary cache file.";
+    }
+    EXPECT_FALSE(ShaderCache::ReadBinaryFile(fileName, 1234, VertexShader, FragmentShader, format, binary));
+
+    std::remove(fileName.c_str());
+}
+
+TEST(projectMShaderCache, BinaryFileSourceMismatch)
+{
+    auto const fileName = TemporaryFileName();
+    ASSERT_TRUE(ShaderCache::WriteBinaryFile(fileName, 1234, VertexShader, FragmentShader, 0x8741, {'a', 'b', 'c'}));
+
+    // Same key, e.g. a hash collision, but different sources.
+    GLenum format{};
+    std::vector<char> binary;
+    EXPECT_FALSE(ShaderCache::ReadBinaryFile(fileName, 1234, VertexShader, FragmentShader + " ", format, binary));
+    EXPECT_FALSE(ShaderCache::ReadBinaryFile(fileName, 1234, FragmentShader, VertexShader, format, binary));
+    EXPECT_FALSE(ShaderCache::ReadBinaryFile(fileName, 1234, VertexShader + FragmentShader, "", format, binary));
+
+    EXPECT_TRUE(ShaderCache::ReadBinaryFile(fileName, 1234, VertexShader, FragmentShader, format, binary));
+
+    std::remove(fileName.c_str());
+}
@@ -0,0 +1,70 @@
+#include "Audio/SpectrumResampler.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <vector>
+
+using namespace libprojectM::Audio;
+
+TEST(projectMSpectrumResampler, SameSizeAppliesGain)
+{
+    SpectrumResampler const resampler(4, 4, 0.5f);
+    EXPECT_TRUE(resampler.IsSpecialized());
+
+    std::vector<float> const source{1.0f, 2.0f, 3.0f, 4.0f};
+    std::vector<float> target(4);
+    resampler.Resample(source.data(), target.data());
+
+    EXPECT_FLOAT_EQ(target[0], 0.5f);
+    EXPECT_FLOAT_EQ(target[1], 1.0f);
+    EXPECT_FLOAT_EQ(target[2], 1.5f);
+    EXPECT_FLOAT_EQ(target[3], 2.0f);
+}
+
+TEST(projectMSpectrumResampler, DecimationUsesRMS)
+{
+    SpectrumResampler const resampler(4, 2, 1.0f);
+    EXPECT_TRUE(resampler.IsSpecialized());
+
+    std::vector<float> const source{3.0f, 4.0f, 0.0f, 2.0f};
+    std::vector<float> target(2);
+    resampler.Resample(source.data(), target.data());
+
+    EXPECT_FLOAT_EQ(target[0], std::sqrt(12.5f));
+    EXPECT_FLOAT_EQ(target[1], std::sqrt(2.0f));
+}
+
+TEST(projectMSpectrumResampler, InterpolationUsesPower)
+{
+    SpectrumResampler const resampler(2, 4, 1.0f);
+    EXPECT_TRUE(resampler.IsSpecialized());
+
+    std::vector<float> const source{1.0f, std::sqrt(3.0f)};
+    std::vector<float> target(4);
+    resampler.Resample(source.data(), target.data());
+
+    EXPECT_FLOAT_EQ(target[0], 1.0f);
+    EXPECT_FLOAT_EQ(target[1], std::sqrt(2.0f));
+    EXPECT_FLOAT_EQ(target[2], std::sqrt(3.0f));
+    EXPECT_FLOAT_EQ(target[3], std::sqrt(3.0f));
+}
+
+TEST(projectMSpectrumResampler, FlatSpectrumStaysFlat)
+{
+    // All supported analyzer sizes to the legacy size, plus generic ratios.
+    for (size_t sourceSamples : {32, 128, 256, 512, 1024, 2048, 4096, 16384})
+    {
+        SpectrumResampler const resampler(sourceSamples, 512, 2.0f);
+        EXPECT_EQ(resampler.IsSpecialized(), sourceSamples >= 128 && sourceSamples <= 4096) << "Source size " << sourceSamples;
+
+        std::vector<float> const source(sourceSamples, 3.0f);
+        std::vector<float> target(512);
+        resampler.Resample(source.data(), target.data());
+
+        for (size_t i = 0; i < target.size(); i++)
+        {
+            ASSERT_FLOAT_EQ(target[i], 6.0f) << "Source size " << sourceSamples << ", index " << i;
+        }
+    }
+}
@@ -0,0 +1,219 @@
+#include "Audio/AudioConstants.hpp"
+#include "Audio/MilkdropFFT.hpp"
+#include "Audio/StereoFFT.hpp"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <random>
+#include <vector>
+
+using namespace libprojectM::Audio;
+
+namespace {
+
+/**
+ * Maximum allowed absolute differences, relative to the largest absolute input sample value.
+ * See StereoFFT class documentation.
+ */
+constexpr float milkdropFFTTolerance = 1e-4f;
+constexpr float referenceDFTTolerance = 2e-6f;
+
+auto PeakAmplitude(const std::vector<float>& left, const std::vector<float>& right) -> float
+{
+    float peak{};
+    for (size_t i = 0; i < WaveformSamples; i++)
+    {
+        peak = std::max({peak, std::abs(left[i]), std::abs(right[i])});
+    }
+    return peak;
+}
+
+/**
+ * Calculates the expected spectrum with a double-precision DFT, using the Milkdrop envelope and equalizer.
+ */
+auto ReferenceSpectrum(const std::vector<float>& samples) -> std::vector<double>
+{
+    static constexpr double pi = 3.141592653589793238462643383279502884197169399;
+    static constexpr size_t transformSize = SpectrumSamples * 2;
+
+    std::vector<double> spectrum(SpectrumSamples);
+    for (size_t k = 0; k < SpectrumSamples; k++)
+    {
+        std::complex<double> sum;
+        for (size_t i = 0; i < WaveformSamples; i++)
+        {
+            double const envelope = 0.5 + 0.5 * std::sin(static_cast<double>(i) * 2.0 * pi / WaveformSamples - pi * 0.5);
+            sum += samples[i] * envelope * std::polar(1.0, -2.0 * pi * static_cast<double>(k * i) / transformSize);
+        }
+        double const equalize = -0.02 * std::log(static_cast<double>(SpectrumSamples - k) / SpectrumSamples);
+        spectrum[k] = equalize * std::abs(sum);
+    }
+    return spectrum;
+}
+
+void CompareWithMilkdropFFT(const std::vector<float>& left, const std::vector<float>& right)
+{
+    MilkdropFFT referenceFFT(WaveformSamples, SpectrumSamples, true);
+    StereoFFT stereoFFT(WaveformSamples, SpectrumSamples, true);
+
+    std::vector<float> expectedLeft;
+    std::vector<float> expectedRight;
+    referenceFFT.TimeToFrequencyDomain(left, expectedLeft);
+    referenceFFT.TimeToFrequencyDomain(right, expectedRight);
+
+    ASSERT_EQ(expectedLeft.size(), SpectrumSamples);
+    ASSERT_EQ(expectedRight.size(), SpectrumSamples);
+
+    std::vector<float> actualLeft(SpectrumSamples);
+    std::vector<float> actualRight(SpectrumSamples);
+    stereoFFT.TimeToFrequencyDomain(left.data(), right.data(), actualLeft.data(), actualRight.data());
+
+    float const tolerance = std::max(PeakAmplitude(left, right) * milkdropFFTTolerance, 1e-6f);
+
+    for (size_t i = 0; i < SpectrumSamples; i++)
+    {
+        EXPECT_NEAR(actualLeft[i], expectedLeft[i], tolerance) << "Left channel, bin " << i;
+        EXPECT_NEAR(actualRight[i], expectedRight[i], tolerance) << "Right channel, bin " << i;
+    }
+}
+
+void CompareWithReferenceDFT(const std::vector<float>& left, const std::vector<float>& right)
+{
+    StereoFFT stereoFFT(WaveformSamples, SpectrumSamples, true);
+
+    std::vector<float> actualLeft(SpectrumSamples);
+    std::vector<float> actualRight(SpectrumSamples);
+    stereoFFT.TimeToFrequencyDomain(left.data(), right.data(), actualLeft.data(), actualRight.data());
+
+    auto const expectedLeft = ReferenceSpectrum(left);
+    auto const expectedRight = ReferenceSpectrum(right);
+
+    double const tolerance = std::max(PeakAmplitude(left, right) * referenceDFTTolerance, 1e-6f);
+
+    for (size_t i = 0; i < SpectrumSamples; i++)
+    {
+        EXPECT_NEAR(actualLeft[i], expectedLeft[i], tolerance) << "Left channel, bin " << i;
+        EXPECT_NEAR(actualRight[i], expectedRight[i], tolerance) << "Right channel, bin " << i;
+    }
+}
+
+auto Sine(float frequency, float amplitude, float phase = 0.0f) -> std::vector<float>
+{
+    std::vector<float> samples(AudioBufferSamples);
+    for (size_t i = 0; i < samples.size(); i++)
+    {
+        samples[i] = amplitude * std::sin(2.0f * 3.14159265f * frequency * static_cast<float>(i) / 44100.0f + phase);
+    }
+    return samples;
+}
+
+auto Noise(unsigned int seed, float amplitude) -> std::vector<float>
+{
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<float> distribution(-amplitude, amplitude);
+    std::vector<float> samples(AudioBufferSamples);
+    for (auto& sample : samples)
+    {
+        sample = distribution(generator);
+    }
+    return samples;
+}
+
+} // namespace
+
+TEST(projectMStereoFFT, Silence)
+{
+    std::vector<float> const silence(AudioBufferSamples, 0.0f);
+    CompareWithMilkdropFFT(silence, silence);
+}
+
+TEST(projectMStereoFFT, SineWaves)
+{
+    CompareWithMilkdropFFT(Sine(440.0f, 100.0f), Sine(1000.0f, 50.0f, 0.3f));
+    CompareWithMilkdropFFT(Sine(60.0f, 128.0f), Sine(60.0f, 128.0f));
+    CompareWithMilkdropFFT(Sine(10000.0f, 20.0f), Sine(15.0f, 120.0f));
+}
+
+TEST(projectMStereoFFT, Noise)
+{
+    CompareWithMilkdropFFT(Noise(1, 128.0f), Noise(2, 128.0f));
+    CompareWithMilkdropFFT(Noise(3, 1.0f), Noise(4, 100.0f));
+}
+
+TEST(projectMStereoFFT, OneChannelSilent)
+{
+    std::vector<float> const silence(AudioBufferSamples, 0.0f);
+    CompareWithMilkdropFFT(Noise(5, 128.0f), silence);
+    CompareWithMilkdropFFT(silence, Sine(2000.0f, 64.0f));
+}
+
+TEST(projectMStereoFFT, MatchesReferenceDFT)
+{
+    CompareWithReferenceDFT(Sine(440.0f, 100.0f), Sine(1000.0f, 50.0f, 0.3f));
+    CompareWithReferenceDFT(Noise(7, 128.0f), Noise(8, 128.0f));
+    CompareWithReferenceDFT(Noise(9, 128.0f), std::vector<float>(AudioBufferSamples, 0.0f));
+}
+
+TEST(projectMStereoFFT, WithoutEqualizerAndEnvelope)
+{
+    MilkdropFFT referenceFFT(WaveformSamples, SpectrumSamples, false, -1.0f);
+    StereoFFT stereoFFT(WaveformSamples, SpectrumSamples, false, -1.0f);
+
+    auto const left = Sine(3000.0f, 80.0f);
+    auto const right = Noise(6, 40.0f);
+
+    std::vector<float> expectedLeft;
+    std::vector<float> expectedRight;
+    referenceFFT.TimeToFrequencyDomain(left, expectedLeft);
+    referenceFFT.TimeToFrequencyDomain(right, expectedRight);
+
+    std::vector<float> actualLeft(SpectrumSamples);
+    std::vector<float> actualRight(SpectrumSamples);
+    stereoFFT.TimeToFrequencyDomain(left.data(), right.data(), actualLeft.data(), actualRight.data());
+
+    // Without equalization, the FFT gain is up to the number of input samples.
+    float const tolerance = PeakAmplitude(left, right) * milkdropFFTTolerance * WaveformSamples;
+
+    for (size_t i = 0; i < SpectrumSamples; i++)
+    {
+        EXPECT_NEAR(actualLeft[i], expectedLeft[i], tolerance) << "Left channel, bin " << i;
+        EXPECT_NEAR(actualRight[i], expectedRight[i], tolerance) << "Right channel, bin " << i;
+    }
+}
+
+TEST(projectMStereoFFT, SmallTransformSizes)
+{
+    static constexpr double pi = 3.141592653589793238462643383279502884197169399;
+
+    auto const left = Noise(10, 100.0f);
+    auto const right = Sine(5000.0f, 60.0f);
+
+    for (size_t samplesOut = 1; samplesOut <= 8; samplesOut *= 2)
+    {
+        size_t const transformSize = samplesOut * 2;
+        StereoFFT stereoFFT(transformSize, samplesOut, false, -1.0f);
+        ASSERT_EQ(stereoFFT.NumFrequencies(), transformSize);
+
+        std::vector<float> actualLeft(samplesOut);
+        std::vector<float> actualRight(samplesOut);
+        stereoFFT.TimeToFrequencyDomain(left.data(), right.data(), actualLeft.data(), actualRight.data());
+
+        for (size_t k = 0; k < samplesOut; k++)
+        {
+            std::complex<double> sumLeft;
+            std::complex<double> sumRight;
+            for (size_t i = 0; i < transformSize; i++)
+            {
+                auto const twiddle = std::polar(1.0, -2.0 * pi * static_cast<double>(k * i) / transformSize);
+                sumLeft += static_cast<double>(left[i]) * twiddle;
+                sumRight += static_cast<double>(right[i]) * twiddle;
+            }
+
+            EXPECT_NEAR(actualLeft[k], std::abs(sumLeft), 1e-3) << "Size " << samplesOut << ", left channel, bin " << k;
+            EXPECT_NEAR(actualRight[k], std::abs(sumRight), 1e-3) << "Size " << samplesOut << ", right channel, bin " << k;
+        }
+    }
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <projectM-opengl.h>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <string>
+
+/**
+ * Creates a surfaceless OpenGL context, e.g. on Mesa's software renderer, and makes it current.
+ * A small framebuffer is bound, as draw calls need a complete framebuffer.
+ */
+class SurfacelessGLContext
+{
+public:
+    SurfacelessGLContext() = default;
+
+    SurfacelessGLContext(const SurfacelessGLContext&) = delete;
+    auto operator=(const SurfacelessGLContext&) -> SurfacelessGLContext& = delete;
+
+    ~SurfacelessGLContext()
+    {
+        if (m_display == EGL_NO_DISPLAY)
+        {
+            return;
+        }
+
+        if (m_context != EGL_NO_CONTEXT)
+        {
+            glDeleteFramebuffers(1, &m_framebuffer);
+            glDeleteRenderbuffers(1, &m_renderbuffer);
+        }
+
+        eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (m_context != EGL_NO_CONTEXT)
+        {
+            eglDestroyContext(m_display, m_context);
+        }
+        eglTerminate(m_display);
+    }
+
+    /**
+     * Creates the context.
+     * @return An empty string on success, otherwise the reason the context isn't available.
+     */
+    auto Create() -> std::string
+    {
+        auto const getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+        if (getPlatformDisplay == nullptr)
+        {
+            return "EGL platform displays not supported.";
+        }
+
+        m_display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+        if (m_display == EGL_NO_DISPLAY || eglInitialize(m_display, nullptr, nullptr) != EGL_TRUE)
+        {
+            m_display = EGL_NO_DISPLAY;
+            return "No surfaceless EGL display available.";
+        }
+
+#ifdef USE_GLES
+        eglBindAPI(EGL_OPENGL_ES_API);
+        EGLint const contextAttributes[]{EGL_CONTEXT_MAJOR_VERSION, 3, EGL_NONE};
+#else
+        eglBindAPI(EGL_OPENGL_API);
+        EGLint const contextAttributes[]{EGL_CONTEXT_MAJOR_VERSION, 3, EGL_CONTEXT_MINOR_VERSION, 3,
+                                         EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT, EGL_NONE};
+#endif
+
+        m_context = eglCreateContext(m_display, nullptr, EGL_NO_CONTEXT, contextAttributes);
+        if (m_context == EGL_NO_CONTEXT || eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, m_context) != EGL_TRUE)
+        {
+            return "Could not create a surfaceless OpenGL 3.3 context.";
+        }
+
+        glGenFramebuffers(1, &m_framebuffer);
+        glGenRenderbuffers(1, &m_renderbuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, m_renderbuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, 4, 4);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_renderbuffer);
+
+        return {};
+    }
+
+private:
+    EGLDisplay m_display{EGL_NO_DISPLAY};
+    EGLContext m_context{EGL_NO_CONTEXT};
+    GLuint m_framebuffer{};
+    GLuint m_renderbuffer{};
+};
@@ -2,6 +2,9 @@
 
 #include <gtest/gtest.h>
 
+#include <cmath>
+#include <random>
+
 using namespace libprojectM::Audio;
 
 /**
@@ -16,6 +19,7 @@ private:
      * stick to the original structure as much as possible.
      */
     FRIEND_TEST(projectMWaveformAligner, AlignDelta);
+    FRIEND_TEST(projectMWaveformAligner, VectorizedMatchesScalar);
 };
 
 TEST(projectMWaveformAligner, AlignDelta)
@@ -83,3 +87,52 @@ TEST(projectMWaveformAligner, AlignDelta)
         wf[AudioBufferSamples/2] = 0.0f;
     }
 }
+
+TEST(projectMWaveformAligner, VectorizedMatchesScalar)
+{
+    auto vectorized = WaveformAlignerMock();
+    auto scalar = WaveformAlignerMock();
+    scalar.m_vectorizedErrorSums = false;
+
+    std::mt19937 generator(42);
+    std::uniform_real_distribution<float> noise(-1.0f, 1.0f);
+
+    WaveformBuffer wf{};
+    for (int frame = 0; frame < 50; frame++)
+    {
+        // Slowly moving sine plus noise, so there's a clear but not trivial best offset.
+        for (size_t i = 0; i < AudioBufferSamples; i++)
+        {
+            wf[i] = 100.0f * std::sin(static_cast<float>(i + frame * 13) * 0.05f) + 20.0f * noise(generator);
+        }
+
+        auto vectorizedWf = wf;
+        auto scalarWf = wf;
+
+        if (frame > 0)
+        {
+            // Compare all error sums the search could possibly use.
+            std::vector<WaveformBuffer> mips(vectorized.m_octaves, WaveformBuffer());
+            vectorized.ResampleOctaves(mips, wf);
+            for (uint32_t octave = 0; octave < vectorized.m_octaves; octave++)
+            {
+                for (int offset = 0; offset < static_cast<int>(vectorized.m_octaveSampleSpacing[octave]); offset += 4)
+                {
+                    float vectorizedSums[4];
+                    float scalarSums[4];
+                    vectorized.CalculateErrorSums(mips[octave], octave, offset, vectorizedSums);
+                    scalar.CalculateErrorSums(mips[octave], octave, offset, scalarSums);
+                    for (int lane = 0; lane < 4 && offset + lane < static_cast<int>(vectorized.m_octaveSampleSpacing[octave]); lane++)
+                    {
+                        ASSERT_EQ(vectorizedSums[lane], scalarSums[lane]) << "Octave " << octave << ", offset " << offset + lane;
+                    }
+                }
+            }
+        }
+
+        vectorized.Align(vectorizedWf);
+        scalar.Align(scalarWf);
+
+        ASSERT_EQ(vectorizedWf, scalarWf) << "Frame " << frame;
+    }
+}
@@ -0,0 +1,95 @@
+#include <gtest/gtest.h>
+
+#include <MilkdropPreset/WorkerPool.hpp>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using libprojectM::MilkdropPreset::WorkerPool;
+
+TEST(projectMWorkerPool, RunsEachTaskOnce)
+{
+    WorkerPool pool(3);
+    EXPECT_EQ(pool.Concurrency(), 4u);
+
+    for (size_t const taskCount : std::vector<size_t>{0, 1, 2, 7, 100})
+    {
+        std::vector<std::atomic<int>> runs(taskCount);
+        for (auto& run : runs)
+        {
+            run = 0;
+        }
+
+        pool.ParallelFor(taskCount, [&runs, &pool](size_t task, size_t slot) {
+            EXPECT_LT(slot, pool.Concurrency());
+            runs[task]++;
+        });
+
+        for (auto& run : runs)
+        {
+            EXPECT_EQ(run.load(), 1);
+        }
+    }
+}
+
+TEST(projectMWorkerPool, NoWorkersRunsOnCallingThread)
+{
+    WorkerPool pool(0);
+    EXPECT_EQ(pool.Concurrency(), 1u);
+
+    auto const callerId = std::this_thread::get_id();
+    size_t tasks{0};
+    pool.ParallelFor(10, [&](size_t, size_t slot) {
+        EXPECT_EQ(slot, 0u);
+        EXPECT_EQ(std::this_thread::get_id(), callerId);
+        tasks++;
+    });
+
+    EXPECT_EQ(tasks, 10u);
+}
+
+TEST(projectMWorkerPool, SlotsAreExclusive)
+{
+    WorkerPool pool(3);
+
+    std::vector<std::atomic<bool>> slotBusy(pool.Concurrency());
+    for (auto& busy : slotBusy)
+    {
+        busy = false;
+    }
+
+    for (int run = 0; run < 20; run++)
+    {
+        pool.ParallelFor(64, [&slotBusy](size_t, size_t slot) {
+            EXPECT_FALSE(slotBusy[slot].exchange(true));
+            std::this_thread::yield();
+            slotBusy[slot] = false;
+        });
+    }
+}
+
+TEST(projectMWorkerPool, ConcurrentCallers)
+{
+    WorkerPool pool(2);
+
+    std::atomic<int> total{0};
+    std::vector<std::thread> callers;
+    for (int caller = 0; caller < 4; caller++)
+    {
+        callers.emplace_back([&pool, &total]() {
+            for (int run = 0; run < 10; run++)
+            {
+                pool.ParallelFor(16, [&total](size_t, size_t) {
+                    total++;
+                });
+            }
+        });
+    }
+    for (auto& caller : callers)
+    {
+        caller.join();
+    }
+
+    EXPECT_EQ(total.load(), 4 * 10 * 16);
+}
@@ -404,6 +404,52 @@ TEST(projectMPlaylistAPI, SetRetryCount)
 }
 
 
+TEST(projectMPlaylistAPI, GetPrefetchDepth)
+{
+    PlaylistCWrapperMock mockPlaylist;
+
+    EXPECT_CALL(mockPlaylist, PrefetchDepth())
+        .Times(1)
+        .WillOnce(Return(3));
+
+    EXPECT_EQ(projectm_playlist_get_prefetch_depth(reinterpret_cast<projectm_playlist_handle>(&mockPlaylist)), 3);
+}
+
+
+TEST(projectMPlaylistAPI, SetPrefetchDepth)
+{
+    PlaylistCWrapperMock mockPlaylist;
+
+    EXPECT_CALL(mockPlaylist, SetPrefetchDepth(3))
+        .Times(1);
+
+    projectm_playlist_set_prefetch_depth(reinterpret_cast<projectm_playlist_handle>(&mockPlaylist), 3);
+}
+
+
+TEST(projectMPlaylistAPI, GetAsyncLoading)
+{
+    PlaylistCWrapperMock mockPlaylist;
+
+    EXPECT_CALL(mockPlaylist, AsyncLoading())
+        .Times(1)
+        .WillOnce(Return(true));
+
+    EXPECT_TRUE(projectm_playlist_get_async_loading(reinterpret_cast<projectm_playlist_handle>(&mockPlaylist)));
+}
+
+
+TEST(projectMPlaylistAPI, SetAsyncLoading)
+{
+    PlaylistCWrapperMock mockPlaylist;
+
+    EXPECT_CALL(mockPlaylist, SetAsyncLoading(true))
+        .Times(1);
+
+    projectm_playlist_set_async_loading(reinterpret_cast<projectm_playlist_handle>(&mockPlaylist), true);
+}
+
+
 TEST(projectMPlaylistAPI, GetPosition)
 {
     PlaylistCWrapperMock mockPlaylist;
@@ -26,9 +26,14 @@ public:
     MOCK_METHOD(void, Sort, (uint32_t, uint32_t, SortPredicate, SortOrder));
     MOCK_METHOD(uint32_t, RetryCount, ());
     MOCK_METHOD(void, SetRetryCount, (uint32_t));
+    MOCK_METHOD(uint32_t, PrefetchDepth, ());
+    MOCK_METHOD(void, SetPrefetchDepth, (uint32_t));
+    MOCK_METHOD(bool, AsyncLoading, ());
+    MOCK_METHOD(void, SetAsyncLoading, (bool));
     MOCK_METHOD(uint32_t, NextPresetIndex, (), ());
     MOCK_METHOD(uint32_t, PreviousPresetIndex, (), ());
     MOCK_METHOD(uint32_t, LastPresetIndex, (), ());
+    MOCK_METHOD(std::vector<uint32_t>, UpcomingPresetIndices, (uint32_t));
     MOCK_METHOD(uint32_t, PresetIndex, (), (const));
     MOCK_METHOD(uint32_t, SetPresetIndex, (uint32_t));
     MOCK_METHOD(void, PlayPresetIndex, (uint32_t, bool, bool) );
@@ -506,6 +506,104 @@ TEST(projectMPlaylistPlaylist, NextPresetIndexSequential)
 }
 
 
+TEST(projectMPlaylistPlaylist, NextPresetIndexShuffleAllPresetsPlayed)
+{
+    Playlist playlist;
+
+    playlist.SetShuffle(true);
+
+    for (int i = 0; i < 10; i++)
+    {
+        EXPECT_TRUE(playlist.AddItem("/some/Preset" + std::to_string(i) + ".milk", Playlist::InsertAtEnd, false));
+    }
+
+    // Each round must play every preset exactly once, and no preset twice in a row.
+    uint32_t lastIndex = playlist.PresetIndex();
+    for (int round = 0; round < 5; round++)
+    {
+        std::set<uint32_t> playlistIndices;
+        for (int i = 0; i < 10; i++)
+        {
+            auto const index = playlist.NextPresetIndex();
+            EXPECT_NE(index, lastIndex);
+            playlistIndices.insert(index);
+            lastIndex = index;
+        }
+
+        EXPECT_EQ(playlistIndices.size(), 10);
+    }
+}
+
+
+TEST(projectMPlaylistPlaylist, UpcomingPresetIndicesEmptyPlaylist)
+{
+    Playlist playlist;
+
+    EXPECT_TRUE(playlist.UpcomingPresetIndices(3).empty());
+}
+
+
+TEST(projectMPlaylistPlaylist, UpcomingPresetIndicesSequential)
+{
+    Playlist playlist;
+
+    playlist.SetShuffle(false);
+
+    EXPECT_TRUE(playlist.AddItem("/some/PresetZ.milk", Playlist::InsertAtEnd, false));
+    EXPECT_TRUE(playlist.AddItem("/some/PresetA.milk", Playlist::InsertAtEnd, false));
+    EXPECT_TRUE(playlist.AddItem("/some/other/PresetC.milk", Playlist::InsertAtEnd, false));
+
+    EXPECT_EQ(playlist.UpcomingPresetIndices(4), std::vector<uint32_t>({1, 2, 0, 1}));
+
+    // Querying must not change the position.
+    EXPECT_EQ(playlist.PresetIndex(), 0);
+    EXPECT_EQ(playlist.NextPresetIndex(), 1);
+    EXPECT_EQ(playlist.UpcomingPresetIndices(2), std::vector<uint32_t>({2, 0}));
+}
+
+
+TEST(projectMPlaylistPlaylist, UpcomingPresetIndicesShuffle)
+{
+    Playlist playlist;
+
+    playlist.SetShuffle(true);
+
+    for (int i = 0; i < 5; i++)
+    {
+        EXPECT_TRUE(playlist.AddItem("/some/Preset" + std::to_string(i) + ".milk", Playlist::InsertAtEnd, false));
+    }
+
+    // Spans more than one shuffle round.
+    auto const upcomingIndices = playlist.UpcomingPresetIndices(12);
+    ASSERT_EQ(upcomingIndices.size(), 12);
+    EXPECT_EQ(playlist.UpcomingPresetIndices(12), upcomingIndices);
+
+    for (auto upcomingIndex : upcomingIndices)
+    {
+        EXPECT_EQ(playlist.NextPresetIndex(), upcomingIndex);
+    }
+}
+
+
+TEST(projectMPlaylistPlaylist, UpcomingPresetIndicesShuffleResetOnChange)
+{
+    Playlist playlist;
+
+    playlist.SetShuffle(true);
+
+    EXPECT_TRUE(playlist.AddItem("/some/PresetZ.milk", Playlist::InsertAtEnd, false));
+    EXPECT_TRUE(playlist.AddItem("/some/PresetA.milk", Playlist::InsertAtEnd, false));
+
+    EXPECT_EQ(playlist.UpcomingPresetIndices(4).size(), 4);
+
+    // The new item must be part of the next round.
+    EXPECT_TRUE(playlist.AddItem("/some/other/PresetC.milk", Playlist::InsertAtEnd, false));
+
+    auto const upcomingIndices = playlist.UpcomingPresetIndices(3);
+    EXPECT_EQ(std::set<uint32_t>(upcomingIndices.begin(), upcomingIndices.end()), std::set<uint32_t>({0, 1, 2}));
+}
+
+
 TEST(projectMPlaylistPlaylist, PreviousPresetIndexEmptyPlaylist)
 {
     Playlist playlist;
@@ -22,3 +22,12 @@ PROJECTM_EXPORT void projectm_load_preset_file(projectm_handle, const char*,
                                bool)
 {
 }
+
+PROJECTM_EXPORT void projectm_load_preset_file_async(projectm_handle, const char*,
+                                     bool)
+{
+}
+
+PROJECTM_EXPORT void projectm_prefetch_preset_file(projectm_handle, const char*)
+{
+}